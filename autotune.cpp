@@ -0,0 +1,358 @@
+#include "autotune.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A candidate must beat the best so far by this much to replace it, so
+// noise alone does not move the setting.
+const double AUTOTUNE_MARGIN = 0.03;
+
+// Block shapes tried, in cells; width 0 is a strip of full rows.
+static const int32_t BLOCK_SHAPES[][2] = {
+   {64, 64}, {128, 128}, {256, 256}, {256, 64}, {512, 128}, {0, 64}, {0, 128}, {0, 256}
+};
+
+const size_t PROFILE_LINE_SIZE = 1024;
+
+autotune_config_t autotune_default_config()
+{
+   autotune_config_t config;
+   config.trial_seconds = 0.25;
+   config.trial_generations = 4;
+   config.max_generations = 0;
+   config.affinity = JOB_AFFINITY_NONE;
+   config.tune_threads = true;
+   config.tune_blocks = true;
+   config.tune_kernels = true;
+   return config;
+}
+
+static double now_seconds()
+{
+   return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void autotune_current(autotune_setting_t * setting)
+{
+   game_get_tuning(&setting->tuning);
+   setting->threads = (setting->tuning.multi_thread && job_queue_worker_count()) ? job_queue_worker_count() + 1 : 1;
+   setting->generations_per_sec = 0;
+}
+
+void autotune_apply(const autotune_setting_t * setting, job_affinity_t affinity)
+{
+   game_tuning_t tuning = setting->tuning;
+   uint32_t workers = setting->threads > 1 ? setting->threads - 1 : 0;
+   if (job_queue_worker_count() != workers) {
+      if (job_queue_worker_count()) {
+         job_queue_shutdown();
+      }
+      if (workers) {
+         job_queue_init(workers, affinity);
+      }
+   }
+   tuning.multi_thread = workers != 0;
+   game_set_tuning(&tuning);
+}
+
+struct tuner_t {
+   const autotune_config_t * config;
+   uint64_t advanced;
+   autotune_setting_t best;
+};
+
+static uint32_t budget(const tuner_t * tuner)
+{
+   if (!tuner->config->max_generations) {
+      return UINT32_MAX;
+   }
+   return (uint32_t)std::min<uint64_t>(tuner->config->max_generations - tuner->advanced, UINT32_MAX);
+}
+
+// Runs `candidate` and keeps it if it beats the best so far.
+static void try_candidate(tuner_t * tuner, autotune_setting_t candidate)
+{
+   if (budget(tuner) == 0) {
+      return;
+   }
+   autotune_apply(&candidate, tuner->config->affinity);
+   // The first generation pays for new threads and cold caches
+   tuner->advanced += game_advance(budget(tuner), NULL);
+
+   uint64_t generations = 0;
+   double start = now_seconds(), seconds = 0;
+   while (budget(tuner) && (generations < tuner->config->trial_generations || seconds < tuner->config->trial_seconds))
+   {
+      uint32_t done = game_advance(budget(tuner), NULL);
+      tuner->advanced += done;
+      generations += done;
+      seconds = now_seconds() - start;
+   }
+   if (generations < tuner->config->trial_generations || seconds <= 0) {
+      return;
+   }
+   candidate.generations_per_sec = generations / seconds;
+   if (candidate.generations_per_sec > tuner->best.generations_per_sec * (1 + AUTOTUNE_MARGIN)) {
+      tuner->best = candidate;
+   }
+}
+
+// Chunks a block spans, as game.cpp rounds them, to skip shapes that the
+// board makes equal.
+static void block_chunks(const game_config_t * game, int32_t width, int32_t height, int32_t * chunks_x, int32_t * chunks_y)
+{
+   int32_t board_x = game->width / CHUNK_SIZE + 1, board_y = game->height / CHUNK_SIZE + 1;
+   *chunks_x = width > 0 ? std::min((width + CHUNK_SIZE - 1) / CHUNK_SIZE, board_x) : board_x;
+   *chunks_y = height > 0 ? std::min((height + CHUNK_SIZE - 1) / CHUNK_SIZE, board_y) : board_y;
+}
+
+uint64_t autotune_run(const autotune_config_t * config, const game_config_t * game, autotune_setting_t * best)
+{
+   tuner_t tuner;
+   tuner.config = config;
+   tuner.advanced = 0;
+   autotune_current(&tuner.best);
+   try_candidate(&tuner, tuner.best);
+
+   if (config->tune_threads) {
+      uint32_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+      uint32_t max_threads = std::min(hardware_threads, JOB_QUEUE_MAX_WORKERS + 1);
+      std::vector<uint32_t> counts;
+      for (uint32_t threads = 1; threads < max_threads; threads *= 2)
+      {
+         counts.push_back(threads);
+      }
+      counts.push_back(max_threads);
+      for (auto threads : counts)
+      {
+         if (threads != tuner.best.threads) {
+            autotune_setting_t candidate = tuner.best;
+            candidate.threads = threads;
+            try_candidate(&tuner, candidate);
+         }
+      }
+   }
+
+   // Tiles on the plane and temporal blocking do not run in blocks
+   if (config->tune_blocks && game->topology != TOPOLOGY_INFINITE && game->temporal_steps <= 1) {
+      std::vector<int32_t> tried;
+      for (size_t i = 0; i < sizeof(BLOCK_SHAPES) / sizeof(BLOCK_SHAPES[0]); i++)
+      {
+         int32_t chunks_x, chunks_y, best_x, best_y;
+         block_chunks(game, BLOCK_SHAPES[i][0], BLOCK_SHAPES[i][1], &chunks_x, &chunks_y);
+         block_chunks(game, tuner.best.tuning.block_width, tuner.best.tuning.block_height, &best_x, &best_y);
+         int32_t shape = (chunks_y << 16) | chunks_x;
+         if ((chunks_x == best_x && chunks_y == best_y) || std::find(tried.begin(), tried.end(), shape) != tried.end()) {
+            continue;
+         }
+         tried.push_back(shape);
+         autotune_setting_t candidate = tuner.best;
+         candidate.tuning.block_width = BLOCK_SHAPES[i][0];
+         candidate.tuning.block_height = BLOCK_SHAPES[i][1];
+         try_candidate(&tuner, candidate);
+      }
+   }
+
+   // Other rules do not run on the kernels
+   if (config->tune_kernels && game->topology != TOPOLOGY_INFINITE && rule_is_conway(game_rule())) {
+      for (uint32_t level = 0; level < SIMD_LEVEL_COUNT; level++)
+      {
+         const update_kernels_t * kernels = update_kernels_get((simd_level_t)level);
+         if (kernels->level == (simd_level_t)level && kernels != tuner.best.tuning.kernels) {
+            autotune_setting_t candidate = tuner.best;
+            candidate.tuning.kernels = kernels;
+            try_candidate(&tuner, candidate);
+         }
+      }
+   }
+
+   autotune_apply(&tuner.best, config->affinity);
+   *best = tuner.best;
+   return tuner.advanced;
+}
+
+void autotune_key(const game_config_t * game, char * key, size_t size)
+{
+   char pattern[256];
+   switch (game->pattern)
+   {
+      case SEED_GLIDER_GUNS: snprintf(pattern, sizeof(pattern), "guns"); break;
+      case SEED_LIDKA_PRED: snprintf(pattern, sizeof(pattern), "lidka"); break;
+      case SEED_RANDOM_SOUP: snprintf(pattern, sizeof(pattern), "soup%u", game->fill_percent); break;
+      case SEED_NONE: snprintf(pattern, sizeof(pattern), "none"); break;
+      case SEED_FILE:
+      {
+         const char * name = game->pattern_path ? game->pattern_path : "";
+         for (const char * c = name; *c; c++)
+         {
+            if (*c == '/' || *c == '\\') {
+               name = c + 1;
+            }
+         }
+         snprintf(pattern, sizeof(pattern), "%s", name);
+         break;
+      }
+   }
+   const char * topology = game->topology == TOPOLOGY_INFINITE ? "infinite" : game->topology == TOPOLOGY_TORUS ? "torus" : "bounded";
+   snprintf(key, size, "%dx%d,%s,%s,%s,%s,temporal=%u,cpus=%u", game->width, game->height, pattern,
+         game->topology == TOPOLOGY_INFINITE ? "tiles" : game->packed ? "packed" : "flat", topology, game_rule()->name,
+         std::max(game->temporal_steps, 1u), std::thread::hardware_concurrency());
+   // Keys end at the first space of a profile line
+   for (char * c = key; *c; c++)
+   {
+      if (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n') {
+         *c = '_';
+      }
+   }
+}
+
+static bool parse_block(const char * value, int32_t * width, int32_t * height)
+{
+   char * end;
+   if (!strncmp(value, "full", 4)) {
+      *width = 0;
+      end = (char *)value + 4;
+   } else {
+      *width = (int32_t)strtol(value, &end, 10);
+   }
+   if (*end != 'x' || *width < 0) {
+      return false;
+   }
+   *height = (int32_t)strtol(end + 1, &end, 10);
+   return *end == 0 && *height >= 0;
+}
+
+bool autotune_load(const char * path, const char * key, autotune_setting_t * setting)
+{
+   FILE * file = fopen(path, "r");
+   if (!file) {
+      return false;
+   }
+   char line[PROFILE_LINE_SIZE];
+   bool found = false;
+   size_t key_length = strlen(key);
+   while (!found && fgets(line, sizeof(line), file))
+   {
+      if (strncmp(line, key, key_length) != 0 || line[key_length] != ' ') {
+         continue;
+      }
+      autotune_current(setting);
+      uint32_t fields = 0;
+      for (char * token = strtok(line + key_length, " \t\r\n"); token; token = strtok(NULL, " \t\r\n"))
+      {
+         char * value = strchr(token, '=');
+         if (!value) {
+            continue;
+         }
+         *value++ = 0;
+         if (!strcmp(token, "threads")) {
+            setting->threads = std::max(1, atoi(value));
+            fields |= 1;
+         } else if (!strcmp(token, "kernel")) {
+            for (uint32_t level = 0; level < SIMD_LEVEL_COUNT; level++)
+            {
+               const update_kernels_t * kernels = update_kernels_get((simd_level_t)level);
+               if (kernels->level == (simd_level_t)level && !strcmp(kernels->name, value)) {
+                  setting->tuning.kernels = kernels;
+                  fields |= 2;
+               }
+            }
+         } else if (!strcmp(token, "block")) {
+            if (parse_block(value, &setting->tuning.block_width, &setting->tuning.block_height)) {
+               fields |= 4;
+            }
+         } else if (!strcmp(token, "generations_per_sec")) {
+            setting->generations_per_sec = strtod(value, NULL);
+         }
+      }
+      // A kernel this CPU cannot run does not count
+      found = fields == 7;
+   }
+   fclose(file);
+   return found;
+}
+
+bool autotune_save(const char * path, const char * key, const autotune_setting_t * setting, const char ** error)
+{
+   std::vector<std::string> lines;
+   size_t key_length = strlen(key);
+   FILE * file = fopen(path, "r");
+   if (file) {
+      char line[PROFILE_LINE_SIZE];
+      while (fgets(line, sizeof(line), file))
+      {
+         if (strncmp(line, key, key_length) != 0 || line[key_length] != ' ') {
+            lines.push_back(line);
+         }
+      }
+      fclose(file);
+   }
+
+   char block[64];
+   if (setting->tuning.block_width > 0) {
+      snprintf(block, sizeof(block), "%dx%d", setting->tuning.block_width, setting->tuning.block_height);
+   } else {
+      snprintf(block, sizeof(block), "fullx%d", setting->tuning.block_height);
+   }
+   const update_kernels_t * kernels = setting->tuning.kernels ? setting->tuning.kernels : update_kernels_select();
+   char line[PROFILE_LINE_SIZE];
+   snprintf(line, sizeof(line), "%s threads=%u kernel=%s block=%s generations_per_sec=%.1f\n", key, setting->threads,
+         kernels->name, block, setting->generations_per_sec);
+   lines.push_back(line);
+
+   file = fopen(path, "w");
+   if (!file) {
+      *error = "cannot write the profile";
+      return false;
+   }
+   bool ok = true;
+   for (const auto & entry : lines)
+   {
+      ok = ok && fputs(entry.c_str(), file) >= 0;
+   }
+   ok = (fclose(file) == 0) && ok;
+   if (!ok) {
+      *error = "cannot write the profile";
+   }
+   return ok;
+}
+
+void autotune_drift_init(autotune_drift_t * drift, double expected, double tolerance)
+{
+   drift->expected = expected;
+   drift->tolerance = tolerance;
+   drift->window_seconds = 1.0;
+   drift->patience = 3;
+   drift->strikes = 0;
+   drift->window_generations = 0;
+   drift->window_start = now_seconds();
+}
+
+bool autotune_drift_update(autotune_drift_t * drift, uint32_t generations)
+{
+   drift->window_generations += generations;
+   double now = now_seconds();
+   double seconds = now - drift->window_start;
+   if (seconds < drift->window_seconds || drift->expected <= 0) {
+      return false;
+   }
+   double rate = drift->window_generations / seconds;
+   drift->window_generations = 0;
+   drift->window_start = now;
+   if (std::fabs(rate / drift->expected - 1) <= drift->tolerance) {
+      drift->strikes = 0;
+      return false;
+   }
+   if (++drift->strikes < drift->patience) {
+      return false;
+   }
+   drift->strikes = 0;
+   return true;
+}
@@ -0,0 +1,78 @@
+#ifndef _AUTOTUNE_H
+#define _AUTOTUNE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "game.h"
+#include "job_queue.h"
+
+// Picks the game tuning and the number of threads for the board that is
+// running by trying candidates on it: thread counts, blocks of chunks per
+// job (strips of full rows among them) and kernels, one after the other,
+// each for a few generations. Every candidate computes the same
+// generations, so trying them just advances the board.
+//
+// The winners go to a profile file, one line per board and machine, that
+// later runs load at startup instead of tuning again:
+//
+//    4096x4096,soup25,packed,bounded,B3/S23,temporal=1,cpus=16 threads=8 kernel=avx2 block=fullx128 generations_per_sec=912.4
+
+struct autotune_setting_t {
+   game_tuning_t tuning;
+   uint32_t threads;                // the waiting thread included; 1 runs every job on it
+   double generations_per_sec;      // what the candidate ran at, 0 if not measured
+};
+
+struct autotune_config_t {
+   double trial_seconds;            // each candidate runs at least this long
+   uint32_t trial_generations;      // and at least this many generations, after one to warm up
+   uint64_t max_generations;        // never advance the board further, 0 = no limit
+   job_affinity_t affinity;         // of the job queue when it is restarted with other thread counts
+   bool tune_threads;               // false keeps the current setting's
+   bool tune_blocks;
+   bool tune_kernels;
+};
+
+autotune_config_t autotune_default_config();
+
+// The current setting, the job queue's thread count included.
+void autotune_current(autotune_setting_t * setting);
+
+// Applies a setting, restarting the job queue when its thread count differs.
+// Only between generations, and not while tracing: the trace buffers belong
+// to the workers.
+void autotune_apply(const autotune_setting_t * setting, job_affinity_t affinity);
+
+// Tries the candidates for the board `game` started from the current
+// setting, leaves the fastest applied and returns the generations advanced.
+uint64_t autotune_run(const autotune_config_t * config, const game_config_t * game, autotune_setting_t * best);
+
+// Profile key of the board game_init started from `game`: size, pattern,
+// representation, topology, rule and hardware threads.
+void autotune_key(const game_config_t * game, char * key, size_t size);
+
+// False if the profile cannot be read or has no line for `key`.
+bool autotune_load(const char * path, const char * key, autotune_setting_t * setting);
+
+// Replaces the line for `key`, keeping the other boards' lines.
+bool autotune_save(const char * path, const char * key, const autotune_setting_t * setting, const char ** error);
+
+// Watches the throughput of a run against what its setting was tuned at.
+struct autotune_drift_t {
+   double expected;                 // generations/sec
+   double tolerance;                // fraction of `expected` either way
+   double window_seconds;           // throughput is measured over windows this long
+   uint32_t patience;               // windows in a row outside the tolerance before it counts
+   uint32_t strikes;
+   uint64_t window_generations;
+   double window_start;
+};
+
+void autotune_drift_init(autotune_drift_t * drift, double expected, double tolerance);
+
+// Counts `generations` more; true once the throughput has been outside the
+// tolerance for `patience` windows in a row, then it starts over.
+bool autotune_drift_update(autotune_drift_t * drift, uint32_t generations);
+
+#endif // _AUTOTUNE_H
@@ -0,0 +1,608 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+#include "game.h"
+#include "job_queue.h"
+#include "domain.h"
+
+// Benchmark matrix over patterns, board sizes, update kernels, board
+// representation, render path and thread count, or with --ranks the strong
+// and weak scaling of a board split into slabs over processes. Results are
+// written as JSON, one case per line, and can be checked against a previous run.
+
+struct bench_pattern_t {
+   std::string name;
+   seed_pattern_t pattern;
+   uint32_t fill_percent;
+};
+
+struct bench_size_t {
+   int32_t width;
+   int32_t height;
+};
+
+struct bench_result_t {
+   std::string name;
+   std::string kernel;
+   std::string pattern;
+   bool packed;
+   bool render;
+   int32_t width;
+   int32_t height;
+   int32_t threads;
+   int32_t ranks;                // 0 outside the scaling cases
+   std::string scaling;          // "strong" or "weak"
+   double efficiency;            // against the first rank count of the same case
+   int32_t generations;
+   double seconds;
+   double gens_per_sec;
+   double cell_updates_per_sec;
+   uint64_t checksum;
+};
+
+struct bench_baseline_t {
+   std::string name;
+   int32_t generations;
+   double gens_per_sec;
+   uint64_t checksum;
+};
+
+const int32_t WARMUP_GENERATIONS = 8;
+const int32_t MAX_RANKS = 1024;
+
+static void usage(const char * program)
+{
+   fprintf(stderr,
+         "usage: %s [options]\n"
+         "  --patterns LIST      guns,lidka,soupN (N = fill percent; default guns,lidka,soup25,soup50)\n"
+         "  --sizes LIST         WxH,... (default 256x256,800x480,1600x960)\n"
+         "  --kernels LIST       scalar,sse2,avx2,avx512 (default: every supported one)\n"
+         "  --boards LIST        flat,packed (default both)\n"
+         "  --render LIST        off,on (default both)\n"
+         "  --threads LIST       thread counts (default 1,2,4,... up to the hardware threads)\n"
+         "  --ranks LIST         process counts: run strong and weak scaling cases over slabs instead\n"
+         "                       of the thread matrix (POSIX only; the guns pattern is skipped)\n"
+         "  --rank-threads N     threads per process in the scaling cases (default 1)\n"
+         "  --generations N      timed generations per run (default 200)\n"
+         "  --repeat N           runs per case, the median is reported (default 3)\n"
+         "  --output FILE        JSON results (default bench_results.json)\n"
+         "  --baseline FILE      previous results to check against\n"
+         "  --tolerance N        allowed slowdown against the baseline in percent (default 10)\n",
+         program);
+}
+
+static std::vector<std::string> split_list(const char * list)
+{
+   std::vector<std::string> items;
+   std::string item;
+   for (const char * c = list; ; c++)
+   {
+      if (*c == ',' || *c == 0) {
+         if (!item.empty()) {
+            items.push_back(item);
+         }
+         item.clear();
+         if (*c == 0) {
+            break;
+         }
+      } else {
+         item += *c;
+      }
+   }
+   return items;
+}
+
+static bool parse_int(const char * arg, int32_t min, int32_t max, int32_t * value)
+{
+   char * end;
+   long parsed = strtol(arg, &end, 10);
+   if (*arg == 0 || *end != 0 || parsed < min || parsed > max) {
+      return false;
+   }
+   *value = (int32_t)parsed;
+   return true;
+}
+
+static bool parse_patterns(const char * list, std::vector<bench_pattern_t> * patterns)
+{
+   patterns->clear();
+   for (auto & name : split_list(list))
+   {
+      bench_pattern_t pattern = {name, SEED_GLIDER_GUNS, 0};
+      int32_t fill = 0;
+      if (name == "guns") {
+         pattern.pattern = SEED_GLIDER_GUNS;
+      } else if (name == "lidka") {
+         pattern.pattern = SEED_LIDKA_PRED;
+      } else if (name.compare(0, 4, "soup") == 0 && parse_int(name.c_str() + 4, 0, 100, &fill)) {
+         pattern.pattern = SEED_RANDOM_SOUP;
+         pattern.fill_percent = fill;
+      } else {
+         return false;
+      }
+      patterns->push_back(pattern);
+   }
+   return !patterns->empty();
+}
+
+static bool parse_sizes(const char * list, std::vector<bench_size_t> * sizes)
+{
+   sizes->clear();
+   for (auto & name : split_list(list))
+   {
+      bench_size_t size;
+      char tail;
+      if (sscanf(name.c_str(), "%dx%d%c", &size.width, &size.height, &tail) != 2 ||
+            size.width < 1 || size.height < 1) {
+         return false;
+      }
+      sizes->push_back(size);
+   }
+   return !sizes->empty();
+}
+
+static bool parse_kernels(const char * list, std::vector<const update_kernels_t *> * kernels)
+{
+   kernels->clear();
+   for (auto & name : split_list(list))
+   {
+      const update_kernels_t * found = NULL;
+      for (uint32_t level = 0; level < SIMD_LEVEL_COUNT; level++)
+      {
+         const update_kernels_t * candidate = update_kernels_get((simd_level_t)level);
+         if (candidate->level == (simd_level_t)level && name == candidate->name) {
+            found = candidate;
+         }
+      }
+      if (!found) {
+         return false;
+      }
+      kernels->push_back(found);
+   }
+   return !kernels->empty();
+}
+
+static bool parse_flags(const char * list, const char * off, const char * on, std::vector<bool> * flags)
+{
+   flags->clear();
+   for (auto & name : split_list(list))
+   {
+      if (name == off) {
+         flags->push_back(false);
+      } else if (name == on) {
+         flags->push_back(true);
+      } else {
+         return false;
+      }
+   }
+   return !flags->empty();
+}
+
+static bool parse_threads(const char * list, std::vector<int32_t> * threads)
+{
+   threads->clear();
+   for (auto & name : split_list(list))
+   {
+      int32_t count;
+      if (!parse_int(name.c_str(), 1, JOB_QUEUE_MAX_WORKERS + 1, &count)) {
+         return false;
+      }
+      threads->push_back(count);
+   }
+   return !threads->empty();
+}
+
+static bool parse_ranks(const char * list, std::vector<int32_t> * ranks)
+{
+   ranks->clear();
+   for (auto & name : split_list(list))
+   {
+      int32_t count;
+      if (!parse_int(name.c_str(), 1, MAX_RANKS, &count)) {
+         return false;
+      }
+      ranks->push_back(count);
+   }
+   return !ranks->empty();
+}
+
+static double run_case(const game_config_t * config, const render_target_t * target, int32_t generations, uint64_t * checksum)
+{
+   if (!game_init(config)) {
+      fprintf(stderr, "cannot start a %d x %d board: %s\n", config->width, config->height, game_init_error());
+      exit(1);
+   }
+   for (auto i = 0; i < WARMUP_GENERATIONS; i++)
+   {
+      game_update_and_render(target);
+   }
+
+   auto start = std::chrono::steady_clock::now();
+   for (auto i = 0; i < generations; i++)
+   {
+      game_update_and_render(target);
+   }
+   auto end = std::chrono::steady_clock::now();
+
+   *checksum = game_checksum();
+   return std::chrono::duration<double>(end - start).count();
+}
+
+// Strong scaling splits the same board over every rank count, weak scaling
+// gives each process a slab of `size.height` rows. Slab runs do no warmup and
+// no rendering. Returns the number of rank counts whose board differs from the
+// first one's in the strong cases, which all end on the same board.
+static uint32_t run_scaling(const bench_pattern_t & pattern, const bench_size_t & size, const update_kernels_t * kernel,
+      bool packed, const std::vector<int32_t> & ranks, int32_t rank_threads, int32_t generations, int32_t repeat,
+      std::vector<bench_result_t> * results)
+{
+   uint32_t mismatches = 0;
+   std::vector<double> times(repeat);
+   for (int weak = 0; weak < 2; weak++)
+   {
+      double first_seconds = 0;
+      int32_t first_ranks = 0;
+      uint64_t first_checksum = 0;
+      for (auto rank_count : ranks)
+      {
+         domain_config_t domain;
+         domain.game = game_default_config();
+         domain.game.width = size.width;
+         domain.game.height = weak ? size.height * rank_count : size.height;
+         domain.game.pattern = pattern.pattern;
+         domain.game.fill_percent = pattern.fill_percent;
+         domain.game.packed = packed;
+         domain.game.multi_thread = rank_threads > 1;
+         domain.game.kernels = kernel;
+         domain.ranks = rank_count;
+         domain.threads_per_rank = rank_threads;
+         domain.generations = generations;
+
+         domain_result_t result;
+         for (auto i = 0; i < repeat; i++)
+         {
+            const char * error = NULL;
+            if (!domain_run(&domain, &result, &error)) {
+               fprintf(stderr, "cannot run %d slabs of a %d x %d board: %s\n", rank_count,
+                     domain.game.width, domain.game.height, error);
+               exit(1);
+            }
+            times[i] = result.seconds;
+         }
+         std::sort(times.begin(), times.end());
+
+         char name[128];
+         snprintf(name, sizeof(name), "%s/%dx%d/%s-%s/%s/r%dt%d", pattern.name.c_str(), size.width, size.height,
+               packed ? "packed" : "flat", kernel->name, weak ? "weak" : "strong", rank_count, rank_threads);
+         bench_result_t r;
+         r.name = name;
+         r.kernel = kernel->name;
+         r.pattern = pattern.name;
+         r.packed = packed;
+         r.render = false;
+         r.width = domain.game.width;
+         r.height = domain.game.height;
+         r.threads = rank_threads;
+         r.ranks = rank_count;
+         r.scaling = weak ? "weak" : "strong";
+         r.generations = generations;
+         r.seconds = times[repeat / 2];
+         r.gens_per_sec = (r.seconds > 0) ? generations / r.seconds : 0;
+         r.cell_updates_per_sec = r.gens_per_sec * (double)r.width * r.height;
+         r.checksum = result.checksum;
+
+         if (!first_ranks) {
+            first_seconds = r.seconds;
+            first_ranks = rank_count;
+            first_checksum = r.checksum;
+         }
+         // Ideal strong scaling divides the time by the added processes, ideal weak scaling keeps it
+         double ideal = weak ? first_seconds : first_seconds * first_ranks / rank_count;
+         r.efficiency = (r.seconds > 0) ? ideal / r.seconds : 0;
+         results->push_back(r);
+
+         printf("%-48s %10.1f gen/s %10.3e cells/s %6.1f%%  %016llx\n", r.name.c_str(),
+               r.gens_per_sec, r.cell_updates_per_sec, 100.0 * r.efficiency, (unsigned long long)r.checksum);
+         if (!weak && r.checksum != first_checksum) {
+            printf("MISMATCH   %-48s checksum %016llx, %d ranks %016llx\n", r.name.c_str(),
+                  (unsigned long long)r.checksum, first_ranks, (unsigned long long)first_checksum);
+            mismatches++;
+         }
+         fflush(stdout);
+      }
+   }
+   return mismatches;
+}
+
+// Reads back the case lines written by write_results; anything else is skipped.
+static bool read_baseline(const char * path, std::vector<bench_baseline_t> * baseline)
+{
+   FILE * file = fopen(path, "r");
+   if (!file) {
+      return false;
+   }
+   char line[1024];
+   while (fgets(line, sizeof(line), file))
+   {
+      const char * name = strstr(line, "\"name\": \"");
+      const char * generations = strstr(line, "\"generations\": ");
+      const char * gens_per_sec = strstr(line, "\"gens_per_sec\": ");
+      const char * checksum = strstr(line, "\"checksum\": \"");
+      if (!name || !generations || !gens_per_sec || !checksum) {
+         continue;
+      }
+      name += strlen("\"name\": \"");
+      const char * name_end = strchr(name, '"');
+      if (!name_end) {
+         continue;
+      }
+      bench_baseline_t entry;
+      entry.name.assign(name, name_end);
+      entry.generations = atoi(generations + strlen("\"generations\": "));
+      entry.gens_per_sec = atof(gens_per_sec + strlen("\"gens_per_sec\": "));
+      entry.checksum = strtoull(checksum + strlen("\"checksum\": \""), NULL, 16);
+      baseline->push_back(entry);
+   }
+   fclose(file);
+   return true;
+}
+
+static bool write_results(const char * path, const std::vector<bench_result_t> & results)
+{
+   FILE * file = fopen(path, "w");
+   if (!file) {
+      return false;
+   }
+   fprintf(file, "{\n");
+   fprintf(file, "  \"benchmark\": \"gol_bench\",\n");
+   fprintf(file, "  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+   fprintf(file, "  \"cases\": [\n");
+   for (size_t i = 0; i < results.size(); i++)
+   {
+      const bench_result_t & r = results[i];
+      char scaling[96] = "";
+      if (r.ranks) {
+         snprintf(scaling, sizeof(scaling), "\"ranks\": %d, \"scaling\": \"%s\", \"efficiency\": %.4f, ",
+               r.ranks, r.scaling.c_str(), r.efficiency);
+      }
+      fprintf(file, "    {\"name\": \"%s\", \"pattern\": \"%s\", \"width\": %d, \"height\": %d, "
+            "\"kernel\": \"%s\", \"packed\": %s, \"render\": %s, \"threads\": %d, "
+            "%s\"generations\": %d, \"seconds\": %.6f, \"gens_per_sec\": %.3f, "
+            "\"cell_updates_per_sec\": %.6e, \"checksum\": \"%016llx\"}%s\n",
+            r.name.c_str(), r.pattern.c_str(), r.width, r.height,
+            r.kernel.c_str(), r.packed ? "true" : "false", r.render ? "true" : "false", r.threads,
+            scaling, r.generations, r.seconds, r.gens_per_sec,
+            r.cell_updates_per_sec, (unsigned long long)r.checksum,
+            (i + 1 < results.size()) ? "," : "");
+   }
+   fprintf(file, "  ]\n}\n");
+   fclose(file);
+   return true;
+}
+
+// Returns the number of regressions: cases slower than the baseline by more
+// than `tolerance` percent, or with a different final board.
+static uint32_t check_baseline(const std::vector<bench_result_t> & results,
+      const std::vector<bench_baseline_t> & baseline, int32_t tolerance)
+{
+   uint32_t regressions = 0;
+   uint32_t compared = 0;
+   for (auto & r : results)
+   {
+      for (auto & b : baseline)
+      {
+         if (b.name != r.name) {
+            continue;
+         }
+         compared++;
+         double change = (b.gens_per_sec > 0) ? 100.0 * (r.gens_per_sec / b.gens_per_sec - 1.0) : 0.0;
+         if (b.generations == r.generations && b.checksum != r.checksum) {
+            printf("MISMATCH   %-48s checksum %016llx, baseline %016llx\n", r.name.c_str(),
+                  (unsigned long long)r.checksum, (unsigned long long)b.checksum);
+            regressions++;
+         } else if (change < -tolerance) {
+            printf("REGRESSION %-48s %10.1f gen/s, baseline %10.1f (%+.1f%%)\n", r.name.c_str(),
+                  r.gens_per_sec, b.gens_per_sec, change);
+            regressions++;
+         }
+         break;
+      }
+   }
+   printf("compared %u of %zu cases against the baseline, %u regressions\n",
+         compared, results.size(), regressions);
+   return regressions;
+}
+
+int main(int argc, char ** argv)
+{
+   std::vector<bench_pattern_t> patterns;
+   std::vector<bench_size_t> sizes;
+   std::vector<const update_kernels_t *> kernels;
+   std::vector<bool> boards;
+   std::vector<bool> renders;
+   std::vector<int32_t> threads;
+   std::vector<int32_t> ranks;
+   int32_t rank_threads = 1;
+   int32_t generations = 200;
+   int32_t repeat = 3;
+   int32_t tolerance = 10;
+   const char * output = "bench_results.json";
+   const char * baseline_path = NULL;
+
+   parse_patterns("guns,lidka,soup25,soup50", &patterns);
+   parse_sizes("256x256,800x480,1600x960", &sizes);
+   for (uint32_t level = 0; level <= simd_detect(); level++)
+   {
+      const update_kernels_t * candidate = update_kernels_get((simd_level_t)level);
+      if (candidate->level == (simd_level_t)level) {
+         kernels.push_back(candidate);
+      }
+   }
+   parse_flags("flat,packed", "flat", "packed", &boards);
+   parse_flags("off,on", "off", "on", &renders);
+   int32_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+   for (auto count = 1; count < hardware_threads; count *= 2)
+   {
+      threads.push_back(count);
+   }
+   threads.push_back(std::min(hardware_threads, (int32_t)JOB_QUEUE_MAX_WORKERS + 1));
+
+   for (auto i = 1; i < argc; i++)
+   {
+      const char * arg = argv[i];
+      const char * value = (i + 1 < argc) ? argv[i + 1] : "";
+      bool ok = true;
+
+      if (!strcmp(arg, "--patterns")) {
+         ok = parse_patterns(value, &patterns); i++;
+      } else if (!strcmp(arg, "--sizes")) {
+         ok = parse_sizes(value, &sizes); i++;
+      } else if (!strcmp(arg, "--kernels")) {
+         ok = parse_kernels(value, &kernels); i++;
+      } else if (!strcmp(arg, "--boards")) {
+         ok = parse_flags(value, "flat", "packed", &boards); i++;
+      } else if (!strcmp(arg, "--render")) {
+         ok = parse_flags(value, "off", "on", &renders); i++;
+      } else if (!strcmp(arg, "--threads")) {
+         ok = parse_threads(value, &threads); i++;
+      } else if (!strcmp(arg, "--ranks")) {
+         ok = parse_ranks(value, &ranks); i++;
+      } else if (!strcmp(arg, "--rank-threads")) {
+         ok = parse_int(value, 1, JOB_QUEUE_MAX_WORKERS + 1, &rank_threads); i++;
+      } else if (!strcmp(arg, "--generations")) {
+         ok = parse_int(value, 1, INT32_MAX, &generations); i++;
+      } else if (!strcmp(arg, "--repeat")) {
+         ok = parse_int(value, 1, 100, &repeat); i++;
+      } else if (!strcmp(arg, "--output")) {
+         output = value; i++;
+      } else if (!strcmp(arg, "--baseline")) {
+         baseline_path = value; i++;
+      } else if (!strcmp(arg, "--tolerance")) {
+         ok = parse_int(value, 0, 100, &tolerance); i++;
+      } else if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) {
+         usage(argv[0]);
+         return 0;
+      } else {
+         ok = false;
+      }
+
+      if (!ok) {
+         fprintf(stderr, "invalid argument: %s %s\n", arg, value);
+         usage(argv[0]);
+         return 1;
+      }
+   }
+
+   std::vector<bench_baseline_t> baseline;
+   if (baseline_path && !read_baseline(baseline_path, &baseline)) {
+      fprintf(stderr, "cannot read baseline %s\n", baseline_path);
+      return 1;
+   }
+
+   size_t max_pixels = 0;
+   for (auto & size : sizes)
+   {
+      max_pixels = std::max(max_pixels, (size_t)size.width * size.height);
+   }
+   std::vector<uint32_t> pixels(max_pixels);
+   // Render cases report their dirty rectangles like the Win32 front end does
+   std::vector<render_rect_t> dirty_rects(256);
+   render_dirty_t dirty = {dirty_rects.data(), (uint32_t)dirty_rects.size(), 0};
+   std::vector<bench_result_t> results;
+   std::vector<double> times(repeat);
+   uint32_t mismatches = 0;
+
+   // The processes are forked, so no job queue may be running in this one
+   if (!ranks.empty()) {
+      for (auto & pattern : patterns)
+      for (auto & size : sizes)
+      for (auto kernel : kernels)
+      for (bool packed : boards)
+      {
+         if (pattern.pattern == SEED_GLIDER_GUNS) {
+            continue;
+         }
+         mismatches += run_scaling(pattern, size, kernel, packed, ranks, rank_threads, generations, repeat, &results);
+      }
+      threads.clear();
+   }
+
+   for (auto thread_count : threads)
+   {
+      // One thread runs every chunk inline, N threads are N - 1 workers plus the caller
+      if (thread_count > 1) {
+         job_queue_init(thread_count - 1);
+      }
+      for (auto & pattern : patterns)
+      for (auto & size : sizes)
+      for (auto kernel : kernels)
+      for (bool packed : boards)
+      for (bool render : renders)
+      {
+         game_config_t config = game_default_config();
+         config.width = size.width;
+         config.height = size.height;
+         config.pattern = pattern.pattern;
+         config.fill_percent = pattern.fill_percent;
+         config.packed = packed;
+         config.multi_thread = thread_count > 1;
+         config.kernels = kernel;
+
+         render_target_t target;
+         target.pixels = pixels.data();
+         target.pitch = size.width;
+         target.pixels_per_cell = 1;
+         target.dirty = &dirty;
+
+         bench_result_t r;
+         for (auto i = 0; i < repeat; i++)
+         {
+            times[i] = run_case(&config, render ? &target : NULL, generations, &r.checksum);
+         }
+         std::sort(times.begin(), times.end());
+
+         char name[128];
+         snprintf(name, sizeof(name), "%s/%dx%d/%s-%s/%s/t%d", pattern.name.c_str(), size.width, size.height,
+               packed ? "packed" : "flat", kernel->name, render ? "render" : "norender", thread_count);
+         r.name = name;
+         r.kernel = kernel->name;
+         r.pattern = pattern.name;
+         r.packed = packed;
+         r.render = render;
+         r.width = size.width;
+         r.height = size.height;
+         r.threads = thread_count;
+         r.ranks = 0;
+         r.efficiency = 0;
+         r.generations = generations;
+         r.seconds = times[repeat / 2];
+         r.gens_per_sec = (r.seconds > 0) ? generations / r.seconds : 0;
+         r.cell_updates_per_sec = r.gens_per_sec * (double)size.width * size.height;
+         results.push_back(r);
+
+         printf("%-48s %10.1f gen/s %10.3e cells/s  %016llx\n", r.name.c_str(),
+               r.gens_per_sec, r.cell_updates_per_sec, (unsigned long long)r.checksum);
+         fflush(stdout);
+      }
+      if (thread_count > 1) {
+         job_queue_shutdown();
+      }
+   }
+
+   if (!write_results(output, results)) {
+      fprintf(stderr, "cannot write %s\n", output);
+      return 1;
+   }
+   printf("wrote %zu cases to %s\n", results.size(), output);
+
+   if (baseline_path && check_baseline(results, baseline, tolerance) > 0) {
+      return 2;
+   }
+   return (mismatches > 0) ? 2 : 0;
+}
@@ -0,0 +1,248 @@
+#include "board.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <malloc.h>
+#include <psapi.h>
+#else
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <cstdio>
+#endif
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static inline size_t round_up(size_t value, size_t multiple) { return (value + multiple - 1) / multiple * multiple; }
+
+// With `untouched` every path returns zeroed memory straight from the OS,
+// with no page faulted in yet.
+static void * board_memory_alloc(size_t * bytes, bool huge_pages, bool untouched, board_memory_t * memory)
+{
+   void * memory_ptr = NULL;
+
+#ifdef _WIN32
+   // Large pages need SeLockMemoryPrivilege, without it VirtualAlloc fails
+   size_t large_page = GetLargePageMinimum();
+   if (huge_pages && large_page) {
+      size_t size = round_up(*bytes, large_page);
+      memory_ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+      if (memory_ptr) {
+         *bytes = size;
+         *memory = BOARD_MEMORY_HUGE_PAGES;
+         return memory_ptr;
+      }
+   }
+   if (untouched) {
+      memory_ptr = VirtualAlloc(NULL, *bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+      *memory = BOARD_MEMORY_MAPPED;
+      return memory_ptr;
+   }
+   memory_ptr = _aligned_malloc(*bytes, BOARD_ALIGNMENT);
+   *memory = BOARD_MEMORY_HEAP;
+#else
+   if (huge_pages) {
+#ifdef MAP_HUGETLB
+      size_t size = round_up(*bytes, HUGE_PAGE_SIZE);
+      memory_ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (memory_ptr != MAP_FAILED) {
+         *bytes = size;
+         *memory = BOARD_MEMORY_HUGE_PAGES;
+         return memory_ptr;
+      }
+      memory_ptr = NULL;
+#endif
+      // No reserved huge pages: ask for transparent ones instead
+      *bytes = round_up(*bytes, HUGE_PAGE_SIZE);
+      if (untouched) {
+         memory_ptr = mmap(NULL, *bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+         if (memory_ptr == MAP_FAILED) {
+            return NULL;
+         }
+#ifdef MADV_HUGEPAGE
+         madvise(memory_ptr, *bytes, MADV_HUGEPAGE);
+#endif
+         *memory = BOARD_MEMORY_MAPPED;
+         return memory_ptr;
+      }
+      if (posix_memalign(&memory_ptr, HUGE_PAGE_SIZE, *bytes) != 0) {
+         return NULL;
+      }
+#ifdef MADV_HUGEPAGE
+      madvise(memory_ptr, *bytes, MADV_HUGEPAGE);
+#endif
+      *memory = BOARD_MEMORY_TRANSPARENT_HUGE;
+      return memory_ptr;
+   }
+   if (untouched) {
+      memory_ptr = mmap(NULL, *bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      *memory = BOARD_MEMORY_MAPPED;
+      return memory_ptr != MAP_FAILED ? memory_ptr : NULL;
+   }
+   if (posix_memalign(&memory_ptr, BOARD_ALIGNMENT, *bytes) != 0) {
+      return NULL;
+   }
+   *memory = BOARD_MEMORY_HEAP;
+#endif
+   return memory_ptr;
+}
+
+static void board_memory_free(void * memory_ptr, size_t bytes, board_memory_t memory)
+{
+   if (!memory_ptr) {
+      return;
+   }
+#ifdef _WIN32
+   (void)bytes;
+   if (memory == BOARD_MEMORY_HUGE_PAGES || memory == BOARD_MEMORY_MAPPED) {
+      VirtualFree(memory_ptr, 0, MEM_RELEASE);
+   } else {
+      _aligned_free(memory_ptr);
+   }
+#else
+   if (memory == BOARD_MEMORY_HUGE_PAGES || memory == BOARD_MEMORY_MAPPED) {
+      munmap(memory_ptr, bytes);
+   } else {
+      free(memory_ptr);
+   }
+#endif
+}
+
+bool board_create(board_t * board, int32_t width, int32_t height, bool huge_pages, bool untouched)
+{
+   const int32_t cells_per_line = BOARD_ALIGNMENT / sizeof(uint32_t);
+
+   board->width = width;
+   board->height = height;
+   board->pitch = (int32_t)round_up(width + 2, cells_per_line);
+   board->bytes = (size_t)board->pitch * (height + 2) * sizeof(uint32_t);
+   board->cells = (uint32_t *)board_memory_alloc(&board->bytes, huge_pages, untouched, &board->memory);
+   if (!board->cells) {
+      board->memory = BOARD_MEMORY_NONE;
+      return false;
+   }
+   if (!untouched) {
+      board_clear(board);
+   }
+   return true;
+}
+
+void board_destroy(board_t * board)
+{
+   board_memory_free(board->cells, board->bytes, board->memory);
+   board->cells = NULL;
+   board->bytes = 0;
+   board->memory = BOARD_MEMORY_NONE;
+}
+
+void board_clear(board_t * board)
+{
+   memset(board->cells, 0, board->bytes);
+}
+
+bool packed_board_create(packed_board_t * board, int32_t width, int32_t height, bool huge_pages, bool untouched)
+{
+   const int32_t words_per_line = BOARD_ALIGNMENT / sizeof(uint64_t);
+
+   // Bits 0 and width + 1 of each row are the halo
+   board->width = width;
+   board->height = height;
+   board->words_per_row = (int32_t)round_up((width + 2 + 63) / 64, words_per_line);
+   board->bytes = (size_t)board->words_per_row * (height + 2) * sizeof(uint64_t);
+   board->words = (uint64_t *)board_memory_alloc(&board->bytes, huge_pages, untouched, &board->memory);
+   if (!board->words) {
+      board->memory = BOARD_MEMORY_NONE;
+      return false;
+   }
+   if (!untouched) {
+      packed_board_clear(board);
+   }
+   return true;
+}
+
+void packed_board_destroy(packed_board_t * board)
+{
+   board_memory_free(board->words, board->bytes, board->memory);
+   board->words = NULL;
+   board->bytes = 0;
+   board->memory = BOARD_MEMORY_NONE;
+}
+
+void packed_board_clear(packed_board_t * board)
+{
+   memset(board->words, 0, board->bytes);
+}
+
+const char * board_memory_name(board_memory_t memory)
+{
+   switch (memory)
+   {
+      case BOARD_MEMORY_HEAP: return "heap";
+      case BOARD_MEMORY_HUGE_PAGES: return "huge pages";
+      case BOARD_MEMORY_TRANSPARENT_HUGE: return "transparent huge pages";
+      case BOARD_MEMORY_MAPPED: return "mapped pages";
+      default: return "none";
+   }
+}
+
+bool process_memory(size_t * resident, size_t * peak)
+{
+#ifdef _WIN32
+   PROCESS_MEMORY_COUNTERS counters;
+   if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+      return false;
+   }
+   *resident = counters.WorkingSetSize;
+   *peak = counters.PeakWorkingSetSize;
+   return true;
+#else
+   *resident = 0;
+   *peak = 0;
+   FILE * status = fopen("/proc/self/status", "r");
+   if (status) {
+      char line[256];
+      unsigned long long kb;
+      while (fgets(line, sizeof(line), status))
+      {
+         if (sscanf(line, "VmRSS: %llu kB", &kb) == 1) {
+            *resident = (size_t)kb * 1024;
+         } else if (sscanf(line, "VmHWM: %llu kB", &kb) == 1) {
+            *peak = (size_t)kb * 1024;
+         }
+      }
+      fclose(status);
+      return *peak != 0;
+   }
+   // Elsewhere only the peak, in kilobytes on Linux and the BSDs, bytes on macOS
+   struct rusage usage;
+   if (getrusage(RUSAGE_SELF, &usage) != 0) {
+      return false;
+   }
+#ifdef __APPLE__
+   *peak = (size_t)usage.ru_maxrss;
+#else
+   *peak = (size_t)usage.ru_maxrss * 1024;
+#endif
+   *resident = *peak;
+   return true;
+#endif
+}
+
+bool process_memory_reset_peak()
+{
+#ifdef __linux__
+   FILE * clear_refs = fopen("/proc/self/clear_refs", "w");
+   if (!clear_refs) {
+      return false;
+   }
+   bool ok = fputs("5", clear_refs) >= 0;
+   return (fclose(clear_refs) == 0) && ok;
+#else
+   return false;
+#endif
+}
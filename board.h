@@ -0,0 +1,70 @@
+#ifndef _BOARD_H
+#define _BOARD_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Boards sized at runtime. Live cells are [1, width] x [1, height]; row and
+// column 0 and width + 1 / height + 1 form a dead halo ring, so kernels can
+// read every neighbour of a live cell without bounds checks. Every row starts
+// on a cache line.
+
+const int32_t BOARD_ALIGNMENT = 64;
+
+enum board_memory_t {
+   BOARD_MEMORY_NONE,
+   BOARD_MEMORY_HEAP,
+   BOARD_MEMORY_HUGE_PAGES,         // explicit huge/large pages
+   BOARD_MEMORY_TRANSPARENT_HUGE,   // heap memory advised to use huge pages
+   BOARD_MEMORY_MAPPED              // straight from the OS, placed by first touch
+};
+
+struct board_t {
+   int32_t width;
+   int32_t height;
+   int32_t pitch;                // cells per row, a multiple of the cache line
+   uint32_t * cells;
+   size_t bytes;
+   board_memory_t memory;
+};
+
+struct packed_board_t {
+   int32_t width;
+   int32_t height;
+   int32_t words_per_row;        // a multiple of the cache line
+   uint64_t * words;
+   size_t bytes;
+   board_memory_t memory;
+};
+
+// Allocates a cleared board. With `huge_pages` the memory comes from huge
+// pages when the OS grants them and falls back to normal pages otherwise.
+// With `untouched` no page is written yet, so on a NUMA machine each lands
+// on the node of the thread that writes it first.
+bool board_create(board_t * board, int32_t width, int32_t height, bool huge_pages, bool untouched = false);
+
+void board_destroy(board_t * board);
+
+void board_clear(board_t * board);
+
+static inline uint32_t * board_row(const board_t * board, int32_t y) { return board->cells + (size_t)y * board->pitch; }
+
+bool packed_board_create(packed_board_t * board, int32_t width, int32_t height, bool huge_pages, bool untouched = false);
+
+void packed_board_destroy(packed_board_t * board);
+
+void packed_board_clear(packed_board_t * board);
+
+static inline uint64_t * packed_board_row(const packed_board_t * board, int32_t y) { return board->words + (size_t)y * board->words_per_row; }
+
+const char * board_memory_name(board_memory_t memory);
+
+// Resident memory of the whole process in bytes: now, and the peak since the
+// start or the last process_memory_reset_peak(). False if the OS cannot tell.
+bool process_memory(size_t * resident, size_t * peak);
+
+// Starts the peak over from what is resident now; false where the OS cannot
+// (only Linux can).
+bool process_memory_reset_peak();
+
+#endif // _BOARD_H
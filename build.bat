@@ -1,2 +1,2 @@
-cl /O2 /Fegol.exe /MT main.cpp job_queue.cpp user32.lib gdi32.lib winmm.lib
+cl /O2 /EHsc /Fegol.exe /MT main.cpp game.cpp board.cpp universe.cpp job_queue.cpp packed_board.cpp simd_kernels.cpp hashlife.cpp mapped_file.cpp pattern.cpp snapshot.cpp recording.cpp rule.cpp frame_mailbox.cpp sim_thread.cpp trace.cpp numa.cpp domain.cpp soup_search.cpp autotune.cpp user32.lib gdi32.lib winmm.lib psapi.lib
 
@@ -0,0 +1,366 @@
+#include "domain.h"
+
+#ifdef _WIN32
+
+bool domain_run(const domain_config_t * config, domain_result_t * result, const char ** error)
+{
+   (void)config;
+   (void)result;
+   *error = "slabs in separate processes need fork and POSIX shared memory";
+   return false;
+}
+
+#else
+
+#include "job_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+const size_t DOMAIN_MAX_ERROR = 128;
+
+// Control messages between the launcher and each process.
+const char DOMAIN_READY = 'r';
+const char DOMAIN_FAILED = 'e';
+const char DOMAIN_GO = 'g';
+const char DOMAIN_DONE = 'd';
+
+// Filled in by each process, in the shared segment after the rows.
+struct domain_rank_result_t {
+   uint64_t checksum;
+   uint64_t population;
+   uint64_t elapsed_ns;
+   uint64_t exchange_ns;
+   char error[DOMAIN_MAX_ERROR];
+};
+
+// Every slab owns two halves, for even and odd generations, of two rows
+// each: its first and its last. A neighbour only writes generation g + 2
+// into a half after receiving our token for g + 1, which we send once we
+// are done reading its rows of g, so rows are never overwritten mid-read.
+struct shm_transport_t {
+   uint64_t * rows;
+   uint32_t rank;
+   uint32_t ranks;
+   int32_t words;
+   int above;                    // sockets to the neighbouring slabs, -1 at the board's edges
+   int below;
+};
+
+static inline uint64_t domain_now_ns()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// MSG_NOSIGNAL: a process that died shows up as an error, not SIGPIPE.
+static bool send_all(int fd, const void * data, size_t size)
+{
+   const char * bytes = (const char *)data;
+   while (size > 0)
+   {
+      ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR) {
+         continue;
+      }
+      if (sent <= 0) {
+         return false;
+      }
+      bytes += sent;
+      size -= (size_t)sent;
+   }
+   return true;
+}
+
+static bool recv_all(int fd, void * data, size_t size)
+{
+   char * bytes = (char *)data;
+   while (size > 0)
+   {
+      ssize_t received = recv(fd, bytes, size, 0);
+      if (received < 0 && errno == EINTR) {
+         continue;
+      }
+      if (received <= 0) {
+         return false;
+      }
+      bytes += received;
+      size -= (size_t)received;
+   }
+   return true;
+}
+
+static inline uint64_t * shm_row(const shm_transport_t * shm, uint32_t rank, uint64_t generation, uint32_t edge)
+{
+   return shm->rows + ((size_t)(rank * 2 + (generation & 1)) * 2 + edge) * shm->words;
+}
+
+// A neighbour's rows for `generation`, once its token says they are written.
+static bool shm_receive_row(const shm_transport_t * shm, int fd, uint32_t rank, uint64_t generation, uint32_t edge, uint64_t * row)
+{
+   if (fd < 0) {
+      memset(row, 0, shm->words * sizeof(uint64_t));
+      return true;
+   }
+   uint64_t token;
+   if (!recv_all(fd, &token, sizeof(token)) || token != generation) {
+      return false;
+   }
+   memcpy(row, shm_row(shm, rank, generation, edge), shm->words * sizeof(uint64_t));
+   return true;
+}
+
+static bool shm_exchange(void * state, uint64_t generation, const uint64_t * first, const uint64_t * last,
+      uint64_t * above, uint64_t * below)
+{
+   shm_transport_t * shm = (shm_transport_t *)state;
+   memcpy(shm_row(shm, shm->rank, generation, 0), first, shm->words * sizeof(uint64_t));
+   memcpy(shm_row(shm, shm->rank, generation, 1), last, shm->words * sizeof(uint64_t));
+
+   // Send both tokens before waiting on either, so neighbours never wait on each other
+   if ((shm->above >= 0 && !send_all(shm->above, &generation, sizeof(generation))) ||
+         (shm->below >= 0 && !send_all(shm->below, &generation, sizeof(generation)))) {
+      return false;
+   }
+   return shm_receive_row(shm, shm->above, shm->rank - 1, generation, 1, above) &&
+      shm_receive_row(shm, shm->below, shm->rank + 1, generation, 0, below);
+}
+
+static bool shm_receive_above(void * state, uint64_t * value)
+{
+   shm_transport_t * shm = (shm_transport_t *)state;
+   return shm->above < 0 || recv_all(shm->above, value, sizeof(*value));
+}
+
+static bool shm_send_below(void * state, uint64_t value)
+{
+   shm_transport_t * shm = (shm_transport_t *)state;
+   return shm->below < 0 || send_all(shm->below, &value, sizeof(value));
+}
+
+// The body of process `rank`: set up its slab, report in, run once the
+// launcher says go, then pass the checksum down the slabs.
+static void domain_rank(const domain_config_t * config, uint32_t rank, uint64_t * rows, domain_rank_result_t * result,
+      int control, int above, int below)
+{
+   game_config_t game = config->game;
+   uint32_t base = (uint32_t)game.height / config->ranks;
+   uint32_t extra = (uint32_t)game.height % config->ranks;
+   game.slab_y = (int32_t)(rank * base + (rank < extra ? rank : extra));
+   game.slab_height = (int32_t)(base + (rank < extra ? 1 : 0));
+   game.multi_thread = config->threads_per_rank > 1;
+   if (game.multi_thread) {
+      job_queue_init(config->threads_per_rank - 1);
+   }
+
+   bool started = game_init(&game);
+   char message = started ? DOMAIN_READY : DOMAIN_FAILED;
+   if (!started) {
+      snprintf(result->error, DOMAIN_MAX_ERROR, "%s", game_init_error());
+   }
+   bool ok = send_all(control, &message, 1) && started &&
+      recv_all(control, &message, 1) && message == DOMAIN_GO;
+
+   shm_transport_t shm = {rows, rank, config->ranks, game_row_words(), above, below};
+   halo_transport_t transport = {&shm, shm_exchange, shm_receive_above, shm_send_below};
+   std::vector<uint64_t> first(shm.words), last(shm.words), halo_above(shm.words), halo_below(shm.words);
+
+   uint64_t start = domain_now_ns();
+   for (int32_t i = 0; i < config->generations && ok; i++)
+   {
+      game_get_edge_rows(first.data(), last.data());
+      uint64_t exchange_start = domain_now_ns();
+      ok = transport.exchange(transport.state, (uint64_t)i, first.data(), last.data(), halo_above.data(), halo_below.data());
+      result->exchange_ns += domain_now_ns() - exchange_start;
+      game_set_halo_rows(halo_above.data(), halo_below.data());
+      game_advance(1, NULL);
+   }
+   result->elapsed_ns = domain_now_ns() - start;
+
+   // FNV-1a offset basis, where game_checksum starts
+   uint64_t checksum = 0xcbf29ce484222325ull;
+   ok = ok && transport.receive_above(transport.state, &checksum);
+   if (ok) {
+      checksum = game_checksum_continue(checksum);
+      ok = transport.send_below(transport.state, checksum);
+   }
+   result->checksum = checksum;
+   result->population = started ? game_population() : 0;
+   if (!ok && !result->error[0]) {
+      snprintf(result->error, DOMAIN_MAX_ERROR, "slab %u lost touch with its neighbours", rank);
+   }
+
+   message = ok ? DOMAIN_DONE : DOMAIN_FAILED;
+   send_all(control, &message, 1);
+   if (game.multi_thread) {
+      job_queue_shutdown();
+   }
+}
+
+static void close_all(std::vector<int> * fds)
+{
+   for (auto & fd : *fds)
+   {
+      if (fd >= 0) {
+         close(fd);
+         fd = -1;
+      }
+   }
+}
+
+bool domain_run(const domain_config_t * config, domain_result_t * result, const char ** error)
+{
+   memset(result, 0, sizeof(*result));
+   uint32_t ranks = config->ranks;
+   if (ranks < 1 || ranks > (uint32_t)config->game.height) {
+      *error = "there must be between one slab and one per row";
+      return false;
+   }
+
+   // Created, mapped and unlinked at once: the processes inherit the
+   // mapping and nothing is left behind if one of them dies
+   int32_t words = (config->game.width + 2 + 63) / 64;
+   size_t rows_bytes = (size_t)ranks * 4 * words * sizeof(uint64_t);
+   size_t bytes = rows_bytes + ranks * sizeof(domain_rank_result_t);
+   char name[64];
+   snprintf(name, sizeof(name), "/gol_domain_%d", (int)getpid());
+   int shm_fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+   if (shm_fd < 0) {
+      *error = "cannot create the shared memory";
+      return false;
+   }
+   void * segment = MAP_FAILED;
+   if (ftruncate(shm_fd, (off_t)bytes) == 0) {
+      segment = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+   }
+   close(shm_fd);
+   shm_unlink(name);
+   if (segment == MAP_FAILED) {
+      *error = "cannot map the shared memory";
+      return false;
+   }
+   uint64_t * rows = (uint64_t *)segment;
+   domain_rank_result_t * results = (domain_rank_result_t *)((uint8_t *)segment + rows_bytes);
+
+   // links[2r] and links[2r + 1] join slab r to slab r + 1; controls[2r]
+   // is the launcher's end of slab r's control socket
+   std::vector<int> links(2 * (ranks - 1), -1);
+   std::vector<int> controls(2 * ranks, -1);
+   bool ok = true;
+   for (uint32_t i = 0; i < ranks - 1 && ok; i++)
+   {
+      ok = socketpair(AF_UNIX, SOCK_STREAM, 0, &links[2 * i]) == 0;
+   }
+   for (uint32_t i = 0; i < ranks && ok; i++)
+   {
+      ok = socketpair(AF_UNIX, SOCK_STREAM, 0, &controls[2 * i]) == 0;
+   }
+   if (!ok) {
+      close_all(&links);
+      close_all(&controls);
+      munmap(segment, bytes);
+      *error = "cannot create the sockets";
+      return false;
+   }
+
+   fflush(stdout);
+   fflush(stderr);
+   std::vector<pid_t> pids;
+   for (uint32_t rank = 0; rank < ranks && ok; rank++)
+   {
+      pid_t pid = fork();
+      if (pid == 0) {
+         int control = controls[2 * rank + 1];
+         int above = (rank > 0) ? links[2 * (rank - 1) + 1] : -1;
+         int below = (rank + 1 < ranks) ? links[2 * rank] : -1;
+         for (size_t i = 0; i < links.size(); i++)
+         {
+            if (links[i] != above && links[i] != below) {
+               close(links[i]);
+            }
+         }
+         for (size_t i = 0; i < controls.size(); i++)
+         {
+            if (controls[i] != control) {
+               close(controls[i]);
+            }
+         }
+         domain_rank(config, rank, rows, &results[rank], control, above, below);
+         _exit(0);
+      }
+      if (pid < 0) {
+         *error = "cannot start the processes";
+         ok = false;
+      } else {
+         pids.push_back(pid);
+      }
+   }
+   close_all(&links);
+   for (uint32_t i = 0; i < ranks; i++)
+   {
+      close(controls[2 * i + 1]);
+   }
+
+   // Everyone starts together once every slab is seeded; a process that
+   // failed, or never started, makes the others give up
+   char message;
+   for (size_t i = 0; i < pids.size(); i++)
+   {
+      ok = recv_all(controls[2 * i], &message, 1) && message == DOMAIN_READY && ok;
+   }
+   for (size_t i = 0; i < pids.size() && ok; i++)
+   {
+      message = DOMAIN_GO;
+      ok = send_all(controls[2 * i], &message, 1);
+   }
+   if (!ok) {
+      for (size_t i = 0; i < pids.size(); i++)
+      {
+         close(controls[2 * i]);
+         controls[2 * i] = -1;
+      }
+   }
+   for (size_t i = 0; i < pids.size() && ok; i++)
+   {
+      ok = recv_all(controls[2 * i], &message, 1) && message == DOMAIN_DONE;
+   }
+   for (size_t i = 0; i < pids.size(); i++)
+   {
+      if (controls[2 * i] >= 0) {
+         close(controls[2 * i]);
+      }
+      int status;
+      while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR) {
+      }
+   }
+
+   static char rank_error[DOMAIN_MAX_ERROR];
+   rank_error[0] = 0;
+   for (uint32_t i = 0; i < ranks; i++)
+   {
+      result->seconds = std::max(result->seconds, results[i].elapsed_ns / 1e9);
+      result->exchange_seconds = std::max(result->exchange_seconds, results[i].exchange_ns / 1e9);
+      result->population += results[i].population;
+      if (!ok && results[i].error[0] && !rank_error[0]) {
+         memcpy(rank_error, results[i].error, DOMAIN_MAX_ERROR);
+      }
+   }
+   result->checksum = results[ranks - 1].checksum;
+   munmap(segment, bytes);
+   if (!ok) {
+      *error = rank_error[0] ? rank_error : (pids.size() < ranks ? *error : "a slab process failed");
+   }
+   return ok;
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _DOMAIN_H
+#define _DOMAIN_H
+
+#include <cstdint>
+
+#include "game.h"
+
+// Domain decomposition across processes: the board is cut into horizontal
+// slabs, one per process, each running its own game and job queue. Before
+// every generation neighbouring slabs swap their edge rows through a halo
+// transport. The one implemented here passes the rows through POSIX shared
+// memory and signals over local sockets, so every slab runs on one machine.
+
+// Rows are game_row_words() words, see game_get_edge_rows.
+struct halo_transport_t {
+   void * state;
+   // Publishes this slab's first and last rows of `generation` and receives
+   // the neighbours' rows next to them. At the edges of the board `above` or
+   // `below` is a dead row.
+   bool (*exchange)(void * state, uint64_t generation, const uint64_t * first, const uint64_t * last,
+         uint64_t * above, uint64_t * below);
+   // Ordered reduction down the slabs: receive_above gets the value the slab
+   // above sent (the top slab keeps `value`), send_below passes one on.
+   bool (*receive_above)(void * state, uint64_t * value);
+   bool (*send_below)(void * state, uint64_t value);
+};
+
+struct domain_config_t {
+   game_config_t game;           // the whole board; each process gets its slab_y / slab_height
+   uint32_t ranks;               // processes, at most the board height
+   uint32_t threads_per_rank;    // 1 runs every chunk on the process's own thread
+   int32_t generations;
+};
+
+struct domain_result_t {
+   double seconds;               // the slowest process, from a common start
+   double exchange_seconds;      // the longest any process spent in halo exchanges
+   uint64_t checksum;            // game_checksum() of the whole board
+   uint64_t population;
+};
+
+// Forks one process per slab and runs them all for `generations`. fork only
+// copies the calling thread, so no job queue may be running. Returns false
+// and sets `error` if the processes or the shared memory cannot be set up
+// or a slab fails to start.
+bool domain_run(const domain_config_t * config, domain_result_t * result, const char ** error);
+
+#endif // _DOMAIN_H
@@ -0,0 +1,160 @@
+#include "frame_mailbox.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+const uint32_t NO_FRAME = ~0u;
+
+static inline void dirty_init(render_dirty_t * dirty, render_rect_t * rects)
+{
+   dirty->rects = rects;
+   dirty->capacity = FRAME_MAX_RECTS;
+   dirty->count = 0;
+}
+
+// Past the capacity everything collapses into the bounding box, like the
+// rectangles game_update_and_render reports.
+static void dirty_add(render_dirty_t * dirty, const render_rect_t * rect)
+{
+   for (uint32_t i = 0; i < dirty->count; i++)
+   {
+      const render_rect_t * r = &dirty->rects[i];
+      if (rect->x >= r->x && rect->y >= r->y &&
+            rect->x + rect->width <= r->x + r->width && rect->y + rect->height <= r->y + r->height) {
+         return;
+      }
+   }
+   if (dirty->count < dirty->capacity) {
+      dirty->rects[dirty->count++] = *rect;
+      return;
+   }
+   render_rect_t bounds = *rect;
+   for (uint32_t i = 0; i < dirty->count; i++)
+   {
+      const render_rect_t * r = &dirty->rects[i];
+      int32_t x1 = std::max(bounds.x + bounds.width, r->x + r->width);
+      int32_t y1 = std::max(bounds.y + bounds.height, r->y + r->height);
+      bounds.x = std::min(bounds.x, r->x);
+      bounds.y = std::min(bounds.y, r->y);
+      bounds.width = x1 - bounds.x;
+      bounds.height = y1 - bounds.y;
+   }
+   dirty->rects[0] = bounds;
+   dirty->count = 1;
+}
+
+static void dirty_merge(render_dirty_t * dirty, const render_dirty_t * other)
+{
+   for (uint32_t i = 0; i < other->count; i++)
+   {
+      dirty_add(dirty, &other->rects[i]);
+   }
+}
+
+bool frame_mailbox_init(frame_mailbox_t * mailbox, int32_t width, int32_t height, uint32_t * const * pixels)
+{
+   mailbox->width = width;
+   mailbox->height = height;
+   mailbox->owns_pixels = !pixels;
+   for (auto i = 0; i < 3; i++)
+   {
+      frame_t * frame = &mailbox->frames[i];
+      frame->pixels = pixels ? pixels[i] : (uint32_t *)calloc((size_t)width * height, sizeof(uint32_t));
+      frame->generation = 0;
+      memset(&frame->stats, 0, sizeof(frame->stats));
+      dirty_init(&frame->dirty, frame->rects);
+      dirty_init(&mailbox->stale[i], mailbox->stale_rects[i]);
+   }
+   dirty_init(&mailbox->carry, mailbox->carry_rects);
+   mailbox->back = 0;
+   mailbox->middle.store(1);
+   mailbox->front = 2;
+   mailbox->latest = NO_FRAME;
+
+   if (mailbox->owns_pixels && (!mailbox->frames[0].pixels || !mailbox->frames[1].pixels || !mailbox->frames[2].pixels)) {
+      frame_mailbox_destroy(mailbox);
+      return false;
+   }
+   return true;
+}
+
+void frame_mailbox_destroy(frame_mailbox_t * mailbox)
+{
+   for (auto i = 0; i < 3; i++)
+   {
+      if (mailbox->owns_pixels) {
+         free(mailbox->frames[i].pixels);
+      }
+      mailbox->frames[i].pixels = NULL;
+   }
+}
+
+bool frame_mailbox_wanted(const frame_mailbox_t * mailbox)
+{
+   return !(mailbox->middle.load(std::memory_order_acquire) & FRAME_FRESH);
+}
+
+render_target_t frame_mailbox_begin(frame_mailbox_t * mailbox, int32_t pixels_per_cell)
+{
+   frame_t * frame = &mailbox->frames[mailbox->back];
+   render_dirty_t * stale = &mailbox->stale[mailbox->back];
+
+   // The latest frame is the middle or the front one; the presenter only
+   // reads it, so it can be copied from while it is being shown
+   if (mailbox->latest != NO_FRAME) {
+      const uint32_t * source = mailbox->frames[mailbox->latest].pixels;
+      for (uint32_t i = 0; i < stale->count; i++)
+      {
+         const render_rect_t * rect = &stale->rects[i];
+         for (auto y = rect->y; y < rect->y + rect->height; y++)
+         {
+            size_t offset = (size_t)y * mailbox->width + rect->x;
+            memcpy(frame->pixels + offset, source + offset, rect->width * sizeof(uint32_t));
+         }
+      }
+   }
+   stale->count = 0;
+
+   render_target_t target;
+   target.pixels = frame->pixels;
+   target.pitch = mailbox->width;
+   target.pixels_per_cell = pixels_per_cell;
+   target.dirty = &frame->dirty;
+   return target;
+}
+
+void frame_mailbox_publish(frame_mailbox_t * mailbox, const game_stats_t * stats)
+{
+   uint32_t back = mailbox->back;
+   frame_t * frame = &mailbox->frames[back];
+   for (uint32_t i = 0; i < 3; i++)
+   {
+      if (i != back) {
+         dirty_merge(&mailbox->stale[i], &frame->dirty);
+      }
+   }
+   dirty_merge(&frame->dirty, &mailbox->carry);
+   frame->generation = stats->generation;
+   frame->stats = *stats;
+
+   uint32_t previous = mailbox->middle.exchange(back | FRAME_FRESH, std::memory_order_acq_rel);
+   mailbox->latest = back;
+   mailbox->back = previous & ~FRAME_FRESH;
+
+   // Not taken: its changes ride along with the next frame
+   mailbox->carry.count = 0;
+   if (previous & FRAME_FRESH) {
+      dirty_merge(&mailbox->carry, &mailbox->frames[mailbox->back].dirty);
+   }
+}
+
+const frame_t * frame_mailbox_take(frame_mailbox_t * mailbox)
+{
+   if (!(mailbox->middle.load(std::memory_order_relaxed) & FRAME_FRESH)) {
+      return NULL;
+   }
+   uint32_t middle = mailbox->middle.exchange(mailbox->front, std::memory_order_acq_rel);
+   mailbox->front = middle & ~FRAME_FRESH;
+   return &mailbox->frames[mailbox->front];
+}
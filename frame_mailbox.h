@@ -0,0 +1,73 @@
+#ifndef _FRAME_MAILBOX_H
+#define _FRAME_MAILBOX_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "game.h"
+
+// Lock-free triple buffer that hands rendered frames from the simulation
+// thread to the presenter. The simulation renders into its back frame and
+// publishes it by swapping it with the middle one; the presenter swaps its
+// front frame with the middle one whenever a newer frame is there. Neither
+// side ever waits, and a frame the presenter was too slow to take is
+// replaced by the next one.
+//
+// Renders only redraw the chunks that changed, so before each render the
+// back frame is brought up to date from the latest published one, and every
+// frame carries the rectangles that changed since the frame the presenter
+// took before it.
+
+const uint32_t FRAME_MAX_RECTS = 256;
+const uint32_t FRAME_FRESH = 4;           // middle frame not taken yet
+
+struct frame_t {
+   uint32_t * pixels;
+   uint64_t generation;
+   game_stats_t stats;                    // of the simulation when it was rendered
+   render_rect_t rects[FRAME_MAX_RECTS];
+   render_dirty_t dirty;
+};
+
+struct frame_mailbox_t {
+   int32_t width;                         // pixels, also the pitch
+   int32_t height;
+   bool owns_pixels;
+   frame_t frames[3];
+   std::atomic<uint32_t> middle;          // frame index | FRAME_FRESH
+   uint32_t front;                        // presenter side
+
+   // Simulation side
+   uint32_t back;
+   uint32_t latest;                       // last published frame, ~0u before the first
+   render_rect_t stale_rects[3][FRAME_MAX_RECTS];
+   render_dirty_t stale[3];               // where each frame is behind the latest one
+   render_rect_t carry_rects[FRAME_MAX_RECTS];
+   render_dirty_t carry;                  // changes of published frames nobody took
+};
+
+// Allocates three cleared width x height frames, or uses `pixels` when given
+// (e.g. DIB sections), which must outlive the mailbox.
+bool frame_mailbox_init(frame_mailbox_t * mailbox, int32_t width, int32_t height, uint32_t * const * pixels = 0);
+
+void frame_mailbox_destroy(frame_mailbox_t * mailbox);
+
+// Simulation side. False while the last published frame is still waiting,
+// so a render now would be replaced before anyone sees it.
+bool frame_mailbox_wanted(const frame_mailbox_t * mailbox);
+
+// Simulation side. Brings the back frame up to date and returns a target
+// rendering into it. The first render must draw every chunk, as the first
+// one after game_init or game_replay_seek does.
+render_target_t frame_mailbox_begin(frame_mailbox_t * mailbox, int32_t pixels_per_cell);
+
+void frame_mailbox_publish(frame_mailbox_t * mailbox, const game_stats_t * stats);
+
+// Presenter side. The newest frame if one was published since the last
+// call, else NULL; it stays valid until the next call.
+const frame_t * frame_mailbox_take(frame_mailbox_t * mailbox);
+
+// Presenter side. The frame taken last, for repainting the whole window.
+static inline const frame_t * frame_mailbox_front(const frame_mailbox_t * mailbox) { return &mailbox->frames[mailbox->front]; }
+
+#endif // _FRAME_MAILBOX_H
@@ -0,0 +1,2429 @@
+#include "game.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "board.h"
+#include "job_queue.h"
+#include "packed_board.h"
+#include "hashlife.h"
+#include "pattern.h"
+#include "snapshot.h"
+#include "recording.h"
+#include "rule.h"
+#include "trace.h"
+#include "universe.h"
+
+#include <algorithm>
+#include <vector>
+
+// Indexed by cell state; dying Generations states fade from alive to dead.
+static uint32_t colors[RULE_MAX_STATES] = {COLOR_DEAD, COLOR_ALIVE};
+
+const size_t HASHLIFE_MAX_NODES = 1 << 22;
+
+static game_config_t config;
+static const update_kernels_t * kernels;
+static const render_target_t * render_target;
+static uint64_t generation = 0;
+static int32_t seed_height;                   // of the whole board, taller than config.height for a slab
+
+static board_t boards[2];
+static board_t * current_board = &boards[0];
+static board_t * next_board = &boards[1];
+
+static packed_board_t packed_boards[2];
+static packed_board_t * current_packed = &packed_boards[0];
+static packed_board_t * next_packed = &packed_boards[1];
+
+static universe_t * universe;
+static const char * init_error = "";
+
+static rule_t rule;
+static rule_update_t rule_update;             // NULL for B3/S23, which runs on `kernels`
+
+static inline uint32_t min2(uint32_t a, uint32_t b) { return (a < b) ? a : b; }
+
+static inline void swap_boards()
+{
+    board_t * temp = current_board;
+    current_board = next_board;
+    next_board = temp;
+
+    packed_board_t * temp_packed = current_packed;
+    current_packed = next_packed;
+    next_packed = temp_packed;
+}
+
+static void update_board(const board_t * old_board, board_t * new_board, int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+    if (rule_update) {
+        rule_update(&rule, old_board, new_board, config.topology == TOPOLOGY_TORUS, startx, starty, endx, endy);
+        return;
+    }
+    kernels->update(old_board->cells, new_board->cells, old_board->pitch, startx, starty, endx, endy);
+}
+
+static void update_packed_board(const packed_board_t * old_board, packed_board_t * new_board, int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+    kernels->update_packed(old_board->words, new_board->words, old_board->words_per_row, startx, starty, endx, endy);
+}
+
+static void draw_rect(const render_target_t * target, int32_t start_x, int32_t start_y, int32_t end_x, int32_t end_y, uint32_t color)
+{
+    uint32_t * row = target->pixels + (start_y * target->pitch);
+    uint32_t pitch = target->pitch;
+    for (auto y = start_y; y < end_y; y++)
+    {
+        uint32_t *pixel = row + start_x;
+        for (auto x = start_x; x < end_x; x++)
+        {
+            *pixel = color;
+            pixel++;
+        }
+        row += pitch;
+    }
+}
+
+static inline uint32_t * cell_pixels(const render_target_t * target, int32_t x, int32_t y)
+{
+    auto ppc = target->pixels_per_cell;
+    return target->pixels + (size_t)(y - 1) * ppc * target->pitch + (size_t)(x - 1) * ppc;
+}
+
+// A row of cells is expanded into its first pixel row only, which is then
+// copied down for the rest of the cells' height.
+static void replicate_pixel_row(const render_target_t * target, uint32_t * pixels, int32_t count)
+{
+    for (auto i = 1; i < target->pixels_per_cell; i++)
+    {
+        memcpy(pixels + (size_t)i * target->pitch, pixels, count * sizeof(uint32_t));
+    }
+}
+
+static void render_board(const render_target_t * target, const board_t * board, int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+    auto ppc = target->pixels_per_cell;
+    for (auto y = starty; y < endy; y++)
+    {
+        const uint32_t * row = board_row(board, y);
+        uint32_t * pixels = cell_pixels(target, startx, y);
+        if (ppc == 1) {
+            for (auto x = startx; x < endx; x++)
+            {
+                pixels[x - startx] = colors[row[x]];
+            }
+        } else {
+            for (auto x = startx; x < endx; x++)
+            {
+                uint32_t color = colors[row[x]];
+                uint32_t * pixel = pixels + (x - startx) * ppc;
+                for (auto i = 0; i < ppc; i++)
+                {
+                    pixel[i] = color;
+                }
+            }
+        }
+        replicate_pixel_row(target, pixels, (endx - startx) * ppc);
+    }
+}
+
+// Bits [startx, endx) of a packed row go through the SIMD expansion at one
+// pixel per cell; larger cells are then widened in place from the right, so
+// no pixel is overwritten before it is read.
+static void render_packed_row(const render_target_t * target, uint32_t * pixels, const uint64_t * row, int32_t startx, int32_t endx)
+{
+    auto ppc = target->pixels_per_cell;
+    auto count = endx - startx;
+    kernels->expand_packed(row, pixels, startx, endx, COLOR_DEAD, COLOR_ALIVE);
+    for (auto x = count - 1; x >= 0 && ppc > 1; x--)
+    {
+        uint32_t color = pixels[x];
+        for (auto i = 0; i < ppc; i++)
+        {
+            pixels[x * ppc + i] = color;
+        }
+    }
+    replicate_pixel_row(target, pixels, count * ppc);
+}
+
+static void render_packed_board(const render_target_t * target, const packed_board_t * board, int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+    for (auto y = starty; y < endy; y++)
+    {
+        render_packed_row(target, cell_pixels(target, startx, y), packed_board_row(board, y), startx, endx);
+    }
+}
+
+// Built-in patterns, placed with the same (x, y, dir_x, dir_y) convention as
+// pattern files.
+static const char GLIDER_GUN_RLE[] =
+      "x = 36, y = 9, rule = B3/S23\n"
+      "24bo$22bobo$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o$2o8bo3bob2o4bobo$10bo5bo7bo$11bo3bo$12b2o!";
+static const char GLIDER_RLE[] =
+      "x = 3, y = 3, rule = B3/S23\n"
+      "2bo$obo$b2o!";
+static const char LIDKA_PRED_RLE[] =
+      "x = 9, y = 6, rule = B3/S23\n"
+      "6bo$6b3o2$3b2o3bo$3bo4bo$3o5bo!";
+static const char SPACESHIP_RLE[] =
+      "x = 5, y = 4, rule = B3/S23\n"
+      "bo2bo$o$o3bo$4o!";
+
+static void place_pattern(board_t * board, const char * rle, int64_t x, int64_t y, int32_t dir_x = 1, int32_t dir_y = 1)
+{
+    const char * error = NULL;
+    pattern_t * pattern = pattern_open_memory(rle, strlen(rle), &error);
+    pattern_placement_t placement = {x, y, dir_x, dir_y};
+    pattern_sink_t sink = pattern_sink_board(board);
+    pattern_decode(pattern, &placement, &sink, &error);
+    pattern_close(pattern);
+}
+
+static int32_t chunks_x = 0;
+static int32_t chunks_y = 0;
+
+// chunk_changed[current_changed] records which chunks changed in the last
+// generation; the update pass in flight fills in the other half. A chunk
+// whose neighbourhood did not change keeps its cells in both boards, so
+// both its update and its render can be skipped.
+static bool * chunk_changed[2];
+static bool * chunk_rendered;             // drawn this frame, for the dirty rectangles
+static bool * chunk_unrendered;           // changed during frames run without a render target
+static uint32_t current_changed = 0;
+static bool render_all_chunks = true;
+static uint32_t active_chunks = 0;
+
+// Chunks changed since the last checkpoint, for incremental checkpoints.
+const uint64_t NO_CHECKPOINT = ~0ull;
+static bool * chunk_dirty;
+static uint64_t checkpoint_generation = NO_CHECKPOINT;
+static const char * checkpoint_error;   // a checkpoint refused since the last flush
+
+const size_t RECORDING_RING_BYTES = 64 << 20;
+static recording_t * recording;
+static uint32_t keyframe_interval;
+static bool keyframe_pending;
+static void record_generation();
+
+static replay_t replay;
+static size_t replay_next_frame;
+
+struct chunk_spec_t {
+   uint32_t startx;
+   uint32_t starty;
+   uint32_t endx;
+   uint32_t endy;
+   uint32_t index;
+};
+
+static void mark_all_chunks_changed()
+{
+   for (auto i = 0; i < chunks_y * chunks_x; i++)
+   {
+      chunk_changed[current_changed][i] = true;
+   }
+   render_all_chunks = true;
+}
+
+// On a torus the chunks on opposite edges are neighbours too.
+static bool chunk_is_active(int32_t cx, int32_t cy)
+{
+   bool wrap = config.topology == TOPOLOGY_TORUS;
+   for (auto y = cy - 1; y <= cy + 1; y++)
+   {
+      for (auto x = cx - 1; x <= cx + 1; x++)
+      {
+         auto nx = wrap ? (x + chunks_x) % chunks_x : x;
+         auto ny = wrap ? (y + chunks_y) % chunks_y : y;
+         if (nx >= 0 && nx < chunks_x && ny >= 0 && ny < chunks_y &&
+               chunk_changed[current_changed][ny * chunks_x + nx]) {
+            return true;
+         }
+      }
+   }
+   return false;
+}
+
+static bool chunk_differs(chunk_spec_t * chunk)
+{
+   for (auto y = chunk->starty; y < chunk->endy; y++)
+   {
+      if (config.packed) {
+         // Masked, the halo bits sharing these words are not part of the chunk
+         auto start_word = chunk->startx / 64;
+         auto end_word = (chunk->endx + 63) / 64;
+         const uint64_t * current_row = packed_board_row(current_packed, y);
+         const uint64_t * next_row = packed_board_row(next_packed, y);
+         for (auto w = start_word; w < end_word; w++)
+         {
+            if ((current_row[w] ^ next_row[w]) & packed_range_mask(w, chunk->startx, chunk->endx)) {
+               return true;
+            }
+         }
+      } else {
+         if (memcmp(board_row(current_board, y) + chunk->startx, board_row(next_board, y) + chunk->startx,
+                  (chunk->endx - chunk->startx) * sizeof(uint32_t))) {
+            return true;
+         }
+      }
+   }
+   return false;
+}
+
+// Population, bounding box and hash of the live cells of each chunk, taken
+// by its update right after it is written. Only chunks that changed are
+// measured and the board totals move by their difference, so the board is
+// never scanned for them.
+struct chunk_stats_t {
+   uint64_t hash;
+   uint32_t population;
+   int32_t min_x;
+   int32_t min_y;
+   int32_t max_x;
+   int32_t max_y;
+};
+
+static chunk_stats_t * chunk_stats;           // of the current generation
+static chunk_stats_t * chunk_stats_next;      // measured by the updates of the chunks that changed
+static uint64_t board_population;
+static uint64_t board_hash;
+
+// Board hashes of the last config.cycle_history generations, newest last.
+struct cycle_entry_t {
+   uint64_t hash;
+   uint64_t population;
+   uint64_t generation;
+};
+
+static std::vector<cycle_entry_t> cycle_entries;
+static uint64_t cycle_recorded;
+static uint32_t cycle_period;
+static uint64_t cycle_start;
+
+// splitmix64 finalizer
+static inline uint64_t mix64(uint64_t x)
+{
+   x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+   x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+   return x ^ (x >> 31);
+}
+
+// Row r of a chunk is hashed NH style, (low half + key) * (high half + key)
+// with two random 32-bit keys per row: one multiply per row, and two
+// different chunks collide with a probability of about 2^-32. The chunk's
+// sum is mixed with its index, so the board hash is the sum of the chunks'
+// shares. Dying Generations states are hashed cell by cell.
+static uint32_t row_keys[2 * CHUNK_SIZE];
+
+static void init_row_keys()
+{
+   uint64_t state = 0;
+   for (auto r = 0; r < CHUNK_SIZE; r++)
+   {
+      uint64_t key = mix64(state += 0x9e3779b97f4a7c15ull);
+      row_keys[2 * r] = (uint32_t)key;
+      row_keys[2 * r + 1] = (uint32_t)(key >> 32);
+   }
+}
+
+static void measure_chunk(const chunk_spec_t * chunk, bool next, chunk_stats_t * stats)
+{
+   uint64_t rows[CHUNK_SIZE];
+   int32_t startx = chunk->startx, endx = chunk->endx;
+   int32_t count = chunk->endy - chunk->starty;
+   uint64_t mask = (endx - startx == 64) ? ~0ull : (1ull << (endx - startx)) - 1;
+   uint64_t dying = 0;
+   if (config.packed) {
+      int32_t w = startx / 64;
+      int32_t shift = startx % 64;
+      for (auto r = 0; r < count; r++)
+      {
+         const uint64_t * row = packed_board_row(next ? next_packed : current_packed, chunk->starty + r);
+         uint64_t bits = row[w] >> shift;
+         if (shift && (w + 1) * 64 < endx) {
+            bits |= row[w + 1] << (64 - shift);
+         }
+         rows[r] = bits & mask;
+      }
+   } else {
+      for (auto r = 0; r < count; r++)
+      {
+         const uint32_t * row = board_row(next ? next_board : current_board, chunk->starty + r);
+         rows[r] = kernels->pack(row + startx, endx - startx);
+         for (auto x = startx; x < endx && rule.states > 2; x++)
+         {
+            dying += (row[x] > 1) ? mix64(((uint64_t)row[x] << 32) ^ ((uint64_t)r << 8) ^ (uint64_t)(x - startx)) : 0;
+         }
+      }
+   }
+
+   row_summary_t summary;
+   kernels->summarize(rows, row_keys, count, &summary);
+   stats->population = summary.population;
+   stats->hash = mix64(summary.hash + dying + chunk->index * 0xbf58476d1ce4e5b9ull);
+   stats->min_x = summary.columns ? startx + (int32_t)packed_lowest_bit(summary.columns) : INT32_MAX;
+   stats->max_x = summary.columns ? startx + (int32_t)packed_highest_bit(summary.columns) : INT32_MIN;
+   stats->min_y = summary.occupied ? chunk->starty + (int32_t)packed_lowest_bit(summary.occupied) : INT32_MAX;
+   stats->max_y = summary.occupied ? chunk->starty + (int32_t)packed_highest_bit(summary.occupied) : INT32_MIN;
+}
+
+static void commit_chunk_stats(uint32_t index, const chunk_stats_t * stats)
+{
+   board_population += (uint64_t)stats->population - chunk_stats[index].population;
+   board_hash += stats->hash - chunk_stats[index].hash;
+   chunk_stats[index] = *stats;
+}
+
+static void reset_cycles()
+{
+   cycle_entries.assign(config.cycle_history, cycle_entry_t());
+   cycle_recorded = 0;
+   cycle_period = 0;
+   cycle_start = 0;
+}
+
+// Looks the current generation up among the last ones, newest first, so the
+// shortest period is found. A match is two generations with the same 64-bit
+// hash and population; once the board repeats it keeps repeating, so the
+// search stops there.
+static void detect_cycle()
+{
+   if (cycle_period || cycle_entries.empty()) {
+      return;
+   }
+   size_t size = cycle_entries.size();
+   size_t count = (size_t)std::min<uint64_t>(cycle_recorded, size);
+   for (size_t i = 1; i <= count; i++)
+   {
+      const cycle_entry_t & entry = cycle_entries[(cycle_recorded - i) % size];
+      if (entry.hash == board_hash && entry.population == board_population) {
+         cycle_period = (uint32_t)(generation - entry.generation);
+         cycle_start = entry.generation;
+         return;
+      }
+   }
+   cycle_entry_t & entry = cycle_entries[cycle_recorded++ % size];
+   entry.hash = board_hash;
+   entry.population = board_population;
+   entry.generation = generation;
+}
+
+static inline uint32_t packed_get(const uint64_t * row, int32_t x) { return (row[x / 64] >> (x % 64)) & 1; }
+
+static inline void packed_set(uint64_t * row, int32_t x, uint32_t alive)
+{
+   uint64_t bit = 1ull << (x % 64);
+   row[x / 64] = alive ? (row[x / 64] | bit) : (row[x / 64] & ~bit);
+}
+
+// Torus ghost cells: the halo next to an edge chunk is a copy of the cells on
+// the opposite edge. Each edge chunk owns the halo cells beside it, corners
+// go to the corner chunks.
+static void exchange_halo(board_t * board, const chunk_spec_t * chunk, bool west, bool east, bool north, bool south)
+{
+   auto w = board->width, h = board->height;
+   auto length = (chunk->endx - chunk->startx) * sizeof(uint32_t);
+   if (north) {
+      memcpy(board_row(board, 0) + chunk->startx, board_row(board, h) + chunk->startx, length);
+   }
+   if (south) {
+      memcpy(board_row(board, h + 1) + chunk->startx, board_row(board, 1) + chunk->startx, length);
+   }
+   for (auto y = chunk->starty; y < chunk->endy; y++)
+   {
+      uint32_t * row = board_row(board, y);
+      if (west) row[0] = row[w];
+      if (east) row[w + 1] = row[1];
+   }
+   if (north && west) board_row(board, 0)[0] = board_row(board, h)[w];
+   if (north && east) board_row(board, 0)[w + 1] = board_row(board, h)[1];
+   if (south && west) board_row(board, h + 1)[0] = board_row(board, 1)[w];
+   if (south && east) board_row(board, h + 1)[w + 1] = board_row(board, 1)[1];
+}
+
+static void exchange_packed_halo(packed_board_t * board, const chunk_spec_t * chunk, bool west, bool east, bool north, bool south)
+{
+   auto w = board->width, h = board->height;
+   auto start_word = chunk->startx / 64;
+   auto end_word = (chunk->endx + 63) / 64;
+   for (auto i = start_word; i < end_word; i++)
+   {
+      uint64_t mask = packed_range_mask(i, chunk->startx, chunk->endx);
+      if (north) {
+         uint64_t * row = packed_board_row(board, 0);
+         row[i] = (packed_board_row(board, h)[i] & mask) | (row[i] & ~mask);
+      }
+      if (south) {
+         uint64_t * row = packed_board_row(board, h + 1);
+         row[i] = (packed_board_row(board, 1)[i] & mask) | (row[i] & ~mask);
+      }
+   }
+   for (auto y = chunk->starty; y < chunk->endy; y++)
+   {
+      uint64_t * row = packed_board_row(board, y);
+      if (west) packed_set(row, 0, packed_get(row, w));
+      if (east) packed_set(row, w + 1, packed_get(row, 1));
+   }
+   if (north && west) packed_set(packed_board_row(board, 0), 0, packed_get(packed_board_row(board, h), w));
+   if (north && east) packed_set(packed_board_row(board, 0), w + 1, packed_get(packed_board_row(board, h), 1));
+   if (south && west) packed_set(packed_board_row(board, h + 1), 0, packed_get(packed_board_row(board, 1), w));
+   if (south && east) packed_set(packed_board_row(board, h + 1), w + 1, packed_get(packed_board_row(board, 1), 1));
+}
+
+static inline bool chunk_on_edge(int32_t cx, int32_t cy)
+{
+   return cx == 0 || cy == 0 || cx == chunks_x - 1 || cy == chunks_y - 1;
+}
+
+static void exchange_chunk(const chunk_spec_t * chunk)
+{
+   bool west = chunk->startx == 1, east = chunk->endx == (uint32_t)config.width + 1;
+   bool north = chunk->starty == 1, south = chunk->endy == (uint32_t)config.height + 1;
+
+   if (config.packed) {
+      exchange_packed_halo(current_packed, chunk, west, east, north, south);
+   } else {
+      exchange_halo(current_board, chunk, west, east, north, south);
+   }
+}
+
+static void update_chunk(chunk_spec_t * chunk)
+{
+   if (config.packed) {
+      update_packed_board(current_packed, next_packed,
+            chunk->startx, 
+            chunk->starty, 
+            chunk->endx, 
+            chunk->endy);
+   } else {
+      update_board(current_board, next_board, 
+            chunk->startx, 
+            chunk->starty, 
+            chunk->endx, 
+            chunk->endy);
+   }
+
+   bool changed = chunk_differs(chunk);
+   chunk_changed[current_changed ^ 1][chunk->index] = changed;
+   if (changed) {
+      measure_chunk(chunk, true, &chunk_stats_next[chunk->index]);
+   }
+}
+
+// Renders run as soon as their own update is done, before the boards are
+// swapped, so they read the generation that is being written.
+static void render_chunk(const chunk_spec_t * chunk)
+{
+   if (!render_all_chunks && !chunk_changed[current_changed ^ 1][chunk->index] && !chunk_unrendered[chunk->index]) {
+      return;
+   }
+
+   if (config.packed) {
+      render_packed_board(render_target, next_packed,
+            chunk->startx, 
+            chunk->starty, 
+            chunk->endx, 
+            chunk->endy);
+   } else {
+      render_board(render_target, next_board,
+            chunk->startx, 
+            chunk->starty, 
+            chunk->endx, 
+            chunk->endy);
+   }
+   chunk_rendered[chunk->index] = true;
+   chunk_unrendered[chunk->index] = false;
+}
+
+// Renders the current board, for frames that were not produced by the chunk
+// updates.
+void render_current_chunk_handler(void * param)
+{
+   chunk_spec_t * chunk = (chunk_spec_t *)param;
+
+   if (config.packed) {
+      render_packed_board(render_target, current_packed, chunk->startx, chunk->starty, chunk->endx, chunk->endy);
+   } else {
+      render_board(render_target, current_board, chunk->startx, chunk->starty, chunk->endx, chunk->endy);
+   }
+   chunk_rendered[chunk->index] = true;
+   chunk_unrendered[chunk->index] = false;
+}
+
+static job_group_t frame_group;
+static job_id_t * update_jobs;
+static job_id_t * exchange_jobs;
+
+// With numa_bands, workers 1 to band_workers own contiguous bands of chunk
+// rows: they first touch those rows of both boards and get their jobs.
+static uint32_t band_workers;
+
+static inline uint32_t chunk_owner(int32_t cy)
+{
+   return band_workers ? 1 + (uint32_t)((int64_t)cy * band_workers / chunks_y) : JOB_ANY_THREAD;
+}
+
+// `tag` names the job and its chunk or tile in traces.
+static inline job_id_t push_job(const trace_tag_t & tag, job_handler_t handler, void * data, uint32_t data_len,
+      const job_id_t * deps = NULL, uint32_t dep_count = 0, uint32_t owner = JOB_ANY_THREAD)
+{
+   if (!config.multi_thread) {
+      uint64_t trace_start_ns = trace_enabled() ? trace_now_ns() : 0;
+      handler(data);
+      if (trace_start_ns) {
+         trace_job(&tag, 0, trace_start_ns, trace_now_ns());
+      }
+      return JOB_NONE;
+   }
+   return job_queue_push(&frame_group, handler, data, data_len, deps, dep_count, &tag, owner);
+}
+
+static inline trace_tag_t job_tag(const char * name, trace_phase_t phase, int32_t x, int32_t y)
+{
+   trace_tag_t tag = {name, phase, x, y};
+   return tag;
+}
+
+// Chunks are CHUNK_SIZE-aligned so packed chunks never share a word; both
+// passes cover the live cells [1, width + 1) x [1, height + 1).
+static inline void chunk_bounds(chunk_spec_t * chunk, int32_t cx, int32_t cy)
+{
+   chunk->startx = (cx == 0) ? 1 : cx * CHUNK_SIZE;
+   chunk->starty = (cy == 0) ? 1 : cy * CHUNK_SIZE;
+   chunk->endx   = min2((cx + 1) * CHUNK_SIZE, config.width + 1);
+   chunk->endy   = min2((cy + 1) * CHUNK_SIZE, config.height + 1);
+   chunk->index  = cy * chunks_x + cx;
+}
+
+// Update, exchange and render jobs each cover a block of block_chunks_x x
+// block_chunks_y chunks, a strip when the block spans whole chunk rows.
+// Bigger blocks trade load balance for fewer jobs and dependencies.
+static int32_t block_chunks_x = 1;
+static int32_t block_chunks_y = 1;
+static int32_t blocks_x = 0;
+static int32_t blocks_y = 0;
+
+// Chunks [cx0, cx1) x [cy0, cy1).
+struct block_spec_t {
+   int32_t cx0;
+   int32_t cy0;
+   int32_t cx1;
+   int32_t cy1;
+};
+
+static void set_blocks(int32_t block_width, int32_t block_height)
+{
+   // In place every block is a strip of full rows
+   block_chunks_x = (block_width > 0 && !config.in_place) ? std::min((block_width + CHUNK_SIZE - 1) / CHUNK_SIZE, chunks_x) : chunks_x;
+   block_chunks_y = block_height > 0 ? std::min((block_height + CHUNK_SIZE - 1) / CHUNK_SIZE, chunks_y) : chunks_y;
+   block_chunks_x = std::max(block_chunks_x, 1);
+   block_chunks_y = std::max(block_chunks_y, 1);
+   blocks_x = (chunks_x + block_chunks_x - 1) / block_chunks_x;
+   blocks_y = (chunks_y + block_chunks_y - 1) / block_chunks_y;
+}
+
+static inline void block_bounds(block_spec_t * block, int32_t bx, int32_t by)
+{
+   block->cx0 = bx * block_chunks_x;
+   block->cy0 = by * block_chunks_y;
+   block->cx1 = std::min(block->cx0 + block_chunks_x, chunks_x);
+   block->cy1 = std::min(block->cy0 + block_chunks_y, chunks_y);
+}
+
+static inline bool block_on_edge(const block_spec_t * block)
+{
+   return block->cx0 == 0 || block->cy0 == 0 || block->cx1 == chunks_x || block->cy1 == chunks_y;
+}
+
+static inline bool chunk_needs_update(const chunk_spec_t * chunk, int32_t cx, int32_t cy)
+{
+   return chunk->startx < chunk->endx && chunk->starty < chunk->endy && chunk_is_active(cx, cy);
+}
+
+// Not update_jobs: inline updates leave JOB_NONE there too
+static inline bool chunk_needs_render(int32_t cx, int32_t cy)
+{
+   return render_all_chunks || chunk_is_active(cx, cy) || chunk_unrendered[cy * chunks_x + cx];
+}
+
+void exchange_ring_handler(void * param)
+{
+   exchange_chunk((chunk_spec_t *)param);
+}
+
+void exchange_block_handler(void * param)
+{
+   block_spec_t * block = (block_spec_t *)param;
+   chunk_spec_t chunk;
+   for (auto cy = block->cy0; cy < block->cy1; cy++)
+   {
+      for (auto cx = block->cx0; cx < block->cx1; cx++)
+      {
+         if (chunk_on_edge(cx, cy)) {
+            chunk_bounds(&chunk, cx, cy);
+            exchange_chunk(&chunk);
+         }
+      }
+   }
+}
+
+// The inactive chunks were marked unchanged when the block was pushed.
+void update_block_handler(void * param)
+{
+   block_spec_t * block = (block_spec_t *)param;
+   chunk_spec_t chunk;
+   for (auto cy = block->cy0; cy < block->cy1; cy++)
+   {
+      for (auto cx = block->cx0; cx < block->cx1; cx++)
+      {
+         chunk_bounds(&chunk, cx, cy);
+         if (chunk_needs_update(&chunk, cx, cy)) {
+            update_chunk(&chunk);
+         }
+      }
+   }
+}
+
+void render_block_handler(void * param)
+{
+   block_spec_t * block = (block_spec_t *)param;
+   chunk_spec_t chunk;
+   for (auto cy = block->cy0; cy < block->cy1; cy++)
+   {
+      for (auto cx = block->cx0; cx < block->cx1; cx++)
+      {
+         if (chunk_needs_render(cx, cy)) {
+            chunk_bounds(&chunk, cx, cy);
+            render_chunk(&chunk);
+         }
+      }
+   }
+}
+
+// In place there is only one board. Each job advances a strip of whole
+// chunk rows through a window of its old rows: rows y - 1 to y + k are
+// copied in, rows y to y + k - 1 are written over the board from the copies,
+// and the last two old rows roll to the front for the next k. The rows just
+// outside a strip belong to its neighbours, which may already have written
+// them, so they are copied to strip_edges before any strip starts.
+const size_t IN_PLACE_WINDOW_BYTES = 16 << 10;
+const int32_t IN_PLACE_MAX_WINDOW_ROWS = 16;
+
+static size_t strip_row_bytes;
+static int32_t window_rows;                   // k + 2
+static uint8_t * strip_windows;               // window_rows rows per strip
+static uint8_t * strip_edges;                 // old rows above and below each strip
+
+struct strip_spec_t {
+   int32_t index;
+   int32_t cy0;                               // chunk rows [cy0, cy1)
+   int32_t cy1;
+};
+
+static inline uint8_t * strip_row(int32_t y)
+{
+   return config.packed ? (uint8_t *)packed_board_row(current_packed, y) : (uint8_t *)board_row(current_board, y);
+}
+
+static inline void strip_rows(const strip_spec_t * strip, int32_t * y0, int32_t * y1)
+{
+   *y0 = (strip->cy0 == 0) ? 1 : strip->cy0 * CHUNK_SIZE;
+   *y1 = std::min(strip->cy1 * CHUNK_SIZE, config.height + 1);
+}
+
+// One window and two edge rows for every chunk row, as many strips as
+// there can be, so the blocks can change without allocating.
+static bool create_strips()
+{
+   free(strip_windows);
+   free(strip_edges);
+   strip_windows = NULL;
+   strip_edges = NULL;
+   if (!config.in_place) {
+      return true;
+   }
+   strip_row_bytes = config.packed ? current_packed->words_per_row * sizeof(uint64_t) : current_board->pitch * sizeof(uint32_t);
+   window_rows = 2 + std::max(1, std::min((int32_t)(IN_PLACE_WINDOW_BYTES / strip_row_bytes), IN_PLACE_MAX_WINDOW_ROWS - 2));
+   strip_windows = (uint8_t *)malloc((size_t)chunks_y * window_rows * strip_row_bytes);
+   strip_edges = (uint8_t *)malloc((size_t)chunks_y * 2 * strip_row_bytes);
+   return strip_windows && strip_edges;
+}
+
+// Writes rows [y, y + k) over the board from window rows 0 to k + 1, which
+// have the board's row stride.
+static void update_window(const uint8_t * window, int32_t y, int32_t k)
+{
+   if (config.packed) {
+      kernels->update_packed((const uint64_t *)window, packed_board_row(current_packed, y - 1), current_packed->words_per_row,
+            1, 1, config.width + 1, 1 + k);
+   } else {
+      kernels->update((const uint32_t *)window, board_row(current_board, y - 1), current_board->pitch,
+            1, 1, config.width + 1, 1 + k);
+   }
+}
+
+// Marks the chunks along row y whose cells differ from the old row.
+static void mark_changed_row(const uint8_t * old, int32_t y, bool * changed)
+{
+   for (auto cx = 0; cx < chunks_x; cx++)
+   {
+      if (changed[cx]) {
+         continue;
+      }
+      if (config.packed) {
+         const uint64_t * row = packed_board_row(current_packed, y);
+         changed[cx] = ((row[cx] ^ ((const uint64_t *)old)[cx]) & packed_range_mask(cx, 1, config.width + 1)) != 0;
+      } else {
+         int32_t startx = (cx == 0) ? 1 : cx * CHUNK_SIZE;
+         int32_t endx = std::min((cx + 1) * CHUNK_SIZE, config.width + 1);
+         changed[cx] = startx < endx &&
+               memcmp(board_row(current_board, y) + startx, (const uint32_t *)old + startx, (endx - startx) * sizeof(uint32_t)) != 0;
+      }
+   }
+}
+
+// Strips with no active chunk are not pushed; updating the inactive chunks
+// of the others leaves them as they were.
+void update_strip_handler(void * param)
+{
+   strip_spec_t * strip = (strip_spec_t *)param;
+   uint8_t * window = strip_windows + (size_t)strip->index * window_rows * strip_row_bytes;
+   const uint8_t * below = strip_edges + ((size_t)strip->index * 2 + 1) * strip_row_bytes;
+   int32_t y0, y1;
+   strip_rows(strip, &y0, &y1);
+
+   memcpy(window, strip_edges + (size_t)strip->index * 2 * strip_row_bytes, strip_row_bytes);
+   memcpy(window + strip_row_bytes, strip_row(y0), strip_row_bytes);
+   for (auto y = y0; y < y1; )
+   {
+      int32_t k = std::min(window_rows - 2, y1 - y);
+      for (auto r = 1; r <= k; r++)
+      {
+         memcpy(window + (r + 1) * strip_row_bytes, (y + r == y1) ? below : strip_row(y + r), strip_row_bytes);
+      }
+      update_window(window, y, k);
+      for (auto r = 0; r < k; r++)
+      {
+         mark_changed_row(window + (r + 1) * strip_row_bytes, y + r, &chunk_changed[current_changed ^ 1][(y + r) / CHUNK_SIZE * chunks_x]);
+      }
+      memmove(window, window + k * strip_row_bytes, 2 * strip_row_bytes);
+      y += k;
+   }
+
+   chunk_spec_t chunk;
+   for (auto cy = strip->cy0; cy < strip->cy1; cy++)
+   {
+      for (auto cx = 0; cx < chunks_x; cx++)
+      {
+         chunk_bounds(&chunk, cx, cy);
+         if (chunk_changed[current_changed ^ 1][chunk.index]) {
+            measure_chunk(&chunk, false, &chunk_stats_next[chunk.index]);
+         }
+      }
+   }
+}
+
+static void push_in_place_jobs(const render_target_t * target)
+{
+   memset(chunk_changed[current_changed ^ 1], 0, chunks_x * chunks_y * sizeof(bool));
+   if (config.topology == TOPOLOGY_TORUS) {
+      chunk_spec_t ring = {1, 1, (uint32_t)config.width + 1, (uint32_t)config.height + 1, 0};
+      exchange_chunk(&ring);
+   }
+
+   strip_spec_t strip;
+   int32_t y0, y1;
+   for (auto by = 0; by < blocks_y; by++)
+   {
+      strip.cy0 = by * block_chunks_y;
+      strip.cy1 = std::min(strip.cy0 + block_chunks_y, chunks_y);
+      strip_rows(&strip, &y0, &y1);
+      memcpy(strip_edges + (size_t)by * 2 * strip_row_bytes, strip_row(y0 - 1), strip_row_bytes);
+      memcpy(strip_edges + ((size_t)by * 2 + 1) * strip_row_bytes, strip_row(y1), strip_row_bytes);
+   }
+
+   active_chunks = 0;
+   chunk_spec_t chunk;
+   for (auto by = 0; by < blocks_y; by++)
+   {
+      strip.index = by;
+      strip.cy0 = by * block_chunks_y;
+      strip.cy1 = std::min(strip.cy0 + block_chunks_y, chunks_y);
+      uint32_t active = 0;
+      for (auto cy = strip.cy0; cy < strip.cy1; cy++)
+      {
+         for (auto cx = 0; cx < chunks_x; cx++)
+         {
+            chunk_bounds(&chunk, cx, cy);
+            active += chunk_needs_update(&chunk, cx, cy);
+         }
+      }
+      update_jobs[by] = JOB_NONE;
+      if (active) {
+         update_jobs[by] = push_job(job_tag("update strip", TRACE_PHASE_UPDATE, 0, strip.cy0), update_strip_handler, &strip, sizeof(strip),
+               NULL, 0, chunk_owner(strip.cy0));
+         active_chunks += active;
+      }
+   }
+
+   // A strip only renders its own rows, so it waits for its own update alone
+   render_target = target;
+   block_spec_t block;
+   for (auto by = 0; by < blocks_y && target; by++)
+   {
+      block_bounds(&block, 0, by);
+      bool wanted = false;
+      for (auto cy = block.cy0; cy < block.cy1 && !wanted; cy++)
+      {
+         for (auto cx = block.cx0; cx < block.cx1 && !wanted; cx++)
+         {
+            wanted = chunk_needs_render(cx, cy);
+         }
+      }
+      if (wanted) {
+         push_job(job_tag("render", TRACE_PHASE_RENDER, 0, block.cy0), render_block_handler, &block, sizeof(block),
+               &update_jobs[by], 1, chunk_owner(block.cy0));
+      }
+   }
+}
+
+// After the board was replaced as a whole.
+static void measure_board()
+{
+   board_population = 0;
+   board_hash = 0;
+   memset(chunk_stats, 0, chunks_x * chunks_y * sizeof(chunk_stats_t));
+   chunk_spec_t chunk;
+   chunk_stats_t stats;
+   for (auto cy = 0; cy < chunks_y; cy++)
+   {
+      for (auto cx = 0; cx < chunks_x; cx++)
+      {
+         chunk_bounds(&chunk, cx, cy);
+         measure_chunk(&chunk, false, &stats);
+         commit_chunk_stats(chunk.index, &stats);
+      }
+   }
+}
+
+static inline render_rect_t cell_rect(const render_target_t * target, int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   auto ppc = target->pixels_per_cell;
+   render_rect_t rect = {(startx - 1) * ppc, (starty - 1) * ppc, (endx - startx) * ppc, (endy - starty) * ppc};
+   return rect;
+}
+
+// Reports the chunks drawn this frame as rectangles, runs of chunks along a
+// chunk row joined with a rectangle ending just above that spans the same
+// columns, and clears them for the next frame.
+static void report_dirty(const render_target_t * target)
+{
+   render_dirty_t * dirty = target->dirty;
+   if (dirty) {
+      dirty->count = 0;
+      bool overflow = false;
+      int32_t min_x = INT32_MAX, min_y = INT32_MAX, max_x = 0, max_y = 0;
+      chunk_spec_t first, last;
+      for (auto cy = 0; cy < chunks_y; cy++)
+      {
+         for (auto cx = 0; cx < chunks_x; cx++)
+         {
+            if (!chunk_rendered[cy * chunks_x + cx]) {
+               continue;
+            }
+            chunk_bounds(&first, cx, cy);
+            while (cx + 1 < chunks_x && chunk_rendered[cy * chunks_x + cx + 1]) {
+               cx++;
+            }
+            chunk_bounds(&last, cx, cy);
+            render_rect_t rect = cell_rect(target, first.startx, first.starty, last.endx, last.endy);
+            min_x = std::min(min_x, rect.x);
+            min_y = std::min(min_y, rect.y);
+            max_x = std::max(max_x, rect.x + rect.width);
+            max_y = std::max(max_y, rect.y + rect.height);
+
+            bool merged = false;
+            for (uint32_t i = 0; i < dirty->count && !merged; i++)
+            {
+               render_rect_t * above = &dirty->rects[i];
+               if (above->x == rect.x && above->width == rect.width && above->y + above->height == rect.y) {
+                  above->height += rect.height;
+                  merged = true;
+               }
+            }
+            if (!merged) {
+               if (dirty->count < dirty->capacity) {
+                  dirty->rects[dirty->count++] = rect;
+               } else {
+                  overflow = true;
+               }
+            }
+         }
+      }
+      if (overflow && dirty->capacity) {
+         render_rect_t bounds = {min_x, min_y, max_x - min_x, max_y - min_y};
+         dirty->rects[0] = bounds;
+         dirty->count = 1;
+      }
+   }
+   memset(chunk_rendered, 0, chunks_x * chunks_y * sizeof(bool));
+}
+
+struct tile_job_t {
+   tile_t * tile;
+};
+
+void update_tile_handler(void * param)
+{
+   tile_job_t * job = (tile_job_t *)param;
+   universe_update_tile(universe, job->tile);
+}
+
+static inline bool tile_visible(const tile_t * tile)
+{
+   int64_t x = tile->tx * TILE_SIZE, y = tile->ty * TILE_SIZE;
+   return x + TILE_SIZE > 1 && x <= config.width && y + TILE_SIZE > 1 && y <= config.height;
+}
+
+// The viewport shows plane cells [1, width] x [1, height], like a bounded
+// board. Renders run before universe_finish, so the generation being written
+// is the one at the other parity.
+void render_tile_handler(void * param)
+{
+   tile_job_t * job = (tile_job_t *)param;
+   tile_t * tile = job->tile;
+
+   if (!render_all_chunks && !tile->changed) {
+      return;
+   }
+
+   const uint64_t * rows = tile->rows[universe_parity(universe) ^ 1];
+   int64_t x0 = tile->tx * TILE_SIZE, y0 = tile->ty * TILE_SIZE;
+   int32_t startx = (int32_t)std::max<int64_t>(x0, 1), endx = (int32_t)std::min<int64_t>(x0 + TILE_SIZE, config.width + 1);
+   int32_t starty = (int32_t)std::max<int64_t>(y0, 1), endy = (int32_t)std::min<int64_t>(y0 + TILE_SIZE, config.height + 1);
+   for (auto y = starty; y < endy; y++)
+   {
+      render_packed_row(render_target, cell_pixels(render_target, startx, y), &rows[y - y0],
+            (int32_t)(startx - x0), (int32_t)(endx - x0));
+   }
+   // Visible tiles line up with the chunks of the viewport
+   chunk_rendered[tile->ty * chunks_x + tile->tx] = true;
+}
+
+// Same pipeline as the bounded board with tiles for chunks; each render only
+// reads its own tile, so it only waits for that tile's update.
+static void game_update_and_render_tiles(const render_target_t * target)
+{
+   tile_job_t job;
+   uint32_t count = universe_prepare(universe);
+
+   active_chunks = count;
+   render_target = target;
+   if (target && render_all_chunks) {
+      // Tiles only exist where there is life, so paint the gaps first
+      draw_rect(target, 0, 0, config.width * target->pixels_per_cell,
+            config.height * target->pixels_per_cell, COLOR_DEAD);
+      memset(chunk_rendered, 1, chunks_x * chunks_y * sizeof(bool));
+   }
+
+   for (uint32_t i = 0; i < count; i++)
+   {
+      job.tile = universe_active_tile(universe, i);
+      job_id_t update = push_job(job_tag("tile update", TRACE_PHASE_UPDATE, (int32_t)job.tile->tx, (int32_t)job.tile->ty), update_tile_handler, &job, sizeof(job));
+      if (target && !render_all_chunks && tile_visible(job.tile)) {
+         push_job(job_tag("tile render", TRACE_PHASE_RENDER, (int32_t)job.tile->tx, (int32_t)job.tile->ty), render_tile_handler, &job, sizeof(job), &update, 1);
+      }
+   }
+   job_group_wait(&frame_group);
+
+   if (target && render_all_chunks) {
+      // Idle tiles hold the same cells at both parities, so every tile can
+      // be drawn once the updates are done
+      size_t tile_count;
+      tile_t * const * tiles = universe_tiles(universe, &tile_count);
+      for (size_t i = 0; i < tile_count; i++)
+      {
+         if (tile_visible(tiles[i])) {
+            job.tile = tiles[i];
+            push_job(job_tag("tile render", TRACE_PHASE_RENDER, (int32_t)job.tile->tx, (int32_t)job.tile->ty), render_tile_handler, &job, sizeof(job));
+         }
+      }
+      job_group_wait(&frame_group);
+   }
+   if (target) {
+      report_dirty(target);
+   }
+
+   universe_finish(universe);
+   generation++;
+   if (trace_enabled()) {
+      trace_frame_end();
+   }
+   // Tiles only remember the changes of the last generation, so a frame
+   // after one that was not rendered redraws them all
+   render_all_chunks = !target;
+}
+
+// Temporal blocking: each tile is loaded with a halo of `steps` cells into
+// a packed scratch board, advanced `steps` generations there while it stays
+// in cache, and written to the other board. The valid area shrinks by one
+// cell per step, so the tile itself comes out exactly as with single steps,
+// and the boards are swept once per block instead of once per generation.
+struct temporal_job_t {
+   int32_t startx;
+   int32_t starty;
+   int32_t endx;
+   int32_t endy;
+   uint32_t steps;
+};
+
+static thread_local std::vector<uint64_t> temporal_scratch[2];
+
+static inline int32_t wrap_coord(int32_t v, int32_t n) { return ((v - 1) % n + n) % n + 1; }
+
+// Copies `count` bits from bit `src_bit` of src to bit `dst_bit` of dst,
+// leaving the other bits of dst alone.
+static void copy_bits(uint64_t * dst, int64_t dst_bit, const uint64_t * src, int64_t src_bit, int64_t count)
+{
+   while (count > 0) {
+      int32_t n = (int32_t)std::min<int64_t>(count, 64 - (dst_bit & 63));
+      int32_t shift = (int32_t)(src_bit & 63);
+      const uint64_t * word = src + (src_bit >> 6);
+      uint64_t bits = word[0] >> shift;
+      if (shift + n > 64) {
+         bits |= word[1] << (64 - shift);
+      }
+      uint64_t mask = (n == 64) ? ~0ull : (1ull << n) - 1;
+      uint64_t & out = dst[dst_bit >> 6];
+      out = (out & ~(mask << (dst_bit & 63))) | ((bits & mask) << (dst_bit & 63));
+      dst_bit += n;
+      src_bit += n;
+      count -= n;
+   }
+}
+
+// Cells [x, x + count) of current board row y to bit `dst_bit` of a zeroed row.
+static void load_row_bits(uint64_t * dst, int32_t dst_bit, int32_t y, int32_t x, int32_t count)
+{
+   if (config.packed) {
+      copy_bits(dst, dst_bit, packed_board_row(current_packed, y), x, count);
+      return;
+   }
+   const uint32_t * row = board_row(current_board, y);
+   for (auto i = 0; i < count; i++)
+   {
+      dst[(dst_bit + i) / 64] |= (uint64_t)(row[x + i] & 1) << ((dst_bit + i) % 64);
+   }
+}
+
+void temporal_tile_handler(void * param)
+{
+   temporal_job_t * job = (temporal_job_t *)param;
+   bool torus = config.topology == TOPOLOGY_TORUS;
+   int32_t k = (int32_t)job->steps;
+   int32_t width = config.width, height = config.height;
+
+   // Scratch cell (c, r) is board cell (ox + c, oy + r); one more cell than
+   // the halo on each side feeds the first step.
+   int32_t ox = job->startx - k - 1, oy = job->starty - k - 1;
+   int32_t scratch_width = job->endx - job->startx + 2 * k + 2;
+   int32_t scratch_height = job->endy - job->starty + 2 * k + 2;
+   int32_t words_per_row = (scratch_width + 63) / 64;
+   for (auto i = 0; i < 2; i++)
+   {
+      temporal_scratch[i].resize((size_t)words_per_row * scratch_height);
+   }
+   uint64_t * a = temporal_scratch[0].data();
+   uint64_t * b = temporal_scratch[1].data();
+   memset(a, 0, (size_t)words_per_row * scratch_height * sizeof(uint64_t));
+
+   for (auto r = 0; r < scratch_height; r++)
+   {
+      int32_t y = oy + r;
+      if (torus) {
+         y = wrap_coord(y, height);
+      } else if (y < 1 || y > height) {
+         continue;
+      }
+      uint64_t * row = a + (size_t)r * words_per_row;
+      for (auto c = 0; c < scratch_width; )
+      {
+         int32_t x = ox + c;
+         if (torus) {
+            x = wrap_coord(x, width);
+         } else if (x < 1) {
+            c += 1 - x;
+            continue;
+         } else if (x > width) {
+            break;
+         }
+         int32_t run = std::min(scratch_width - c, width + 1 - x);
+         load_row_bits(row, c, y, x, run);
+         c += run;
+      }
+   }
+
+   // Off a bounded board cells stay dead, so clear them after every step
+   bool clip = !torus && (ox < 1 || oy < 1 || ox + scratch_width > width + 1 || oy + scratch_height > height + 1);
+   for (auto s = 1; s <= k; s++)
+   {
+      kernels->update_packed(a, b, words_per_row, s, s, scratch_width - s, scratch_height - s);
+      for (auto r = s; r < scratch_height - s && clip; r++)
+      {
+         uint64_t * row = b + (size_t)r * words_per_row;
+         int32_t y = oy + r;
+         for (auto w = 0; w < words_per_row; w++)
+         {
+            row[w] = (y < 1 || y > height) ? 0 : row[w] & packed_range_mask(w, 1 - ox, width + 1 - ox);
+         }
+      }
+      std::swap(a, b);
+   }
+
+   for (auto y = job->starty; y < job->endy; y++)
+   {
+      const uint64_t * row = a + (size_t)(y - oy) * words_per_row;
+      if (config.packed) {
+         copy_bits(packed_board_row(next_packed, y), job->startx, row, job->startx - ox, job->endx - job->startx);
+      } else {
+         uint32_t * out = board_row(next_board, y);
+         for (auto x = job->startx; x < job->endx; x++)
+         {
+            out[x] = (row[(x - ox) / 64] >> ((x - ox) % 64)) & 1;
+         }
+      }
+   }
+
+   // Tiles are made of whole chunks
+   chunk_spec_t chunk;
+   for (auto cy = job->starty / CHUNK_SIZE; cy <= (job->endy - 1) / CHUNK_SIZE; cy++)
+   {
+      for (auto cx = job->startx / CHUNK_SIZE; cx <= (job->endx - 1) / CHUNK_SIZE; cx++)
+      {
+         chunk_bounds(&chunk, cx, cy);
+         measure_chunk(&chunk, true, &chunk_stats_next[chunk.index]);
+      }
+   }
+}
+
+static void game_update_and_render_temporal(const render_target_t * target, uint32_t steps)
+{
+   // Tiles are multiples of 64 cells wide, so packed tiles never share a word
+   temporal_job_t job;
+   int32_t tile = config.temporal_tile;
+   job.steps = steps;
+   for (auto ty = 0; ty <= config.height / tile; ty++)
+   {
+      for (auto tx = 0; tx <= config.width / tile; tx++)
+      {
+         job.startx = std::max(tx * tile, 1);
+         job.starty = std::max(ty * tile, 1);
+         job.endx = std::min((tx + 1) * tile, config.width + 1);
+         job.endy = std::min((ty + 1) * tile, config.height + 1);
+         if (job.startx < job.endx && job.starty < job.endy) {
+            push_job(job_tag("temporal", TRACE_PHASE_UPDATE, tx, ty), temporal_tile_handler, &job, sizeof(job), NULL, 0,
+                  chunk_owner(job.starty / CHUNK_SIZE));
+         }
+      }
+   }
+   job_group_wait(&frame_group);
+   swap_boards();
+   generation += steps;
+
+   // Changes are not tracked across a block: every chunk counts as changed
+   mark_all_chunks_changed();
+   active_chunks = chunks_x * chunks_y;
+   for (auto i = 0; i < chunks_x * chunks_y; i++)
+   {
+      chunk_dirty[i] = true;
+      commit_chunk_stats(i, &chunk_stats_next[i]);
+   }
+   detect_cycle();
+
+   render_target = target;
+   chunk_spec_t chunk;
+   for (auto cy = 0; cy < chunks_y && target; cy++)
+   {
+      for (auto cx = 0; cx < chunks_x; cx++)
+      {
+         chunk_bounds(&chunk, cx, cy);
+         if (chunk.startx < chunk.endx && chunk.starty < chunk.endy) {
+            push_job(job_tag("render", TRACE_PHASE_RENDER, cx, cy), render_current_chunk_handler, &chunk, sizeof(chunk), NULL, 0, chunk_owner(cy));
+         }
+      }
+   }
+   job_group_wait(&frame_group);
+   if (target) {
+      report_dirty(target);
+   }
+   if (trace_enabled()) {
+      trace_frame_end();
+   }
+}
+
+uint32_t game_advance(uint32_t max_generations, const render_target_t * target)
+{
+   if (config.temporal_steps > 1) {
+      uint32_t steps = std::min(std::max(max_generations, 1u), config.temporal_steps);
+      game_update_and_render_temporal(target, steps);
+      return steps;
+   }
+   game_update_and_render(target);
+   return 1;
+}
+
+// Waits for the jobs of a generation and takes the changed chunks over.
+static void finish_generation(const render_target_t * target)
+{
+   job_group_wait(&frame_group);
+   if (target) {
+      report_dirty(target);
+   }
+
+   // In place both board pointers are the one board
+   swap_boards();
+   current_changed ^= 1;
+   for (auto i = 0; i < chunks_x * chunks_y; i++)
+   {
+      chunk_dirty[i] |= chunk_changed[current_changed][i];
+      chunk_unrendered[i] |= !target && chunk_changed[current_changed][i];
+      if (chunk_changed[current_changed][i]) {
+         commit_chunk_stats(i, &chunk_stats_next[i]);
+      }
+   }
+   generation++;
+   detect_cycle();
+   if (trace_enabled()) {
+      trace_frame_end();
+   }
+   if (recording) {
+      record_generation();
+   }
+   if (target) {
+      render_all_chunks = false;
+   }
+}
+
+void game_update_and_render(const render_target_t * target)
+{
+   if (config.topology == TOPOLOGY_INFINITE) {
+      game_update_and_render_tiles(target);
+      return;
+   }
+   if (config.temporal_steps > 1) {
+      game_update_and_render_temporal(target, config.temporal_steps);
+      return;
+   }
+   if (config.in_place) {
+      push_in_place_jobs(target);
+      finish_generation(target);
+      return;
+   }
+
+   chunk_spec_t chunk;
+   block_spec_t block;
+   uint32_t next_changed = current_changed ^ 1;
+
+   // The halo exchange only touches the edges of the current board, so the
+   // interior updates go ahead while it runs; an update waits only for the
+   // exchanges of the blocks around it.
+   bool torus = config.topology == TOPOLOGY_TORUS;
+   job_id_t ring_job = JOB_NONE;
+   if (torus && config.packed) {
+      // Packed halo bits share words with the edge cells on both sides, so
+      // one job exchanges the whole ring instead
+      chunk.startx = 1;
+      chunk.starty = 1;
+      chunk.endx = config.width + 1;
+      chunk.endy = config.height + 1;
+      chunk.index = 0;
+      ring_job = push_job(job_tag("exchange ring", TRACE_PHASE_UPDATE, 0, 0), exchange_ring_handler, &chunk, sizeof(chunk));
+   }
+   for (auto by = 0; by < blocks_y; by++)
+   {
+      for (auto bx = 0; bx < blocks_x; bx++)
+      {
+         block_bounds(&block, bx, by);
+         exchange_jobs[by * blocks_x + bx] = JOB_NONE;
+         if (torus && block_on_edge(&block)) {
+            exchange_jobs[by * blocks_x + bx] = config.packed ? ring_job :
+               push_job(job_tag("exchange", TRACE_PHASE_UPDATE, block.cx0, block.cy0), exchange_block_handler, &block, sizeof(block),
+                     NULL, 0, chunk_owner(block.cy0));
+         }
+      }
+   }
+
+   active_chunks = 0;
+   for (auto by = 0; by < blocks_y; by++)
+   {
+      for (auto bx = 0; bx < blocks_x; bx++)
+      {
+         block_bounds(&block, bx, by);
+         update_jobs[by * blocks_x + bx] = JOB_NONE;
+         uint32_t active = 0;
+         for (auto cy = block.cy0; cy < block.cy1; cy++)
+         {
+            for (auto cx = block.cx0; cx < block.cx1; cx++)
+            {
+               chunk_bounds(&chunk, cx, cy);
+               if (chunk_needs_update(&chunk, cx, cy)) {
+                  active++;
+               } else {
+                  chunk_changed[next_changed][chunk.index] = false;
+               }
+            }
+         }
+         if (!active) {
+            continue;
+         }
+         job_id_t deps[9];
+         uint32_t dep_count = 0;
+         for (auto y = by - 1; y <= by + 1 && torus; y++)
+         {
+            for (auto x = bx - 1; x <= bx + 1; x++)
+            {
+               if (x >= 0 && x < blocks_x && y >= 0 && y < blocks_y &&
+                     exchange_jobs[y * blocks_x + x] != JOB_NONE &&
+                     (dep_count == 0 || deps[dep_count - 1] != exchange_jobs[y * blocks_x + x])) {
+                  deps[dep_count++] = exchange_jobs[y * blocks_x + x];
+               }
+            }
+         }
+         update_jobs[by * blocks_x + bx] = push_job(job_tag("update", TRACE_PHASE_UPDATE, block.cx0, block.cy0), update_block_handler,
+               &block, sizeof(block), deps, dep_count, chunk_owner(block.cy0));
+         active_chunks += active;
+      }
+   }
+
+   // Each render waits only for the updates of its 3x3 neighbourhood of
+   // blocks instead of the whole update pass. Chunks that were not updated
+   // did not change, so they only need a render on the first frame.
+   render_target = target;
+   for (auto by = 0; by < blocks_y && target; by++)
+   {
+      for (auto bx = 0; bx < blocks_x; bx++)
+      {
+         block_bounds(&block, bx, by);
+         bool wanted = false;
+         for (auto cy = block.cy0; cy < block.cy1 && !wanted; cy++)
+         {
+            for (auto cx = block.cx0; cx < block.cx1 && !wanted; cx++)
+            {
+               wanted = chunk_needs_render(cx, cy);
+            }
+         }
+         if (!wanted) {
+            continue;
+         }
+         job_id_t deps[9];
+         uint32_t dep_count = 0;
+         for (auto y = by - 1; y <= by + 1; y++)
+         {
+            for (auto x = bx - 1; x <= bx + 1; x++)
+            {
+               if (x >= 0 && x < blocks_x && y >= 0 && y < blocks_y) {
+                  deps[dep_count++] = update_jobs[y * blocks_x + x];
+               }
+            }
+         }
+         push_job(job_tag("render", TRACE_PHASE_RENDER, block.cx0, block.cy0), render_block_handler, &block, sizeof(block),
+               deps, dep_count, chunk_owner(block.cy0));
+      }
+   }
+   finish_generation(target);
+}
+
+static void seed_glider_guns(int32_t width, int32_t height)
+{
+    const int32_t lut[] = {(5*width)/6, (width / 2 - 5), (width / 2 + 5), (1*width)/6};
+    for (uint32_t i = 0; i < 32; i++)
+    {
+        auto x = lut[i & 0x3];
+        auto y = (9*height / 16) + (((i/4) - 4) * ((12 * height) / 100));
+        auto dx = (i % 2 == 0) ? 1 : -1;
+        auto dy = (i < 16) ? -1 : 1;
+        place_pattern(current_board, GLIDER_GUN_RLE, x, y, dx, dy);
+        update_board(current_board, next_board, 1, 1, width + 1, height + 1);
+        swap_boards();
+    }
+    place_pattern(current_board, SPACESHIP_RLE, width - 8, height / 2 + 2);
+    place_pattern(current_board, SPACESHIP_RLE, 8, height / 2 - 2, -1, -1);
+}
+
+const uint64_t SPLITMIX_GAMMA = 0x9e3779b97f4a7c15ull;
+
+// splitmix64, so a seed gives the same soup on every platform and compiler
+static inline uint64_t next_random(uint64_t * state)
+{
+    uint64_t z = (*state += SPLITMIX_GAMMA);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Rows from `first_row` + 1 on; the generator state only advances by the
+// gamma, so the rows above are skipped in one step.
+static void seed_random_soup(int32_t width, int32_t height, uint32_t fill_percent, uint64_t seed, int32_t first_row)
+{
+    uint64_t state = seed + (uint64_t)first_row * (uint64_t)width * SPLITMIX_GAMMA;
+    for (auto y = 1; y <= height; y++)
+    {
+        uint32_t * row = board_row(current_board, y);
+        for (auto x = 1; x <= width; x++)
+        {
+            row[x] = (next_random(&state) % 100) < fill_percent;
+        }
+    }
+}
+
+static bool seed_pattern_file(const pattern_sink_t * sink)
+{
+    pattern_t * pattern = pattern_open(config.pattern_path, &init_error);
+    if (!pattern) {
+        return false;
+    }
+    int64_t width = pattern_width(pattern);
+    int64_t height = pattern_height(pattern);
+    int64_t left = config.pattern_centered ? 1 + (config.width - width) / 2 : config.pattern_x;
+    int64_t top = (config.pattern_centered ? 1 + (seed_height - height) / 2 : config.pattern_y) - config.slab_y;
+    pattern_placement_t placement = {left, top, 1, 1};
+    if (config.pattern_flip_x) {
+        placement.x = left + width - 1;
+        placement.dir_x = -1;
+    }
+    if (config.pattern_flip_y) {
+        placement.y = top + height - 1;
+        placement.dir_y = -1;
+    }
+    bool loaded = pattern_decode(pattern, &placement, sink, &init_error);
+    pattern_close(pattern);
+    return loaded;
+}
+
+static void fast_forward(uint32_t log2_generations)
+{
+    hashlife_t * hl = hashlife_create(HASHLIFE_MAX_NODES);
+    hashlife_load(hl, current_board->cells, current_board->pitch, 1, 1, config.width + 1, config.height + 1);
+    hashlife_advance(hl, log2_generations);
+    hashlife_store(hl, current_board->cells, current_board->pitch, 1, 1, config.width + 1, config.height + 1);
+    generation += hashlife_generation(hl);
+    hashlife_destroy(hl);
+}
+
+static inline uint32_t blend_channel(uint32_t from, uint32_t to, uint32_t shift, uint32_t step, uint32_t steps)
+{
+    int32_t a = (from >> shift) & 0xff;
+    int32_t b = (to >> shift) & 0xff;
+    return (uint32_t)(a + (b - a) * (int32_t)step / (int32_t)steps) << shift;
+}
+
+// The config's rule, else the pattern file's, else B3/S23.
+static bool init_rule()
+{
+    const char * text = config.rule ? config.rule : "B3/S23";
+    pattern_t * pattern = NULL;
+    if (!config.rule && config.pattern == SEED_FILE) {
+        pattern = pattern_open(config.pattern_path, &init_error);
+        if (!pattern) {
+            return false;
+        }
+        text = pattern_rule(pattern);
+    }
+    bool parsed = rule_parse(text, &rule, &init_error);
+    if (pattern) {
+        pattern_close(pattern);
+    }
+    if (!parsed) {
+        return false;
+    }
+
+    rule_update = rule_kernel(&rule);
+    if (rule_update && (config.packed || config.topology == TOPOLOGY_INFINITE || config.temporal_steps > 1 || config.fast_forward_log2)) {
+        init_error = "packed boards, the infinite plane, temporal blocking and HashLife only run B3/S23";
+        return false;
+    }
+
+    for (uint32_t state = 2; state < rule.states; state++)
+    {
+        colors[state] = 0;
+        for (uint32_t shift = 0; shift < 24; shift += 8)
+        {
+            colors[state] |= blend_channel(COLOR_ALIVE, COLOR_DEAD, shift, state - 1, rule.states - 1);
+        }
+    }
+    return true;
+}
+
+struct first_touch_job_t {
+   uint8_t * boards[2];
+   size_t row_bytes;
+   int32_t starty;
+   int32_t endy;
+};
+
+static void first_touch_handler(void * data)
+{
+   first_touch_job_t * job = (first_touch_job_t *)data;
+   for (auto i = 0; i < 2; i++)
+   {
+      if (job->boards[i]) {
+         memset(job->boards[i] + job->starty * job->row_bytes, 0, (job->endy - job->starty) * job->row_bytes);
+      }
+   }
+}
+
+// Has the owner of every chunk row write its rows of both untouched boards
+// first, so their pages land on its node. The halo rows go with the first
+// and last chunk rows.
+static void first_touch_boards(void * board0, void * board1, size_t row_bytes, int32_t rows)
+{
+   first_touch_job_t job;
+   job.boards[0] = (uint8_t *)board0;
+   job.boards[1] = (uint8_t *)board1;
+   job.row_bytes = row_bytes;
+   for (auto cy = 0; cy < chunks_y; cy++)
+   {
+      job.starty = cy * CHUNK_SIZE;
+      job.endy = (cy == chunks_y - 1) ? rows : min2((cy + 1) * CHUNK_SIZE, rows);
+      if (job.starty < job.endy) {
+         push_job(job_tag("first touch", TRACE_PHASE_COUNT, 0, cy), first_touch_handler, &job, sizeof(job), NULL, 0, chunk_owner(cy));
+      }
+   }
+   job_group_wait(&frame_group);
+}
+
+static void game_release_boards()
+{
+    for (auto i = 0; i < 2; i++)
+    {
+        board_destroy(&boards[i]);
+        packed_board_destroy(&packed_boards[i]);
+    }
+    current_board = &boards[0];
+    next_board = &boards[1];
+    current_packed = &packed_boards[0];
+    next_packed = &packed_boards[1];
+}
+
+bool game_init(const game_config_t * game_config)
+{
+    config = *game_config;
+    kernels = config.kernels ? config.kernels : update_kernels_select();
+    init_row_keys();
+    generation = 0;
+    config.temporal_steps = (config.topology == TOPOLOGY_INFINITE) ? 1 : std::max(config.temporal_steps, 1u);
+    config.temporal_tile = std::max((config.temporal_tile + 63) / 64 * 64, 64);
+    init_error = "";
+
+    game_release_boards();
+    if (!init_rule()) {
+        return false;
+    }
+    if (config.in_place && (config.topology == TOPOLOGY_INFINITE || config.temporal_steps > 1 || rule_update)) {
+        init_error = "in-place updates run B3/S23 on bounded or torus boards, without temporal blocking";
+        return false;
+    }
+    if (config.fast_forward_log2 && config.topology != TOPOLOGY_BOUNDED) {
+        // HashLife neither wraps nor grows the board: it would crop the plane
+        init_error = "HashLife only fast-forwards bounded boards";
+        return false;
+    }
+    seed_height = config.height;
+    if (config.slab_height) {
+        if (config.topology != TOPOLOGY_BOUNDED || config.temporal_steps > 1 || config.fast_forward_log2 || rule_update ||
+              config.pattern == SEED_GLIDER_GUNS) {
+            init_error = "slabs run B3/S23 on bounded boards, without temporal blocking or HashLife, and cannot seed the glider guns";
+            return false;
+        }
+        if (config.slab_y < 0 || config.slab_height < 1 || config.slab_y + config.slab_height > config.height) {
+            init_error = "the slab does not fit the board";
+            return false;
+        }
+        config.height = config.slab_height;
+    }
+    band_workers = (config.numa_bands && config.multi_thread && config.topology != TOPOLOGY_INFINITE) ? job_queue_worker_count() : 0;
+    // Packed runs only seed the cell boards before packing them. In place
+    // the second board is only there for the glider guns to settle in.
+    bool untouched = band_workers && !config.packed;
+    for (auto i = 0; i < ((config.in_place && config.pattern != SEED_GLIDER_GUNS) ? 1 : 2); i++)
+    {
+        if (!board_create(&boards[i], config.width, config.height, config.huge_pages, untouched)) {
+            game_release_boards();
+            init_error = "cannot allocate the boards";
+            return false;
+        }
+    }
+
+    chunks_x = config.width / CHUNK_SIZE + 1;
+    chunks_y = config.height / CHUNK_SIZE + 1;
+    set_blocks(config.block_width, config.block_height);
+    for (auto i = 0; i < 2; i++)
+    {
+        free(chunk_changed[i]);
+        chunk_changed[i] = (bool *)calloc(chunks_x * chunks_y, sizeof(bool));
+    }
+    free(chunk_dirty);
+    chunk_dirty = (bool *)calloc(chunks_x * chunks_y, sizeof(bool));
+    free(chunk_rendered);
+    chunk_rendered = (bool *)calloc(chunks_x * chunks_y, sizeof(bool));
+    free(chunk_unrendered);
+    chunk_unrendered = (bool *)calloc(chunks_x * chunks_y, sizeof(bool));
+    free(chunk_stats);
+    chunk_stats = (chunk_stats_t *)calloc(chunks_x * chunks_y, sizeof(chunk_stats_t));
+    free(chunk_stats_next);
+    chunk_stats_next = (chunk_stats_t *)calloc(chunks_x * chunks_y, sizeof(chunk_stats_t));
+    checkpoint_generation = NO_CHECKPOINT;
+    free(update_jobs);
+    update_jobs = (job_id_t *)calloc(chunks_x * chunks_y, sizeof(job_id_t));
+    free(exchange_jobs);
+    exchange_jobs = (job_id_t *)calloc(chunks_x * chunks_y, sizeof(job_id_t));
+    if (untouched) {
+       first_touch_boards(boards[0].cells, boards[1].cells, boards[0].pitch * sizeof(uint32_t), config.height + 2);
+    }
+
+    switch (config.pattern)
+    {
+       case SEED_LIDKA_PRED:
+          place_pattern(current_board, LIDKA_PRED_RLE, config.width / 2, seed_height / 2 - config.slab_y);
+          break;
+       case SEED_GLIDER_GUNS:
+          seed_glider_guns(config.width, config.height);
+          break;
+       case SEED_RANDOM_SOUP:
+          seed_random_soup(config.width, config.height, config.fill_percent, config.seed, config.slab_y);
+          break;
+       case SEED_FILE:
+          // The plane takes the whole pattern, unclipped, once it exists
+          if (config.topology != TOPOLOGY_INFINITE) {
+             pattern_sink_t sink = pattern_sink_board(current_board);
+             if (!seed_pattern_file(&sink)) {
+                game_release_boards();
+                return false;
+             }
+          }
+          break;
+       case SEED_NONE:
+          break;
+    }
+
+    if (config.fast_forward_log2) {
+       fast_forward(config.fast_forward_log2);
+    }
+    if (config.in_place && current_board != &boards[0]) {
+       std::swap(boards[0], boards[1]);
+    }
+    if (config.in_place) {
+       board_destroy(&boards[1]);
+       current_board = next_board = &boards[0];
+    }
+
+    mark_all_chunks_changed();
+    reset_cycles();
+
+    if (config.topology == TOPOLOGY_INFINITE) {
+       // The seed is placed on the board and then moved onto the plane
+       if (!universe) {
+          universe = universe_create();
+       }
+       universe_clear(universe);
+       universe_load(universe, current_board);
+       board_destroy(&boards[0]);
+       board_destroy(&boards[1]);
+       config.packed = false;
+       if (config.pattern == SEED_FILE) {
+          pattern_sink_t sink = pattern_sink_universe(universe);
+          return seed_pattern_file(&sink);
+       }
+       return true;
+    }
+
+    if (config.packed) {
+       // Seeders write cells; once packed the cell boards are no longer needed
+       for (auto i = 0; i < (config.in_place ? 1 : 2); i++)
+       {
+          if (!packed_board_create(&packed_boards[i], config.width, config.height, config.huge_pages, band_workers != 0)) {
+             game_release_boards();
+             init_error = "cannot allocate the boards";
+             return false;
+          }
+       }
+       if (band_workers) {
+          first_touch_boards(packed_boards[0].words, packed_boards[1].words, packed_boards[0].words_per_row * sizeof(uint64_t),
+                config.height + 2);
+       }
+       packed_board_pack(current_board->cells, current_board->pitch, current_packed->words, current_packed->words_per_row,
+             config.width + 2, config.height + 2);
+       board_destroy(&boards[0]);
+       board_destroy(&boards[1]);
+       if (config.in_place) {
+          next_packed = current_packed;
+       }
+    }
+    if (!create_strips()) {
+       game_release_boards();
+       init_error = "cannot allocate the boards";
+       return false;
+    }
+    measure_board();
+    detect_cycle();
+    return true;
+}
+
+void game_get_stats(game_stats_t * stats)
+{
+   stats->generation = generation;
+   stats->active_chunks = active_chunks;
+   stats->temporal_steps = config.temporal_steps;
+   stats->temporal_tile = config.temporal_tile;
+   stats->min_x = stats->min_y = INT32_MAX;
+   stats->max_x = stats->max_y = INT32_MIN;
+   stats->period = cycle_period;
+   stats->cycle_start = cycle_start;
+   if (config.topology == TOPOLOGY_INFINITE) {
+      stats->population = universe_population(universe);
+      stats->hash = 0;
+      size_t tile_count;
+      universe_tiles(universe, &tile_count);
+      stats->total_chunks = (uint32_t)tile_count;
+      stats->memory = BOARD_MEMORY_HEAP;
+      stats->board_bytes = tile_count * sizeof(tile_t);
+      return;
+   }
+   stats->total_chunks = chunks_x * chunks_y;
+   stats->population = board_population;
+   stats->hash = board_hash;
+   for (auto i = 0; i < chunks_x * chunks_y; i++)
+   {
+      const chunk_stats_t & chunk = chunk_stats[i];
+      if (chunk.population) {
+         stats->min_x = std::min(stats->min_x, chunk.min_x);
+         stats->min_y = std::min(stats->min_y, chunk.min_y);
+         stats->max_x = std::max(stats->max_x, chunk.max_x);
+         stats->max_y = std::max(stats->max_y, chunk.max_y);
+      }
+   }
+   stats->memory = config.packed ? current_packed->memory : current_board->memory;
+   stats->board_bytes = (config.in_place ? 1 : 2) * (config.packed ? current_packed->bytes : current_board->bytes) +
+         (config.in_place ? (size_t)chunks_y * (window_rows + 2) * strip_row_bytes : 0);
+}
+
+bool game_get_placement(game_placement_t * placement)
+{
+   memset(placement, 0, sizeof(*placement));
+   if (config.topology == TOPOLOGY_INFINITE) {
+      return false;
+   }
+   size_t page_size = numa_page_size();
+   for (auto i = 0; i < 2; i++)
+   {
+      const uint8_t * base = config.packed ? (const uint8_t *)packed_boards[i].words : (const uint8_t *)boards[i].cells;
+      size_t bytes = config.packed ? packed_boards[i].bytes : boards[i].bytes;
+      size_t row_bytes = config.packed ? packed_boards[i].words_per_row * sizeof(uint64_t) : boards[i].pitch * sizeof(uint32_t);
+      std::vector<int32_t> nodes(numa_page_count(base, bytes));
+      if (!numa_page_nodes(base, bytes, nodes.data())) {
+         return false;
+      }
+      uintptr_t first_page = (uintptr_t)base / page_size * page_size;
+      for (size_t page = 0; page < nodes.size(); page++)
+      {
+         placement->pages++;
+         int32_t node = nodes[page];
+         if (node == NUMA_NO_NODE || node >= (int32_t)NUMA_MAX_NODES) {
+            placement->untouched++;
+            continue;
+         }
+         placement->node_pages[node]++;
+         placement->node_count = std::max(placement->node_count, (uint32_t)node + 1);
+
+         // Judged by the band of the first row on the page
+         uintptr_t address = std::max(first_page + page * page_size, (uintptr_t)base);
+         int32_t cy = std::min((int32_t)((address - (uintptr_t)base) / row_bytes / CHUNK_SIZE), chunks_y - 1);
+         uint32_t owner_node = band_workers ? job_queue_thread_node(chunk_owner(cy)) : JOB_NO_NODE;
+         if (owner_node != JOB_NO_NODE && (uint32_t)node != owner_node) {
+            placement->misplaced++;
+         }
+      }
+   }
+   return true;
+}
+
+const char * game_init_error()
+{
+   return init_error;
+}
+
+const update_kernels_t * game_kernels()
+{
+   return kernels;
+}
+
+void game_get_tuning(game_tuning_t * tuning)
+{
+   tuning->kernels = kernels;
+   tuning->block_width = config.block_width;
+   tuning->block_height = config.block_height;
+   tuning->multi_thread = config.multi_thread;
+}
+
+void game_set_tuning(const game_tuning_t * tuning)
+{
+   kernels = tuning->kernels ? tuning->kernels : update_kernels_select();
+   config.kernels = tuning->kernels;
+   config.block_width = tuning->block_width;
+   config.block_height = tuning->block_height;
+   config.multi_thread = tuning->multi_thread;
+   set_blocks(config.block_width, config.block_height);
+   // The bands stay where they were first touched, only their owners move
+   band_workers = (config.numa_bands && config.multi_thread && config.topology != TOPOLOGY_INFINITE) ? job_queue_worker_count() : 0;
+}
+
+const rule_t * game_rule()
+{
+   return &rule;
+}
+
+// Cells of row y packed 64 per word, whatever the board representation.
+static inline uint64_t board_word(int32_t y, int32_t w)
+{
+   if (config.packed) {
+      return packed_board_row(current_packed, y)[w];
+   }
+   uint64_t word = 0;
+   uint32_t * row = board_row(current_board, y);
+   for (auto i = 0; i < 64 && w * 64 + i < current_board->pitch; i++)
+   {
+      word |= (uint64_t)(row[w * 64 + i] == 1) << i;
+   }
+   return word;
+}
+
+static inline void hash_word(uint64_t * hash, uint64_t word)
+{
+   for (auto i = 0; i < 8; i++)
+   {
+      *hash ^= (word >> (i * 8)) & 0xff;
+      *hash *= 0x100000001b3ull;
+   }
+}
+
+static bool tile_before(const tile_t * a, const tile_t * b)
+{
+   return (a->ty != b->ty) ? a->ty < b->ty : a->tx < b->tx;
+}
+
+// Plane checksum: the populated tiles in row-major order with their positions.
+static uint64_t universe_checksum()
+{
+   uint64_t hash = 0xcbf29ce484222325ull;
+   size_t tile_count;
+   tile_t * const * all = universe_tiles(universe, &tile_count);
+   std::vector<tile_t *> tiles;
+   for (size_t i = 0; i < tile_count; i++)
+   {
+      if (all[i]->population) {
+         tiles.push_back(all[i]);
+      }
+   }
+   std::sort(tiles.begin(), tiles.end(), tile_before);
+   for (auto tile : tiles)
+   {
+      const uint64_t * rows = universe_tile_rows(universe, tile);
+      hash_word(&hash, (uint64_t)tile->tx);
+      hash_word(&hash, (uint64_t)tile->ty);
+      for (auto y = 0; y < TILE_SIZE; y++)
+      {
+         hash_word(&hash, rows[y]);
+      }
+   }
+   return hash;
+}
+
+uint64_t game_checksum()
+{
+   if (config.topology == TOPOLOGY_INFINITE) {
+      return universe_checksum();
+   }
+   return game_checksum_continue(0xcbf29ce484222325ull);
+}
+
+uint64_t game_checksum_continue(uint64_t hash)
+{
+   auto words = (config.width + 1 + 63) / 64;
+   for (auto y = 1; y <= config.height; y++)
+   {
+      for (auto w = 0; w < words; w++)
+      {
+         hash_word(&hash, board_word(y, w) & packed_range_mask(w, 1, config.width + 1));
+      }
+   }
+   return hash;
+}
+
+int32_t game_row_words()
+{
+   return (config.width + 2 + 63) / 64;
+}
+
+void game_get_edge_rows(uint64_t * first, uint64_t * last)
+{
+   for (auto w = 0; w < game_row_words(); w++)
+   {
+      first[w] = board_word(1, w) & packed_range_mask(w, 1, config.width + 1);
+      last[w] = board_word(config.height, w) & packed_range_mask(w, 1, config.width + 1);
+   }
+}
+
+// Returns true if the row changed.
+static bool set_halo_row(int32_t y, const uint64_t * words)
+{
+   bool changed = false;
+   if (config.packed) {
+      uint64_t * row = packed_board_row(current_packed, y);
+      for (auto w = 0; w < game_row_words(); w++)
+      {
+         uint64_t word = words[w] & packed_range_mask(w, 1, config.width + 1);
+         changed |= row[w] != word;
+         row[w] = word;
+      }
+      return changed;
+   }
+   uint32_t * row = board_row(current_board, y);
+   for (auto x = 1; x <= config.width; x++)
+   {
+      uint32_t cell = (words[x / 64] >> (x % 64)) & 1;
+      changed |= row[x] != cell;
+      row[x] = cell;
+   }
+   return changed;
+}
+
+void game_set_halo_rows(const uint64_t * above, const uint64_t * below)
+{
+   // A changed halo wakes the chunk row next to it like a changed neighbour
+   bool above_changed = set_halo_row(0, above);
+   bool below_changed = set_halo_row(config.height + 1, below);
+   for (auto cx = 0; cx < chunks_x; cx++)
+   {
+      chunk_changed[current_changed][cx] |= above_changed;
+      chunk_changed[current_changed][(chunks_y - 1) * chunks_x + cx] |= below_changed;
+   }
+}
+
+uint64_t game_population()
+{
+   if (config.topology == TOPOLOGY_INFINITE) {
+      return universe_population(universe);
+   }
+   return board_population;
+}
+
+
+// Cells [startx, endx) of row y, at most 64 of them, from bit 0 up. Between
+// generations the other board still holds the previous generation of every
+// chunk that changed.
+static uint64_t chunk_row_bits(int32_t y, int32_t startx, int32_t endx, bool previous = false)
+{
+   uint64_t bits = 0;
+   if (config.packed) {
+      const uint64_t * row = packed_board_row(previous ? next_packed : current_packed, y);
+      int32_t w = startx / 64;
+      int32_t shift = startx % 64;
+      bits = row[w] >> shift;
+      if (shift && (w + 1) * 64 < endx) {
+         bits |= row[w + 1] << (64 - shift);
+      }
+   } else {
+      const uint32_t * row = board_row(previous ? next_board : current_board, y);
+      for (auto x = startx; x < endx; x++)
+      {
+         bits |= (uint64_t)(row[x] == 1) << (x - startx);
+      }
+   }
+   return (endx - startx == 64) ? bits : bits & ((1ull << (endx - startx)) - 1);
+}
+
+static void set_chunk_row_bits(int32_t y, int32_t startx, int32_t endx, uint64_t bits)
+{
+   if (config.packed) {
+      uint64_t * row = packed_board_row(current_packed, y);
+      uint64_t mask = (endx - startx == 64) ? ~0ull : (1ull << (endx - startx)) - 1;
+      int32_t w = startx / 64;
+      int32_t shift = startx % 64;
+      row[w] = (row[w] & ~(mask << shift)) | ((bits & mask) << shift);
+      if (shift && (w + 1) * 64 < endx) {
+         row[w + 1] = (row[w + 1] & ~(mask >> (64 - shift))) | ((bits & mask) >> (64 - shift));
+      }
+   } else {
+      uint32_t * row = board_row(current_board, y);
+      for (auto x = startx; x < endx; x++)
+      {
+         row[x] = (bits >> (x - startx)) & 1;
+      }
+   }
+}
+
+// CHUNK_SIZE rows of a chunk; returns false if they are all empty.
+static bool capture_chunk(uint64_t * rows, const chunk_spec_t * chunk, bool previous = false)
+{
+   uint64_t any = 0;
+   for (uint32_t r = 0; r < CHUNK_SIZE; r++)
+   {
+      uint32_t y = chunk->starty + r;
+      rows[r] = (y < chunk->endy) ? chunk_row_bits(y, chunk->startx, chunk->endx, previous) : 0;
+      any |= rows[r];
+   }
+   return any != 0;
+}
+
+void game_checkpoint(const char * path, bool incremental, bool compress)
+{
+   if (rule.states > 2) {
+      checkpoint_error = "snapshots hold two-state boards only";
+      return;
+   }
+   bool infinite = config.topology == TOPOLOGY_INFINITE;
+   incremental = incremental && !infinite && checkpoint_generation != NO_CHECKPOINT;
+
+   snapshot_t * snapshot = snapshot_create(config.topology, config.width, config.height, generation);
+   if (compress) {
+      snapshot->header.flags |= SNAPSHOT_COMPRESSED;
+   }
+   if (incremental) {
+      snapshot->header.flags |= SNAPSHOT_INCREMENTAL;
+      snapshot->header.base_generation = checkpoint_generation;
+   }
+
+   if (infinite) {
+      size_t tile_count;
+      tile_t * const * tiles = universe_tiles(universe, &tile_count);
+      for (size_t i = 0; i < tile_count; i++)
+      {
+         if (tiles[i]->population) {
+            snapshot_record_t * record = snapshot_add_record(snapshot, tiles[i]->tx * TILE_SIZE, tiles[i]->ty * TILE_SIZE);
+            memcpy(record->rows, universe_tile_rows(universe, tiles[i]), sizeof(record->rows));
+         }
+      }
+   } else {
+      // Only the capture runs here, the file is written in the background
+      chunk_spec_t chunk;
+      snapshot_record_t record;
+      for (auto cy = 0; cy < chunks_y; cy++)
+      {
+         for (auto cx = 0; cx < chunks_x; cx++)
+         {
+            chunk_bounds(&chunk, cx, cy);
+            if (chunk.startx >= chunk.endx || chunk.starty >= chunk.endy || (incremental && !chunk_dirty[chunk.index])) {
+               continue;
+            }
+            chunk_dirty[chunk.index] = false;
+            // An incremental checkpoint also records chunks that died out
+            if (capture_chunk(record.rows, &chunk) || incremental) {
+               memcpy(snapshot_add_record(snapshot, chunk.startx, chunk.starty)->rows, record.rows, sizeof(record.rows));
+            }
+         }
+      }
+   }
+   checkpoint_generation = generation;
+   snapshot_write_async(snapshot, path);
+}
+
+bool game_checkpoint_flush(const char ** error)
+{
+   bool written = snapshot_writer_flush(error);
+   if (checkpoint_error) {
+      *error = checkpoint_error;
+      checkpoint_error = NULL;
+      return false;
+   }
+   return written;
+}
+
+bool game_snapshot_config(const char * path, game_config_t * game_config, const char ** error)
+{
+   snapshot_reader_t reader;
+   if (!snapshot_open(&reader, path, error)) {
+      return false;
+   }
+   game_config->topology = (topology_t)reader.header->topology;
+   game_config->width = reader.header->width;
+   game_config->height = reader.header->height;
+   game_config->pattern = SEED_NONE;
+   game_config->fast_forward_log2 = 0;
+   snapshot_close(&reader);
+   return true;
+}
+
+bool game_restore(const char * path, const char ** error)
+{
+   snapshot_reader_t reader;
+   if (!snapshot_open(&reader, path, error)) {
+      return false;
+   }
+   const snapshot_header_t * header = reader.header;
+   bool incremental = (header->flags & SNAPSHOT_INCREMENTAL) != 0;
+   uint64_t snapshot_generation = header->generation;
+   if (header->topology != (uint32_t)config.topology ||
+         (config.topology != TOPOLOGY_INFINITE && (header->width != config.width || header->height != config.height))) {
+      *error = "snapshot was taken with another board size or topology";
+   } else if (incremental && header->base_generation != generation) {
+      *error = "incremental snapshot does not apply to the current generation";
+   } else {
+      *error = NULL;
+   }
+   if (*error) {
+      snapshot_close(&reader);
+      return false;
+   }
+
+   bool infinite = config.topology == TOPOLOGY_INFINITE;
+   if (!incremental) {
+      if (infinite) {
+         universe_clear(universe);
+      } else if (config.packed) {
+         packed_board_clear(current_packed);
+      } else {
+         board_clear(current_board);
+      }
+   }
+
+   snapshot_record_t scratch;
+   const snapshot_record_t * record;
+   while ((record = snapshot_next_record(&reader, &scratch)) != NULL) {
+      if (infinite) {
+         if (record->x % TILE_SIZE || record->y % TILE_SIZE) {
+            *error = "snapshot record is not on a tile";
+            break;
+         }
+         universe_set_tile(universe, record->x / TILE_SIZE, record->y / TILE_SIZE, record->rows);
+         continue;
+      }
+      if (record->x < 1 || record->x > config.width || record->y < 1 || record->y > config.height ||
+            (record->x != 1 && record->x % CHUNK_SIZE) || (record->y != 1 && record->y % CHUNK_SIZE)) {
+         *error = "snapshot record is not on a chunk";
+         break;
+      }
+      chunk_spec_t chunk;
+      chunk_bounds(&chunk, (int32_t)record->x / CHUNK_SIZE, (int32_t)record->y / CHUNK_SIZE);
+      for (auto y = chunk.starty; y < chunk.endy; y++)
+      {
+         set_chunk_row_bits(y, chunk.startx, chunk.endx, record->rows[y - chunk.starty]);
+      }
+   }
+   snapshot_close(&reader);
+   if (*error) {
+      return false;
+   }
+
+   generation = snapshot_generation;
+   checkpoint_generation = generation;
+   if (!infinite) {
+      memset(chunk_dirty, 0, chunks_x * chunks_y * sizeof(bool));
+      mark_all_chunks_changed();
+      measure_board();
+      reset_cycles();
+      detect_cycle();
+   }
+   render_all_chunks = true;
+   return true;
+}
+
+// Keyframes hold every non-empty chunk, delta frames the XOR of the chunks
+// that changed with their previous generation.
+static void record_generation()
+{
+   bool keyframe = keyframe_pending || generation % keyframe_interval == 0;
+   recording_begin_frame(recording, keyframe ? RECORDING_KEYFRAME : RECORDING_DELTA, generation);
+
+   chunk_spec_t chunk;
+   uint64_t rows[CHUNK_SIZE];
+   uint64_t previous_rows[CHUNK_SIZE];
+   for (auto cy = 0; cy < chunks_y; cy++)
+   {
+      for (auto cx = 0; cx < chunks_x; cx++)
+      {
+         chunk_bounds(&chunk, cx, cy);
+         if (chunk.startx >= chunk.endx || chunk.starty >= chunk.endy) {
+            continue;
+         }
+         if (keyframe) {
+            if (capture_chunk(rows, &chunk)) {
+               recording_add_chunk(recording, chunk.index, rows);
+            }
+         } else if (chunk_changed[current_changed][chunk.index]) {
+            capture_chunk(rows, &chunk);
+            capture_chunk(previous_rows, &chunk, true);
+            for (auto r = 0; r < CHUNK_SIZE; r++)
+            {
+               rows[r] ^= previous_rows[r];
+            }
+            recording_add_chunk(recording, chunk.index, rows);
+         }
+      }
+   }
+   // A dropped frame breaks the chain of deltas until the next keyframe
+   keyframe_pending = !recording_end_frame(recording);
+}
+
+bool game_record_start(const char * path, uint32_t interval, const char ** error)
+{
+   if (config.topology == TOPOLOGY_INFINITE) {
+      *error = "recording needs a bounded or torus board";
+      return false;
+   }
+   if (config.temporal_steps > 1) {
+      *error = "recording needs one generation per update, not temporal blocking";
+      return false;
+   }
+   if (rule.states > 2) {
+      *error = "recordings hold two-state boards only";
+      return false;
+   }
+   if (config.in_place) {
+      *error = "recording needs the previous generation, which in-place updates overwrite";
+      return false;
+   }
+   recording_header_t header = {};
+   header.topology = config.topology;
+   header.width = config.width;
+   header.height = config.height;
+   header.chunks_x = chunks_x;
+   header.keyframe_interval = interval;
+   recording = recording_create(path, &header, RECORDING_RING_BYTES, error);
+   if (!recording) {
+      return false;
+   }
+   keyframe_interval = interval ? interval : 1;
+   keyframe_pending = true;
+   record_generation();
+   return true;
+}
+
+bool game_record_stop(recording_stats_t * stats)
+{
+   if (!recording) {
+      return true;
+   }
+   bool ok = recording_close(recording, stats);
+   recording = NULL;
+   return ok;
+}
+
+bool game_replay_open(const char * path, game_config_t * game_config, const char ** error)
+{
+   if (!replay_open(&replay, path, error)) {
+      return false;
+   }
+   if (replay.frames.empty()) {
+      *error = "recording has no frames";
+      replay_close(&replay);
+      return false;
+   }
+   game_config->topology = (topology_t)replay.header.topology;
+   game_config->width = replay.header.width;
+   game_config->height = replay.header.height;
+   game_config->pattern = SEED_NONE;
+   game_config->fast_forward_log2 = 0;
+   replay_next_frame = 0;
+   return true;
+}
+
+void game_replay_close()
+{
+   replay_close(&replay);
+}
+
+// XORs a frame into the current board and marks the chunks it touched in
+// chunk_changed[current_changed].
+static void replay_apply_frame(const replay_frame_t * frame)
+{
+   if (frame->type == RECORDING_KEYFRAME) {
+      if (config.packed) {
+         packed_board_clear(current_packed);
+      } else {
+         board_clear(current_board);
+      }
+   }
+   memset(chunk_changed[current_changed], 0, chunks_x * chunks_y * sizeof(bool));
+
+   chunk_spec_t chunk;
+   uint64_t rows[CHUNK_SIZE];
+   uint32_t index;
+   const uint8_t * cursor = frame->data;
+   while (replay_next_chunk(frame, &cursor, &index, rows)) {
+      if (index >= (uint32_t)(chunks_x * chunks_y)) {
+         continue;
+      }
+      chunk_bounds(&chunk, index % chunks_x, index / chunks_x);
+      for (auto y = chunk.starty; y < chunk.endy; y++)
+      {
+         uint64_t bits = rows[y - chunk.starty];
+         if (bits) {
+            set_chunk_row_bits(y, chunk.startx, chunk.endx, chunk_row_bits(y, chunk.startx, chunk.endx) ^ bits);
+         }
+      }
+      chunk_changed[current_changed][index] = true;
+      if (frame->type != RECORDING_KEYFRAME) {
+         chunk_stats_t stats;
+         measure_chunk(&chunk, false, &stats);
+         commit_chunk_stats(index, &stats);
+      }
+   }
+   generation = frame->generation;
+   if (frame->type == RECORDING_KEYFRAME) {
+      // The clear emptied chunks the keyframe does not list
+      render_all_chunks = true;
+      measure_board();
+   }
+   detect_cycle();
+}
+
+bool game_replay_seek(uint64_t target_generation)
+{
+   int64_t keyframe = replay_find_keyframe(&replay, target_generation);
+   if (keyframe < 0) {
+      return false;
+   }
+   replay_next_frame = (size_t)keyframe;
+   reset_cycles();
+   while (replay_next_frame < replay.frames.size() && replay.frames[replay_next_frame].generation <= target_generation) {
+      replay_apply_frame(&replay.frames[replay_next_frame++]);
+   }
+   render_all_chunks = true;
+   return true;
+}
+
+bool game_replay_next(const render_target_t * target)
+{
+   if (replay_next_frame >= replay.frames.size()) {
+      return false;
+   }
+   replay_apply_frame(&replay.frames[replay_next_frame++]);
+
+   render_target = target;
+   chunk_spec_t chunk;
+   for (auto cy = 0; cy < chunks_y && target; cy++)
+   {
+      for (auto cx = 0; cx < chunks_x; cx++)
+      {
+         chunk_bounds(&chunk, cx, cy);
+         if (render_all_chunks || chunk_changed[current_changed][chunk.index] || chunk_unrendered[chunk.index]) {
+            push_job(job_tag("render", TRACE_PHASE_RENDER, cx, cy), render_current_chunk_handler, &chunk, sizeof(chunk), NULL, 0, chunk_owner(cy));
+         }
+      }
+   }
+   job_group_wait(&frame_group);
+   if (trace_enabled()) {
+      trace_frame_end();
+   }
+   if (target) {
+      report_dirty(target);
+      render_all_chunks = false;
+   } else {
+      for (auto i = 0; i < chunks_x * chunks_y; i++)
+      {
+         chunk_unrendered[i] |= chunk_changed[current_changed][i];
+      }
+   }
+   return true;
+}
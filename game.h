@@ -0,0 +1,262 @@
+#ifndef _GAME_H
+#define _GAME_H
+
+#include <cstdint>
+
+#include "board.h"
+#include "numa.h"
+#include "recording.h"
+#include "rule.h"
+#include "simd_kernels.h"
+
+// Simulation core shared by the Win32 front end and the headless runner.
+
+// Default board size, also the size of the Win32 window.
+const int32_t NCELLS_X = 1600;
+const int32_t NCELLS_Y = 960;
+
+// Side of the chunks that the flat boards are updated, skipped and rendered in.
+const int32_t CHUNK_SIZE = 64;
+
+const uint32_t COLOR_DEAD = 0x00222222;
+const uint32_t COLOR_ALIVE = 0x00fed844;
+
+enum seed_pattern_t {
+   SEED_GLIDER_GUNS,
+   SEED_LIDKA_PRED,
+   SEED_RANDOM_SOUP,
+   SEED_FILE,                    // RLE or macrocell file at pattern_path
+   SEED_NONE                     // empty board, e.g. to restore a snapshot into
+};
+
+enum topology_t {
+   TOPOLOGY_BOUNDED,             // dead cells beyond the board
+   TOPOLOGY_INFINITE,            // unbounded plane of tiles, the board is the seed area and viewport
+   TOPOLOGY_TORUS                // opposite edges of the board are joined
+};
+
+struct game_config_t {
+   int32_t width;                // live cells, the board adds a dead halo ring
+   int32_t height;
+   seed_pattern_t pattern;
+   topology_t topology;
+   uint32_t fill_percent;        // SEED_RANDOM_SOUP density
+   uint64_t seed;                // SEED_RANDOM_SOUP generator seed
+   const char * pattern_path;    // SEED_FILE
+   bool pattern_centered;        // SEED_FILE centred on the board, else top left corner at pattern_x, pattern_y
+   int64_t pattern_x;
+   int64_t pattern_y;
+   bool pattern_flip_x;
+   bool pattern_flip_y;
+   bool packed;                  // bit-packed board instead of one uint32_t per cell (tiles always are)
+   bool in_place;                // one board updated in place through a few rows per strip instead of two, see game_init
+   bool multi_thread;
+   bool huge_pages;              // back the boards with huge pages when the OS allows
+   bool numa_bands;              // each worker owns a band of chunk rows, first touched and updated by it
+   uint32_t fast_forward_log2;   // HashLife skip of 2^n generations after seeding, 0 = off; bounded boards only
+   uint32_t temporal_steps;      // generations per update, advanced tile by tile in cache; 1 = off
+   int32_t temporal_tile;        // temporal blocking tile size in cells, rounded up to a multiple of 64
+   const char * rule;            // rulestring, NULL for the pattern file's rule or B3/S23
+   const update_kernels_t * kernels;
+   int32_t block_width;          // cells updated by one job, rounded up to whole 64-cell chunks; 0 = the full width
+   int32_t block_height;         // 0 = the full height
+   int32_t slab_y;               // with slab_height, hold only rows [slab_y + 1, slab_y + slab_height] of the board
+   int32_t slab_height;          // 0 = the whole board, see domain.h
+   uint32_t cycle_history;       // generations of board hashes kept to find cycles, the longest period found; 0 = off
+};
+
+// Pixels [x, x + width) x [y, y + height).
+struct render_rect_t {
+   int32_t x;
+   int32_t y;
+   int32_t width;
+   int32_t height;
+};
+
+// Set after every frame to the rectangles that were redrawn, so only those
+// need presenting. Past `capacity` rectangles their bounding box is reported.
+struct render_dirty_t {
+   render_rect_t * rects;
+   uint32_t capacity;
+   uint32_t count;
+};
+
+// Pixels of cell (x, y) start at pixels[(y - 1) * ppc * pitch + (x - 1) * ppc].
+struct render_target_t {
+   uint32_t * pixels;
+   int32_t pitch;                // in pixels
+   int32_t pixels_per_cell;
+   render_dirty_t * dirty;       // NULL when not wanted
+};
+
+struct game_stats_t {
+   uint64_t generation;
+   uint32_t active_chunks;
+   uint32_t total_chunks;        // allocated tiles on the infinite plane
+   board_memory_t memory;
+   size_t board_bytes;           // both boards of the active representation
+   uint32_t temporal_steps;
+   int32_t temporal_tile;
+   uint64_t population;          // live cells
+   int32_t min_x;                // bounding box of the live cells; min_x > max_x if there are
+   int32_t min_y;                // none, and on the infinite plane
+   int32_t max_x;
+   int32_t max_y;
+   uint64_t hash;                // of the live cells and their positions
+   uint32_t period;              // generations after which the board repeats, 0 until a repeat is seen
+   uint64_t cycle_start;         // first generation of the cycle
+};
+
+// Where the pages of the two boards are.
+struct game_placement_t {
+   uint64_t pages;
+   uint64_t untouched;           // not faulted in yet
+   uint64_t misplaced;           // on another node than their band's owner, if it is pinned
+   uint32_t node_count;
+   uint64_t node_pages[NUMA_MAX_NODES];
+};
+
+static inline game_config_t game_default_config()
+{
+   game_config_t config;
+   config.width = NCELLS_X;
+   config.height = NCELLS_Y;
+   config.pattern = SEED_GLIDER_GUNS;
+   config.topology = TOPOLOGY_BOUNDED;
+   config.fill_percent = 25;
+   config.seed = 1;
+   config.pattern_path = 0;
+   config.pattern_centered = true;
+   config.pattern_x = 1;
+   config.pattern_y = 1;
+   config.pattern_flip_x = false;
+   config.pattern_flip_y = false;
+   config.packed = false;
+   config.in_place = false;
+   config.multi_thread = true;
+   config.huge_pages = false;
+   config.numa_bands = false;
+   config.fast_forward_log2 = 0;
+   config.temporal_steps = 1;
+   config.temporal_tile = 512;
+   config.rule = 0;
+   config.kernels = 0;
+   config.block_width = 64;
+   config.block_height = 64;
+   config.slab_y = 0;
+   config.slab_height = 0;
+   config.cycle_history = 64;
+   return config;
+}
+
+// Allocates the boards and seeds `config->pattern`. A NULL kernels pointer
+// picks the best kernels for this CPU. Returns false if the boards cannot be
+// allocated, the pattern file cannot be loaded or the rule is malformed or
+// unsupported with this config, see game_init_error(). Rules other than
+// B3/S23 run on flat bounded or torus boards only. A slab is seeded as its
+// rows of the whole board would be; it runs B3/S23 on bounded boards only,
+// without temporal blocking or HashLife, and the glider guns cannot seed it.
+// In-place updates need B3/S23 on a bounded or torus board without temporal
+// blocking, run their blocks as strips of full rows and cannot be recorded.
+// HashLife fast-forwarding ignores the wrap and crops to the board, so it
+// runs on bounded boards only.
+bool game_init(const game_config_t * config);
+
+const char * game_init_error();
+
+// Advances one generation, or temporal_steps with temporal blocking, and,
+// unless `target` is NULL, redraws the chunks that changed into it.
+void game_update_and_render(const render_target_t * target);
+
+// Same, but never past `max_generations`; returns the generations advanced.
+uint32_t game_advance(uint32_t max_generations, const render_target_t * target);
+
+void game_get_stats(game_stats_t * stats);
+
+// Asks the OS which NUMA node every page of the boards is on; false on the
+// infinite plane or when the OS cannot tell. It walks every page, so it is
+// meant for the end of a run.
+bool game_get_placement(game_placement_t * placement);
+
+const update_kernels_t * game_kernels();
+
+// What game_init chose for the settings that change how fast the board runs
+// but never what it computes, so they can change between any two
+// generations. Blocks only apply to the flat boards without temporal
+// blocking; with multi_thread the job queue must be running.
+struct game_tuning_t {
+   const update_kernels_t * kernels;      // NULL picks the best supported
+   int32_t block_width;
+   int32_t block_height;
+   bool multi_thread;
+};
+
+void game_get_tuning(game_tuning_t * tuning);
+
+void game_set_tuning(const game_tuning_t * tuning);
+
+const rule_t * game_rule();
+
+// FNV-1a over the current generation, identical for flat and packed boards.
+uint64_t game_checksum();
+
+// Kept up to date by the updates, like the rest of the game_get_stats
+// population, bounding box and cycle fields.
+uint64_t game_population();
+
+// FNV-1a of game_checksum() continued from `hash` over this board's rows, so
+// chaining the slabs top to bottom gives the checksum of the whole board.
+uint64_t game_checksum_continue(uint64_t hash);
+
+// Slab edges, as rows of game_row_words() words: bit i of word w is cell
+// x = w * 64 + i, halo columns included.
+int32_t game_row_words();
+
+// The first and last live rows.
+void game_get_edge_rows(uint64_t * first, uint64_t * last);
+
+// Sets the halo rows above and below the live rows, the neighbouring slabs'
+// edges, for the next generation.
+void game_set_halo_rows(const uint64_t * above, const uint64_t * below);
+
+// Captures the current generation, between two calls to
+// game_update_and_render, and leaves the writing to a background thread.
+// An incremental checkpoint holds only the chunks changed since the previous
+// one; the first checkpoint, and every checkpoint of the infinite plane, is
+// full. Snapshots hold live cells only, so Generations rules cannot be
+// checkpointed: nothing is written and game_checkpoint_flush fails.
+void game_checkpoint(const char * path, bool incremental, bool compress);
+
+// Waits for the checkpoints being written, false if one of them failed.
+bool game_checkpoint_flush(const char ** error);
+
+// Sets the topology and board size of `config` to those of a snapshot and
+// leaves the board empty for game_restore.
+bool game_snapshot_config(const char * path, game_config_t * config, const char ** error);
+
+// Replaces the board with a full snapshot, or applies an incremental one
+// whose base is the current generation.
+bool game_restore(const char * path, const char ** error);
+
+// Appends every following generation to a recording, starting with a
+// keyframe of the current one. Bounded and torus boards only.
+bool game_record_start(const char * path, uint32_t keyframe_interval, const char ** error);
+
+// Returns false if writing the recording failed.
+bool game_record_stop(recording_stats_t * stats);
+
+// Sets the topology and board size of `config` to those of a recording;
+// game_init it, then game_replay_seek and game_replay_next play it back in
+// place of game_update_and_render.
+bool game_replay_open(const char * path, game_config_t * config, const char ** error);
+
+void game_replay_close();
+
+// Shows the last recorded generation at or before `generation`.
+bool game_replay_seek(uint64_t generation);
+
+// Steps to the next recorded frame and renders the chunks it changed;
+// false at the end of the recording.
+bool game_replay_next(const render_target_t * target);
+
+#endif // _GAME_H
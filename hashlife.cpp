@@ -0,0 +1,465 @@
+#include "hashlife.h"
+
+#include <cstdlib>
+#include <cstring>
+
+const uint32_t HASHLIFE_MAX_LEVEL = 62;
+const size_t HASHLIFE_BLOCK_NODES = 1 << 16;
+const size_t HASHLIFE_INITIAL_BUCKETS = 1 << 16;
+
+// Level 0 nodes are single cells; a level k node covers 2^k x 2^k cells.
+struct hl_node_t {
+   hl_node_t * nw;
+   hl_node_t * ne;
+   hl_node_t * sw;
+   hl_node_t * se;
+   hl_node_t * result;     // center advanced by 2^step_log, valid while step_log is unchanged
+   hl_node_t * next;       // hash chain / free list
+   uint64_t population;
+   uint32_t level;
+   uint32_t marked;
+};
+
+struct hl_block_t {
+   hl_block_t * next;
+   hl_node_t nodes[HASHLIFE_BLOCK_NODES];
+};
+
+struct hashlife_t {
+   hl_node_t cells[2];
+   hl_node_t * empty[HASHLIFE_MAX_LEVEL + 1];
+   hl_node_t ** buckets;
+   size_t bucket_count;
+   size_t node_count;
+   size_t max_nodes;
+   hl_block_t * blocks;
+   size_t block_used;
+   hl_node_t * free_list;
+
+   hl_node_t * root;
+   int64_t origin_x;       // board coordinates of the root's top-left cell
+   int64_t origin_y;
+   uint64_t generation;
+   uint32_t step_log;
+};
+
+static inline size_t hl_hash(const hl_node_t * nw, const hl_node_t * ne, const hl_node_t * sw, const hl_node_t * se)
+{
+   uint64_t h = (uint64_t)(uintptr_t)nw;
+   h = h * 0x9e3779b97f4a7c15ull + (uint64_t)(uintptr_t)ne;
+   h = h * 0x9e3779b97f4a7c15ull + (uint64_t)(uintptr_t)sw;
+   h = h * 0x9e3779b97f4a7c15ull + (uint64_t)(uintptr_t)se;
+   return (size_t)(h ^ (h >> 29));
+}
+
+static hl_node_t * hl_alloc(hashlife_t * hl)
+{
+   if (hl->free_list) {
+      hl_node_t * node = hl->free_list;
+      hl->free_list = node->next;
+      return node;
+   }
+   if (!hl->blocks || hl->block_used == HASHLIFE_BLOCK_NODES) {
+      hl_block_t * block = (hl_block_t *)malloc(sizeof(hl_block_t));
+      block->next = hl->blocks;
+      hl->blocks = block;
+      hl->block_used = 0;
+   }
+   return &hl->blocks->nodes[hl->block_used++];
+}
+
+static void hl_rehash(hashlife_t * hl, size_t bucket_count)
+{
+   hl_node_t ** buckets = (hl_node_t **)calloc(bucket_count, sizeof(hl_node_t *));
+   for (size_t i = 0; i < hl->bucket_count; i++)
+   {
+      hl_node_t * node = hl->buckets[i];
+      while (node) {
+         hl_node_t * next = node->next;
+         size_t b = hl_hash(node->nw, node->ne, node->sw, node->se) & (bucket_count - 1);
+         node->next = buckets[b];
+         buckets[b] = node;
+         node = next;
+      }
+   }
+   free(hl->buckets);
+   hl->buckets = buckets;
+   hl->bucket_count = bucket_count;
+}
+
+static hl_node_t * hl_make(hashlife_t * hl, hl_node_t * nw, hl_node_t * ne, hl_node_t * sw, hl_node_t * se)
+{
+   size_t b = hl_hash(nw, ne, sw, se) & (hl->bucket_count - 1);
+   for (hl_node_t * node = hl->buckets[b]; node; node = node->next)
+   {
+      if (node->nw == nw && node->ne == ne && node->sw == sw && node->se == se) {
+         return node;
+      }
+   }
+
+   hl_node_t * node = hl_alloc(hl);
+   node->nw = nw;
+   node->ne = ne;
+   node->sw = sw;
+   node->se = se;
+   node->result = NULL;
+   node->population = nw->population + ne->population + sw->population + se->population;
+   node->level = nw->level + 1;
+   node->marked = 0;
+   node->next = hl->buckets[b];
+   hl->buckets[b] = node;
+   hl->node_count++;
+
+   if (hl->node_count > hl->bucket_count) {
+      hl_rehash(hl, hl->bucket_count * 2);
+   }
+   return node;
+}
+
+// Surround `node` with empty space: a level k+1 node with `node` in its center.
+static hl_node_t * hl_expand(hashlife_t * hl, hl_node_t * node)
+{
+   hl_node_t * e = hl->empty[node->level - 1];
+   return hl_make(hl,
+         hl_make(hl, e, e, e, node->nw),
+         hl_make(hl, e, e, node->ne, e),
+         hl_make(hl, e, node->sw, e, e),
+         hl_make(hl, node->se, e, e, e));
+}
+
+// Level k-1 node at the center of a level k node, without advancing time.
+static hl_node_t * hl_center(hashlife_t * hl, hl_node_t * node)
+{
+   return hl_make(hl, node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}
+
+static hl_node_t * hl_horizontal(hashlife_t * hl, hl_node_t * w, hl_node_t * e)
+{
+   return hl_make(hl, w->ne, e->nw, w->se, e->sw);
+}
+
+static hl_node_t * hl_vertical(hashlife_t * hl, hl_node_t * n, hl_node_t * s)
+{
+   return hl_make(hl, n->sw, n->se, s->nw, s->ne);
+}
+
+// Level 2 base case: the center 2x2 of a 4x4 block after one generation.
+static hl_node_t * hl_base(hashlife_t * hl, hl_node_t * node)
+{
+   uint32_t bits = 0;
+   hl_node_t * quads[4] = { node->nw, node->ne, node->sw, node->se };
+   for (auto q = 0; q < 4; q++)
+   {
+      auto qx = (q & 1) * 2;
+      auto qy = (q >> 1) * 2;
+      hl_node_t * cells[4] = { quads[q]->nw, quads[q]->ne, quads[q]->sw, quads[q]->se };
+      for (auto c = 0; c < 4; c++)
+      {
+         if (cells[c]->population) {
+            bits |= 1u << ((qy + (c >> 1)) * 4 + qx + (c & 1));
+         }
+      }
+   }
+
+   hl_node_t * out[4];
+   for (auto c = 0; c < 4; c++)
+   {
+      auto x = 1 + (c & 1);
+      auto y = 1 + (c >> 1);
+      uint32_t live_neighbours = 0;
+      for (auto dy = -1; dy <= 1; dy++)
+      {
+         for (auto dx = -1; dx <= 1; dx++)
+         {
+            if (dx || dy) {
+               live_neighbours += (bits >> ((y + dy) * 4 + x + dx)) & 1;
+            }
+         }
+      }
+      uint32_t alive = (bits >> (y * 4 + x)) & 1;
+      out[c] = &hl->cells[(live_neighbours | alive) == 3];
+   }
+   return hl_make(hl, out[0], out[1], out[2], out[3]);
+}
+
+// Center of a level k node advanced by min(2^step_log, 2^(k-2)) generations.
+static hl_node_t * hl_step(hashlife_t * hl, hl_node_t * node)
+{
+   if (node->result) {
+      return node->result;
+   }
+   if (node->population == 0) {
+      return node->result = hl->empty[node->level - 1];
+   }
+   if (node->level == 2) {
+      return node->result = hl_base(hl, node);
+   }
+
+   // Nine overlapping level k-1 squares.
+   hl_node_t * n00 = node->nw;
+   hl_node_t * n01 = hl_horizontal(hl, node->nw, node->ne);
+   hl_node_t * n02 = node->ne;
+   hl_node_t * n10 = hl_vertical(hl, node->nw, node->sw);
+   hl_node_t * n11 = hl_center(hl, node);
+   hl_node_t * n12 = hl_vertical(hl, node->ne, node->se);
+   hl_node_t * n20 = node->sw;
+   hl_node_t * n21 = hl_horizontal(hl, node->sw, node->se);
+   hl_node_t * n22 = node->se;
+
+   hl_node_t * result;
+   if (node->level <= hl->step_log + 2) {
+      // Full speed: two half-steps, each 2^(k-3) generations.
+      hl_node_t * r00 = hl_step(hl, n00), * r01 = hl_step(hl, n01), * r02 = hl_step(hl, n02);
+      hl_node_t * r10 = hl_step(hl, n10), * r11 = hl_step(hl, n11), * r12 = hl_step(hl, n12);
+      hl_node_t * r20 = hl_step(hl, n20), * r21 = hl_step(hl, n21), * r22 = hl_step(hl, n22);
+      result = hl_make(hl,
+            hl_step(hl, hl_make(hl, r00, r01, r10, r11)),
+            hl_step(hl, hl_make(hl, r01, r02, r11, r12)),
+            hl_step(hl, hl_make(hl, r10, r11, r20, r21)),
+            hl_step(hl, hl_make(hl, r11, r12, r21, r22)));
+   } else {
+      // Slower than full speed: take the centers without advancing, then
+      // advance the four combined squares by the whole step.
+      hl_node_t * c00 = hl_center(hl, n00), * c01 = hl_center(hl, n01), * c02 = hl_center(hl, n02);
+      hl_node_t * c10 = hl_center(hl, n10), * c11 = hl_center(hl, n11), * c12 = hl_center(hl, n12);
+      hl_node_t * c20 = hl_center(hl, n20), * c21 = hl_center(hl, n21), * c22 = hl_center(hl, n22);
+      result = hl_make(hl,
+            hl_step(hl, hl_make(hl, c00, c01, c10, c11)),
+            hl_step(hl, hl_make(hl, c01, c02, c11, c12)),
+            hl_step(hl, hl_make(hl, c10, c11, c20, c21)),
+            hl_step(hl, hl_make(hl, c11, c12, c21, c22)));
+   }
+   return node->result = result;
+}
+
+static void hl_mark(hl_node_t * node)
+{
+   if (node->level == 0 || node->marked) {
+      return;
+   }
+   node->marked = 1;
+   hl_mark(node->nw);
+   hl_mark(node->ne);
+   hl_mark(node->sw);
+   hl_mark(node->se);
+}
+
+static void hl_clear_results(hashlife_t * hl)
+{
+   for (size_t i = 0; i < hl->bucket_count; i++)
+   {
+      for (hl_node_t * node = hl->buckets[i]; node; node = node->next)
+      {
+         node->result = NULL;
+      }
+   }
+}
+
+// Mark everything reachable from the root and the empty nodes, optionally
+// keeping memoized results alive too, and return the rest to the free list.
+static void hl_collect(hashlife_t * hl, bool keep_results)
+{
+   if (!keep_results) {
+      hl_clear_results(hl);
+   }
+
+   hl_mark(hl->root);
+   for (uint32_t level = 1; level <= HASHLIFE_MAX_LEVEL; level++)
+   {
+      hl_mark(hl->empty[level]);
+   }
+
+   for (size_t i = 0; i < hl->bucket_count; i++)
+   {
+      for (hl_node_t * node = hl->buckets[i]; node; node = node->next)
+      {
+         if (node->marked && node->result) {
+            hl_mark(node->result);
+         }
+      }
+   }
+   // Nodes marked late in the pass above may still point at unmarked results.
+   for (size_t i = 0; i < hl->bucket_count; i++)
+   {
+      for (hl_node_t * node = hl->buckets[i]; node; node = node->next)
+      {
+         if (node->result && !node->result->marked) {
+            node->result = NULL;
+         }
+      }
+   }
+
+   for (size_t i = 0; i < hl->bucket_count; i++)
+   {
+      hl_node_t ** link = &hl->buckets[i];
+      while (*link) {
+         hl_node_t * node = *link;
+         if (node->marked) {
+            node->marked = 0;
+            link = &node->next;
+         } else {
+            *link = node->next;
+            node->next = hl->free_list;
+            hl->free_list = node;
+            hl->node_count--;
+         }
+      }
+   }
+}
+
+hashlife_t * hashlife_create(size_t max_nodes)
+{
+   hashlife_t * hl = (hashlife_t *)calloc(1, sizeof(hashlife_t));
+   hl->max_nodes = max_nodes;
+   hl->bucket_count = HASHLIFE_INITIAL_BUCKETS;
+   hl->buckets = (hl_node_t **)calloc(hl->bucket_count, sizeof(hl_node_t *));
+   for (auto i = 0; i < 2; i++)
+   {
+      hl->cells[i].population = i;
+      hl->cells[i].level = 0;
+   }
+   hl->empty[0] = &hl->cells[0];
+   for (uint32_t level = 1; level <= HASHLIFE_MAX_LEVEL; level++)
+   {
+      hl_node_t * e = hl->empty[level - 1];
+      hl->empty[level] = hl_make(hl, e, e, e, e);
+   }
+   hl->root = hl->empty[3];
+   hl->step_log = 0;
+   return hl;
+}
+
+void hashlife_destroy(hashlife_t * hl)
+{
+   hl_block_t * block = hl->blocks;
+   while (block) {
+      hl_block_t * next = block->next;
+      free(block);
+      block = next;
+   }
+   free(hl->buckets);
+   free(hl);
+}
+
+static hl_node_t * hl_build(hashlife_t * hl, const uint32_t * cells, int32_t stride,
+      int64_t x, int64_t y, uint32_t level, int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   int64_t size = 1ll << level;
+   if (x >= endx || y >= endy || x + size <= startx || y + size <= starty) {
+      return hl->empty[level];
+   }
+   if (level == 0) {
+      return &hl->cells[cells[y * stride + x] ? 1 : 0];
+   }
+   int64_t half = size / 2;
+   return hl_make(hl,
+         hl_build(hl, cells, stride, x,        y,        level - 1, startx, starty, endx, endy),
+         hl_build(hl, cells, stride, x + half, y,        level - 1, startx, starty, endx, endy),
+         hl_build(hl, cells, stride, x,        y + half, level - 1, startx, starty, endx, endy),
+         hl_build(hl, cells, stride, x + half, y + half, level - 1, startx, starty, endx, endy));
+}
+
+void hashlife_load(hashlife_t * hl, const uint32_t * cells, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   uint32_t level = 3;
+   while ((1ll << level) < (endx - startx) || (1ll << level) < (endy - starty)) {
+      level++;
+   }
+   hl->root = hl_build(hl, cells, stride, startx, starty, level, startx, starty, endx, endy);
+   hl->origin_x = startx;
+   hl->origin_y = starty;
+   hl->generation = 0;
+}
+
+static void hl_store(const hl_node_t * node, int64_t x, int64_t y, uint32_t * cells, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   int64_t size = 1ll << node->level;
+   if (x >= endx || y >= endy || x + size <= startx || y + size <= starty) {
+      return;
+   }
+   if (node->level == 0) {
+      cells[y * stride + x] = (uint32_t)node->population;
+      return;
+   }
+   if (node->population == 0) {
+      for (int64_t yy = (y > starty ? y : starty); yy < y + size && yy < endy; yy++)
+      {
+         for (int64_t xx = (x > startx ? x : startx); xx < x + size && xx < endx; xx++)
+         {
+            cells[yy * stride + xx] = 0;
+         }
+      }
+      return;
+   }
+   int64_t half = size / 2;
+   hl_store(node->nw, x,        y,        cells, stride, startx, starty, endx, endy);
+   hl_store(node->ne, x + half, y,        cells, stride, startx, starty, endx, endy);
+   hl_store(node->sw, x,        y + half, cells, stride, startx, starty, endx, endy);
+   hl_store(node->se, x + half, y + half, cells, stride, startx, starty, endx, endy);
+}
+
+void hashlife_store(const hashlife_t * hl, uint32_t * cells, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   for (auto y = starty; y < endy; y++)
+   {
+      memset(cells + y * stride + startx, 0, (endx - startx) * sizeof(uint32_t));
+   }
+   hl_store(hl->root, hl->origin_x, hl->origin_y, cells, stride, startx, starty, endx, endy);
+}
+
+// True if all live cells of a level k root lie within its central 2^(k-2) square.
+static bool hl_is_padded(const hl_node_t * root)
+{
+   return root->level >= 3 &&
+      root->nw->population == root->nw->se->se->population &&
+      root->ne->population == root->ne->sw->sw->population &&
+      root->sw->population == root->sw->ne->ne->population &&
+      root->se->population == root->se->nw->nw->population;
+}
+
+void hashlife_advance(hashlife_t * hl, uint32_t log2_generations)
+{
+   if (hl->node_count > hl->max_nodes) {
+      hl_collect(hl, true);
+      if (hl->node_count > hl->max_nodes / 2) {
+         hl_collect(hl, false);
+      }
+   }
+   if (log2_generations != hl->step_log) {
+      hl_clear_results(hl);
+      hl->step_log = log2_generations;
+   }
+
+   // Live cells travel at most one cell per generation, so with the pattern
+   // inside the central quarter one more level keeps the result exact.
+   while (hl->root->level < log2_generations + 3 || !hl_is_padded(hl->root)) {
+      int64_t quarter = 1ll << (hl->root->level - 1);
+      hl->root = hl_expand(hl, hl->root);
+      hl->origin_x -= quarter;
+      hl->origin_y -= quarter;
+   }
+
+   int64_t quarter = 1ll << (hl->root->level - 2);
+   hl->root = hl_step(hl, hl->root);
+   hl->origin_x += quarter;
+   hl->origin_y += quarter;
+   hl->generation += 1ull << log2_generations;
+}
+
+uint64_t hashlife_generation(const hashlife_t * hl)
+{
+   return hl->generation;
+}
+
+uint64_t hashlife_population(const hashlife_t * hl)
+{
+   return hl->root->population;
+}
+
+size_t hashlife_node_count(const hashlife_t * hl)
+{
+   return hl->node_count;
+}
@@ -0,0 +1,39 @@
+#ifndef _HASHLIFE_H
+#define _HASHLIFE_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Memoized quadtree (HashLife) engine on an unbounded plane. Board cells map
+// to the plane 1:1, so a flat board region can be loaded, fast-forwarded by
+// 2^k generations at a time and stored back for the normal renderer.
+//
+// Unlike the flat board there is no dead border: patterns that would crash
+// into the edge of the board keep going and are simply cropped on store.
+
+struct hashlife_t;
+
+// `max_nodes` bounds the node cache; it is enforced by garbage collection
+// between steps, so a single very large step can overshoot it temporarily.
+hashlife_t * hashlife_create(size_t max_nodes);
+
+void hashlife_destroy(hashlife_t * hl);
+
+// Replace the universe with the live cells of [startx, endx) x [starty, endy).
+void hashlife_load(hashlife_t * hl, const uint32_t * cells, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy);
+
+// Write [startx, endx) x [starty, endy) of the universe into `cells`.
+void hashlife_store(const hashlife_t * hl, uint32_t * cells, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy);
+
+// Advance by 2^log2_generations generations in one step.
+void hashlife_advance(hashlife_t * hl, uint32_t log2_generations);
+
+uint64_t hashlife_generation(const hashlife_t * hl);
+
+uint64_t hashlife_population(const hashlife_t * hl);
+
+size_t hashlife_node_count(const hashlife_t * hl);
+
+#endif // _HASHLIFE_H
@@ -0,0 +1,885 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "autotune.h"
+#include "domain.h"
+#include "frame_mailbox.h"
+#include "game.h"
+#include "job_queue.h"
+#include "sim_thread.h"
+#include "snapshot.h"
+#include "soup_search.h"
+#include "trace.h"
+
+// Command-line runner without a window: seeds a board, runs it for a fixed
+// number of generations and reports the throughput.
+
+const int32_t MAX_BOARD_SIZE = 1 << 20;
+const int32_t MAX_RESTORE_FILES = 256;
+
+static void usage(const char * program)
+{
+   fprintf(stderr,
+         "usage: %s [options]\n"
+         "  --width N            board width in cells (default %d)\n"
+         "  --height N           board height in cells (default %d)\n"
+         "  --generations N      generations to run (default 1000)\n"
+         "  --pattern NAME       guns | lidka | soup\n"
+         "  --density N          soup fill in percent (default 25)\n"
+         "  --seed N             soup generator seed (default 1)\n"
+         "  --pattern-file PATH  seed from an RLE or macrocell (.mc) file, centred\n"
+         "  --place X,Y          put the top left corner of the pattern file at cell X,Y\n"
+         "  --flip-x             mirror the pattern file horizontally\n"
+         "  --flip-y             mirror the pattern file vertically\n"
+         "  --rule RULE          B3/S23 style, Generations B2/S345/C4 or Larger than Life\n"
+         "                       R5,C0,M1,S34..58,B34..45,NM (default: the pattern file's, else B3/S23)\n"
+         "  --packed             bit-packed board\n"
+         "  --in-place           one board updated in place, strip by strip, instead of two\n"
+         "  --infinite           unbounded plane of tiles, the board is only the seed area\n"
+         "  --torus              join the opposite edges of the board\n"
+         "  --huge-pages         back the boards with huge pages when available\n"
+         "  --kernel NAME        scalar | sse2 | avx2 | avx512 (default: best supported)\n"
+         "  --threads N          job queue workers (default: one per hardware thread)\n"
+         "  --single-thread      run every chunk on the main thread\n"
+         "  --affinity MODE      none | compact | scatter: pin workers to CPUs, filling one NUMA\n"
+         "                       node at a time or dealing them over the nodes (default none)\n"
+         "  --numa-bands         give each worker a band of rows, first touched and updated by it\n"
+         "  --block WxH          cells updated by one job, in whole 64-cell chunks; W = full for strips\n"
+         "                       of whole rows (default 64x64)\n"
+         "  --autotune           try thread counts, blocks and kernels on this board before the run,\n"
+         "                       except those set by --threads, --single-thread, --block and --kernel\n"
+         "  --profile FILE       start with the setting FILE holds for this board and machine, or\n"
+         "                       autotune and save it there\n"
+         "  --retune-drift PCT   autotune again, mid-run, once the throughput strays PCT%% from what\n"
+         "                       the setting was tuned at (default 25, 0 = never)\n"
+         "  --ranks N            split the board into N horizontal slabs, one process each, swapping\n"
+         "                       halo rows through shared memory (--threads then counts per process)\n"
+         "  --soups N            census N random soups on their own 64 x 64 boards instead; takes --seed,\n"
+         "                       --density (default 50), --kernel and the thread options\n"
+         "  --soup-size N        side of the random square of each soup (default 16)\n"
+         "  --soup-batch N       boards advanced together by one job (default 64)\n"
+         "  --soup-generations N soups still changing after N generations count as unsettled (default 10000)\n"
+         "  --max-period N       longest period a settled soup may have (default 64)\n"
+         "  --census N           print the N most common objects (default 20)\n"
+         "  --fast-forward N     skip 2^N generations with HashLife after seeding\n"
+         "  --temporal K         advance K generations per pass over the board, tile by tile\n"
+         "  --temporal-tile N    temporal blocking tile size in cells (default 512)\n"
+         "  --checksum           print a checksum of the final board\n"
+         "  --cycle-history N    generations of board hashes kept to find cycles (default 64, 0 = off)\n"
+         "  --stop-on-cycle      stop as soon as the board repeats\n"
+         "  --checkpoint PREFIX  write a snapshot to PREFIX.<generation>.snap after the run\n"
+         "  --checkpoint-every N also write one every N generations\n"
+         "  --incremental        snapshots after the first hold only the changed chunks\n"
+         "  --compress           zero-run compress the snapshots\n"
+         "  --restore FILE       start from a snapshot; repeat to apply incremental ones on top\n"
+         "  --record FILE        record every generation as a delta against the previous one\n"
+         "  --keyframe-interval N  generations between recording keyframes (default 256)\n"
+         "  --replay FILE        play a recording back instead of simulating\n"
+         "  --seek N             start the replay at generation N\n"
+         "  --present-fps N      simulate on its own thread and present frames into an\n"
+         "                       offscreen buffer N times a second through the frame mailbox\n"
+         "  --gen-rate N         with --present-fps, aim for N generations/sec (default: as fast as possible)\n"
+         "  --trace FILE         record every job and write a Chrome trace (chrome://tracing, Perfetto)\n"
+         "  --percentiles        print p50/p99/max of the update, render and present phases\n",
+         program, NCELLS_X, NCELLS_Y);
+}
+
+static bool parse_int(const char * arg, int32_t min, int32_t max, int32_t * value)
+{
+   char * end;
+   long parsed = strtol(arg, &end, 10);
+   if (*arg == 0 || *end != 0 || parsed < min || parsed > max) {
+      return false;
+   }
+   *value = (int32_t)parsed;
+   return true;
+}
+
+static bool parse_place(const char * arg, game_config_t * config)
+{
+   char * end;
+   long long x = strtoll(arg, &end, 10);
+   if (end == arg || *end != ',') {
+      return false;
+   }
+   const char * y_arg = end + 1;
+   long long y = strtoll(y_arg, &end, 10);
+   if (end == y_arg || *end != 0) {
+      return false;
+   }
+   config->pattern_centered = false;
+   config->pattern_x = x;
+   config->pattern_y = y;
+   return true;
+}
+
+static bool parse_block(const char * arg, game_config_t * config)
+{
+   char * end;
+   int32_t width;
+   if (!strncmp(arg, "full", 4)) {
+      width = 0;
+      end = (char *)arg + 4;
+   } else {
+      long parsed = strtol(arg, &end, 10);
+      if (end == arg || parsed < 1 || parsed > MAX_BOARD_SIZE) {
+         return false;
+      }
+      width = (int32_t)parsed;
+   }
+   if (*end != 'x') {
+      return false;
+   }
+   config->block_width = width;
+   return parse_int(end + 1, 1, MAX_BOARD_SIZE, &config->block_height);
+}
+
+static void checkpoint(const char * prefix, bool incremental, bool compress)
+{
+   game_stats_t stats;
+   game_get_stats(&stats);
+   char path[4096];
+   snprintf(path, sizeof(path), "%s.%llu.snap", prefix, (unsigned long long)stats.generation);
+   game_checkpoint(path, incremental, compress);
+}
+
+struct present_stats_t {
+   uint64_t generations;
+   uint64_t frames_presented;
+   uint64_t frames_rendered;
+   uint64_t pixels_copied;
+};
+
+// Plays the presenter of the Win32 front end: takes the newest frame from
+// the mailbox `fps` times a second and copies its dirty rectangles to a
+// screen buffer, until the simulation thread has run `generations`.
+static void run_presented(const game_config_t * config, int32_t generations, int32_t fps, int32_t gen_rate,
+      bool replay, bool stop_on_cycle, present_stats_t * present)
+{
+   frame_mailbox_t mailbox;
+   if (!frame_mailbox_init(&mailbox, config->width, config->height)) {
+      fprintf(stderr, "cannot allocate the frames\n");
+      exit(1);
+   }
+   std::vector<uint32_t> screen((size_t)config->width * config->height);
+
+   sim_thread_config_t sim_config = sim_thread_default_config();
+   sim_config.generations_per_sec = gen_rate;
+   sim_config.generations = generations;
+   sim_config.replay = replay;
+   sim_config.loop = false;
+   sim_config.stop_on_cycle = stop_on_cycle;
+   memset(present, 0, sizeof(*present));
+   sim_thread_start(&mailbox, &sim_config);
+
+   auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / fps));
+   auto next = std::chrono::steady_clock::now();
+   for (bool running = true; running; )
+   {
+      running = sim_thread_running();
+      uint64_t present_start = trace_enabled() ? trace_now_ns() : 0;
+      const frame_t * frame = frame_mailbox_take(&mailbox);
+      if (frame) {
+         for (uint32_t i = 0; i < frame->dirty.count; i++)
+         {
+            const render_rect_t * rect = &frame->dirty.rects[i];
+            for (auto y = rect->y; y < rect->y + rect->height; y++)
+            {
+               size_t offset = (size_t)y * config->width + rect->x;
+               memcpy(&screen[offset], frame->pixels + offset, rect->width * sizeof(uint32_t));
+            }
+            present->pixels_copied += (uint64_t)rect->width * rect->height;
+         }
+         present->frames_presented++;
+         if (present_start) {
+            uint64_t present_end = trace_now_ns();
+            trace_event("present", present_start, present_end);
+            trace_phase_add(TRACE_PHASE_PRESENT, (present_end - present_start) / 1000);
+         }
+      }
+      next += period;
+      if (running) {
+         std::this_thread::sleep_until(next);
+      }
+   }
+   sim_thread_stop();
+
+   sim_thread_stats_t sim_stats;
+   sim_thread_get_stats(&sim_stats, false);
+   present->generations = sim_stats.generations;
+   present->frames_rendered = sim_stats.frames;
+   frame_mailbox_destroy(&mailbox);
+}
+
+static bool parse_affinity(const char * name, job_affinity_t * affinity)
+{
+   for (uint32_t mode = JOB_AFFINITY_NONE; mode <= JOB_AFFINITY_SCATTER; mode++)
+   {
+      if (!strcmp(job_affinity_name((job_affinity_t)mode), name)) {
+         *affinity = (job_affinity_t)mode;
+         return true;
+      }
+   }
+   return false;
+}
+
+// Jobs and busy time of the threads on each node, and where the boards are.
+static void print_numa(double seconds)
+{
+   job_queue_stats_t job_stats;
+   job_queue_get_stats(&job_stats, false);
+   for (uint32_t node = 0; node <= NUMA_MAX_NODES; node++)
+   {
+      // The last pass is for the unpinned threads
+      uint32_t match = (node == NUMA_MAX_NODES) ? JOB_NO_NODE : node;
+      uint32_t threads = 0;
+      uint64_t jobs = 0, remote = 0, busy_us = 0;
+      for (uint32_t i = 0; i < job_stats.thread_count; i++)
+      {
+         if (job_stats.node[i] == match) {
+            threads++;
+            jobs += job_stats.jobs[i];
+            remote += job_stats.remote_jobs[i];
+            busy_us += job_stats.busy_us[i];
+         }
+      }
+      if (!threads) {
+         continue;
+      }
+      char label[32] = "unpinned:";
+      if (match != JOB_NO_NODE) {
+         snprintf(label, sizeof(label), "node %u:", node);
+      }
+      printf("%-19s%u threads, %.0f jobs/sec, %.1f%% busy, %llu remote jobs\n", label, threads,
+            (seconds > 0) ? jobs / seconds : 0, (seconds > 0) ? 100.0 * busy_us / (threads * seconds * 1e6) : 0,
+            (unsigned long long)remote);
+   }
+
+   game_placement_t placement;
+   if (!game_get_placement(&placement)) {
+      printf("board pages:       placement unknown\n");
+      return;
+   }
+   printf("board pages:       %llu", (unsigned long long)placement.pages);
+   for (uint32_t node = 0; node < placement.node_count; node++)
+   {
+      printf(", node %u %llu", node, (unsigned long long)placement.node_pages[node]);
+   }
+   printf(", %llu untouched, %llu misplaced\n", (unsigned long long)placement.untouched, (unsigned long long)placement.misplaced);
+}
+
+// The board cut into slabs run by `ranks` processes; `threads` workers each.
+static int run_domain(const game_config_t * config, int32_t ranks, int32_t threads, int32_t generations, bool checksum)
+{
+   domain_config_t domain;
+   domain.game = *config;
+   domain.ranks = ranks;
+   domain.generations = generations;
+   if (!config->multi_thread) {
+      domain.threads_per_rank = 1;
+   } else if (threads) {
+      domain.threads_per_rank = threads + 1;
+   } else {
+      domain.threads_per_rank = std::max(1u, std::thread::hardware_concurrency() / ranks);
+   }
+
+   domain_result_t result;
+   const char * error = NULL;
+   if (!domain_run(&domain, &result, &error)) {
+      fprintf(stderr, "cannot run %d slabs: %s\n", ranks, error);
+      return 1;
+   }
+   double cells = (double)config->width * config->height;
+   double gens_per_sec = (result.seconds > 0) ? generations / result.seconds : 0;
+   printf("kernel:            %s%s\n", config->kernels ? config->kernels->name : update_kernels_select()->name,
+         config->packed ? " (packed)" : "");
+   printf("processes:         %d slabs of %d rows, %u threads each\n", ranks, config->height / ranks, domain.threads_per_rank);
+   printf("board:             %d x %d\n", config->width, config->height);
+   printf("generations:       %d\n", generations);
+   printf("elapsed:           %.3f s\n", result.seconds);
+   printf("generations/sec:   %.1f\n", gens_per_sec);
+   printf("cell-updates/sec:  %.3e\n", gens_per_sec * cells);
+   printf("halo exchange:     %.3f s (%.1f%%) at most per process\n", result.exchange_seconds,
+         (result.seconds > 0) ? 100.0 * result.exchange_seconds / result.seconds : 0);
+   printf("population:        %llu\n", (unsigned long long)result.population);
+   if (checksum) {
+      printf("checksum:          %016llx\n", (unsigned long long)result.checksum);
+   }
+   return 0;
+}
+
+// Runs the soups through the batched census instead of the board.
+static int run_soups(const soup_search_config_t * search, int32_t census_lines)
+{
+   soup_search_result_t result;
+   const char * error = NULL;
+   if (!soup_search_run(search, &result, &error)) {
+      fprintf(stderr, "cannot run the soups: %s\n", error);
+      return 1;
+   }
+   double soups_per_sec = (result.seconds > 0) ? result.soups / result.seconds : 0;
+   printf("kernel:            %s (ensemble)\n", search->kernels ? search->kernels->name : update_kernels_select()->name);
+   printf("threads:           %u, %u batches of %u boards\n", result.threads, result.batches, search->batch_boards);
+   printf("soups:             %llu of %u x %u at %u%%, seed %llu, on %d x %d boards\n", (unsigned long long)result.soups,
+         search->soup_size, search->soup_size, search->fill_percent, (unsigned long long)search->seed,
+         SOUP_BOARD_SIZE, SOUP_BOARD_SIZE);
+   printf("elapsed:           %.3f s\n", result.seconds);
+   printf("soups/sec:         %.1f\n", soups_per_sec);
+   // Threads beyond the hardware's do not add cores
+   uint32_t cores = std::min(result.threads, std::max(1u, std::thread::hardware_concurrency()));
+   printf("soups/sec/core:    %.1f\n", soups_per_sec / cores);
+   printf("generations/soup:  %.1f\n", result.soups ? (double)result.generations / result.soups : 0);
+   printf("settled:           %llu, %llu unsettled after %u generations\n", (unsigned long long)result.settled,
+         (unsigned long long)result.unsettled, search->max_generations);
+   uint64_t objects = 0;
+   for (const auto & entry : result.census)
+   {
+      objects += entry.count;
+   }
+   printf("census:            %llu objects of %zu kinds, %llu more held up by the walls\n", (unsigned long long)objects,
+         result.census.size(), (unsigned long long)result.walled);
+   for (size_t i = 0; i < result.census.size() && i < (size_t)census_lines; i++)
+   {
+      printf("%18llu %s\n", (unsigned long long)result.census[i].count, result.census[i].apgcode.c_str());
+   }
+   return 0;
+}
+
+// Seeds the board, or restores it from the snapshots.
+static bool start_board(const game_config_t * config, const char * const * restore_paths, int32_t restore_count)
+{
+   const char * error = NULL;
+   if (!game_init(config)) {
+      fprintf(stderr, "cannot start a %d x %d board: %s\n", config->width, config->height, game_init_error());
+      return false;
+   }
+   for (auto i = 0; i < restore_count; i++)
+   {
+      if (!game_restore(restore_paths[i], &error)) {
+         fprintf(stderr, "%s: %s\n", restore_paths[i], error);
+         return false;
+      }
+   }
+   return true;
+}
+
+// Takes the game tuning the autotuner left into `config`, for game_init and the report.
+static void sync_tuning(game_config_t * config)
+{
+   game_tuning_t tuning;
+   game_get_tuning(&tuning);
+   config->kernels = tuning.kernels;
+   config->block_width = tuning.block_width;
+   config->block_height = tuning.block_height;
+   config->multi_thread = tuning.multi_thread;
+}
+
+static void print_tuning(const autotune_setting_t * setting, const char * source, uint32_t retunes)
+{
+   char block[64];
+   if (setting->tuning.block_width > 0) {
+      snprintf(block, sizeof(block), "%d", setting->tuning.block_width);
+   } else {
+      snprintf(block, sizeof(block), "full");
+   }
+   printf("tuning:            %u threads, %s, %s x %d blocks, %.1f generations/sec (%s), retuned %u times\n",
+         setting->threads, setting->tuning.kernels->name, block, setting->tuning.block_height,
+         setting->generations_per_sec, source, retunes);
+}
+
+static bool parse_kernel(const char * name, const update_kernels_t ** kernels)
+{
+   for (uint32_t level = 0; level < SIMD_LEVEL_COUNT; level++)
+   {
+      const update_kernels_t * candidate = update_kernels_get((simd_level_t)level);
+      if (candidate->level == (simd_level_t)level && strcmp(candidate->name, name) == 0) {
+         *kernels = candidate;
+         return true;
+      }
+   }
+   return false;
+}
+
+int main(int argc, char ** argv)
+{
+   game_config_t config = game_default_config();
+   int32_t generations = 1000;
+   int32_t threads = 0;
+   bool threads_set = false;
+   bool block_set = false;
+   bool autotune = false;
+   const char * profile_path = NULL;
+   int32_t retune_drift = 25;
+   job_affinity_t affinity = JOB_AFFINITY_NONE;
+   int32_t ranks = 0;
+   int32_t soups = 0;
+   soup_search_config_t search = soup_search_default_config();
+   bool density_set = false;
+   int32_t census_lines = 20;
+   bool checksum = false;
+   bool stop_on_cycle = false;
+   const char * checkpoint_prefix = NULL;
+   int32_t checkpoint_every = 0;
+   bool incremental = false;
+   bool compress = false;
+   const char * restore_paths[MAX_RESTORE_FILES];
+   int32_t restore_count = 0;
+   const char * record_path = NULL;
+   int32_t keyframe_interval = 256;
+   const char * replay_path = NULL;
+   int32_t seek = 0;
+   int32_t present_fps = 0;
+   int32_t gen_rate = 0;
+   const char * trace_path = NULL;
+   bool percentiles = false;
+
+   for (auto i = 1; i < argc; i++)
+   {
+      const char * arg = argv[i];
+      const char * value = (i + 1 < argc) ? argv[i + 1] : "";
+      int32_t number = 0;
+      bool ok = true;
+
+      if (!strcmp(arg, "--width")) {
+         ok = parse_int(value, 1, MAX_BOARD_SIZE, &config.width); i++;
+      } else if (!strcmp(arg, "--height")) {
+         ok = parse_int(value, 1, MAX_BOARD_SIZE, &config.height); i++;
+      } else if (!strcmp(arg, "--generations")) {
+         ok = parse_int(value, 0, INT32_MAX, &generations); i++;
+      } else if (!strcmp(arg, "--pattern")) {
+         if (!strcmp(value, "guns")) {
+            config.pattern = SEED_GLIDER_GUNS;
+         } else if (!strcmp(value, "lidka")) {
+            config.pattern = SEED_LIDKA_PRED;
+         } else if (!strcmp(value, "soup")) {
+            config.pattern = SEED_RANDOM_SOUP;
+         } else {
+            ok = false;
+         }
+         i++;
+      } else if (!strcmp(arg, "--density")) {
+         ok = parse_int(value, 0, 100, &number); i++;
+         config.fill_percent = number;
+         density_set = true;
+      } else if (!strcmp(arg, "--seed")) {
+         ok = parse_int(value, 0, INT32_MAX, &number); i++;
+         config.seed = number;
+      } else if (!strcmp(arg, "--pattern-file")) {
+         config.pattern = SEED_FILE;
+         config.pattern_path = value;
+         ok = *value != 0; i++;
+      } else if (!strcmp(arg, "--place")) {
+         ok = parse_place(value, &config); i++;
+      } else if (!strcmp(arg, "--flip-x")) {
+         config.pattern_flip_x = true;
+      } else if (!strcmp(arg, "--flip-y")) {
+         config.pattern_flip_y = true;
+      } else if (!strcmp(arg, "--rule")) {
+         config.rule = value;
+         ok = *value != 0; i++;
+      } else if (!strcmp(arg, "--packed")) {
+         config.packed = true;
+      } else if (!strcmp(arg, "--in-place")) {
+         config.in_place = true;
+      } else if (!strcmp(arg, "--infinite")) {
+         config.topology = TOPOLOGY_INFINITE;
+      } else if (!strcmp(arg, "--torus")) {
+         config.topology = TOPOLOGY_TORUS;
+      } else if (!strcmp(arg, "--huge-pages")) {
+         config.huge_pages = true;
+      } else if (!strcmp(arg, "--kernel")) {
+         ok = parse_kernel(value, &config.kernels); i++;
+      } else if (!strcmp(arg, "--threads")) {
+         ok = parse_int(value, 0, JOB_QUEUE_MAX_WORKERS, &threads); i++;
+         threads_set = true;
+      } else if (!strcmp(arg, "--single-thread")) {
+         config.multi_thread = false;
+         threads_set = true;
+      } else if (!strcmp(arg, "--affinity")) {
+         ok = parse_affinity(value, &affinity); i++;
+      } else if (!strcmp(arg, "--numa-bands")) {
+         config.numa_bands = true;
+      } else if (!strcmp(arg, "--block")) {
+         ok = parse_block(value, &config); i++;
+         block_set = true;
+      } else if (!strcmp(arg, "--autotune")) {
+         autotune = true;
+      } else if (!strcmp(arg, "--profile")) {
+         profile_path = value;
+         ok = *value != 0; i++;
+      } else if (!strcmp(arg, "--retune-drift")) {
+         ok = parse_int(value, 0, 1000, &retune_drift); i++;
+      } else if (!strcmp(arg, "--ranks")) {
+         ok = parse_int(value, 1, MAX_BOARD_SIZE, &ranks); i++;
+      } else if (!strcmp(arg, "--soups")) {
+         ok = parse_int(value, 1, INT32_MAX, &soups); i++;
+      } else if (!strcmp(arg, "--soup-size")) {
+         ok = parse_int(value, 1, SOUP_BOARD_SIZE, &number); i++;
+         search.soup_size = number;
+      } else if (!strcmp(arg, "--soup-batch")) {
+         ok = parse_int(value, 1, 65536, &number); i++;
+         search.batch_boards = number;
+      } else if (!strcmp(arg, "--soup-generations")) {
+         ok = parse_int(value, 1, INT32_MAX, &number); i++;
+         search.max_generations = number;
+      } else if (!strcmp(arg, "--max-period")) {
+         ok = parse_int(value, 1, 65536, &number); i++;
+         search.max_period = number;
+      } else if (!strcmp(arg, "--census")) {
+         ok = parse_int(value, 0, INT32_MAX, &census_lines); i++;
+      } else if (!strcmp(arg, "--fast-forward")) {
+         ok = parse_int(value, 0, 62, &number); i++;
+         config.fast_forward_log2 = number;
+      } else if (!strcmp(arg, "--temporal")) {
+         ok = parse_int(value, 1, 1024, &number); i++;
+         config.temporal_steps = number;
+      } else if (!strcmp(arg, "--temporal-tile")) {
+         ok = parse_int(value, 64, MAX_BOARD_SIZE, &config.temporal_tile); i++;
+      } else if (!strcmp(arg, "--checksum")) {
+         checksum = true;
+      } else if (!strcmp(arg, "--cycle-history")) {
+         ok = parse_int(value, 0, 1 << 20, &number); i++;
+         config.cycle_history = number;
+      } else if (!strcmp(arg, "--stop-on-cycle")) {
+         stop_on_cycle = true;
+      } else if (!strcmp(arg, "--checkpoint")) {
+         checkpoint_prefix = value;
+         ok = *value != 0; i++;
+      } else if (!strcmp(arg, "--checkpoint-every")) {
+         ok = parse_int(value, 1, INT32_MAX, &checkpoint_every); i++;
+      } else if (!strcmp(arg, "--incremental")) {
+         incremental = true;
+      } else if (!strcmp(arg, "--compress")) {
+         compress = true;
+      } else if (!strcmp(arg, "--restore")) {
+         ok = *value != 0 && restore_count < MAX_RESTORE_FILES; i++;
+         restore_paths[restore_count++] = value;
+      } else if (!strcmp(arg, "--record")) {
+         record_path = value;
+         ok = *value != 0; i++;
+      } else if (!strcmp(arg, "--keyframe-interval")) {
+         ok = parse_int(value, 1, INT32_MAX, &keyframe_interval); i++;
+      } else if (!strcmp(arg, "--replay")) {
+         replay_path = value;
+         ok = *value != 0; i++;
+      } else if (!strcmp(arg, "--seek")) {
+         ok = parse_int(value, 0, INT32_MAX, &seek); i++;
+      } else if (!strcmp(arg, "--present-fps")) {
+         ok = parse_int(value, 1, 10000, &present_fps); i++;
+      } else if (!strcmp(arg, "--gen-rate")) {
+         ok = parse_int(value, 1, INT32_MAX, &gen_rate); i++;
+      } else if (!strcmp(arg, "--trace")) {
+         trace_path = value;
+         ok = *value != 0; i++;
+      } else if (!strcmp(arg, "--percentiles")) {
+         percentiles = true;
+      } else if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) {
+         usage(argv[0]);
+         return 0;
+      } else {
+         ok = false;
+      }
+
+      if (!ok) {
+         fprintf(stderr, "invalid argument: %s %s\n", arg, value);
+         usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if ((present_fps && checkpoint_every) || (gen_rate && !present_fps)) {
+      fprintf(stderr, present_fps ? "--checkpoint-every cannot run with --present-fps\n" : "--gen-rate needs --present-fps\n");
+      return 1;
+   }
+
+   if ((autotune || profile_path) && (ranks || soups || present_fps || replay_path || trace_path || percentiles)) {
+      fprintf(stderr, "--autotune and --profile run without --ranks, --soups, --present-fps, --replay and tracing\n");
+      return 1;
+   }
+
+   if (ranks) {
+      if (present_fps || checkpoint_prefix || restore_count || record_path || replay_path || trace_path || percentiles) {
+         fprintf(stderr, "--ranks only runs generations, without snapshots, recordings, presenting or tracing\n");
+         return 1;
+      }
+      // Every process starts its own job queue
+      return run_domain(&config, ranks, threads, generations, checksum);
+   }
+
+   if (soups) {
+      if (present_fps || checkpoint_prefix || restore_count || record_path || replay_path || trace_path || percentiles) {
+         fprintf(stderr, "--soups only runs the census, without snapshots, recordings, presenting or tracing\n");
+         return 1;
+      }
+      search.soups = soups;
+      search.seed = config.seed;
+      search.fill_percent = density_set ? config.fill_percent : search.fill_percent;
+      search.kernels = config.kernels;
+      search.multi_thread = config.multi_thread;
+      if (config.multi_thread) {
+         job_queue_init(threads, affinity);
+      }
+      int exit_code = run_soups(&search, census_lines);
+      if (config.multi_thread) {
+         job_queue_shutdown();
+      }
+      return exit_code;
+   }
+
+   const char * error = NULL;
+   if (restore_count && !game_snapshot_config(restore_paths[0], &config, &error)) {
+      fprintf(stderr, "%s: %s\n", restore_paths[0], error);
+      return 1;
+   }
+   if (replay_path && !game_replay_open(replay_path, &config, &error)) {
+      fprintf(stderr, "%s: %s\n", replay_path, error);
+      return 1;
+   }
+
+   if (config.multi_thread) {
+      job_queue_init(threads, affinity);
+   }
+   if (!start_board(&config, restore_paths, restore_count)) {
+      if (config.multi_thread) {
+         job_queue_shutdown();
+      }
+      return 1;
+   }
+
+   // Options set on the command line win over the tuner and the profile
+   autotune_config_t tune_config = autotune_default_config();
+   tune_config.affinity = affinity;
+   tune_config.tune_threads = !threads_set;
+   tune_config.tune_blocks = !block_set;
+   tune_config.tune_kernels = !config.kernels;
+   autotune_setting_t tuned;
+   autotune_drift_t drift;
+   const char * tuning_source = NULL;
+   char profile_key[512];
+   uint32_t retunes = 0;
+   bool retune = false;
+   if (autotune || profile_path) {
+      autotune_key(&config, profile_key, sizeof(profile_key));
+      if (!autotune && autotune_load(profile_path, profile_key, &tuned)) {
+         autotune_setting_t current;
+         autotune_current(&current);
+         if (!tune_config.tune_threads) {
+            tuned.threads = current.threads;
+         }
+         if (!tune_config.tune_blocks) {
+            tuned.tuning.block_width = current.tuning.block_width;
+            tuned.tuning.block_height = current.tuning.block_height;
+         }
+         if (!tune_config.tune_kernels) {
+            tuned.tuning.kernels = current.tuning.kernels;
+         }
+         autotune_apply(&tuned, affinity);
+         sync_tuning(&config);
+         tuning_source = "profile";
+      } else {
+         autotune_run(&tune_config, &config, &tuned);
+         // The candidates ran the board on, start it over with the winner
+         sync_tuning(&config);
+         if (!start_board(&config, restore_paths, restore_count)) {
+            if (job_queue_worker_count()) {
+               job_queue_shutdown();
+            }
+            return 1;
+         }
+         if (profile_path && !autotune_save(profile_path, profile_key, &tuned, &error)) {
+            fprintf(stderr, "%s: %s\n", profile_path, error);
+         }
+         tuning_source = "tuned";
+      }
+      autotune_drift_init(&drift, tuned.generations_per_sec, retune_drift / 100.0);
+   }
+
+   bool started = true;
+   if (checkpoint_prefix && game_rule()->states > 2) {
+      fprintf(stderr, "%s: Generations rules cannot be checkpointed\n", game_rule()->name);
+      started = false;
+   }
+   if (replay_path && !game_replay_seek(seek)) {
+      fprintf(stderr, "%s: no keyframe at or before generation %d\n", replay_path, seek);
+      started = false;
+   }
+   if (record_path && !game_record_start(record_path, keyframe_interval, &error)) {
+      fprintf(stderr, "%s: %s\n", record_path, error);
+      started = false;
+   }
+   if (!started) {
+      if (job_queue_worker_count()) {
+         job_queue_shutdown();
+      }
+      return 1;
+   }
+
+   game_stats_t stats;
+   game_get_stats(&stats);
+   uint64_t start_generation = stats.generation;
+
+   if (trace_path || percentiles) {
+      trace_thread_name("main");
+      trace_start(trace_path ? TRACE_DEFAULT_EVENTS : 0);
+   }
+   // Seeding and packing may need more than the run; the peak is the run's
+   size_t resident = 0, setup_peak = 0, run_peak = 0;
+   bool memory_known = process_memory(&resident, &setup_peak);
+   bool run_peak_known = memory_known && process_memory_reset_peak();
+   present_stats_t present;
+   if (config.multi_thread) {
+      job_queue_stats_t job_stats;
+      job_queue_get_stats(&job_stats, true);
+   }
+   auto start = std::chrono::steady_clock::now();
+   if (present_fps) {
+      run_presented(&config, generations, present_fps, gen_rate, replay_path != NULL, stop_on_cycle, &present);
+      generations = (int32_t)present.generations;
+   }
+   for (auto i = 0; i < generations && !present_fps; )
+   {
+      if (replay_path) {
+         if (!game_replay_next(NULL)) {
+            generations = i;
+            break;
+         }
+         i++;
+         continue;
+      }
+      int32_t done = i;
+      if (retune) {
+         tune_config.max_generations = generations - i;
+         i += (int32_t)autotune_run(&tune_config, &config, &tuned);
+         sync_tuning(&config);
+         if (profile_path && !autotune_save(profile_path, profile_key, &tuned, &error)) {
+            fprintf(stderr, "%s: %s\n", profile_path, error);
+         }
+         autotune_drift_init(&drift, tuned.generations_per_sec, retune_drift / 100.0);
+         retunes++;
+         retune = false;
+      } else {
+         i += game_advance(generations - i, NULL);
+         retune = tuning_source && retune_drift && autotune_drift_update(&drift, i - done);
+      }
+      if (checkpoint_prefix && checkpoint_every && done / checkpoint_every != i / checkpoint_every && i < generations) {
+         checkpoint(checkpoint_prefix, incremental, compress);
+      }
+      if (stop_on_cycle) {
+         game_get_stats(&stats);
+         if (stats.period) {
+            generations = i;
+         }
+      }
+   }
+   if (checkpoint_prefix) {
+      checkpoint(checkpoint_prefix, incremental, compress);
+   }
+   auto end = std::chrono::steady_clock::now();
+   trace_stop();
+   double seconds = std::chrono::duration<double>(end - start).count();
+
+   double cells = (double)config.width * config.height;
+   double gens_per_sec = (seconds > 0) ? generations / seconds : 0;
+
+   game_get_stats(&stats);
+   if (config.topology == TOPOLOGY_INFINITE) {
+      printf("kernel:            tiles, %u allocated\n", stats.total_chunks);
+   } else {
+      printf("kernel:            %s%s\n", game_kernels()->name, config.packed ? " (packed)" : "");
+   }
+   printf("rule:              %s%s\n", game_rule()->name, rule_specialized(game_rule()) ? "" : " (table-driven)");
+   if (stats.temporal_steps > 1) {
+      printf("temporal blocking: %u generations per pass, %d x %d tiles\n", stats.temporal_steps, stats.temporal_tile, stats.temporal_tile);
+   }
+   if (tuning_source) {
+      print_tuning(&tuned, tuning_source, retunes);
+   }
+   printf("threads:           %u%s%s\n", config.multi_thread ? job_queue_worker_count() + 1 : 1,
+         affinity != JOB_AFFINITY_NONE ? ", pinned " : "", affinity != JOB_AFFINITY_NONE ? job_affinity_name(affinity) : "");
+   printf("board:             %d x %d, %.1f MB in %s%s\n", config.width, config.height,
+         stats.board_bytes / (1024.0 * 1024.0), board_memory_name(stats.memory), config.in_place ? ", updated in place" : "");
+   if (memory_known && process_memory(&resident, &run_peak)) {
+      if (run_peak_known) {
+         printf("memory:            peak RSS %.1f MB over the run, %.1f MB with the setup\n", run_peak / (1024.0 * 1024.0),
+               std::max(setup_peak, run_peak) / (1024.0 * 1024.0));
+      } else {
+         printf("memory:            peak RSS %.1f MB\n", run_peak / (1024.0 * 1024.0));
+      }
+   }
+   printf("generations:       %llu -> %llu\n",
+         (unsigned long long)start_generation, (unsigned long long)stats.generation);
+   printf("elapsed:           %.3f s\n", seconds);
+   printf("generations/sec:   %.1f\n", gens_per_sec);
+   printf("cell-updates/sec:  %.3e\n", gens_per_sec * cells);
+   if (present_fps) {
+      printf("frames/sec:        %.1f presented, %llu rendered, %.1f%% of the pixels copied\n",
+            (seconds > 0) ? present.frames_presented / seconds : 0, (unsigned long long)present.frames_rendered,
+            present.frames_presented ? 100.0 * present.pixels_copied / ((double)present.frames_presented * cells) : 0);
+   }
+   if (config.multi_thread && (affinity != JOB_AFFINITY_NONE || config.numa_bands)) {
+      print_numa(seconds);
+   }
+   printf("population:        %llu\n", (unsigned long long)stats.population);
+   if (stats.min_x <= stats.max_x) {
+      printf("bounding box:      (%d, %d) - (%d, %d), %d x %d\n", stats.min_x, stats.min_y, stats.max_x, stats.max_y,
+            stats.max_x - stats.min_x + 1, stats.max_y - stats.min_y + 1);
+   }
+   if (stats.period) {
+      printf("cycle:             period %u from generation %llu\n", stats.period, (unsigned long long)stats.cycle_start);
+   } else if (config.cycle_history && config.topology != TOPOLOGY_INFINITE) {
+      printf("cycle:             none within %u generations\n", config.cycle_history);
+   }
+   if (checksum) {
+      printf("checksum:          %016llx\n", (unsigned long long)game_checksum());
+   }
+   for (uint32_t phase = 0; phase < TRACE_PHASE_COUNT && (trace_path || percentiles); phase++)
+   {
+      trace_percentiles_t p;
+      trace_get_percentiles((trace_phase_t)phase, &p, false);
+      if (p.count) {
+         printf("%-8s us:       p50 %llu, p99 %llu, max %llu over %llu frames\n", trace_phase_name((trace_phase_t)phase),
+               (unsigned long long)p.p50_us, (unsigned long long)p.p99_us, (unsigned long long)p.max_us,
+               (unsigned long long)p.count);
+      }
+   }
+
+   int32_t exit_code = 0;
+   uint64_t dropped;
+   if (trace_path) {
+      if (trace_write_chrome(trace_path, &dropped)) {
+         printf("trace:             %s%s\n", trace_path, dropped ? " (events dropped, buffers full)" : "");
+      } else {
+         fprintf(stderr, "cannot write %s\n", trace_path);
+         exit_code = 1;
+      }
+   }
+   if (checkpoint_prefix && !game_checkpoint_flush(&error)) {
+      fprintf(stderr, "checkpoint failed: %s\n", error);
+      exit_code = 1;
+   }
+   snapshot_writer_shutdown();
+
+   recording_stats_t recorded;
+   if (record_path) {
+      if (!game_record_stop(&recorded)) {
+         fprintf(stderr, "recording failed: cannot write %s\n", record_path);
+         exit_code = 1;
+      }
+      printf("recording:         %llu frames, %llu keyframes, %llu dropped, %.1f KB\n",
+            (unsigned long long)recorded.frames, (unsigned long long)recorded.keyframes,
+            (unsigned long long)recorded.dropped, recorded.bytes / 1024.0);
+   }
+   if (replay_path) {
+      game_replay_close();
+   }
+
+   if (job_queue_worker_count()) {
+      job_queue_shutdown();
+   }
+   return exit_code;
+}
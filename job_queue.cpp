@@ -1,146 +1,604 @@
 #include "job_queue.h"
-#include <windows.h>
+#include "numa.h"
 
-const uint32_t JOB_QUEUE_WORKERS = 3;
-const uint32_t JOB_QUEUE_SIZE = 10;
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+const uint32_t JOB_QUEUE_SIZE = 4096;
+const uint32_t JOB_QUEUE_SLOTS = 8192;
+const uint32_t JOB_QUEUE_SLOT_BITS = 13;
 const uint32_t JOB_QUEUE_PARAMS_SIZE = 40;
+const uint32_t JOB_QUEUE_MAX_SUCCESSORS = 32;
+const uint32_t JOB_QUEUE_STEAL_SPINS = 64;
 
 enum job_status_t {
    JOB_FREE,
-   JOB_AVAILABLE,
-   JOB_PENDING
+   JOB_RESERVED,     // being filled in by job_queue_push
+   JOB_PENDING,      // waiting on dependencies, queued or running
+   JOB_DONE
 };
 
-struct job_spec_t {
-   job_status_t status;
+// Jobs live in slots; the deques only pass slot indices around. A job id is
+// the slot index plus the slot's generation at the time of the push, so an
+// id that outlived its job just reads as done.
+struct job_slot_t {
    job_handler_t handler;
+   job_group_t * group;
+   trace_tag_t tag;
+   uint32_t owner;
+   std::atomic<uint32_t> status;
+   std::atomic<int32_t> unresolved;
+   std::atomic_flag lock;
+   uint32_t generation;
+   uint32_t successor_count;
+   uint32_t successors[JOB_QUEUE_MAX_SUCCESSORS];
    uint8_t params[JOB_QUEUE_PARAMS_SIZE];
 };
 
+// Chase-Lev work-stealing deque: the owner pushes and takes at the bottom,
+// other threads steal from the top.
+struct alignas(64) job_deque_t {
+   std::atomic<int64_t> top;
+   alignas(64) std::atomic<int64_t> bottom;
+   std::atomic<uint32_t> jobs[JOB_QUEUE_SIZE];
+};
+
+// Jobs for one worker, pushed by any thread. Empty inboxes are skipped
+// without taking the lock.
+struct alignas(64) job_inbox_t {
+   std::atomic_flag lock;
+   std::atomic<uint32_t> head;
+   std::atomic<uint32_t> tail;
+   uint32_t jobs[JOB_QUEUE_SIZE];
+};
+
+struct alignas(64) job_thread_stats_t {
+   std::atomic<uint64_t> busy_us;
+   std::atomic<uint64_t> jobs;
+   std::atomic<uint64_t> remote_jobs;
+};
+
 static struct {
-   HANDLE work_event;
-   CRITICAL_SECTION cs;
-   bool running;
-   job_spec_t specs[JOB_QUEUE_SIZE];
+   std::atomic<bool> running;
+   uint32_t worker_count;
+   std::thread workers[JOB_QUEUE_MAX_WORKERS];
+   // Deque 0 belongs to the waiting thread, deque i to worker i.
+   job_deque_t deques[JOB_QUEUE_MAX_WORKERS + 1];
+   job_inbox_t inboxes[JOB_QUEUE_MAX_WORKERS + 1];
+
+   job_affinity_t affinity;
+   numa_topology_t topology;
+   uint32_t cpu[JOB_QUEUE_MAX_WORKERS + 1];
+   uint32_t node[JOB_QUEUE_MAX_WORKERS + 1];
+   job_thread_stats_t stats[JOB_QUEUE_MAX_WORKERS + 1];
+   std::chrono::steady_clock::time_point stats_start;
+
+   job_slot_t slots[JOB_QUEUE_SLOTS];
+   std::atomic<uint32_t> slot_cursor;
+
+   std::atomic<uint32_t> pending;
+   std::atomic<uint32_t> work_epoch;
+   std::atomic<uint32_t> sleepers;
+   std::atomic<uint32_t> waiters;
+   std::mutex mutex;
+   std::condition_variable work_cv;
+   std::condition_variable done_cv;
 } job_queue;
 
-static DWORD job_queue_worker(LPVOID param);
+static thread_local uint32_t job_queue_thread_index = 0;
+
+static void job_queue_run(uint32_t index);
 
-void job_queue_init()
+static inline uint64_t job_queue_now_us()
 {
-   job_queue.work_event = CreateEvent(NULL, TRUE, FALSE, NULL);
-   InitializeCriticalSection(&job_queue.cs);
-   job_queue.running = true;
-   for (auto i = 0; i < JOB_QUEUE_SIZE; i++)
-   {
-      job_queue.specs[i].handler = NULL;
-      job_queue.specs[i].status = JOB_FREE;
+   return std::chrono::duration_cast<std::chrono::microseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline void slot_lock(job_slot_t * slot)
+{
+   while (slot->lock.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
    }
+}
 
-   for (auto i = 0; i < JOB_QUEUE_WORKERS; i++) {
-      HANDLE thread = CreateThread( 0, 0,
-            job_queue_worker, NULL,
-            0, 0); 
-      if (thread != NULL) {
-         CloseHandle(thread);
-      } else {
-         OutputDebugStringA("Thread creation failed");
+static inline void slot_unlock(job_slot_t * slot)
+{
+   slot->lock.clear(std::memory_order_release);
+}
+
+static bool deque_push(job_deque_t * deque, uint32_t index)
+{
+   int64_t b = deque->bottom.load(std::memory_order_relaxed);
+   int64_t t = deque->top.load(std::memory_order_acquire);
+   if (b - t >= (int64_t)JOB_QUEUE_SIZE) {
+      return false;
+   }
+   deque->jobs[b & (JOB_QUEUE_SIZE - 1)].store(index, std::memory_order_relaxed);
+   deque->bottom.store(b + 1, std::memory_order_release);
+   return true;
+}
+
+static bool deque_take(job_deque_t * deque, uint32_t * out)
+{
+   int64_t b = deque->bottom.load(std::memory_order_relaxed) - 1;
+   deque->bottom.store(b, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   int64_t t = deque->top.load(std::memory_order_relaxed);
+
+   bool found = false;
+   if (t <= b) {
+      *out = deque->jobs[b & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+      found = true;
+      if (t == b) {
+         // Last job: race thieves for it.
+         found = deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+         deque->bottom.store(b + 1, std::memory_order_relaxed);
       }
+   } else {
+      deque->bottom.store(b + 1, std::memory_order_relaxed);
    }
+   return found;
 }
 
-void job_queue_push(job_handler_t handler, void * data, uint32_t data_len)
+static bool deque_steal(job_deque_t * deque, uint32_t * out)
 {
-   bool queued = false;
+   int64_t t = deque->top.load(std::memory_order_acquire);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   int64_t b = deque->bottom.load(std::memory_order_acquire);
+   if (t >= b) {
+      return false;
+   }
+   *out = deque->jobs[t & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+   return deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
 
-   EnterCriticalSection(&job_queue.cs);
-   for (auto i = 0; (i < JOB_QUEUE_SIZE) && !queued; i++)
+static bool inbox_push(job_inbox_t * inbox, uint32_t index)
+{
+   while (inbox->lock.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+   }
+   uint32_t tail = inbox->tail.load(std::memory_order_relaxed);
+   bool pushed = tail - inbox->head.load(std::memory_order_relaxed) < JOB_QUEUE_SIZE;
+   if (pushed) {
+      inbox->jobs[tail & (JOB_QUEUE_SIZE - 1)] = index;
+      inbox->tail.store(tail + 1, std::memory_order_release);
+   }
+   inbox->lock.clear(std::memory_order_release);
+   return pushed;
+}
+
+static bool inbox_take(job_inbox_t * inbox, uint32_t * out)
+{
+   if (inbox->head.load(std::memory_order_acquire) == inbox->tail.load(std::memory_order_acquire)) {
+      return false;
+   }
+   while (inbox->lock.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+   }
+   uint32_t head = inbox->head.load(std::memory_order_relaxed);
+   bool taken = head != inbox->tail.load(std::memory_order_relaxed);
+   if (taken) {
+      *out = inbox->jobs[head & (JOB_QUEUE_SIZE - 1)];
+      inbox->head.store(head + 1, std::memory_order_release);
+   }
+   inbox->lock.clear(std::memory_order_release);
+   return taken;
+}
+
+// Own deque and inbox first, then steal round-robin starting after
+// ourselves. Other inboxes come last and only on our own node, where their
+// owners' memory is local to us too.
+static bool job_queue_find(uint32_t index, uint32_t * out)
+{
+   if (deque_take(&job_queue.deques[index], out) || inbox_take(&job_queue.inboxes[index], out)) {
+      return true;
+   }
+   uint32_t deque_count = job_queue.worker_count + 1;
+   for (uint32_t i = 1; i < deque_count; i++)
+   {
+      if (deque_steal(&job_queue.deques[(index + i) % deque_count], out)) {
+         return true;
+      }
+   }
+   for (uint32_t i = 1; i < deque_count; i++)
    {
-      if (job_queue.specs[i].status == JOB_FREE) {
-         job_queue.specs[i].handler = handler;
-         memcpy_s(job_queue.specs[i].params, JOB_QUEUE_PARAMS_SIZE, data, data_len);
-         job_queue.specs[i].status = JOB_AVAILABLE;
-         queued = true;
-         SetEvent(job_queue.work_event);
+      uint32_t other = (index + i) % deque_count;
+      if (job_queue.node[other] == job_queue.node[index] && inbox_take(&job_queue.inboxes[other], out)) {
+         return true;
       }
    }
-   LeaveCriticalSection(&job_queue.cs);
+   return false;
+}
 
-   if (!queued) {
-      handler(data);
+static bool job_queue_help()
+{
+   uint32_t index;
+   if (job_queue_find(job_queue_thread_index, &index)) {
+      job_queue_run(index);
+      return true;
    }
+   return false;
 }
 
-void job_queue_wait_until_done()
+// Makes a job whose dependencies are all done visible to the workers.
+static void job_queue_enqueue(uint32_t index)
 {
-   bool all_done = false;
-   bool all_started = false;
+   uint32_t owner = job_queue.slots[index].owner;
+   bool owned = owner != JOB_ANY_THREAD && inbox_push(&job_queue.inboxes[owner], index);
+   if (!owned && !deque_push(&job_queue.deques[job_queue_thread_index], index)) {
+      // Full: run it on this thread, as before.
+      job_queue_run(index);
+      return;
+   }
+
+   job_queue.work_epoch.fetch_add(1, std::memory_order_seq_cst);
+   bool wake_worker = job_queue.sleepers.load(std::memory_order_seq_cst) > 0;
+   bool wake_waiter = job_queue.waiters.load(std::memory_order_seq_cst) > 0;
+   if (wake_worker || wake_waiter) {
+      std::lock_guard<std::mutex> lock(job_queue.mutex);
+      // Not every worker may take an owned job: make sure its owner wakes
+      if (wake_worker && owned) {
+         job_queue.work_cv.notify_all();
+      } else if (wake_worker) {
+         job_queue.work_cv.notify_one();
+      }
+      if (wake_waiter) {
+         job_queue.done_cv.notify_all();
+      }
+   }
+}
 
-   while (!all_started)
+static uint32_t slot_alloc()
+{
+   for (uint32_t attempt = 1; ; attempt++)
    {
-      all_started = true;
-      bool found = false;
-      uint32_t job_index;
+      uint32_t index = job_queue.slot_cursor.fetch_add(1, std::memory_order_relaxed) & (JOB_QUEUE_SLOTS - 1);
+      uint32_t expected = JOB_FREE;
+      if (job_queue.slots[index].status.compare_exchange_strong(expected, JOB_RESERVED, std::memory_order_acq_rel)) {
+         return index;
+      }
+      // Every slot is in flight: make progress on them first.
+      if (attempt % JOB_QUEUE_SLOTS == 0 && !job_queue_help()) {
+         std::this_thread::yield();
+      }
+   }
+}
 
-      EnterCriticalSection(&job_queue.cs);
-      for (auto i = 0; (i < JOB_QUEUE_SIZE) && !found; i++)
-      {
-         if (job_queue.specs[i].status == JOB_AVAILABLE) {
-            job_queue.specs[i].status = JOB_PENDING;
-            found = true;
-            all_started = false;
-            job_index = i;
-         } 
+// Registers `successor` to be released when `dep` finishes. Returns false if
+// `dep` is already done.
+static bool job_add_successor(job_id_t dep, uint32_t successor)
+{
+   job_slot_t * slot = &job_queue.slots[dep & (JOB_QUEUE_SLOTS - 1)];
+   uint32_t generation = dep >> JOB_QUEUE_SLOT_BITS;
+
+   for (;;) {
+      slot_lock(slot);
+      bool pending = slot->generation == generation && slot->status.load(std::memory_order_acquire) == JOB_PENDING;
+      bool added = false;
+      if (pending && slot->successor_count < JOB_QUEUE_MAX_SUCCESSORS) {
+         slot->successors[slot->successor_count++] = successor;
+         added = true;
       }
-      LeaveCriticalSection(&job_queue.cs);
+      slot_unlock(slot);
 
-      if (found) {
-         job_queue.specs[job_index].handler(job_queue.specs[job_index].params);
-         EnterCriticalSection(&job_queue.cs);
-         job_queue.specs[job_index].status = JOB_FREE;
-         LeaveCriticalSection(&job_queue.cs);
+      if (!pending || added) {
+         return added;
+      }
+      // Successor list full: wait for `dep` by running other jobs.
+      if (!job_queue_help()) {
+         std::this_thread::yield();
       }
    }
+}
 
-   ResetEvent(job_queue.work_event);
-   while (!all_done) {
-      all_done = true;
-      EnterCriticalSection(&job_queue.cs);
-      for (auto i = 0; (i < JOB_QUEUE_SIZE) && all_done; i++)
-      {
-         if (job_queue.specs[i].status != JOB_FREE) {
-            all_done = false;
-         } 
+static void job_complete(uint32_t index)
+{
+   job_slot_t * slot = &job_queue.slots[index];
+   uint32_t successors[JOB_QUEUE_MAX_SUCCESSORS];
+
+   slot_lock(slot);
+   slot->status.store(JOB_DONE, std::memory_order_release);
+   uint32_t successor_count = slot->successor_count;
+   memcpy(successors, slot->successors, successor_count * sizeof(uint32_t));
+   slot_unlock(slot);
+
+   for (uint32_t i = 0; i < successor_count; i++)
+   {
+      if (job_queue.slots[successors[i]].unresolved.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+         job_queue_enqueue(successors[i]);
       }
-      LeaveCriticalSection(&job_queue.cs);
+   }
+
+   job_group_t * group = slot->group;
+   slot->status.store(JOB_FREE, std::memory_order_release);
+
+   bool group_done = group && group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+   bool all_done = job_queue.pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+   if (group_done || all_done) {
+      std::lock_guard<std::mutex> lock(job_queue.mutex);
+      job_queue.done_cv.notify_all();
    }
 }
 
-static DWORD job_queue_worker(LPVOID param) {
-   while (job_queue.running)
+static void job_queue_run(uint32_t index)
+{
+   job_slot_t * slot = &job_queue.slots[index];
+   job_thread_stats_t * stats = &job_queue.stats[job_queue_thread_index];
+   if (slot->owner != JOB_ANY_THREAD && job_queue.node[slot->owner] != job_queue.node[job_queue_thread_index]) {
+      stats->remote_jobs.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   uint64_t start = job_queue_now_us();
+   uint64_t trace_start_ns = trace_enabled() ? trace_now_ns() : 0;
+   slot->handler(slot->params);
+   if (trace_start_ns) {
+      trace_job(&slot->tag, job_queue_thread_index, trace_start_ns, trace_now_ns());
+   }
+   stats->busy_us.fetch_add(job_queue_now_us() - start, std::memory_order_relaxed);
+   stats->jobs.fetch_add(1, std::memory_order_relaxed);
+
+   job_complete(index);
+}
+
+static void job_queue_worker(uint32_t index)
+{
+   job_queue_thread_index = index;
+   if (job_queue.affinity != JOB_AFFINITY_NONE) {
+      numa_pin_thread(job_queue.cpu[index]);
+   }
+   char name[32];
+   snprintf(name, sizeof(name), "worker %u", index);
+   trace_thread_name(name);
+   uint32_t slot;
+
+   while (job_queue.running.load(std::memory_order_acquire))
    {
-      WaitForSingleObject(job_queue.work_event, INFINITE);
-      
+      uint32_t epoch = job_queue.work_epoch.load(std::memory_order_seq_cst);
       bool found = false;
-      uint32_t job_index;
-      EnterCriticalSection(&job_queue.cs);
-      for (auto i = 0; (i < JOB_QUEUE_SIZE) && !found; i++)
+      for (uint32_t spin = 0; spin < JOB_QUEUE_STEAL_SPINS && !found; spin++)
       {
-         if (job_queue.specs[i].status == JOB_AVAILABLE) {
-            job_queue.specs[i].status = JOB_PENDING;
-            found = true;
-            job_index = i;
-         }
+         found = job_queue_find(index, &slot);
       }
-      LeaveCriticalSection(&job_queue.cs);
       if (found) {
-         job_queue.specs[job_index].handler(job_queue.specs[job_index].params);
-         EnterCriticalSection(&job_queue.cs);
-         job_queue.specs[job_index].status = JOB_FREE;
-         LeaveCriticalSection(&job_queue.cs);
+         job_queue_run(slot);
+         continue;
       }
+
+      // Nothing to do: sleep until a push bumps the epoch.
+      std::unique_lock<std::mutex> lock(job_queue.mutex);
+      job_queue.sleepers.fetch_add(1, std::memory_order_seq_cst);
+      job_queue.work_cv.wait(lock, [epoch] {
+         return !job_queue.running.load(std::memory_order_acquire) ||
+            job_queue.work_epoch.load(std::memory_order_seq_cst) != epoch;
+      });
+      job_queue.sleepers.fetch_sub(1, std::memory_order_seq_cst);
+   }
+   trace_thread_exit();
+}
+
+// Index into the topology's CPUs for worker `worker` (from 1).
+static uint32_t job_queue_pick_cpu(const numa_topology_t * topology, job_affinity_t affinity, uint32_t worker)
+{
+   if (affinity == JOB_AFFINITY_COMPACT) {
+      return (worker - 1) % topology->cpu_count;
+   }
+   uint32_t nodes[NUMA_MAX_NODES];
+   uint32_t node_count = 0;
+   for (uint32_t node = 0; node < topology->node_count; node++)
+   {
+      if (topology->node_cpus[node]) {
+         nodes[node_count++] = node;
+      }
+   }
+   uint32_t node = nodes[(worker - 1) % node_count];
+   return topology->node_first[node] + (worker - 1) / node_count % topology->node_cpus[node];
+}
+
+void job_queue_init(uint32_t worker_count, job_affinity_t affinity)
+{
+   if (worker_count == 0) {
+      uint32_t hardware_threads = std::thread::hardware_concurrency();
+      worker_count = (hardware_threads > 1) ? hardware_threads - 1 : 1;
+   }
+   if (worker_count > JOB_QUEUE_MAX_WORKERS) {
+      worker_count = JOB_QUEUE_MAX_WORKERS;
    }
 
-   return 0;
+   job_queue.running.store(true);
+   job_queue.worker_count = worker_count;
+   job_queue.pending.store(0);
+   job_queue.work_epoch.store(0);
+   job_queue.sleepers.store(0);
+   job_queue.waiters.store(0);
+   job_queue.slot_cursor.store(0);
+   for (uint32_t i = 0; i < JOB_QUEUE_SLOTS; i++)
+   {
+      job_queue.slots[i].status.store(JOB_FREE);
+      job_queue.slots[i].lock.clear();
+   }
+   job_queue.affinity = affinity;
+   if (affinity != JOB_AFFINITY_NONE) {
+      numa_detect(&job_queue.topology);
+   }
+   for (uint32_t i = 0; i <= worker_count; i++)
+   {
+      job_queue.deques[i].top.store(0);
+      job_queue.deques[i].bottom.store(0);
+      job_queue.inboxes[i].lock.clear();
+      job_queue.inboxes[i].head.store(0);
+      job_queue.inboxes[i].tail.store(0);
+      job_queue.stats[i].busy_us.store(0);
+      job_queue.stats[i].jobs.store(0);
+      job_queue.stats[i].remote_jobs.store(0);
+      job_queue.node[i] = JOB_NO_NODE;
+      if (i > 0 && affinity != JOB_AFFINITY_NONE) {
+         uint32_t cpu = job_queue_pick_cpu(&job_queue.topology, affinity, i);
+         job_queue.cpu[i] = job_queue.topology.cpus[cpu];
+         job_queue.node[i] = numa_cpu_node(&job_queue.topology, cpu);
+      }
+   }
+   job_queue.stats_start = std::chrono::steady_clock::now();
+
+   for (uint32_t i = 0; i < worker_count; i++)
+   {
+      job_queue.workers[i] = std::thread(job_queue_worker, i + 1);
+   }
+}
+
+void job_queue_shutdown()
+{
+   job_queue_wait_until_done();
+   {
+      std::lock_guard<std::mutex> lock(job_queue.mutex);
+      job_queue.running.store(false);
+      job_queue.work_cv.notify_all();
+   }
+   for (uint32_t i = 0; i < job_queue.worker_count; i++)
+   {
+      job_queue.workers[i].join();
+   }
+   job_queue.worker_count = 0;
+}
+
+uint32_t job_queue_worker_count()
+{
+   return job_queue.worker_count;
+}
+
+job_affinity_t job_queue_affinity()
+{
+   return job_queue.affinity;
+}
+
+uint32_t job_queue_thread_node(uint32_t thread)
+{
+   return job_queue.node[thread];
+}
+
+const char * job_affinity_name(job_affinity_t affinity)
+{
+   switch (affinity)
+   {
+      case JOB_AFFINITY_COMPACT: return "compact";
+      case JOB_AFFINITY_SCATTER: return "scatter";
+      default: return "none";
+   }
 }
 
+job_id_t job_queue_push(job_group_t * group, job_handler_t handler, void * data, uint32_t data_len,
+      const job_id_t * deps, uint32_t dep_count, const trace_tag_t * tag, uint32_t owner)
+{
+   static const trace_tag_t untagged = { "job", TRACE_PHASE_COUNT, 0, 0 };
+   if (!tag) {
+      tag = &untagged;
+   }
+   if (data_len > JOB_QUEUE_PARAMS_SIZE) {
+      uint64_t trace_start_ns = trace_enabled() ? trace_now_ns() : 0;
+      handler(data);
+      if (trace_start_ns) {
+         trace_job(tag, job_queue_thread_index, trace_start_ns, trace_now_ns());
+      }
+      return JOB_NONE;
+   }
+
+   uint32_t index = slot_alloc();
+   job_slot_t * slot = &job_queue.slots[index];
+   slot->handler = handler;
+   slot->group = group;
+   slot->tag = *tag;
+   slot->owner = (owner >= 1 && owner <= job_queue.worker_count) ? owner : JOB_ANY_THREAD;
+   memcpy(slot->params, data, data_len);
+
+   // Counted before it becomes visible so it can't finish first. The extra
+   // unresolved reference keeps it from starting while deps are added.
+   if (group) {
+      group->pending.fetch_add(1, std::memory_order_acq_rel);
+   }
+   job_queue.pending.fetch_add(1, std::memory_order_acq_rel);
+   slot->unresolved.store(1, std::memory_order_relaxed);
+
+   slot_lock(slot);
+   slot->generation = (slot->generation + 1) & ((1u << (32 - JOB_QUEUE_SLOT_BITS)) - 1);
+   slot->successor_count = 0;
+   slot->status.store(JOB_PENDING, std::memory_order_release);
+   job_id_t id = (slot->generation << JOB_QUEUE_SLOT_BITS) | index;
+   slot_unlock(slot);
+
+   for (uint32_t i = 0; i < dep_count; i++)
+   {
+      if (deps[i] != JOB_NONE) {
+         slot->unresolved.fetch_add(1, std::memory_order_acq_rel);
+         if (!job_add_successor(deps[i], index)) {
+            slot->unresolved.fetch_sub(1, std::memory_order_acq_rel);
+         }
+      }
+   }
+
+   if (slot->unresolved.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      job_queue_enqueue(index);
+   }
+   return id;
+}
+
+void job_queue_push(job_handler_t handler, void * data, uint32_t data_len)
+{
+   job_queue_push(NULL, handler, data, data_len);
+}
+
+static void job_queue_wait(std::atomic<uint32_t> * pending)
+{
+   while (pending->load(std::memory_order_acquire) > 0)
+   {
+      if (job_queue_help()) {
+         continue;
+      }
+      // Remaining jobs are running on workers or waiting on their
+      // dependencies; wake up for completions or newly released jobs.
+      uint32_t epoch = job_queue.work_epoch.load(std::memory_order_seq_cst);
+      std::unique_lock<std::mutex> lock(job_queue.mutex);
+      job_queue.waiters.fetch_add(1, std::memory_order_seq_cst);
+      job_queue.done_cv.wait(lock, [pending, epoch] {
+         return pending->load(std::memory_order_acquire) == 0 ||
+            job_queue.work_epoch.load(std::memory_order_seq_cst) != epoch;
+      });
+      job_queue.waiters.fetch_sub(1, std::memory_order_seq_cst);
+   }
+}
+
+void job_group_wait(job_group_t * group)
+{
+   job_queue_wait(&group->pending);
+}
+
+void job_queue_wait_until_done()
+{
+   job_queue_wait(&job_queue.pending);
+}
+
+void job_queue_get_stats(job_queue_stats_t * stats, bool reset)
+{
+   auto now = std::chrono::steady_clock::now();
+   stats->thread_count = job_queue.worker_count + 1;
+   stats->elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - job_queue.stats_start).count();
+   for (uint32_t i = 0; i < stats->thread_count; i++)
+   {
+      if (reset) {
+         stats->busy_us[i] = job_queue.stats[i].busy_us.exchange(0, std::memory_order_relaxed);
+         stats->jobs[i] = job_queue.stats[i].jobs.exchange(0, std::memory_order_relaxed);
+         stats->remote_jobs[i] = job_queue.stats[i].remote_jobs.exchange(0, std::memory_order_relaxed);
+      } else {
+         stats->busy_us[i] = job_queue.stats[i].busy_us.load(std::memory_order_relaxed);
+         stats->jobs[i] = job_queue.stats[i].jobs.load(std::memory_order_relaxed);
+         stats->remote_jobs[i] = job_queue.stats[i].remote_jobs.load(std::memory_order_relaxed);
+      }
+      stats->node[i] = job_queue.node[i];
+   }
+   if (reset) {
+      job_queue.stats_start = now;
+   }
+}
@@ -1,14 +1,77 @@
 #ifndef _JOB_QUEUE_H
 #define _JOB_QUEUE_H
 
+#include <atomic>
 #include <cstdint>
 
+#include "trace.h"
+
 typedef void (*job_handler_t)(void *);
 
-void job_queue_init();
+// Handle to a pushed job, used to declare dependencies. Handles of finished
+// jobs stay valid (they simply count as done) even after the slot is reused.
+typedef uint32_t job_id_t;
+
+const job_id_t JOB_NONE = ~0u;
+const uint32_t JOB_QUEUE_MAX_WORKERS = 64;
+const uint32_t JOB_QUEUE_MAX_DEPENDENCIES = 16;
+const uint32_t JOB_ANY_THREAD = ~0u;
+const uint32_t JOB_NO_NODE = ~0u;
+
+// Where the workers run. COMPACT fills the CPUs of one NUMA node before
+// moving on to the next, SCATTER deals workers round-robin over the nodes.
+// The thread that waits is never pinned.
+enum job_affinity_t {
+   JOB_AFFINITY_NONE,
+   JOB_AFFINITY_COMPACT,
+   JOB_AFFINITY_SCATTER
+};
+
+// A set of jobs waited on together through its own completion counter.
+struct job_group_t {
+   std::atomic<uint32_t> pending;
+};
+
+struct job_queue_stats_t {
+   uint32_t thread_count;                          // workers + the waiting thread (index 0)
+   uint64_t elapsed_us;                            // since the last reset
+   uint64_t busy_us[JOB_QUEUE_MAX_WORKERS + 1];    // time spent inside handlers
+   uint64_t jobs[JOB_QUEUE_MAX_WORKERS + 1];
+   uint64_t remote_jobs[JOB_QUEUE_MAX_WORKERS + 1];  // owned by a worker on another node
+   uint32_t node[JOB_QUEUE_MAX_WORKERS + 1];       // JOB_NO_NODE when not pinned
+};
+
+// Starts `worker_count` workers; 0 means one per hardware thread besides the
+// caller, which runs jobs itself while it waits.
+void job_queue_init(uint32_t worker_count = 0, job_affinity_t affinity = JOB_AFFINITY_NONE);
+
+void job_queue_shutdown();
 
+uint32_t job_queue_worker_count();
+
+job_affinity_t job_queue_affinity();
+
+// NUMA node worker `thread` is pinned to, JOB_NO_NODE if it is not.
+uint32_t job_queue_thread_node(uint32_t thread);
+
+const char * job_affinity_name(job_affinity_t affinity);
+
+// Jobs pushed from a worker go to that worker's deque, everything else goes
+// to the deque owned by the thread that waits.
 void job_queue_push(job_handler_t handler, void * data, uint32_t data_len);
 
+// Runs `handler` once every job in `deps` has finished. JOB_NONE entries
+// are ignored. While tracing, the run is recorded under `tag`. A job with an
+// `owner` worker (1 to job_queue_worker_count()) goes to that worker's inbox
+// instead, and only workers on the owner's node may take it from there.
+job_id_t job_queue_push(job_group_t * group, job_handler_t handler, void * data, uint32_t data_len,
+      const job_id_t * deps = 0, uint32_t dep_count = 0, const trace_tag_t * tag = 0, uint32_t owner = JOB_ANY_THREAD);
+
+void job_group_wait(job_group_t * group);
+
+// Waits for every job, grouped or not.
 void job_queue_wait_until_done();
 
+void job_queue_get_stats(job_queue_stats_t * stats, bool reset);
+
 #endif // _JOB_QUEUE_H
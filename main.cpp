@@ -6,126 +6,71 @@
 #include <strsafe.h>
 #include <stdint.h>
 
+#include "frame_mailbox.h"
+#include "game.h"
 #include "job_queue.h"
+#include "sim_thread.h"
+#include "trace.h"
 
 #define USE_STRETCH_DI_BITS 0
 #define USE_LIDKA_PRED 0
 #define USE_MULTI_THREAD 1
+#define USE_PACKED_BOARD 0
+#define USE_HASHLIFE_FAST_FORWARD 0
+#define USE_INFINITE_PLANE 0
+#define USE_TORUS 0
+#define USE_RECORDING 0
+#define USE_REPLAY 0
+#define USE_TRACE 0
 
-const int32_t NCELLS_X = 1600;
-const int32_t NCELLS_Y = 960;
 const int32_t PIXELS_PER_CELL = 1;
 const int32_t BYTES_PER_PIXEL = 4;
-const uint32_t COLOR_DEAD = 0x00222222;
-const uint32_t COLOR_ALIVE = 0x00fed844;
 
 const int32_t WINDOW_HEIGHT = NCELLS_Y * PIXELS_PER_CELL;
 const int32_t WINDOW_WIDTH =  NCELLS_X * PIXELS_PER_CELL;
-const uint32_t colors[2] = {COLOR_DEAD, COLOR_ALIVE};
 
 const size_t BUFFER_SIZE = 512;
 
-static struct {
-    void * buffer;
-    BITMAPINFO bitmap_info;
-    HDC back_buffer_context;
-    HBITMAP hbitmap;
-} screen;
+const uint32_t FRAMES_PER_SEC = 30;
 
-static bool running = true;
+// Generations the simulation thread aims for; 0 runs it as fast as it can
+const double GENERATIONS_PER_SEC = 0;
 
-uint32_t boards[2][(NCELLS_Y + 2) * (NCELLS_X + 2)];
-uint32_t * current_board = boards[0];
-uint32_t * next_board = boards[1];
+// Generations skipped with HashLife before the first frame (lidka_pred settles after ~29000)
+const uint32_t FAST_FORWARD_LOG2 = 15;
 
-static inline uint32_t bcoord(uint32_t x, uint32_t y) { return y * NCELLS_X + x; }
-static inline uint32_t min2(uint32_t a, uint32_t b) { return (a < b) ? a : b; }
+// Rulestring, see rule.h; NULL runs B3/S23
+const char * RULE = NULL;
 
-static inline void swap_boards()
-{
-    uint32_t * temp = current_board;
-    current_board = next_board;
-    next_board = temp;
-}
+// USE_RECORDING writes the run here, USE_REPLAY plays it back in a loop
+const char * RECORDING_PATH = "gol.golrec";
+const uint32_t KEYFRAME_INTERVAL = 256;
 
-static void update_board(uint32_t* old_board, uint32_t* new_board, int32_t startx, int32_t starty, int32_t endx, int32_t endy)
-{
-   // char buffer[BUFFER_SIZE];
-   // StringCbPrintfA(buffer, BUFFER_SIZE, "tid: %8X x: %d..%d, y: %d..%d\n", GetCurrentThreadId(), startx, endx, starty, endy);
-   // OutputDebugStringA(buffer);
-    for (auto y = starty; y < endy; y++)
-    {
-        for (auto x = startx; x < endx; x++) 
-        {
-            auto coord = bcoord(x, y);
-            auto live_neighbours = 
-                       old_board[coord - 1 - NCELLS_X] +
-                       old_board[coord     - NCELLS_X] +
-                       old_board[coord + 1 - NCELLS_X] +
-                       old_board[coord - 1           ] +
-                       old_board[coord + 1           ] +
-                       old_board[coord - 1 + NCELLS_X] +
-                       old_board[coord     + NCELLS_X] +
-                       old_board[coord + 1 + NCELLS_X];
-            if (old_board[coord]) {
-                if ((live_neighbours >= 2) && (live_neighbours <= 3)) {
-                    new_board[coord] = 1;
-                } else {
-                    new_board[coord] = 0;
-                }
-            } else {
-                if (live_neighbours == 3) {
-                    new_board[coord] = 1;
-                } else {
-                    new_board[coord] = 0;
-                }
-            }
-        }
-    }
-}
+// USE_TRACE records every job and writes a Chrome trace here on exit
+const char * TRACE_PATH = "gol_trace.json";
 
-void Win32DrawRect(int32_t start_x, int32_t start_y, int32_t end_x, int32_t end_y, uint32_t color)
-{
-    uint32_t * row = ((uint32_t *)screen.buffer) + (start_y * WINDOW_WIDTH);
-    uint32_t pitch = (WINDOW_WIDTH);
-    for (auto y = start_y; y < end_y; y++)
-    {
-        uint32_t *pixel = row + start_x;
-        for (auto x = start_x; x < end_x; x++)
-        {
-            *pixel = color;
-            pixel++;
-        }
-        row += pitch;
-    }
-}
-                
+// One buffer per frame of the mailbox
+static struct {
+    void * buffer[3];
+    BITMAPINFO bitmap_info;
+    HDC back_buffer_context[3];
+    HBITMAP hbitmap[3];
+} screen;
 
-void render_board(uint32_t* board, int32_t startx, int32_t starty, int32_t endx, int32_t endy)
-{
-    for (auto y = starty; y < endy; y++)
-    {
-        for (auto x = startx; x < endx; x++) 
-        {
-            auto coord = bcoord(x, y);
-            auto start_x = (x - 1) * PIXELS_PER_CELL;
-            auto end_x = start_x + PIXELS_PER_CELL;
-            auto start_y = (y - 1) * PIXELS_PER_CELL;
-            auto end_y = start_y + PIXELS_PER_CELL;
-            Win32DrawRect(start_x, start_y, end_x, end_y, colors[board[coord]]);
-        }
-    }
-}
+static frame_mailbox_t mailbox;
+
+static bool running = true;
 
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
-void Win32UpdateWindow(HDC device_context, int32_t x, int32_t y, int32_t width, int32_t height)
+void Win32UpdateWindow(HDC device_context, const frame_t * frame, int32_t x, int32_t y, int32_t width, int32_t height)
 {
+    auto index = frame - mailbox.frames;
 #if USE_STRETCH_DI_BITS
     StretchDIBits(device_context, 
             x, y, width, height, 
             x, y, width, height, 
-            screen.buffer, 
+            screen.buffer[index], 
             &screen.bitmap_info,
             DIB_RGB_COLORS,
             SRCCOPY);
@@ -133,7 +78,7 @@ void Win32UpdateWindow(HDC device_context, int32_t x, int32_t y, int32_t width,
     BitBlt( device_context,
           x, y,
           width, height,
-          screen.back_buffer_context,
+          screen.back_buffer_context[index],
           x, y,
           SRCCOPY);
 #endif
@@ -147,210 +92,45 @@ void Win32AllocateScreenBuffer(int32_t width, int32_t height) {
     screen.bitmap_info.bmiHeader.biBitCount = 32;
     screen.bitmap_info.bmiHeader.biCompression = BI_RGB;
 
+    for (auto i = 0; i < 3; i++)
+    {
 #if USE_STRETCH_DI_BITS
-    screen.buffer = VirtualAlloc(0, (width * height * BYTES_PER_PIXEL), MEM_COMMIT, PAGE_READWRITE);
+        screen.buffer[i] = VirtualAlloc(0, (width * height * BYTES_PER_PIXEL), MEM_COMMIT, PAGE_READWRITE);
 #else
-    screen.back_buffer_context = CreateCompatibleDC(0);
-    screen.hbitmap = CreateDIBSection( 
-          screen.back_buffer_context,
-          &screen.bitmap_info,
-          DIB_RGB_COLORS,
-          &screen.buffer,
-          0, 0);
-    SelectObject(screen.back_buffer_context, screen.hbitmap);
+        screen.back_buffer_context[i] = CreateCompatibleDC(0);
+        screen.hbitmap[i] = CreateDIBSection( 
+              screen.back_buffer_context[i],
+              &screen.bitmap_info,
+              DIB_RGB_COLORS,
+              &screen.buffer[i],
+              0, 0);
+        SelectObject(screen.back_buffer_context[i], screen.hbitmap[i]);
 #endif
 
-    uint32_t * pixel = (uint32_t *)screen.buffer;
-    for (auto i = 0; i < width*height; i++)
-    {
-        *pixel = 0x00ff00ff;
-        pixel++;
+        uint32_t * pixel = (uint32_t *)screen.buffer[i];
+        for (auto j = 0; j < width*height; j++)
+        {
+            *pixel = 0x00ff00ff;
+            pixel++;
+        }
     }
 }
 
-void glider_gun(uint32_t* board, uint32_t x, uint32_t y, uint32_t dir_x = 1, uint32_t dir_y = 1)
-{
-    auto start = bcoord(x, y);
-    board[start + bcoord(dir_x *  0, dir_y * 4)] = 1;
-    board[start + bcoord(dir_x *  1, dir_y * 4)] = 1;
-    board[start + bcoord(dir_x *  0, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x *  1, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 10, dir_y * 4)] = 1;
-    board[start + bcoord(dir_x * 10, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 10, dir_y * 6)] = 1;
-    board[start + bcoord(dir_x * 11, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 11, dir_y * 7)] = 1;
-    board[start + bcoord(dir_x * 12, dir_y * 2)] = 1;
-    board[start + bcoord(dir_x * 12, dir_y * 8)] = 1;
-    board[start + bcoord(dir_x * 13, dir_y * 2)] = 1;
-    board[start + bcoord(dir_x * 13, dir_y * 8)] = 1;
-    board[start + bcoord(dir_x * 14, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 15, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 15, dir_y * 7)] = 1;
-    board[start + bcoord(dir_x * 16, dir_y * 4)] = 1;
-    board[start + bcoord(dir_x * 16, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 16, dir_y * 6)] = 1;
-    board[start + bcoord(dir_x * 17, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 20, dir_y * 2)] = 1;
-    board[start + bcoord(dir_x * 20, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 20, dir_y * 4)] = 1;
-    board[start + bcoord(dir_x * 21, dir_y * 2)] = 1;
-    board[start + bcoord(dir_x * 21, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 21, dir_y * 4)] = 1;
-    board[start + bcoord(dir_x * 22, dir_y * 1)] = 1;
-    board[start + bcoord(dir_x * 22, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 24, dir_y * 0)] = 1;
-    board[start + bcoord(dir_x * 24, dir_y * 1)] = 1;
-    board[start + bcoord(dir_x * 24, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 24, dir_y * 6)] = 1;
-    board[start + bcoord(dir_x * 34, dir_y * 2)] = 1;
-    board[start + bcoord(dir_x * 34, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 35, dir_y * 2)] = 1;
-    board[start + bcoord(dir_x * 35, dir_y * 3)] = 1;
-}
-
-void glider(uint32_t* board, uint32_t x, uint32_t y, uint32_t dir_x = 1, uint32_t dir_y = 1)
-{
-    auto start = bcoord(x, y);
-    board[start + bcoord(dir_x * 2, dir_y * 0)] = 1;
-    board[start + bcoord(dir_x * 2, dir_y * 1)] = 1;
-    board[start + bcoord(dir_x * 2, dir_y * 2)] = 1;
-    board[start + bcoord(dir_x * 1, dir_y * 2)] = 1;
-    board[start + bcoord(dir_x * 0, dir_y * 1)] = 1;
-}
-
-void lidka_pred(uint32_t* board, uint32_t x, uint32_t y, uint32_t dir_x = 1, uint32_t dir_y = 1)
-{
-    auto start = bcoord(x, y);
-    board[start + bcoord(dir_x * 0, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 1, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 2, dir_y * 5)] = 1;
-    board[start + bcoord(dir_x * 3, dir_y * 4)] = 1;
-    board[start + bcoord(dir_x * 3, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 4, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 6, dir_y * 0)] = 1;
-    board[start + bcoord(dir_x * 6, dir_y * 1)] = 1;
-    board[start + bcoord(dir_x * 7, dir_y * 1)] = 1;
-    board[start + bcoord(dir_x * 8, dir_y * 1)] = 1;
-    board[start + bcoord(dir_x * 8, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 8, dir_y * 4)] = 1;
-    board[start + bcoord(dir_x * 8, dir_y * 5)] = 1;
-}
-
-void spaceship(uint32_t* board, uint32_t x, uint32_t y, uint32_t dir_x = 1, uint32_t dir_y = 1)
-{
-    auto start = bcoord(x, y);
-    board[start + bcoord(dir_x * 0, dir_y * 1)] = 1;
-    board[start + bcoord(dir_x * 0, dir_y * 2)] = 1;
-    board[start + bcoord(dir_x * 0, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 1, dir_y * 0)] = 1;
-    board[start + bcoord(dir_x * 1, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 2, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 3, dir_y * 3)] = 1;
-    board[start + bcoord(dir_x * 4, dir_y * 0)] = 1;
-    board[start + bcoord(dir_x * 4, dir_y * 2)] = 1;
-}
-
-struct chunk_spec_t {
-   uint32_t startx;
-   uint32_t starty;
-   uint32_t endx;
-   uint32_t endy;
-};
-
-void update_chunck_handler(void * param)
-{
-   chunk_spec_t * chunk = (chunk_spec_t *)param;
-
-   update_board(current_board, next_board, 
-         chunk->startx, 
-         chunk->starty, 
-         chunk->endx, 
-         chunk->endy);
-}
-
-void render_chunck_handler(void * param)
-{
-   chunk_spec_t * chunk = (chunk_spec_t *)param;
-
-   render_board(current_board,
-         chunk->startx, 
-         chunk->starty, 
-         chunk->endx, 
-         chunk->endy);
-}
-
-void game_update_and_render()
-{
-#if USE_MULTI_THREAD
-   chunk_spec_t chunk;
-   uint32_t y_step = 64;
-   uint32_t x_step = 64;
-   uint32_t starty = 1;
-   uint32_t endy = min2(starty+y_step, NCELLS_Y);
-
-   // OutputDebugStringA("Update");
-   while (starty < NCELLS_Y) {
-      uint32_t startx = 1;
-      uint32_t endx = min2(startx+x_step, NCELLS_X);
-      chunk.starty = starty;
-      chunk.endy   = endy;
-      while (startx < NCELLS_X) {
-         chunk.startx = startx;
-         chunk.endx   = endx;
-
-         job_queue_push(update_chunck_handler, &chunk, sizeof(chunk));
-
-         startx = min2(startx + x_step, NCELLS_X);
-         endx   = min2(endx + x_step, NCELLS_X);
-      }
-      starty = min2(starty + y_step, NCELLS_Y);
-      endy   = min2(endy + y_step, NCELLS_Y);
-   }
-   job_queue_wait_until_done();
-
-   swap_boards();
-
-   // OutputDebugStringA("Render");
-   starty = 1;
-   endy = min2(starty+y_step, NCELLS_Y+1);
-   while (starty < NCELLS_Y+1) {
-      uint32_t startx = 1;
-      uint32_t endx = min2(startx+x_step, NCELLS_X+1);
-      chunk.starty = starty;
-      chunk.endy   = endy;
-      while (startx < NCELLS_X+1) {
-         chunk.startx = startx;
-         chunk.endx   = endx;
-
-         job_queue_push(render_chunck_handler, &chunk, sizeof(chunk));
-
-         startx = min2(startx + x_step, NCELLS_X+1);
-         endx   = min2(endx + x_step, NCELLS_X+1);
-      }
-      starty = min2(starty + y_step, NCELLS_Y+1);
-      endy   = min2(endy + y_step, NCELLS_Y+1);
-   }
-   job_queue_wait_until_done();
-#else
-   update_board(current_board, next_board, 1, 1, NCELLS_X, NCELLS_Y);
-   swap_boards();
-   render_board(current_board, 1, 1, NCELLS_X+1, NCELLS_Y+1);
-#endif
-}
-
-
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow)
 {
     // Register the window class.
     const wchar_t CLASS_NAME[]  = L"GameOfLifeWindow";
-    LARGE_INTEGER StartingTime, EndingTime, ElapsedUsWork, ElapsedUsTotal, ElapsedUsUpdateRender;
+    LARGE_INTEGER StartingTime, EndingTime, ElapsedUsWork, ElapsedUsTotal;
     LARGE_INTEGER Frequency;
     LARGE_INTEGER TargerUsPerFrame;
-    uint64_t work_accumulator = 0, total_accumulator = 0, update_render_accumulator = 0;
+    uint64_t work_accumulator = 0, total_accumulator = 0;
+    uint64_t active_chunks_accumulator = 0, frames_presented = 0;
+    job_queue_stats_t job_stats;
+    game_stats_t stats;
+    sim_thread_stats_t sim_stats;
     const uint32_t max_accumulator = 60;
     int32_t accumulator = 0;
-    TargerUsPerFrame.QuadPart = (1000 * 1000) / 30;
+    TargerUsPerFrame.QuadPart = (1000 * 1000) / FRAMES_PER_SEC;
     QueryPerformanceFrequency(&Frequency); 
     char buffer[BUFFER_SIZE];
 
@@ -391,41 +171,65 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow
 
     job_queue_init();
 
+    game_config_t config = game_default_config();
+    config.pattern = USE_LIDKA_PRED ? SEED_LIDKA_PRED : SEED_GLIDER_GUNS;
+    config.packed = USE_PACKED_BOARD;
+    config.multi_thread = USE_MULTI_THREAD;
+    config.topology = USE_INFINITE_PLANE ? TOPOLOGY_INFINITE : (USE_TORUS ? TOPOLOGY_TORUS : TOPOLOGY_BOUNDED);
+    config.fast_forward_log2 = (USE_LIDKA_PRED && USE_HASHLIFE_FAST_FORWARD) ? FAST_FORWARD_LOG2 : 0;
+    config.rule = RULE;
+#if USE_REPLAY || USE_RECORDING
+    const char * error;
+#endif
+#if USE_REPLAY
+    if (!game_replay_open(RECORDING_PATH, &config, &error) || config.width > NCELLS_X || config.height > NCELLS_Y) {
+        return 0;
+    }
+#endif
+    if (!game_init(&config)) {
+        return 0;
+    }
+#if USE_REPLAY
+    game_replay_seek(0);
+#elif USE_RECORDING
+    if (!game_record_start(RECORDING_PATH, KEYFRAME_INTERVAL, &error)) {
+        OutputDebugStringA(error);
+    }
+#endif
+
+    StringCbPrintfA(buffer, BUFFER_SIZE, "Update kernel: %s\n", game_kernels()->name);
+    OutputDebugStringA(buffer);
+#if USE_HASHLIFE_FAST_FORWARD
+    game_get_stats(&stats);
+    StringCbPrintfA(buffer, BUFFER_SIZE, "HashLife: generation %llu, population %llu\n",
+          stats.generation, game_population());
+    OutputDebugStringA(buffer);
+#endif
+
     Win32AllocateScreenBuffer(WINDOW_WIDTH, WINDOW_HEIGHT);
+    uint32_t * frame_pixels[3] = {(uint32_t *)screen.buffer[0], (uint32_t *)screen.buffer[1], (uint32_t *)screen.buffer[2]};
+    frame_mailbox_init(&mailbox, WINDOW_WIDTH, WINDOW_HEIGHT, frame_pixels);
 
     ShowWindow(hwnd, nCmdShow);
 
-#if USE_LIDKA_PRED
-    lidka_pred(current_board, NCELLS_X / 2, NCELLS_Y / 2);
-#else
-    const int32_t lut[] = {(5*NCELLS_X)/6, (NCELLS_X / 2 - 5), (NCELLS_X / 2 + 5), (1*NCELLS_X)/6};
-    for (uint32_t i = 0; i < 32; i++)
-    {
-        auto x = lut[i & 0x3];
-        auto y = (9*NCELLS_Y / 16) + (((i/4) - 4) * ((12 * NCELLS_Y) / 100));
-        auto dx = (i % 2 == 0) ? 1 : -1;
-        auto dy = (i < 16) ? -1 : 1;
-        glider_gun(current_board, x, y, dx, dy);
-        update_board(current_board, next_board, 1, 1, NCELLS_X, NCELLS_Y);
-        swap_boards();
-    }
-    spaceship(current_board, NCELLS_X - 8, NCELLS_Y / 2 + 2);
-    spaceship(current_board, 8, NCELLS_Y / 2 - 2, -1, -1);
-#endif
+    // From here on only the simulation thread touches the game; this one
+    // pumps messages and presents whatever frame is newest
+    sim_thread_config_t sim_config = sim_thread_default_config();
+    sim_config.generations_per_sec = GENERATIONS_PER_SEC;
+    sim_config.pixels_per_cell = PIXELS_PER_CELL;
+    sim_config.replay = USE_REPLAY;
+    // Phase percentiles are always on, job events only with USE_TRACE
+    trace_thread_name("present");
+    trace_start(USE_TRACE ? TRACE_DEFAULT_EVENTS : 0);
+    sim_thread_start(&mailbox, &sim_config);
+    job_queue_get_stats(&job_stats, true);
+    sim_thread_get_stats(&sim_stats, true);
 
     MSG msg = { };
     while (running)
     {
         QueryPerformanceCounter(&StartingTime);
 
-        game_update_and_render();
-
-        QueryPerformanceCounter(&EndingTime);
-        ElapsedUsUpdateRender.QuadPart = EndingTime.QuadPart - StartingTime.QuadPart;
-        ElapsedUsUpdateRender.QuadPart *= 1000000;
-        ElapsedUsUpdateRender.QuadPart /= Frequency.QuadPart;
-        update_render_accumulator += ElapsedUsUpdateRender.QuadPart;
-
         while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
         {
             if (msg.message == WM_QUIT) {
@@ -435,12 +239,25 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow
             DispatchMessage(&msg);
         }
 
-        HDC hdc = GetDC(hwnd);
-        RECT client_rect;
-        GetClientRect(hwnd, &client_rect);
-        auto width = client_rect.right - client_rect.left;
-        auto height = client_rect.bottom - client_rect.top;
-        Win32UpdateWindow(hdc, 0, 0, width, height);
+        // Only what changed since the last frame taken; WM_PAINT covers the
+        // rest of the window
+        const frame_t * frame = frame_mailbox_take(&mailbox);
+        if (frame) {
+            uint64_t present_start = trace_now_ns();
+            HDC hdc = GetDC(hwnd);
+            for (uint32_t i = 0; i < frame->dirty.count; i++)
+            {
+                const render_rect_t * rect = &frame->dirty.rects[i];
+                Win32UpdateWindow(hdc, frame, rect->x, rect->y, rect->width, rect->height);
+            }
+            ReleaseDC(hwnd, hdc);
+            frames_presented++;
+            uint64_t present_end = trace_now_ns();
+            trace_event("present", present_start, present_end);
+            trace_phase_add(TRACE_PHASE_PRESENT, (present_end - present_start) / 1000);
+        }
+        stats = frame_mailbox_front(&mailbox)->stats;
+        active_chunks_accumulator += stats.active_chunks;
 
         QueryPerformanceCounter(&EndingTime);
         ElapsedUsWork.QuadPart = EndingTime.QuadPart - StartingTime.QuadPart;
@@ -464,19 +281,81 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow
 
         if (accumulator++ >= max_accumulator)
         {
-           StringCbPrintfA(buffer, BUFFER_SIZE, "AVG UpdateRender: %8lld us Work: %8lld us, Total: %8lld us\n", 
-                 update_render_accumulator / max_accumulator, 
+           // Simulation and presentation run at their own rates
+           sim_thread_get_stats(&sim_stats, true);
+           double seconds = sim_stats.elapsed_us / 1000000.0;
+           double gens_per_sec = (seconds > 0) ? sim_stats.generations / seconds : 0;
+           double frames_per_sec = (seconds > 0) ? frames_presented / seconds : 0;
+           StringCbPrintfA(buffer, BUFFER_SIZE, "Generation %lld: %.1f gen/s, %.1f frames/s (%lld rendered)\n",
+                 sim_stats.generation, gens_per_sec, frames_per_sec, sim_stats.frames);
+           OutputDebugStringA(buffer);
+
+           StringCbPrintfA(buffer, BUFFER_SIZE, "AVG Present: %8lld us, Total: %8lld us, Active chunks: %4lld/%d\n", 
                  work_accumulator / max_accumulator, 
-                 total_accumulator / max_accumulator);
+                 total_accumulator / max_accumulator,
+                 active_chunks_accumulator / max_accumulator,
+                 stats.total_chunks);
+           OutputDebugStringA(buffer);
+
+           // Stats of the last presented frame
+           StringCbPrintfA(buffer, BUFFER_SIZE, "Population: %llu, bounding box (%d, %d) - (%d, %d), period %u from generation %llu\n",
+                 stats.population, stats.min_x, stats.min_y, stats.max_x, stats.max_y,
+                 stats.period, stats.cycle_start);
+           OutputDebugStringA(buffer);
+
+           // Averages hide the slow frames, the tail shows them
+           for (uint32_t phase = 0; phase < TRACE_PHASE_COUNT; phase++)
+           {
+              trace_percentiles_t p;
+              trace_get_percentiles((trace_phase_t)phase, &p, true);
+              StringCbPrintfA(buffer, BUFFER_SIZE, "%-8s p50: %6lld us p99: %6lld us max: %6lld us (%lld frames)\n",
+                    trace_phase_name((trace_phase_t)phase), p.p50_us, p.p99_us, p.max_us, p.count);
+              OutputDebugStringA(buffer);
+           }
+
+           // Pipeline fill: share of the wall time the job threads spent
+           // inside jobs; idle is the rest, per thread (0 = the simulation
+           // thread)
+           job_queue_get_stats(&job_stats, true);
+           uint64_t busy_us = 0;
+           for (uint32_t i = 0; i < job_stats.thread_count; i++)
+           {
+              busy_us += job_stats.busy_us[i];
+           }
+           uint64_t fill = (job_stats.elapsed_us > 0) ?
+              (100 * busy_us) / (job_stats.elapsed_us * job_stats.thread_count) : 0;
+           size_t used = 0;
+           StringCbPrintfA(buffer, BUFFER_SIZE, "Pipeline fill: %3lld%%, idle us/frame:", fill);
+           for (uint32_t i = 0; i < job_stats.thread_count; i++)
+           {
+              StringCbLengthA(buffer, BUFFER_SIZE, &used);
+              uint64_t idle_us = (job_stats.elapsed_us > job_stats.busy_us[i]) ?
+                 job_stats.elapsed_us - job_stats.busy_us[i] : 0;
+              StringCbPrintfA(buffer + used, BUFFER_SIZE - used, " %lld", idle_us / max_accumulator);
+           }
+           StringCbLengthA(buffer, BUFFER_SIZE, &used);
+           StringCbPrintfA(buffer + used, BUFFER_SIZE - used, "\n");
            OutputDebugStringA(buffer);
 
-           update_render_accumulator = 0;
            work_accumulator          = 0;
            total_accumulator         = 0;
+           active_chunks_accumulator = 0;
+           frames_presented          = 0;
            accumulator               = 0;
         }
     }
 
+    sim_thread_stop();
+    trace_stop();
+#if USE_TRACE
+    uint64_t dropped;
+    if (!trace_write_chrome(TRACE_PATH, &dropped)) {
+        OutputDebugStringA("Cannot write the trace\n");
+    }
+#endif
+#if USE_RECORDING && !USE_REPLAY
+    game_record_stop(NULL);
+#endif
     timeEndPeriod(1);
 
     return 0;
@@ -500,7 +379,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 LONG width = ps.rcPaint.right - ps.rcPaint.left;
                 LONG height = ps.rcPaint.bottom - ps.rcPaint.top;
 
-                Win32UpdateWindow(hdc, x, y, width, height);
+                Win32UpdateWindow(hdc, frame_mailbox_front(&mailbox), x, y, width, height);
 
                 EndPaint(hwnd, &ps);
             }
@@ -0,0 +1,109 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool mapped_file_open(mapped_file_t * file, const char * path)
+{
+   file->data = NULL;
+   file->size = 0;
+   file->mapping_handle = NULL;
+   file->file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+   if (file->file_handle == INVALID_HANDLE_VALUE) {
+      file->file_handle = NULL;
+      return false;
+   }
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(file->file_handle, &size)) {
+      mapped_file_close(file);
+      return false;
+   }
+   file->size = (size_t)size.QuadPart;
+   if (file->size == 0) {
+      return true;
+   }
+   file->mapping_handle = CreateFileMappingA(file->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (!file->mapping_handle) {
+      mapped_file_close(file);
+      return false;
+   }
+   file->data = (const uint8_t *)MapViewOfFile(file->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+   if (!file->data) {
+      mapped_file_close(file);
+      return false;
+   }
+   return true;
+}
+
+void mapped_file_close(mapped_file_t * file)
+{
+   if (file->data) {
+      UnmapViewOfFile(file->data);
+   }
+   if (file->mapping_handle) {
+      CloseHandle(file->mapping_handle);
+   }
+   if (file->file_handle) {
+      CloseHandle(file->file_handle);
+   }
+   file->data = NULL;
+   file->size = 0;
+   file->mapping_handle = NULL;
+   file->file_handle = NULL;
+}
+
+#else
+
+bool mapped_file_open(mapped_file_t * file, const char * path)
+{
+   file->data = NULL;
+   file->size = 0;
+   file->fd = open(path, O_RDONLY);
+   if (file->fd < 0) {
+      return false;
+   }
+   struct stat st;
+   if (fstat(file->fd, &st) != 0) {
+      mapped_file_close(file);
+      return false;
+   }
+   file->size = (size_t)st.st_size;
+   if (file->size == 0) {
+      return true;
+   }
+   void * data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+   if (data == MAP_FAILED) {
+      mapped_file_close(file);
+      return false;
+   }
+   madvise(data, file->size, MADV_SEQUENTIAL);
+   file->data = (const uint8_t *)data;
+   return true;
+}
+
+void mapped_file_close(mapped_file_t * file)
+{
+   if (file->data) {
+      munmap((void *)file->data, file->size);
+   }
+   if (file->fd >= 0) {
+      close(file->fd);
+   }
+   file->data = NULL;
+   file->size = 0;
+   file->fd = -1;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are faulted in as they are
+// touched, so files larger than memory can be streamed front to back.
+
+struct mapped_file_t {
+   const uint8_t * data;
+   size_t size;
+#ifdef _WIN32
+   void * file_handle;
+   void * mapping_handle;
+#else
+   int fd;
+#endif
+};
+
+bool mapped_file_open(mapped_file_t * file, const char * path);
+
+void mapped_file_close(mapped_file_t * file);
+
+#endif // _MAPPED_FILE_H
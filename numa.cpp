@@ -0,0 +1,229 @@
+#include "numa.h"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef PSAPI_VERSION
+#define PSAPI_VERSION 2          // QueryWorkingSetEx from kernel32
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+// Pages asked about per call.
+const size_t NUMA_QUERY_BATCH = 1024;
+
+static void add_cpu(numa_topology_t * topology, uint32_t node, uint32_t cpu)
+{
+   if (topology->cpu_count >= NUMA_MAX_CPUS || node >= NUMA_MAX_NODES) {
+      return;
+   }
+   if (topology->node_cpus[node] == 0) {
+      topology->node_first[node] = topology->cpu_count;
+   }
+   topology->cpus[topology->cpu_count++] = cpu;
+   topology->node_cpus[node]++;
+   if (node + 1 > topology->node_count) {
+      topology->node_count = node + 1;
+   }
+}
+
+#ifndef _WIN32
+// "0-3,8,10-11" style list of the CPUs of one node, false if there is no
+// such node.
+static bool read_cpulist(uint32_t node, char * list, size_t size)
+{
+   char path[64];
+   snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+   FILE * file = fopen(path, "r");
+   if (!file) {
+      return false;
+   }
+   bool read = fgets(list, (int)size, file) != NULL;
+   fclose(file);
+   return read;
+}
+#endif
+
+void numa_detect(numa_topology_t * topology)
+{
+   memset(topology, 0, sizeof(*topology));
+
+#ifdef _WIN32
+   DWORD_PTR process_mask = 0, system_mask = 0;
+   GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+   ULONG highest = 0;
+   if (!GetNumaHighestNodeNumber(&highest)) {
+      highest = 0;
+   }
+   // Processor group 0 only, like SetThreadAffinityMask
+   for (ULONG node = 0; node <= highest && node < NUMA_MAX_NODES; node++)
+   {
+      ULONGLONG mask = 0;
+      if (!GetNumaNodeProcessorMask((UCHAR)node, &mask)) {
+         continue;
+      }
+      mask &= process_mask;
+      for (uint32_t cpu = 0; cpu < 64; cpu++)
+      {
+         if (mask & (1ull << cpu)) {
+            add_cpu(topology, node, cpu);
+         }
+      }
+   }
+#else
+   cpu_set_t allowed;
+   CPU_ZERO(&allowed);
+   if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      for (uint32_t cpu = 0; cpu < std::thread::hardware_concurrency() && cpu < CPU_SETSIZE; cpu++)
+      {
+         CPU_SET(cpu, &allowed);
+      }
+   }
+   char list[4096];
+   for (uint32_t node = 0; node < NUMA_MAX_NODES; node++)
+   {
+      if (!read_cpulist(node, list, sizeof(list))) {
+         continue;
+      }
+      for (char * range = strtok(list, ",\n"); range; range = strtok(NULL, ",\n"))
+      {
+         unsigned first, last;
+         int fields = sscanf(range, "%u-%u", &first, &last);
+         if (fields < 1) {
+            continue;
+         }
+         if (fields == 1) {
+            last = first;
+         }
+         for (uint32_t cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+         {
+            if (CPU_ISSET(cpu, &allowed)) {
+               add_cpu(topology, node, cpu);
+            }
+         }
+      }
+   }
+   // No sysfs node directory: one node with every allowed CPU
+   for (uint32_t cpu = 0; topology->cpu_count == 0 && cpu < CPU_SETSIZE; cpu++)
+   {
+      if (CPU_ISSET(cpu, &allowed)) {
+         add_cpu(topology, 0, cpu);
+      }
+   }
+#endif
+
+   if (topology->cpu_count == 0) {
+      uint32_t hardware_threads = std::thread::hardware_concurrency();
+      for (uint32_t cpu = 0; cpu < (hardware_threads ? hardware_threads : 1); cpu++)
+      {
+         add_cpu(topology, 0, cpu);
+      }
+   }
+}
+
+uint32_t numa_cpu_node(const numa_topology_t * topology, uint32_t index)
+{
+   for (uint32_t node = 0; node < topology->node_count; node++)
+   {
+      if (index >= topology->node_first[node] && index < topology->node_first[node] + topology->node_cpus[node]) {
+         return node;
+      }
+   }
+   return 0;
+}
+
+bool numa_pin_thread(uint32_t cpu)
+{
+#ifdef _WIN32
+   return cpu < 64 && SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#else
+   if (cpu >= CPU_SETSIZE) {
+      return false;
+   }
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+size_t numa_page_size()
+{
+#ifdef _WIN32
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwPageSize;
+#else
+   long size = sysconf(_SC_PAGESIZE);
+   return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+size_t numa_page_count(const void * ptr, size_t bytes)
+{
+   size_t page_size = numa_page_size();
+   uintptr_t first = (uintptr_t)ptr / page_size * page_size;
+   return ((uintptr_t)ptr + bytes - first + page_size - 1) / page_size;
+}
+
+bool numa_page_nodes(const void * ptr, size_t bytes, int32_t * nodes)
+{
+   size_t page_size = numa_page_size();
+   uintptr_t first = (uintptr_t)ptr / page_size * page_size;
+   size_t page_count = numa_page_count(ptr, bytes);
+
+#ifdef _WIN32
+   PSAPI_WORKING_SET_EX_INFORMATION info[NUMA_QUERY_BATCH];
+   for (size_t done = 0; done < page_count; done += NUMA_QUERY_BATCH)
+   {
+      size_t count = (page_count - done < NUMA_QUERY_BATCH) ? page_count - done : NUMA_QUERY_BATCH;
+      for (size_t i = 0; i < count; i++)
+      {
+         info[i].VirtualAddress = (void *)(first + (done + i) * page_size);
+      }
+      if (!QueryWorkingSetEx(GetCurrentProcess(), info, (DWORD)(count * sizeof(info[0])))) {
+         return false;
+      }
+      for (size_t i = 0; i < count; i++)
+      {
+         nodes[done + i] = info[i].VirtualAttributes.Valid ? (int32_t)info[i].VirtualAttributes.Node : NUMA_NO_NODE;
+      }
+   }
+   return true;
+#elif defined(SYS_move_pages)
+   // move_pages without target nodes only reports where each page is
+   void * pages[NUMA_QUERY_BATCH];
+   int status[NUMA_QUERY_BATCH];
+   for (size_t done = 0; done < page_count; done += NUMA_QUERY_BATCH)
+   {
+      size_t count = (page_count - done < NUMA_QUERY_BATCH) ? page_count - done : NUMA_QUERY_BATCH;
+      for (size_t i = 0; i < count; i++)
+      {
+         pages[i] = (void *)(first + (done + i) * page_size);
+      }
+      if (syscall(SYS_move_pages, 0, (unsigned long)count, pages, NULL, status, 0) != 0) {
+         return false;
+      }
+      for (size_t i = 0; i < count; i++)
+      {
+         nodes[done + i] = status[i] >= 0 ? status[i] : NUMA_NO_NODE;
+      }
+   }
+   return true;
+#else
+   (void)nodes;
+   (void)page_count;
+   return false;
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef _NUMA_H
+#define _NUMA_H
+
+#include <cstdint>
+#include <cstddef>
+
+// NUMA topology, thread pinning and page placement queries, straight from
+// the OS (sysfs and move_pages on Linux, the NUMA API on Windows) without
+// libnuma. Machines or builds without NUMA look like a single node.
+
+const uint32_t NUMA_MAX_NODES = 64;
+const uint32_t NUMA_MAX_CPUS = 1024;
+const int32_t NUMA_NO_NODE = -1;
+
+// The CPUs this process may run on, grouped by node: node n owns
+// cpus[node_first[n]] to cpus[node_first[n] + node_cpus[n] - 1].
+struct numa_topology_t {
+   uint32_t node_count;
+   uint32_t cpu_count;
+   uint32_t cpus[NUMA_MAX_CPUS];
+   uint32_t node_first[NUMA_MAX_NODES];
+   uint32_t node_cpus[NUMA_MAX_NODES];
+};
+
+void numa_detect(numa_topology_t * topology);
+
+// Node of cpus[index].
+uint32_t numa_cpu_node(const numa_topology_t * topology, uint32_t index);
+
+// Pins the calling thread to one OS CPU. Returns false if the OS refused.
+bool numa_pin_thread(uint32_t cpu);
+
+size_t numa_page_size();
+
+// Pages that [ptr, ptr + bytes) lies on.
+size_t numa_page_count(const void * ptr, size_t bytes);
+
+// Node of each page of [ptr, ptr + bytes), NUMA_NO_NODE for pages not yet
+// touched. Returns false if the OS cannot tell; `nodes` needs room for
+// numa_page_count(ptr, bytes) entries.
+bool numa_page_nodes(const void * ptr, size_t bytes, int32_t * nodes);
+
+#endif // _NUMA_H
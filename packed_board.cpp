@@ -0,0 +1,60 @@
+#include "packed_board.h"
+
+void packed_board_pack(const uint32_t * cells, int32_t cell_stride, uint64_t * words, int32_t words_per_row, int32_t ncells_x, int32_t nrows)
+{
+   for (auto y = 0; y < nrows; y++)
+   {
+      const uint32_t * row = cells + y * cell_stride;
+      uint64_t * out = words + y * words_per_row;
+      for (auto w = 0; w < words_per_row; w++)
+      {
+         uint64_t word = 0;
+         for (auto i = 0; i < 64; i++)
+         {
+            auto x = w * 64 + i;
+            if (x < ncells_x && row[x]) {
+               word |= 1ull << i;
+            }
+         }
+         out[w] = word;
+      }
+   }
+}
+
+void packed_board_unpack(const uint64_t * words, int32_t words_per_row, uint32_t * cells, int32_t cell_stride, int32_t ncells_x, int32_t nrows)
+{
+   for (auto y = 0; y < nrows; y++)
+   {
+      const uint64_t * row = words + y * words_per_row;
+      uint32_t * out = cells + y * cell_stride;
+      for (auto x = 0; x < ncells_x; x++)
+      {
+         out[x] = (row[x / 64] >> (x % 64)) & 1;
+      }
+   }
+}
+
+void packed_update_board(const uint64_t * old_board, uint64_t * new_board, int32_t words_per_row,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   if (startx >= endx) {
+      return;
+   }
+   int32_t start_word = startx / 64;
+   int32_t end_word = (endx + 63) / 64;
+
+   for (auto y = starty; y < endy; y++)
+   {
+      const uint64_t * up = old_board + (y - 1) * words_per_row;
+      const uint64_t * mid = up + words_per_row;
+      const uint64_t * down = mid + words_per_row;
+      uint64_t * out = new_board + y * words_per_row;
+
+      for (auto w = start_word; w < end_word; w++)
+      {
+         uint64_t next = packed_step_word(up, mid, down, w, words_per_row);
+         uint64_t mask = packed_range_mask(w, startx, endx);
+         out[w] = (next & mask) | (out[w] & ~mask);
+      }
+   }
+}
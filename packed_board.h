@@ -0,0 +1,122 @@
+#ifndef _PACKED_BOARD_H
+#define _PACKED_BOARD_H
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Bit-packed board: one bit per cell, 64 cells per word, rows of
+// `words_per_row` words. Bit i of word w in a row is the cell at x = w*64 + i.
+
+static inline int32_t packed_words_per_row(int32_t ncells_x) { return (ncells_x + 1 + 63) / 64; }
+
+// Cells to the west/east of every bit in `cur`, pulling the edge bit from the
+// neighbouring word of the same row.
+static inline uint64_t packed_west(uint64_t prev, uint64_t cur) { return (cur << 1) | (prev >> 63); }
+static inline uint64_t packed_east(uint64_t cur, uint64_t next) { return (cur >> 1) | (next << 63); }
+
+static inline uint32_t packed_popcount(uint64_t word)
+{
+#ifdef _MSC_VER
+   return (uint32_t)__popcnt64(word);
+#else
+   return (uint32_t)__builtin_popcountll(word);
+#endif
+}
+
+// Index of the lowest set bit, `word` must not be 0.
+static inline uint32_t packed_lowest_bit(uint64_t word)
+{
+#ifdef _MSC_VER
+   unsigned long index;
+   _BitScanForward64(&index, word);
+   return (uint32_t)index;
+#else
+   return (uint32_t)__builtin_ctzll(word);
+#endif
+}
+
+// Index of the highest set bit, `word` must not be 0.
+static inline uint32_t packed_highest_bit(uint64_t word)
+{
+#ifdef _MSC_VER
+   unsigned long index;
+   _BitScanReverse64(&index, word);
+   return (uint32_t)index;
+#else
+   return (uint32_t)(63 - __builtin_clzll(word));
+#endif
+}
+
+static inline void packed_add3(uint64_t a, uint64_t b, uint64_t c, uint64_t & sum, uint64_t & carry)
+{
+   uint64_t t = a ^ b;
+   sum = t ^ c;
+   carry = (a & b) | (t & c);
+}
+
+// B3/S23 for 64 cells at once. Neighbour counts are summed with bit-sliced
+// adders into ones/twos plus a "four or more" flag.
+static inline uint64_t packed_life_word(
+      uint64_t nw, uint64_t n,  uint64_t ne,
+      uint64_t w,  uint64_t c,  uint64_t e,
+      uint64_t sw, uint64_t s,  uint64_t se)
+{
+   uint64_t s0, c0, s1, c1;
+   packed_add3(nw, n, ne, s0, c0);
+   packed_add3(w, e, sw, s1, c1);
+   uint64_t s2 = s ^ se;
+   uint64_t c2 = s & se;
+
+   uint64_t ones, c3;
+   packed_add3(s0, s1, s2, ones, c3);
+
+   uint64_t t0, fours0;
+   packed_add3(c0, c1, c2, t0, fours0);
+   uint64_t twos = t0 ^ c3;
+   uint64_t fours1 = t0 & c3;
+
+   return twos & ~(fours0 | fours1) & (ones | c);
+}
+
+// Mask of the bits of word `w` whose cells lie in [startx, endx).
+static inline uint64_t packed_range_mask(int32_t w, int32_t startx, int32_t endx)
+{
+   int32_t lo = w * 64;
+   int32_t from = (startx > lo) ? startx - lo : 0;
+   int32_t to = (endx < lo + 64) ? endx - lo : 64;
+   if (from >= to) {
+      return 0;
+   }
+   uint64_t hi_mask = (to == 64) ? ~0ull : ((1ull << to) - 1);
+   return hi_mask & ~((1ull << from) - 1);
+}
+
+// Next state of word `w` of row `y`, given the rows above and below.
+static inline uint64_t packed_step_word(const uint64_t * up, const uint64_t * mid, const uint64_t * down, int32_t w, int32_t words_per_row)
+{
+   bool has_prev = w > 0;
+   bool has_next = w + 1 < words_per_row;
+   uint64_t up_prev = has_prev ? up[w - 1] : 0, up_next = has_next ? up[w + 1] : 0;
+   uint64_t mid_prev = has_prev ? mid[w - 1] : 0, mid_next = has_next ? mid[w + 1] : 0;
+   uint64_t down_prev = has_prev ? down[w - 1] : 0, down_next = has_next ? down[w + 1] : 0;
+
+   return packed_life_word(
+         packed_west(up_prev, up[w]), up[w], packed_east(up[w], up_next),
+         packed_west(mid_prev, mid[w]), mid[w], packed_east(mid[w], mid_next),
+         packed_west(down_prev, down[w]), down[w], packed_east(down[w], down_next));
+}
+
+void packed_board_pack(const uint32_t * cells, int32_t cell_stride, uint64_t * words, int32_t words_per_row, int32_t ncells_x, int32_t nrows);
+
+void packed_board_unpack(const uint64_t * words, int32_t words_per_row, uint32_t * cells, int32_t cell_stride, int32_t ncells_x, int32_t nrows);
+
+// Same contract as update_board: cells in [startx, endx) x [starty, endy) are
+// written, everything else in new_board is left alone. Chunks that share a
+// word must not be updated concurrently, so tile on 64-cell boundaries.
+void packed_update_board(const uint64_t * old_board, uint64_t * new_board, int32_t words_per_row,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy);
+
+#endif // _PACKED_BOARD_H
@@ -0,0 +1,450 @@
+#include "pattern.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "mapped_file.h"
+#include "packed_board.h"
+
+const uint32_t MACROCELL_LEAF_LEVEL = 3;
+const uint32_t MACROCELL_MAX_LEVEL = 62;
+// RLE runs and positions stay below this, so adding a run never overflows
+const int64_t RLE_MAX_EXTENT = 1ll << 61;
+
+struct pattern_t {
+   mapped_file_t file;
+   bool mapped;
+   const char * data;
+   size_t size;
+   size_t body;                  // offset of the first cell data
+   pattern_format_t format;
+   int64_t width;
+   int64_t height;
+   char rule[64];
+};
+
+// Macrocell node: a level 3 leaf holds its 8x8 cells, bit y * 8 + x; above
+// that the children are node numbers, 0 being the empty node.
+struct mc_node_t {
+   uint32_t level;
+   uint32_t children[4];
+   uint64_t leaf;
+};
+
+struct pattern_decoder_t {
+   const pattern_placement_t * placement;
+   const pattern_sink_t * sink;
+};
+
+static inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Decimal digits at *p, after blanks, up to `end`: the file is not
+// NUL-terminated. False if there are none or they exceed `limit`.
+static bool parse_number(const char ** p, const char * end, uint64_t limit, uint64_t * value)
+{
+   while (*p < end && (**p == ' ' || **p == '\t')) (*p)++;
+   if (*p == end || !is_digit(**p)) {
+      return false;
+   }
+   *value = 0;
+   for (; *p < end && is_digit(**p); (*p)++)
+   {
+      uint64_t digit = (uint64_t)(**p - '0');
+      if (*value > (limit - digit) / 10) {
+         return false;
+      }
+      *value = *value * 10 + digit;
+   }
+   return true;
+}
+
+static inline size_t next_line(const char * data, size_t size, size_t at)
+{
+   const char * end = (const char *)memchr(data + at, '\n', size - at);
+   return end ? (size_t)(end - data) + 1 : size;
+}
+
+static void copy_rule(pattern_t * pattern, const char * start, const char * end)
+{
+   while (start < end && is_space(*start)) start++;
+   while (end > start && is_space(end[-1])) end--;
+   size_t length = std::min((size_t)(end - start), sizeof(pattern->rule) - 1);
+   memcpy(pattern->rule, start, length);
+   pattern->rule[length] = 0;
+}
+
+// "x = 36, y = 9, rule = B3/S23"
+static void parse_rle_header(pattern_t * pattern, const char * line, const char * end)
+{
+   const char * p = line;
+   while (p < end) {
+      while (p < end && (is_space(*p) || *p == ',')) p++;
+      const char * key = p;
+      while (p < end && *p != '=' && *p != ',') p++;
+      if (p == end || *p != '=') {
+         break;
+      }
+      const char * key_end = p;
+      while (key_end > key && is_space(key_end[-1])) key_end--;
+      p++;
+      const char * value = p;
+      while (p < end && *p != ',') p++;
+      uint64_t number;
+      if (key_end - key == 1 && (*key == 'x' || *key == 'y')) {
+         int64_t extent = parse_number(&value, p, RLE_MAX_EXTENT, &number) ? (int64_t)number : 0;
+         (*key == 'x' ? pattern->width : pattern->height) = extent;
+      } else if (key_end - key == 4 && !strncmp(key, "rule", 4)) {
+         copy_rule(pattern, value, p);
+      }
+   }
+}
+
+static bool pattern_read_header(pattern_t * pattern, const char ** error)
+{
+   const char * data = pattern->data;
+   size_t size = pattern->size;
+   size_t at = 0;
+
+   strcpy(pattern->rule, "B3/S23");
+   pattern->width = 0;
+   pattern->height = 0;
+
+   if (size >= 4 && !memcmp(data, "[M2]", 4)) {
+      pattern->format = PATTERN_MACROCELL;
+      at = next_line(data, size, 0);
+      while (at < size && data[at] == '#') {
+         size_t end = next_line(data, size, at);
+         if (at + 1 < size && data[at + 1] == 'R') {
+            copy_rule(pattern, data + at + 2, data + end);
+         }
+         at = end;
+      }
+      pattern->body = at;
+
+      // The root is the last node, its level gives the extent
+      size_t last = size;
+      while (last > at && is_space(data[last - 1])) last--;
+      size_t line = last;
+      while (line > at && data[line - 1] != '\n') line--;
+      if (line >= last) {
+         *error = "macrocell file has no nodes";
+         return false;
+      }
+      uint64_t level = MACROCELL_LEAF_LEVEL;
+      const char * p = data + line;
+      if (is_digit(*p) && !parse_number(&p, data + last, UINT32_MAX, &level)) {
+         level = UINT32_MAX;
+      }
+      if (level < MACROCELL_LEAF_LEVEL || level > MACROCELL_MAX_LEVEL) {
+         *error = "macrocell root level out of range";
+         return false;
+      }
+      pattern->width = pattern->height = 1ll << level;
+      return true;
+   }
+
+   pattern->format = PATTERN_RLE;
+   while (at < size) {
+      size_t end = next_line(data, size, at);
+      if (data[at] == '#' || data[at] == '\r' || data[at] == '\n') {
+         at = end;
+         continue;
+      }
+      size_t p = at;
+      while (p < end && is_space(data[p])) p++;
+      if (p < end && data[p] == 'x') {
+         parse_rle_header(pattern, data + p, data + end);
+         at = end;
+      }
+      break;
+   }
+   pattern->body = at;
+   return true;
+}
+
+static pattern_t * pattern_open_data(pattern_t * pattern, const char ** error)
+{
+   if (!pattern_read_header(pattern, error)) {
+      pattern_close(pattern);
+      return NULL;
+   }
+   return pattern;
+}
+
+pattern_t * pattern_open(const char * path, const char ** error)
+{
+   pattern_t * pattern = (pattern_t *)calloc(1, sizeof(pattern_t));
+   if (!mapped_file_open(&pattern->file, path)) {
+      free(pattern);
+      *error = "cannot open pattern file";
+      return NULL;
+   }
+   pattern->mapped = true;
+   pattern->data = (const char *)pattern->file.data;
+   pattern->size = pattern->file.size;
+   return pattern_open_data(pattern, error);
+}
+
+pattern_t * pattern_open_memory(const char * data, size_t size, const char ** error)
+{
+   pattern_t * pattern = (pattern_t *)calloc(1, sizeof(pattern_t));
+   pattern->data = data;
+   pattern->size = size;
+   return pattern_open_data(pattern, error);
+}
+
+void pattern_close(pattern_t * pattern)
+{
+   if (pattern->mapped) {
+      mapped_file_close(&pattern->file);
+   }
+   free(pattern);
+}
+
+pattern_format_t pattern_format(const pattern_t * pattern) { return pattern->format; }
+int64_t pattern_width(const pattern_t * pattern) { return pattern->width; }
+int64_t pattern_height(const pattern_t * pattern) { return pattern->height; }
+const char * pattern_rule(const pattern_t * pattern) { return pattern->rule; }
+
+// Board x range of pattern columns [px, px + length) after placement.
+static inline int64_t placed_x(const pattern_placement_t * placement, int64_t px, int64_t length)
+{
+   return (placement->dir_x >= 0) ? placement->x + px : placement->x - px - length + 1;
+}
+
+static inline int64_t placed_y(const pattern_placement_t * placement, int64_t py, int64_t length)
+{
+   return (placement->dir_y >= 0) ? placement->y + py : placement->y - py - length + 1;
+}
+
+static inline void emit_run(const pattern_decoder_t * decoder, int64_t px, int64_t py, int64_t length)
+{
+   const pattern_sink_t * sink = decoder->sink;
+   int64_t x = placed_x(decoder->placement, px, length);
+   int64_t y = placed_y(decoder->placement, py, 1);
+   if (y < sink->min_y || y >= sink->max_y || x + length <= sink->min_x || x >= sink->max_x) {
+      return;
+   }
+   sink->run(sink->user, x, y, length);
+}
+
+static bool decode_rle(const pattern_t * pattern, const pattern_decoder_t * decoder, const char ** error)
+{
+   const char * p = pattern->data + pattern->body;
+   const char * end = pattern->data + pattern->size;
+   int64_t px = 0, py = 0;
+   int64_t count = 0;
+
+   for (; p < end; p++)
+   {
+      char c = *p;
+      if (is_digit(c)) {
+         if (count > (RLE_MAX_EXTENT - (c - '0')) / 10) {
+            *error = "RLE run count too large";
+            return false;
+         }
+         count = count * 10 + (c - '0');
+         continue;
+      }
+      int64_t n = count ? count : 1;
+      if (c == 'b' || c == '.') {
+         px += n;
+      } else if (c == '$') {
+         py += n;
+         px = 0;
+      } else if (c == '!') {
+         return true;
+      } else if (c == '#') {
+         p = pattern->data + next_line(pattern->data, pattern->size, (size_t)(p - pattern->data)) - 1;
+      } else if (is_space(c)) {
+         continue;
+      } else if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+         // 'o' and the multi-state letters are all live cells
+         emit_run(decoder, px, py, n);
+         px += n;
+      } else {
+         *error = "unexpected character in RLE data";
+         return false;
+      }
+      count = 0;
+      if (px > RLE_MAX_EXTENT || py > RLE_MAX_EXTENT) {
+         *error = "RLE pattern too large";
+         return false;
+      }
+   }
+   return true;
+}
+
+static void emit_leaf(const pattern_decoder_t * decoder, uint64_t leaf, int64_t px, int64_t py)
+{
+   for (auto y = 0; y < 8; y++)
+   {
+      uint32_t row = (uint32_t)(leaf >> (y * 8)) & 0xff;
+      int32_t x = 0;
+      while (row) {
+         while (!(row & 1)) {
+            row >>= 1;
+            x++;
+         }
+         int32_t start = x;
+         while (row & 1) {
+            row >>= 1;
+            x++;
+         }
+         emit_run(decoder, px + start, py + y, x - start);
+      }
+   }
+}
+
+static void emit_node(const pattern_decoder_t * decoder, const std::vector<mc_node_t> & nodes, uint32_t id, int64_t px, int64_t py)
+{
+   if (id == 0) {
+      return;
+   }
+   const mc_node_t & node = nodes[id];
+   int64_t size = 1ll << node.level;
+   int64_t x = placed_x(decoder->placement, px, size);
+   int64_t y = placed_y(decoder->placement, py, size);
+   const pattern_sink_t * sink = decoder->sink;
+   if (x + size <= sink->min_x || x >= sink->max_x || y + size <= sink->min_y || y >= sink->max_y) {
+      return;
+   }
+
+   if (node.level == MACROCELL_LEAF_LEVEL) {
+      emit_leaf(decoder, node.leaf, px, py);
+      return;
+   }
+   int64_t half = size / 2;
+   emit_node(decoder, nodes, node.children[0], px, py);
+   emit_node(decoder, nodes, node.children[1], px + half, py);
+   emit_node(decoder, nodes, node.children[2], px, py + half);
+   emit_node(decoder, nodes, node.children[3], px + half, py + half);
+}
+
+// One node per line: "$..*$*.*$" style 8x8 leaves, or "level nw ne sw se".
+static bool decode_macrocell(const pattern_t * pattern, const pattern_decoder_t * decoder, const char ** error)
+{
+   const char * data = pattern->data;
+   size_t size = pattern->size;
+   std::vector<mc_node_t> nodes(1);
+   nodes[0].level = 0;
+
+   for (size_t at = pattern->body; at < size; )
+   {
+      size_t end = next_line(data, size, at);
+      char c = data[at];
+      mc_node_t node = {};
+      if (c == '.' || c == '*' || c == '$') {
+         node.level = MACROCELL_LEAF_LEVEL;
+         int32_t x = 0, y = 0;
+         for (size_t p = at; p < end && y < 8; p++)
+         {
+            if (data[p] == '.') {
+               x++;
+            } else if (data[p] == '*') {
+               if (x < 8) {
+                  node.leaf |= 1ull << (y * 8 + x);
+               }
+               x++;
+            } else if (data[p] == '$') {
+               x = 0;
+               y++;
+            }
+         }
+         nodes.push_back(node);
+      } else if (is_digit(c)) {
+         const char * p = data + at;
+         uint64_t number;
+         if (!parse_number(&p, data + end, MACROCELL_MAX_LEVEL, &number)) {
+            *error = "macrocell node level out of range";
+            return false;
+         }
+         node.level = (uint32_t)number;
+         for (auto i = 0; i < 4; i++)
+         {
+            if (!parse_number(&p, data + end, UINT32_MAX, &number)) {
+               *error = "macrocell node refers to an undefined node";
+               return false;
+            }
+            node.children[i] = (uint32_t)number;
+            if (node.children[i] >= nodes.size() ||
+                  (node.children[i] && nodes[node.children[i]].level + 1 != node.level)) {
+               *error = "macrocell node refers to an undefined node";
+               return false;
+            }
+         }
+         if (node.level <= MACROCELL_LEAF_LEVEL || node.level > MACROCELL_MAX_LEVEL) {
+            *error = "macrocell node level out of range";
+            return false;
+         }
+         nodes.push_back(node);
+      } else if (c != '#' && !is_space(c)) {
+         *error = "unexpected line in macrocell data";
+         return false;
+      }
+      at = end;
+   }
+
+   if (nodes.size() > 1) {
+      emit_node(decoder, nodes, (uint32_t)nodes.size() - 1, 0, 0);
+   }
+   return true;
+}
+
+bool pattern_decode(pattern_t * pattern, const pattern_placement_t * placement, const pattern_sink_t * sink, const char ** error)
+{
+   pattern_decoder_t decoder = {placement, sink};
+   if (pattern->format == PATTERN_MACROCELL) {
+      return decode_macrocell(pattern, &decoder, error);
+   }
+   return decode_rle(pattern, &decoder, error);
+}
+
+static void board_run(void * user, int64_t x, int64_t y, int64_t length)
+{
+   board_t * board = (board_t *)user;
+   int64_t start = std::max<int64_t>(x, 1);
+   int64_t end = std::min<int64_t>(x + length, (int64_t)board->width + 1);
+   if (start < end) {
+      uint32_t * row = board_row(board, (int32_t)y);
+      std::fill(row + start, row + end, 1u);
+   }
+}
+
+static void packed_run(void * user, int64_t x, int64_t y, int64_t length)
+{
+   packed_board_t * board = (packed_board_t *)user;
+   int32_t start = (int32_t)std::max<int64_t>(x, 1);
+   int32_t end = (int32_t)std::min<int64_t>(x + length, (int64_t)board->width + 1);
+   uint64_t * row = packed_board_row(board, (int32_t)y);
+   for (auto w = start / 64; w < (end + 63) / 64 && start < end; w++)
+   {
+      row[w] |= packed_range_mask(w, start, end);
+   }
+}
+
+static void universe_run(void * user, int64_t x, int64_t y, int64_t length)
+{
+   universe_set_run((universe_t *)user, x, y, length);
+}
+
+pattern_sink_t pattern_sink_board(board_t * board)
+{
+   pattern_sink_t sink = {board_run, board, 1, 1, (int64_t)board->width + 1, (int64_t)board->height + 1};
+   return sink;
+}
+
+pattern_sink_t pattern_sink_packed(packed_board_t * board)
+{
+   pattern_sink_t sink = {packed_run, board, 1, 1, (int64_t)board->width + 1, (int64_t)board->height + 1};
+   return sink;
+}
+
+pattern_sink_t pattern_sink_universe(universe_t * universe)
+{
+   pattern_sink_t sink = {universe_run, universe, INT64_MIN / 2, INT64_MIN / 2, INT64_MAX / 2, INT64_MAX / 2};
+   return sink;
+}
@@ -0,0 +1,66 @@
+#ifndef _PATTERN_H
+#define _PATTERN_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "board.h"
+#include "universe.h"
+
+// Streaming loader for RLE (.rle) and Golly Macrocell (.mc) patterns. Files
+// are memory mapped and decoded in one pass; live cells reach the board as
+// horizontal runs, never one store per cell.
+
+enum pattern_format_t {
+   PATTERN_RLE,
+   PATTERN_MACROCELL
+};
+
+// Pattern cell (px, py) lands on (x + dir_x * px, y + dir_y * py), the same
+// convention as the old hand-written seeders. dir_x / dir_y are 1 or -1.
+struct pattern_placement_t {
+   int64_t x;
+   int64_t y;
+   int32_t dir_x;
+   int32_t dir_y;
+};
+
+// Receives the live cells [x, x + length) of row y in board coordinates.
+// Runs outside [min_x, max_x) x [min_y, max_y) may be dropped by the loader,
+// which lets macrocell decoding skip whole off-board subtrees.
+struct pattern_sink_t {
+   void (*run)(void * user, int64_t x, int64_t y, int64_t length);
+   void * user;
+   int64_t min_x;
+   int64_t min_y;
+   int64_t max_x;
+   int64_t max_y;
+};
+
+struct pattern_t;
+
+// Maps the file and reads its header. Returns NULL and sets `error` on failure.
+pattern_t * pattern_open(const char * path, const char ** error);
+
+// Same for a pattern held in memory, which must outlive the pattern_t.
+pattern_t * pattern_open_memory(const char * data, size_t size, const char ** error);
+
+void pattern_close(pattern_t * pattern);
+
+pattern_format_t pattern_format(const pattern_t * pattern);
+
+// Extent of the pattern: the RLE header size, or the macrocell root square.
+int64_t pattern_width(const pattern_t * pattern);
+int64_t pattern_height(const pattern_t * pattern);
+
+// Rule string from the file, "B3/S23" when it has none.
+const char * pattern_rule(const pattern_t * pattern);
+
+bool pattern_decode(pattern_t * pattern, const pattern_placement_t * placement, const pattern_sink_t * sink, const char ** error);
+
+// Sinks clipped to the live cells of a board, or unbounded for the plane.
+pattern_sink_t pattern_sink_board(board_t * board);
+pattern_sink_t pattern_sink_packed(packed_board_t * board);
+pattern_sink_t pattern_sink_universe(universe_t * universe);
+
+#endif // _PATTERN_H
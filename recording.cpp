@@ -0,0 +1,317 @@
+#include "recording.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "packed_board.h"
+
+static const char RECORDING_MAGIC[8] = {'G', 'O', 'L', 'R', 'E', 'C', 0, 0};
+const uint32_t CHUNK_BITS = RECORDING_CHUNK_SIZE * RECORDING_CHUNK_SIZE;
+
+struct recording_t {
+   FILE * file;
+   std::vector<uint8_t> frame;         // chunks of the frame being built
+   recording_frame_t frame_header;
+   recording_stats_t stats;
+
+   // Single producer, single consumer: head and tail count bytes ever
+   // written and ever flushed, the ring holds the bytes in between.
+   uint8_t * ring;
+   size_t ring_size;
+   std::atomic<uint64_t> head;
+   std::atomic<uint64_t> tail;
+
+   std::thread thread;
+   std::mutex lock;
+   std::condition_variable wake;
+   bool running;
+   bool failed;
+};
+
+static void recording_main(recording_t * recording)
+{
+   for (;;) {
+      uint64_t head;
+      {
+         std::unique_lock<std::mutex> lock(recording->lock);
+         recording->wake.wait(lock, [recording] {
+            return recording->head.load(std::memory_order_acquire) != recording->tail.load(std::memory_order_relaxed) ||
+                  !recording->running;
+         });
+         head = recording->head.load(std::memory_order_acquire);
+         if (head == recording->tail.load(std::memory_order_relaxed) && !recording->running) {
+            return;
+         }
+      }
+
+      uint64_t tail = recording->tail.load(std::memory_order_relaxed);
+      while (tail < head) {
+         size_t start = (size_t)(tail % recording->ring_size);
+         size_t count = (size_t)std::min<uint64_t>(head - tail, recording->ring_size - start);
+         if (fwrite(recording->ring + start, 1, count, recording->file) != count) {
+            recording->failed = true;
+         }
+         tail += count;
+      }
+      recording->tail.store(tail, std::memory_order_release);
+   }
+}
+
+recording_t * recording_create(const char * path, const recording_header_t * header, size_t ring_bytes, const char ** error)
+{
+   FILE * file = fopen(path, "wb");
+   if (!file) {
+      *error = "cannot create the recording file";
+      return NULL;
+   }
+   recording_header_t file_header = *header;
+   memcpy(file_header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+   file_header.version = RECORDING_VERSION;
+   if (fwrite(&file_header, sizeof(file_header), 1, file) != 1) {
+      fclose(file);
+      *error = "cannot write the recording file";
+      return NULL;
+   }
+
+   recording_t * recording = new recording_t();
+   recording->file = file;
+   recording->ring = new uint8_t[ring_bytes];
+   recording->ring_size = ring_bytes;
+   recording->head = 0;
+   recording->tail = 0;
+   recording->running = true;
+   recording->failed = false;
+   recording->stats = {};
+   recording->thread = std::thread(recording_main, recording);
+   return recording;
+}
+
+bool recording_close(recording_t * recording, recording_stats_t * stats)
+{
+   {
+      std::lock_guard<std::mutex> lock(recording->lock);
+      recording->running = false;
+   }
+   recording->wake.notify_one();
+   recording->thread.join();
+
+   bool ok = !recording->failed && fclose(recording->file) == 0;
+   if (stats) {
+      *stats = recording->stats;
+   }
+   delete[] recording->ring;
+   delete recording;
+   return ok;
+}
+
+void recording_begin_frame(recording_t * recording, recording_frame_type_t type, uint64_t generation)
+{
+   recording->frame.clear();
+   recording->frame_header.type = type;
+   recording->frame_header.chunk_count = 0;
+   recording->frame_header.generation = generation;
+}
+
+static inline void put_varint(std::vector<uint8_t> * out, uint32_t value)
+{
+   while (value >= 0x80) {
+      out->push_back((uint8_t)(value | 0x80));
+      value >>= 7;
+   }
+   out->push_back((uint8_t)value);
+}
+
+// First bit at or after `pos` that is not `bit`, or CHUNK_BITS.
+static uint32_t run_end(const uint64_t * rows, uint32_t pos, bool bit)
+{
+   uint64_t flip = bit ? ~0ull : 0;
+   uint32_t w = pos / 64;
+   uint64_t word = (rows[w] ^ flip) >> (pos % 64);
+   if (word) {
+      return pos + packed_lowest_bit(word);
+   }
+   for (w++; w < RECORDING_CHUNK_SIZE; w++)
+   {
+      word = rows[w] ^ flip;
+      if (word) {
+         return w * 64 + packed_lowest_bit(word);
+      }
+   }
+   return CHUNK_BITS;
+}
+
+void recording_add_chunk(recording_t * recording, uint32_t index, const uint64_t * rows)
+{
+   std::vector<uint8_t> & frame = recording->frame;
+   size_t start = frame.size();
+   frame.resize(start + 2 * sizeof(uint32_t));
+   memcpy(&frame[start], &index, sizeof(index));
+
+   uint32_t pos = 0;
+   bool bit = false;
+   for (;;) {
+      uint32_t end = run_end(rows, pos, bit);
+      if (end == CHUNK_BITS && !bit) {
+         break;
+      }
+      put_varint(&frame, end - pos);
+      pos = end;
+      bit = !bit;
+      if (pos == CHUNK_BITS) {
+         break;
+      }
+   }
+
+   uint32_t bytes = (uint32_t)(frame.size() - start - 2 * sizeof(uint32_t));
+   memcpy(&frame[start + sizeof(uint32_t)], &bytes, sizeof(bytes));
+   recording->frame_header.chunk_count++;
+}
+
+static void ring_write(recording_t * recording, uint64_t head, const void * data, size_t count)
+{
+   size_t start = (size_t)(head % recording->ring_size);
+   size_t first = std::min(count, recording->ring_size - start);
+   memcpy(recording->ring + start, data, first);
+   memcpy(recording->ring, (const uint8_t *)data + first, count - first);
+}
+
+bool recording_end_frame(recording_t * recording)
+{
+   recording->frame_header.bytes = recording->frame.size();
+   size_t bytes = sizeof(recording_frame_t) + recording->frame.size();
+   uint64_t head = recording->head.load(std::memory_order_relaxed);
+   uint64_t tail = recording->tail.load(std::memory_order_acquire);
+   if (bytes > recording->ring_size - (head - tail)) {
+      recording->stats.dropped++;
+      return false;
+   }
+
+   ring_write(recording, head, &recording->frame_header, sizeof(recording_frame_t));
+   ring_write(recording, head + sizeof(recording_frame_t), recording->frame.data(), recording->frame.size());
+   recording->head.store(head + bytes, std::memory_order_release);
+   {
+      // Only ever held for the I/O thread's wait check, never across a write
+      std::lock_guard<std::mutex> lock(recording->lock);
+   }
+   recording->wake.notify_one();
+
+   recording->stats.frames++;
+   recording->stats.keyframes += recording->frame_header.type == RECORDING_KEYFRAME;
+   recording->stats.bytes += bytes;
+   return true;
+}
+
+bool replay_open(replay_t * replay, const char * path, const char ** error)
+{
+   if (!mapped_file_open(&replay->file, path)) {
+      *error = "cannot open the recording file";
+      return false;
+   }
+   const uint8_t * data = replay->file.data;
+   size_t size = replay->file.size;
+   if (size < sizeof(recording_header_t) || memcmp(data, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0) {
+      *error = "not a recording file";
+      mapped_file_close(&replay->file);
+      return false;
+   }
+   memcpy(&replay->header, data, sizeof(recording_header_t));
+   if (replay->header.version != RECORDING_VERSION) {
+      *error = "unsupported recording version";
+      mapped_file_close(&replay->file);
+      return false;
+   }
+
+   replay->frames.clear();
+   size_t at = sizeof(recording_header_t);
+   while (size - at >= sizeof(recording_frame_t)) {
+      recording_frame_t header;
+      memcpy(&header, data + at, sizeof(header));
+      at += sizeof(header);
+      if (header.bytes > size - at) {
+         break;
+      }
+      replay_frame_t frame = {header.type, header.chunk_count, header.generation, data + at, data + at + header.bytes};
+      replay->frames.push_back(frame);
+      at += (size_t)header.bytes;
+   }
+   return true;
+}
+
+void replay_close(replay_t * replay)
+{
+   mapped_file_close(&replay->file);
+   replay->frames.clear();
+}
+
+int64_t replay_find_keyframe(const replay_t * replay, uint64_t generation)
+{
+   // Frames are in generation order
+   int64_t lo = 0, hi = (int64_t)replay->frames.size();
+   while (lo < hi) {
+      int64_t mid = (lo + hi) / 2;
+      if (replay->frames[mid].generation <= generation) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+   for (int64_t i = lo - 1; i >= 0; i--)
+   {
+      if (replay->frames[i].type == RECORDING_KEYFRAME) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+static inline bool get_varint(const uint8_t ** cursor, const uint8_t * end, uint32_t * value)
+{
+   *value = 0;
+   for (uint32_t shift = 0; *cursor < end && shift < 35; shift += 7)
+   {
+      uint8_t byte = *(*cursor)++;
+      *value |= (uint32_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+bool replay_next_chunk(const replay_frame_t * frame, const uint8_t ** cursor, uint32_t * index, uint64_t * rows)
+{
+   uint32_t bytes;
+   if ((size_t)(frame->end - *cursor) < 2 * sizeof(uint32_t)) {
+      return false;
+   }
+   memcpy(index, *cursor, sizeof(uint32_t));
+   memcpy(&bytes, *cursor + sizeof(uint32_t), sizeof(uint32_t));
+   *cursor += 2 * sizeof(uint32_t);
+   const uint8_t * end = *cursor + std::min<size_t>(bytes, frame->end - *cursor);
+
+   memset(rows, 0, RECORDING_CHUNK_SIZE * sizeof(uint64_t));
+   uint32_t pos = 0;
+   bool bit = false;
+   uint32_t length;
+   while (*cursor < end && get_varint(cursor, end, &length)) {
+      length = std::min(length, CHUNK_BITS - pos);
+      if (bit) {
+         // Set bits [pos, pos + length), a word at a time
+         for (uint32_t p = pos; p < pos + length; )
+         {
+            uint32_t count = std::min(64 - p % 64, pos + length - p);
+            rows[p / 64] |= ((count == 64) ? ~0ull : ((1ull << count) - 1)) << (p % 64);
+            p += count;
+         }
+      }
+      pos += length;
+      bit = !bit;
+   }
+   *cursor = end;
+   return true;
+}
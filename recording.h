@@ -0,0 +1,98 @@
+#ifndef _RECORDING_H
+#define _RECORDING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "mapped_file.h"
+
+// Generation recordings. After a header, every generation is a frame: the
+// chunks that changed, each as the run lengths of the XOR between its old and
+// new 64 x 64 cells. Every keyframe_interval generations a keyframe holds
+// the whole board instead (XOR against an empty board), so replay can seek
+// without decoding from the start.
+
+const uint32_t RECORDING_VERSION = 1;
+const uint32_t RECORDING_CHUNK_SIZE = 64;
+
+enum recording_frame_type_t {
+   RECORDING_DELTA,
+   RECORDING_KEYFRAME
+};
+
+struct recording_header_t {
+   char magic[8];                   // "GOLREC\0\0"
+   uint32_t version;
+   uint32_t topology;               // topology_t
+   int32_t width;
+   int32_t height;
+   uint32_t chunks_x;
+   uint32_t keyframe_interval;
+};
+
+struct recording_frame_t {
+   uint32_t type;                   // recording_frame_type_t
+   uint32_t chunk_count;
+   uint64_t generation;
+   uint64_t bytes;                  // of chunk data following this header
+};
+
+// Chunk data: uint32_t chunk index, uint32_t byte count, then varint run
+// lengths alternating between unchanged and changed bits, starting with
+// unchanged, in row-major order. A trailing unchanged run is left out.
+
+struct recording_stats_t {
+   uint64_t frames;
+   uint64_t keyframes;
+   uint64_t dropped;                // frames lost to a full ring buffer
+   uint64_t bytes;
+};
+
+struct recording_t;
+
+// Starts the I/O thread. Frames go through a ring buffer of `ring_bytes`;
+// when it is full the frame is dropped rather than waiting for the disk.
+recording_t * recording_create(const char * path, const recording_header_t * header, size_t ring_bytes, const char ** error);
+
+// Flushes the ring buffer, stops the I/O thread and closes the file.
+// Returns false if a write failed.
+bool recording_close(recording_t * recording, recording_stats_t * stats);
+
+void recording_begin_frame(recording_t * recording, recording_frame_type_t type, uint64_t generation);
+
+// `rows` is the XOR of the chunk's old and new cells, bit i of rows[r] for
+// cell (startx + i, starty + r).
+void recording_add_chunk(recording_t * recording, uint32_t index, const uint64_t * rows);
+
+// Queues the frame; false if it was dropped, in which case the next frame
+// has to be a keyframe.
+bool recording_end_frame(recording_t * recording);
+
+struct replay_frame_t {
+   uint32_t type;
+   uint32_t chunk_count;
+   uint64_t generation;
+   const uint8_t * data;
+   const uint8_t * end;
+};
+
+// Indexes the frames of a recording, stopping at a frame cut short by a crash.
+struct replay_t {
+   mapped_file_t file;
+   recording_header_t header;
+   std::vector<replay_frame_t> frames;
+};
+
+bool replay_open(replay_t * replay, const char * path, const char ** error);
+
+void replay_close(replay_t * replay);
+
+// Index of the last keyframe at or before `generation`, -1 if none.
+int64_t replay_find_keyframe(const replay_t * replay, uint64_t generation);
+
+// Decodes the next chunk of a frame into `rows` and advances `cursor`, which
+// starts at frame->data. Returns false after the last chunk.
+bool replay_next_chunk(const replay_frame_t * frame, const uint8_t ** cursor, uint32_t * index, uint64_t * rows);
+
+#endif // _RECORDING_H
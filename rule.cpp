@@ -0,0 +1,441 @@
+#include "rule.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Bit n set for every digit n in `digits`; constexpr so masks can be template
+// arguments.
+static constexpr uint32_t counts(const char * digits)
+{
+   return *digits ? (1u << (*digits - '0')) | counts(digits + 1) : 0;
+}
+
+template <uint32_t STATES>
+static inline uint32_t live(uint32_t cell)
+{
+   return (STATES == 2) ? cell : (cell == 1);
+}
+
+// 1 if bit n of MASK is set, as one compare per set bit: unlike a variable
+// shift or a table lookup this vectorizes.
+template <uint32_t MASK, uint32_t N = 0>
+struct mask_test {
+   static inline uint32_t test(uint32_t n)
+   {
+      return (((MASK >> N) & 1) ? (uint32_t)(n == N) : 0) | mask_test<MASK, N + 1>::test(n);
+   }
+};
+
+template <uint32_t MASK>
+struct mask_test<MASK, 9> {
+   static inline uint32_t test(uint32_t) { return 0; }
+};
+
+template <uint32_t BIRTH, uint32_t SURVIVAL, uint32_t STATES>
+static inline uint32_t next_state(uint32_t cell, uint32_t neighbours)
+{
+   uint32_t born = mask_test<BIRTH>::test(neighbours);
+   uint32_t survives = mask_test<SURVIVAL>::test(neighbours);
+   if (STATES == 2) {
+      return (cell & survives) | ((cell ^ 1) & born);
+   }
+   if (cell == 0) {
+      return born;
+   }
+   if (cell == 1) {
+      return 2 - survives;
+   }
+   return (cell + 1 < STATES) ? cell + 1 : 0;
+}
+
+// One instantiation per rule: the masks fold into the code, so the inner loop
+// is the neighbour sum and a few compares.
+template <uint32_t BIRTH, uint32_t SURVIVAL, uint32_t STATES>
+static void update_life_like(const rule_t *, const board_t * old_board, board_t * new_board, bool,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   int32_t stride = old_board->pitch;
+   for (auto y = starty; y < endy; y++)
+   {
+      const uint32_t * c = board_row(old_board, y);
+      uint32_t * out = board_row(new_board, y);
+      for (auto x = startx; x < endx; x++)
+      {
+         const uint32_t * p = c + x;
+         uint32_t neighbours =
+            live<STATES>(p[-1 - stride]) + live<STATES>(p[-stride]) + live<STATES>(p[1 - stride]) +
+            live<STATES>(p[-1])                                      + live<STATES>(p[1]) +
+            live<STATES>(p[-1 + stride]) + live<STATES>(p[stride])  + live<STATES>(p[1 + stride]);
+         out[x] = next_state<BIRTH, SURVIVAL, STATES>(p[0], neighbours);
+      }
+   }
+}
+
+static void update_life_like_table(const rule_t * rule, const board_t * old_board, board_t * new_board, bool,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   int32_t stride = old_board->pitch;
+   uint32_t states = rule->states;
+   for (auto y = starty; y < endy; y++)
+   {
+      const uint32_t * c = board_row(old_board, y);
+      uint32_t * out = board_row(new_board, y);
+      for (auto x = startx; x < endx; x++)
+      {
+         const uint32_t * p = c + x;
+         uint32_t neighbours =
+            (p[-1 - stride] == 1) + (p[-stride] == 1) + (p[1 - stride] == 1) +
+            (p[-1] == 1)                              + (p[1] == 1) +
+            (p[-1 + stride] == 1) + (p[stride] == 1)  + (p[1 + stride] == 1);
+         uint32_t cell = p[0];
+         out[x] = (cell < 2) ? rule->table[cell][neighbours] : ((cell + 1 < states) ? cell + 1 : 0);
+      }
+   }
+}
+
+static thread_local std::vector<int32_t> ltl_columns;
+
+static inline int32_t wrap_coord(int32_t v, int32_t n) { return ((v - 1) % n + n) % n + 1; }
+
+// Adds `sign` times the live cells of row y, columns [x, x + count), to the
+// column sums. Off the board rows and columns are dead unless `wrap`.
+static void add_row(int32_t * columns, const board_t * board, bool wrap, int32_t y, int32_t x, int32_t count, int32_t sign)
+{
+   if (y < 1 || y > board->height) {
+      if (!wrap) {
+         return;
+      }
+      y = wrap_coord(y, board->height);
+   }
+   const uint32_t * row = board_row(board, y);
+   for (auto i = 0; i < count; i++)
+   {
+      int32_t cx = x + i;
+      if (cx < 1 || cx > board->width) {
+         if (!wrap) {
+            continue;
+         }
+         cx = wrap_coord(cx, board->width);
+      }
+      columns[i] += sign * (row[cx] == 1);
+   }
+}
+
+// Box sums kept up to date as the window slides: the column sums move down a
+// row at a time, the row sum right a column at a time, so a cell costs the
+// same whatever the range.
+static void update_larger_than_life(const rule_t * rule, const board_t * old_board, board_t * new_board, bool wrap,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   if (startx >= endx || starty >= endy) {
+      return;
+   }
+   int32_t r = rule->range;
+   int32_t span = endx - startx + 2 * r;
+   ltl_columns.assign(span, 0);
+   int32_t * columns = ltl_columns.data();
+   for (auto dy = -r; dy <= r; dy++)
+   {
+      add_row(columns, old_board, wrap, starty + dy, startx - r, span, 1);
+   }
+
+   for (auto y = starty; y < endy; y++)
+   {
+      if (y > starty) {
+         add_row(columns, old_board, wrap, y + r, startx - r, span, 1);
+         add_row(columns, old_board, wrap, y - r - 1, startx - r, span, -1);
+      }
+      const uint32_t * row = board_row(old_board, y);
+      uint32_t * out = board_row(new_board, y);
+      int32_t count = 0;
+      for (auto i = 0; i < 2 * r; i++)
+      {
+         count += columns[i];
+      }
+      for (auto x = startx; x < endx; x++)
+      {
+         int32_t i = x - startx;
+         count += columns[i + 2 * r];
+         uint32_t cell = row[x];
+         int32_t neighbours = count - (!rule->count_self && cell == 1);
+         if (cell == 0) {
+            out[x] = neighbours >= rule->birth_min && neighbours <= rule->birth_max;
+         } else if (cell == 1) {
+            out[x] = (neighbours >= rule->survival_min && neighbours <= rule->survival_max) ? 1 : ((rule->states > 2) ? 2 : 0);
+         } else {
+            out[x] = (cell + 1 < rule->states) ? cell + 1 : 0;
+         }
+         count -= columns[i];
+      }
+   }
+}
+
+struct rule_specialization_t {
+   uint32_t birth;
+   uint32_t survival;
+   uint32_t states;
+   rule_update_t update;
+};
+
+#define LIFE_LIKE(B, S, C) { counts(B), counts(S), C, update_life_like<counts(B), counts(S), C> }
+
+static const rule_specialization_t specializations[] = {
+   LIFE_LIKE("36", "23", 2),                 // HighLife
+   LIFE_LIKE("3678", "34678", 2),            // Day & Night
+   LIFE_LIKE("2", "", 2),                    // Seeds
+   LIFE_LIKE("3", "012345678", 2),           // Life without Death
+   LIFE_LIKE("1357", "1357", 2),             // Replicator
+   LIFE_LIKE("36", "125", 2),                // 2x2
+   LIFE_LIKE("368", "245", 2),               // Morley
+   LIFE_LIKE("4678", "35678", 2),            // Anneal
+   LIFE_LIKE("2", "", 3),                    // Brian's Brain
+   LIFE_LIKE("2", "345", 4),                 // Star Wars
+};
+
+static const rule_specialization_t * find_specialization(const rule_t * rule)
+{
+   if (rule->range != 1) {
+      return NULL;
+   }
+   for (auto & s : specializations)
+   {
+      if (s.birth == rule->birth && s.survival == rule->survival && s.states == rule->states) {
+         return &s;
+      }
+   }
+   return NULL;
+}
+
+rule_update_t rule_kernel(const rule_t * rule)
+{
+   if (rule_is_conway(rule)) {
+      return NULL;
+   }
+   if (rule->range > 1) {
+      return update_larger_than_life;
+   }
+   const rule_specialization_t * s = find_specialization(rule);
+   return s ? s->update : update_life_like_table;
+}
+
+bool rule_specialized(const rule_t * rule)
+{
+   return rule_is_conway(rule) || find_specialization(rule) != NULL;
+}
+
+static bool parse_digits(const char * p, const char * end, uint32_t * mask)
+{
+   *mask = 0;
+   for (; p < end; p++)
+   {
+      if (*p < '0' || *p > '8') {
+         return false;
+      }
+      *mask |= 1u << (*p - '0');
+   }
+   return true;
+}
+
+static bool parse_number(const char * p, const char * end, int32_t * value)
+{
+   if (p == end || end - p > 6) {
+      return false;
+   }
+   *value = 0;
+   for (; p < end; p++)
+   {
+      if (!isdigit((unsigned char)*p)) {
+         return false;
+      }
+      *value = *value * 10 + (*p - '0');
+   }
+   return true;
+}
+
+// "34..58"
+static bool parse_interval(const char * p, const char * end, int32_t * min, int32_t * max)
+{
+   const char * dots = strstr(p, "..");
+   if (!dots || dots >= end) {
+      return parse_number(p, end, min) && (*max = *min, true);
+   }
+   return parse_number(p, dots, min) && parse_number(dots + 2, end, max) && *min <= *max;
+}
+
+static void format_digits(char * out, uint32_t mask)
+{
+   for (auto n = 0; n <= 8; n++)
+   {
+      if (mask & (1u << n)) {
+         *out++ = (char)('0' + n);
+      }
+   }
+   *out = 0;
+}
+
+// Golly's Larger than Life format: comma separated R, C, M, S, B and N.
+static bool parse_larger_than_life(const char * text, rule_t * rule, const char ** error)
+{
+   bool have_birth = false, have_survival = false;
+   int32_t states = 0, middle = 0;
+   for (const char * p = text; *p; )
+   {
+      const char * end = strchr(p, ',');
+      if (!end) {
+         end = p + strlen(p);
+      }
+      char key = (char)toupper((unsigned char)*p);
+      bool ok = false;
+      switch (key)
+      {
+         case 'R': ok = parse_number(p + 1, end, &rule->range); break;
+         case 'C': ok = parse_number(p + 1, end, &states); break;
+         case 'M': ok = parse_number(p + 1, end, &middle) && middle <= 1; break;
+         case 'S': ok = have_survival = parse_interval(p + 1, end, &rule->survival_min, &rule->survival_max); break;
+         case 'B': ok = have_birth = parse_interval(p + 1, end, &rule->birth_min, &rule->birth_max); break;
+         case 'N': ok = end - p == 2 && toupper((unsigned char)p[1]) == 'M'; break;
+      }
+      if (!ok) {
+         *error = (key == 'N') ? "only the Moore neighbourhood (NM) is supported" : "malformed Larger than Life rule";
+         return false;
+      }
+      p = *end ? end + 1 : end;
+   }
+   if (!have_birth || !have_survival) {
+      *error = "malformed Larger than Life rule";
+      return false;
+   }
+   if (rule->range < 1 || rule->range > RULE_MAX_RANGE) {
+      *error = "Larger than Life range must be 1 to 32";
+      return false;
+   }
+   rule->states = (states < 2) ? 2 : (uint32_t)states;
+   rule->count_self = middle == 1;
+   snprintf(rule->name, sizeof(rule->name), "R%d,C%u,M%d,S%d..%d,B%d..%d,NM", rule->range, (states < 2) ? 0 : rule->states,
+         middle, rule->survival_min, rule->survival_max, rule->birth_min, rule->birth_max);
+
+   if (rule->range == 1) {
+      // Plain outer totalistic, which gets the 3 x 3 kernels
+      for (auto n = 0; n <= 8; n++)
+      {
+         int32_t self = rule->count_self ? 1 : 0;
+         rule->birth |= (n >= rule->birth_min && n <= rule->birth_max) ? 1u << n : 0;
+         rule->survival |= (n + self >= rule->survival_min && n + self <= rule->survival_max) ? 1u << n : 0;
+      }
+   }
+   return true;
+}
+
+// "B3/S23", "B2/S345/C4" or the older "23/3" and "345/2/4" survival first.
+static bool parse_life_like(const char * text, rule_t * rule, const char ** error)
+{
+   const char * parts[3];
+   const char * ends[3];
+   uint32_t count = 0;
+   for (const char * p = text; ; )
+   {
+      const char * end = strchr(p, '/');
+      if (!end) {
+         end = p + strlen(p);
+      }
+      if (count == 3) {
+         *error = "malformed rule";
+         return false;
+      }
+      parts[count] = p;
+      ends[count++] = end;
+      if (!*end) {
+         break;
+      }
+      p = end + 1;
+   }
+
+   bool lettered = false;
+   for (uint32_t i = 0; i < count; i++)
+   {
+      lettered = lettered || (parts[i] < ends[i] && isalpha((unsigned char)*parts[i]));
+   }
+
+   int32_t states = 2;
+   bool ok = true;
+   if (lettered) {
+      bool have_birth = false, have_survival = false;
+      for (uint32_t i = 0; i < count && ok; i++)
+      {
+         const char * p = parts[i];
+         if (p == ends[i]) {
+            ok = false;
+            break;
+         }
+         switch (toupper((unsigned char)*p))
+         {
+            case 'B': ok = parse_digits(p + 1, ends[i], &rule->birth); have_birth = true; break;
+            case 'S': ok = parse_digits(p + 1, ends[i], &rule->survival); have_survival = true; break;
+            case 'C':
+            case 'G': ok = parse_number(p + 1, ends[i], &states); break;
+            default: ok = false;
+         }
+      }
+      ok = ok && have_birth && have_survival;
+   } else {
+      ok = count >= 2 && parse_digits(parts[0], ends[0], &rule->survival) && parse_digits(parts[1], ends[1], &rule->birth) &&
+            (count < 3 || parse_number(parts[2], ends[2], &states));
+   }
+   if (!ok) {
+      *error = "malformed rule";
+      return false;
+   }
+   if (states < 2 || states > (int32_t)RULE_MAX_STATES) {
+      *error = "rules have 2 to 256 states";
+      return false;
+   }
+
+   rule->states = (uint32_t)states;
+   rule->range = 1;
+   char birth[10], survival[10];
+   format_digits(birth, rule->birth);
+   format_digits(survival, rule->survival);
+   if (rule->states > 2) {
+      snprintf(rule->name, sizeof(rule->name), "B%s/S%s/C%u", birth, survival, rule->states);
+   } else {
+      snprintf(rule->name, sizeof(rule->name), "B%s/S%s", birth, survival);
+   }
+   return true;
+}
+
+bool rule_parse(const char * text, rule_t * rule, const char ** error)
+{
+   char buffer[256];
+   size_t length = 0;
+   for (const char * p = text; *p && *p != ':'; p++)
+   {
+      if (!isspace((unsigned char)*p)) {
+         if (length == sizeof(buffer) - 1) {
+            *error = "malformed rule";
+            return false;
+         }
+         buffer[length++] = *p;
+      }
+   }
+   buffer[length] = 0;
+
+   memset(rule, 0, sizeof(*rule));
+   bool larger_than_life = length > 1 && toupper((unsigned char)buffer[0]) == 'R' && isdigit((unsigned char)buffer[1]);
+   if (larger_than_life ? !parse_larger_than_life(buffer, rule, error) : !parse_life_like(buffer, rule, error)) {
+      return false;
+   }
+
+   if ((rule->range == 1) ? (rule->birth & 1) : rule->birth_min <= 0) {
+      *error = "B0 rules are not supported";
+      return false;
+   }
+   for (auto n = 0; n <= 8; n++)
+   {
+      rule->table[0][n] = (rule->birth >> n) & 1;
+      rule->table[1][n] = ((rule->survival >> n) & 1) ? 1 : ((rule->states > 2) ? 2 : 0);
+   }
+   return true;
+}
@@ -0,0 +1,61 @@
+#ifndef _RULE_H
+#define _RULE_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "board.h"
+
+// Cellular automaton rules for the flat board. Three families, all with
+// state 0 dead and state 1 alive:
+//
+//    B3/S23, 23/3          outer totalistic over the 8 neighbours
+//    B2/S345/C4, 345/2/4   Generations: a live cell that does not survive
+//                          ages through states 2 .. C - 1 and then dies
+//    R5,C0,M1,S34..58,B34..45,NM
+//                          Larger than Life: counts over a (2R + 1)^2
+//                          square, M1 counting the cell itself
+//
+// Only state 1 cells count as neighbours. B3/S23 is left to the SIMD
+// kernels; well-known rules have kernels instantiated for their masks and
+// everything else goes through the table-driven kernel.
+
+const uint32_t RULE_MAX_STATES = 256;
+const int32_t RULE_MAX_RANGE = 32;     // below CHUNK_SIZE, so a chunk only sees its 3 x 3 neighbours
+
+struct rule_t {
+   uint32_t birth;               // range 1: bit n set if a dead cell with n live neighbours is born
+   uint32_t survival;
+   uint32_t states;              // 2, or more for Generations
+   int32_t range;                // neighbourhood radius, above 1 for Larger than Life
+   bool count_self;              // Larger than Life M1
+   int32_t birth_min;            // Larger than Life count ranges, inclusive
+   int32_t birth_max;
+   int32_t survival_min;
+   int32_t survival_max;
+   uint8_t table[2][9];          // range 1: next state of a dead and of a live cell by live neighbours
+   char name[64];                // canonical rulestring
+};
+
+// Parses a rulestring; a trailing Golly ":T..." grid suffix is ignored, the
+// topology comes from the game config. B0 rules are rejected: they would
+// light up the empty chunks that the chunk scheduler skips.
+bool rule_parse(const char * text, rule_t * rule, const char ** error);
+
+static inline bool rule_is_conway(const rule_t * rule)
+{
+   return rule->range == 1 && rule->states == 2 && rule->birth == (1u << 3) && rule->survival == ((1u << 2) | (1u << 3));
+}
+
+// Same contract as update_kernel_t, on whole boards so Larger than Life can
+// reach past the one cell halo; `wrap` joins the opposite edges.
+typedef void (*rule_update_t)(const rule_t * rule, const board_t * old_board, board_t * new_board, bool wrap,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy);
+
+// Kernel for `rule`: a precompiled specialization when there is one, the
+// table-driven kernel otherwise. NULL for B3/S23.
+rule_update_t rule_kernel(const rule_t * rule);
+
+bool rule_specialized(const rule_t * rule);
+
+#endif // _RULE_H
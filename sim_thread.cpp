@@ -0,0 +1,137 @@
+#include "sim_thread.h"
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Past this much behind schedule the target rate stops trying to catch up.
+const double SIM_THREAD_MAX_LAG_SEC = 0.25;
+
+static struct {
+   std::thread thread;
+   std::atomic<bool> stop;
+   std::atomic<bool> running;
+   frame_mailbox_t * mailbox;
+   sim_thread_config_t config;
+
+   std::atomic<uint64_t> generation;
+   std::atomic<uint64_t> generations;
+   std::atomic<uint64_t> frames;
+   std::chrono::steady_clock::time_point stats_start;
+} sim;
+
+// One update, rendered when the presenter is ready for a frame. Returns the
+// generations it advanced, 0 when there is nothing left to run.
+static uint64_t sim_thread_step()
+{
+   bool render = frame_mailbox_wanted(sim.mailbox);
+   render_target_t target;
+   if (render) {
+      target = frame_mailbox_begin(sim.mailbox, sim.config.pixels_per_cell);
+   }
+   if (sim.config.replay) {
+      if (!game_replay_next(render ? &target : NULL)) {
+         if (!sim.config.loop || !game_replay_seek(0)) {
+            return 0;
+         }
+         // Nothing was drawn into the frame, the next render draws it all
+         render = false;
+      }
+   } else {
+      game_update_and_render(render ? &target : NULL);
+   }
+
+   // Temporal blocking advances several generations per update, a replay
+   // starting over goes back
+   game_stats_t stats;
+   game_get_stats(&stats);
+   uint64_t previous = sim.generation.exchange(stats.generation, std::memory_order_relaxed);
+   uint64_t advanced = (stats.generation > previous) ? stats.generation - previous : 1;
+   sim.generations.fetch_add(advanced, std::memory_order_relaxed);
+   if (render) {
+      frame_mailbox_publish(sim.mailbox, &stats);
+      sim.frames.fetch_add(1, std::memory_order_relaxed);
+   }
+   if (sim.config.stop_on_cycle && stats.period) {
+      sim.stop.store(true, std::memory_order_relaxed);
+   }
+   return advanced;
+}
+
+static void sim_thread_run()
+{
+   trace_thread_name("simulation");
+   typedef std::chrono::steady_clock clock;
+   double rate = sim.config.generations_per_sec;
+   clock::duration period = (rate > 0) ?
+      std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / rate)) : clock::duration::zero();
+   clock::duration max_lag = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(SIM_THREAD_MAX_LAG_SEC));
+   clock::time_point next = clock::now();
+
+   for (uint64_t done = 0; !sim.stop.load(std::memory_order_relaxed); )
+   {
+      if (sim.config.generations && done >= sim.config.generations) {
+         break;
+      }
+      if (rate > 0) {
+         auto now = clock::now();
+         if (now < next) {
+            std::this_thread::sleep_until(next);
+         } else if (now - next > max_lag) {
+            next = now;
+         }
+         next += period;
+      }
+      uint64_t advanced = sim_thread_step();
+      if (!advanced) {
+         break;
+      }
+      done += advanced;
+   }
+   trace_thread_exit();
+   sim.running.store(false, std::memory_order_release);
+}
+
+void sim_thread_start(frame_mailbox_t * mailbox, const sim_thread_config_t * config)
+{
+   game_stats_t stats;
+   game_get_stats(&stats);
+   sim.mailbox = mailbox;
+   sim.config = *config;
+   sim.stop.store(false);
+   sim.running.store(true);
+   sim.generation.store(stats.generation);
+   sim.generations.store(0);
+   sim.frames.store(0);
+   sim.stats_start = std::chrono::steady_clock::now();
+   sim.thread = std::thread(sim_thread_run);
+}
+
+void sim_thread_stop()
+{
+   sim.stop.store(true);
+   if (sim.thread.joinable()) {
+      sim.thread.join();
+   }
+}
+
+bool sim_thread_running()
+{
+   return sim.running.load(std::memory_order_acquire);
+}
+
+void sim_thread_get_stats(sim_thread_stats_t * stats, bool reset)
+{
+   auto now = std::chrono::steady_clock::now();
+   stats->generation = sim.generation.load(std::memory_order_relaxed);
+   stats->elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - sim.stats_start).count();
+   if (reset) {
+      stats->generations = sim.generations.exchange(0, std::memory_order_relaxed);
+      stats->frames = sim.frames.exchange(0, std::memory_order_relaxed);
+      sim.stats_start = now;
+   } else {
+      stats->generations = sim.generations.load(std::memory_order_relaxed);
+      stats->frames = sim.frames.load(std::memory_order_relaxed);
+   }
+}
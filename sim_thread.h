@@ -0,0 +1,56 @@
+#ifndef _SIM_THREAD_H
+#define _SIM_THREAD_H
+
+#include <cstdint>
+
+#include "frame_mailbox.h"
+
+// Runs the game on its own thread, as fast as it can or at a target rate,
+// so the presenter's frame rate no longer caps the simulation. A frame is
+// rendered into the mailbox only when the presenter has taken the previous
+// one; the generations in between run without a render target.
+//
+// The game is not thread safe: between sim_thread_start and sim_thread_stop
+// only the simulation thread may call into it. It becomes the thread that
+// waits on the job queue.
+
+struct sim_thread_config_t {
+   double generations_per_sec;   // 0 = as fast as possible
+   uint64_t generations;         // stop after this many, 0 = run until sim_thread_stop
+   int32_t pixels_per_cell;
+   bool replay;                  // play the open recording instead of simulating
+   bool loop;                    // replay: start over at the end instead of stopping
+   bool stop_on_cycle;           // stop once the board repeats, see game_stats_t::period
+};
+
+struct sim_thread_stats_t {
+   uint64_t generation;
+   uint64_t generations;         // since the last reset
+   uint64_t frames;              // rendered into the mailbox since the last reset
+   uint64_t elapsed_us;          // since the last reset
+};
+
+static inline sim_thread_config_t sim_thread_default_config()
+{
+   sim_thread_config_t config;
+   config.generations_per_sec = 0;
+   config.generations = 0;
+   config.pixels_per_cell = 1;
+   config.replay = false;
+   config.loop = true;
+   config.stop_on_cycle = false;
+   return config;
+}
+
+void sim_thread_start(frame_mailbox_t * mailbox, const sim_thread_config_t * config);
+
+// Asks the thread to stop after the generation in progress and joins it.
+void sim_thread_stop();
+
+// False once the thread stopped on its own: the generation count was
+// reached, the recording ended or the board repeated.
+bool sim_thread_running();
+
+void sim_thread_get_stats(sim_thread_stats_t * stats, bool reset);
+
+#endif // _SIM_THREAD_H
@@ -0,0 +1,539 @@
+#include "simd_kernels.h"
+#include "packed_board.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+// MSVC lets any function use any intrinsic; GCC and Clang need the ISA
+// enabled per function so the rest of the binary stays baseline x86-64.
+#if defined(_MSC_VER)
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// A cell is alive next generation iff (live neighbours | alive) == 3.
+static inline uint32_t life_cell(const uint32_t * c, int32_t stride)
+{
+   uint32_t live_neighbours =
+      c[-1 - stride] + c[-stride] + c[1 - stride] +
+      c[-1]                       + c[1] +
+      c[-1 + stride] + c[stride]  + c[1 + stride];
+   return (live_neighbours | c[0]) == 3;
+}
+
+static void update_row_scalar(const uint32_t * old_row, uint32_t * new_row, int32_t stride, int32_t startx, int32_t endx)
+{
+   for (auto x = startx; x < endx; x++)
+   {
+      new_row[x] = life_cell(old_row + x, stride);
+   }
+}
+
+static void update_board_scalar(const uint32_t * old_board, uint32_t * new_board, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   for (auto y = starty; y < endy; y++)
+   {
+      update_row_scalar(old_board + y * stride, new_board + y * stride, stride, startx, endx);
+   }
+}
+
+// Packed kernels vectorize the words that lie fully inside [startx, endx)
+// and have both neighbouring words in the row; the rest go through the
+// scalar word step with a mask.
+static inline void packed_word_scalar(const uint64_t * up, const uint64_t * mid, const uint64_t * down, uint64_t * out,
+      int32_t w, int32_t words_per_row, int32_t startx, int32_t endx)
+{
+   uint64_t next = packed_step_word(up, mid, down, w, words_per_row);
+   uint64_t mask = packed_range_mask(w, startx, endx);
+   out[w] = (next & mask) | (out[w] & ~mask);
+}
+
+static inline void expand_scalar(const uint64_t * row, uint32_t * pixels, int32_t startx, int32_t endx,
+      uint32_t dead, uint32_t alive)
+{
+   for (auto x = startx; x < endx; x++)
+   {
+      pixels[x - startx] = ((row[x / 64] >> (x % 64)) & 1) ? alive : dead;
+   }
+}
+
+static void expand_packed_scalar(const uint64_t * row, uint32_t * pixels, int32_t startx, int32_t endx,
+      uint32_t dead, uint32_t alive)
+{
+   expand_scalar(row, pixels, startx, endx, dead, alive);
+}
+
+static uint64_t pack_scalar(const uint32_t * cells, int32_t count)
+{
+   uint64_t bits = 0;
+   for (auto x = 0; x < count; x++)
+   {
+      bits |= (uint64_t)(cells[x] == 1) << x;
+   }
+   return bits;
+}
+
+// Rows from `first` on. Without popcnt in the baseline ISA the bits are
+// counted SWAR style.
+static void summarize_scalar(const uint64_t * rows, const uint32_t * keys, int32_t first, int32_t count, row_summary_t * summary)
+{
+   for (auto r = first; r < count; r++)
+   {
+      uint64_t x = rows[r];
+      summary->hash += (uint64_t)((uint32_t)x + keys[2 * r]) * (uint32_t)((uint32_t)(x >> 32) + keys[2 * r + 1]);
+      summary->columns |= x;
+      summary->occupied |= (uint64_t)(x != 0) << r;
+      x = x - ((x >> 1) & 0x5555555555555555ull);
+      x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+      x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+      summary->population += (uint32_t)((x * 0x0101010101010101ull) >> 56);
+   }
+}
+
+static void summarize_rows_scalar(const uint64_t * rows, const uint32_t * keys, int32_t count, row_summary_t * summary)
+{
+   summary->population = 0;
+   summary->hash = 0;
+   summary->columns = 0;
+   summary->occupied = 0;
+   summarize_scalar(rows, keys, 0, count, summary);
+}
+
+// Boards [first, last) of an ensemble whose rows are `stride` words apart.
+static void ensemble_boards_scalar(const uint64_t * old_rows, uint64_t * new_rows, const uint64_t * reference,
+      uint64_t * differs, int32_t stride, int32_t first, int32_t last, int32_t rows)
+{
+   for (auto b = first; b < last; b++)
+   {
+      uint64_t up = 0, mid = old_rows[b], diff = 0;
+      for (auto r = 0; r < rows; r++)
+      {
+         uint64_t down = (r + 1 < rows) ? old_rows[(r + 1) * stride + b] : 0;
+         uint64_t next = packed_life_word(up << 1, up, up >> 1, mid << 1, mid, mid >> 1, down << 1, down, down >> 1);
+         new_rows[r * stride + b] = next;
+         diff |= next ^ reference[r * stride + b];
+         up = mid;
+         mid = down;
+      }
+      differs[b] = diff;
+   }
+}
+
+static void update_ensemble_scalar(const uint64_t * old_rows, uint64_t * new_rows, const uint64_t * reference,
+      uint64_t * differs, int32_t boards, int32_t rows)
+{
+   ensemble_boards_scalar(old_rows, new_rows, reference, differs, boards, 0, boards, rows);
+}
+
+// Vector packing compares LANES cells at a time and leaves the tail to the
+// scalar loop.
+#define PACK_KERNEL_BODY(LANES, GROUP) \
+   uint64_t bits = 0; \
+   auto x = 0; \
+   for (; x + LANES <= count; x += LANES) \
+   { \
+      bits |= (uint64_t)(GROUP) << x; \
+   } \
+   if (x < count) \
+   { \
+      bits |= pack_scalar(cells + x, count - x) << x; \
+   } \
+   return bits;
+
+// Vector expansion takes LANES cells at a time from LANES-aligned bit
+// positions, so a group never straddles two words.
+#define EXPAND_KERNEL_BODY(LANES, GROUP) \
+   auto x = startx; \
+   auto head = std::min(endx, (startx + LANES - 1) / LANES * LANES); \
+   expand_scalar(row, pixels, x, head, dead, alive); \
+   for (x = head; x + LANES <= endx; x += LANES) \
+   { \
+      uint32_t bits = (uint32_t)(row[x / 64] >> (x % 64)); \
+      GROUP; \
+   } \
+   expand_scalar(row, pixels + (x - startx), x, endx, dead, alive);
+
+#define SIMD_ADD3(AND, OR, XOR, a, b, c, sum, carry) \
+   { auto t_ = XOR(a, b); sum = XOR(t_, c); carry = OR(AND(a, b), AND(t_, c)); }
+
+// Same adder network as packed_life_word, over vectors of words.
+#define SIMD_LIFE(AND, OR, XOR, ANDNOT, nw, n, ne, w, c, e, sw, s, se, out) \
+   { \
+      auto s0_ = nw, c0_ = nw, s1_ = nw, c1_ = nw, ones_ = nw, c3_ = nw, t0_ = nw, f0_ = nw; \
+      SIMD_ADD3(AND, OR, XOR, nw, n, ne, s0_, c0_); \
+      SIMD_ADD3(AND, OR, XOR, w, e, sw, s1_, c1_); \
+      auto s2_ = XOR(s, se); \
+      auto c2_ = AND(s, se); \
+      SIMD_ADD3(AND, OR, XOR, s0_, s1_, s2_, ones_, c3_); \
+      SIMD_ADD3(AND, OR, XOR, c0_, c1_, c2_, t0_, f0_); \
+      auto twos_ = XOR(t0_, c3_); \
+      auto fours_ = OR(f0_, AND(t0_, c3_)); \
+      out = AND(ANDNOT(fours_, twos_), OR(ones_, c)); \
+   }
+
+#define PACKED_KERNEL_BODY(LANES, VEC, LOADU, STOREU, SLLI, SRLI, AND, OR, XOR, ANDNOT) \
+   if (startx >= endx) { \
+      return; \
+   } \
+   int32_t start_word = startx / 64; \
+   int32_t end_word = (endx + 63) / 64; \
+   int32_t vec_start = (startx + 63) / 64; \
+   int32_t vec_end = endx / 64; \
+   if (vec_start < 1) vec_start = 1; \
+   if (vec_end > words_per_row - 1) vec_end = words_per_row - 1; \
+   for (auto y = starty; y < endy; y++) \
+   { \
+      const uint64_t * up = old_board + (y - 1) * words_per_row; \
+      const uint64_t * mid = up + words_per_row; \
+      const uint64_t * down = mid + words_per_row; \
+      uint64_t * out = new_board + y * words_per_row; \
+      auto w = start_word; \
+      for (; w < end_word && w < vec_start; w++) { \
+         packed_word_scalar(up, mid, down, out, w, words_per_row, startx, endx); \
+      } \
+      for (; w + LANES <= vec_end; w += LANES) { \
+         VEC u = LOADU(up + w), m = LOADU(mid + w), d = LOADU(down + w); \
+         VEC nw = OR(SLLI(u, 1), SRLI(LOADU(up + w - 1), 63)); \
+         VEC ne = OR(SRLI(u, 1), SLLI(LOADU(up + w + 1), 63)); \
+         VEC we = OR(SLLI(m, 1), SRLI(LOADU(mid + w - 1), 63)); \
+         VEC ea = OR(SRLI(m, 1), SLLI(LOADU(mid + w + 1), 63)); \
+         VEC sw = OR(SLLI(d, 1), SRLI(LOADU(down + w - 1), 63)); \
+         VEC se = OR(SRLI(d, 1), SLLI(LOADU(down + w + 1), 63)); \
+         VEC next; \
+         SIMD_LIFE(AND, OR, XOR, ANDNOT, nw, u, ne, we, m, ea, sw, d, se, next); \
+         STOREU(out + w, next); \
+      } \
+      for (; w < end_word; w++) { \
+         packed_word_scalar(up, mid, down, out, w, words_per_row, startx, endx); \
+      } \
+   }
+
+// LANES boards at a time, walking down their rows with the three rows around
+// the current one in registers; leftover boards go through the scalar loop.
+#define ENSEMBLE_KERNEL_BODY(LANES, VEC, LOADU, STOREU, SLLI, SRLI, AND, OR, XOR, ANDNOT, ZERO) \
+   auto b = 0; \
+   for (; b + LANES <= boards; b += LANES) \
+   { \
+      VEC up = ZERO, mid = LOADU(old_rows + b), diff = ZERO; \
+      for (auto r = 0; r < rows; r++) \
+      { \
+         VEC down = (r + 1 < rows) ? LOADU(old_rows + (r + 1) * boards + b) : ZERO; \
+         VEC next; \
+         SIMD_LIFE(AND, OR, XOR, ANDNOT, SLLI(up, 1), up, SRLI(up, 1), SLLI(mid, 1), mid, SRLI(mid, 1), \
+               SLLI(down, 1), down, SRLI(down, 1), next); \
+         STOREU(new_rows + r * boards + b, next); \
+         diff = OR(diff, XOR(next, LOADU(reference + r * boards + b))); \
+         up = mid; \
+         mid = down; \
+      } \
+      STOREU(differs + b, diff); \
+   } \
+   ensemble_boards_scalar(old_rows, new_rows, reference, differs, boards, b, boards, rows);
+
+#if SIMD_X86
+
+#define SSE_LOADU(p) _mm_loadu_si128((const __m128i *)(p))
+#define SSE_STOREU(p, v) _mm_storeu_si128((__m128i *)(p), v)
+
+SIMD_TARGET("sse2")
+static void update_board_sse2(const uint32_t * old_board, uint32_t * new_board, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   const __m128i three = _mm_set1_epi32(3);
+   const __m128i one = _mm_set1_epi32(1);
+   for (auto y = starty; y < endy; y++)
+   {
+      const uint32_t * c = old_board + y * stride;
+      uint32_t * out = new_board + y * stride;
+      auto x = startx;
+      for (; x + 4 <= endx; x += 4)
+      {
+         __m128i n = _mm_add_epi32(
+               _mm_add_epi32(_mm_add_epi32(SSE_LOADU(c + x - 1 - stride), SSE_LOADU(c + x - stride)),
+                             _mm_add_epi32(SSE_LOADU(c + x + 1 - stride), SSE_LOADU(c + x - 1))),
+               _mm_add_epi32(_mm_add_epi32(SSE_LOADU(c + x + 1), SSE_LOADU(c + x - 1 + stride)),
+                             _mm_add_epi32(SSE_LOADU(c + x + stride), SSE_LOADU(c + x + 1 + stride))));
+         __m128i alive = _mm_cmpeq_epi32(_mm_or_si128(n, SSE_LOADU(c + x)), three);
+         SSE_STOREU(out + x, _mm_and_si128(alive, one));
+      }
+      update_row_scalar(c, out, stride, x, endx);
+   }
+}
+
+SIMD_TARGET("sse2")
+static void packed_update_board_sse2(const uint64_t * old_board, uint64_t * new_board, int32_t words_per_row,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   PACKED_KERNEL_BODY(2, __m128i, SSE_LOADU, SSE_STOREU, _mm_slli_epi64, _mm_srli_epi64,
+         _mm_and_si128, _mm_or_si128, _mm_xor_si128, _mm_andnot_si128)
+}
+
+SIMD_TARGET("sse2")
+static void update_ensemble_sse2(const uint64_t * old_rows, uint64_t * new_rows, const uint64_t * reference,
+      uint64_t * differs, int32_t boards, int32_t rows)
+{
+   ENSEMBLE_KERNEL_BODY(2, __m128i, SSE_LOADU, SSE_STOREU, _mm_slli_epi64, _mm_srli_epi64,
+         _mm_and_si128, _mm_or_si128, _mm_xor_si128, _mm_andnot_si128, _mm_setzero_si128())
+}
+
+SIMD_TARGET("sse2")
+static void expand_packed_sse2(const uint64_t * row, uint32_t * pixels, int32_t startx, int32_t endx,
+      uint32_t dead, uint32_t alive)
+{
+   const __m128i lanes = _mm_set_epi32(8, 4, 2, 1);
+   const __m128i dead_v = _mm_set1_epi32((int)dead);
+   const __m128i alive_v = _mm_set1_epi32((int)alive);
+   EXPAND_KERNEL_BODY(4, {
+      __m128i set = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)bits), lanes), lanes);
+      SSE_STOREU(pixels + (x - startx), _mm_or_si128(_mm_and_si128(set, alive_v), _mm_andnot_si128(set, dead_v)));
+   })
+}
+
+SIMD_TARGET("sse2")
+static uint64_t pack_sse2(const uint32_t * cells, int32_t count)
+{
+   const __m128i one = _mm_set1_epi32(1);
+   PACK_KERNEL_BODY(4, _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(SSE_LOADU(cells + x), one))))
+}
+
+#define AVX2_LOADU(p) _mm256_loadu_si256((const __m256i *)(p))
+#define AVX2_STOREU(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+
+SIMD_TARGET("avx2")
+static void update_board_avx2(const uint32_t * old_board, uint32_t * new_board, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   const __m256i three = _mm256_set1_epi32(3);
+   const __m256i one = _mm256_set1_epi32(1);
+   for (auto y = starty; y < endy; y++)
+   {
+      const uint32_t * c = old_board + y * stride;
+      uint32_t * out = new_board + y * stride;
+      auto x = startx;
+      for (; x + 8 <= endx; x += 8)
+      {
+         __m256i n = _mm256_add_epi32(
+               _mm256_add_epi32(_mm256_add_epi32(AVX2_LOADU(c + x - 1 - stride), AVX2_LOADU(c + x - stride)),
+                                _mm256_add_epi32(AVX2_LOADU(c + x + 1 - stride), AVX2_LOADU(c + x - 1))),
+               _mm256_add_epi32(_mm256_add_epi32(AVX2_LOADU(c + x + 1), AVX2_LOADU(c + x - 1 + stride)),
+                                _mm256_add_epi32(AVX2_LOADU(c + x + stride), AVX2_LOADU(c + x + 1 + stride))));
+         __m256i alive = _mm256_cmpeq_epi32(_mm256_or_si256(n, AVX2_LOADU(c + x)), three);
+         AVX2_STOREU(out + x, _mm256_and_si256(alive, one));
+      }
+      update_row_scalar(c, out, stride, x, endx);
+   }
+}
+
+SIMD_TARGET("avx2")
+static void packed_update_board_avx2(const uint64_t * old_board, uint64_t * new_board, int32_t words_per_row,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   PACKED_KERNEL_BODY(4, __m256i, AVX2_LOADU, AVX2_STOREU, _mm256_slli_epi64, _mm256_srli_epi64,
+         _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, _mm256_andnot_si256)
+}
+
+SIMD_TARGET("avx2")
+static void update_ensemble_avx2(const uint64_t * old_rows, uint64_t * new_rows, const uint64_t * reference,
+      uint64_t * differs, int32_t boards, int32_t rows)
+{
+   ENSEMBLE_KERNEL_BODY(4, __m256i, AVX2_LOADU, AVX2_STOREU, _mm256_slli_epi64, _mm256_srli_epi64,
+         _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256, _mm256_andnot_si256, _mm256_setzero_si256())
+}
+
+SIMD_TARGET("avx2")
+static void expand_packed_avx2(const uint64_t * row, uint32_t * pixels, int32_t startx, int32_t endx,
+      uint32_t dead, uint32_t alive)
+{
+   const __m256i lanes = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+   const __m256i dead_v = _mm256_set1_epi32((int)dead);
+   const __m256i alive_v = _mm256_set1_epi32((int)alive);
+   EXPAND_KERNEL_BODY(8, {
+      __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)bits), lanes), lanes);
+      AVX2_STOREU(pixels + (x - startx), _mm256_blendv_epi8(dead_v, alive_v, set));
+   })
+}
+
+SIMD_TARGET("avx2")
+static uint64_t pack_avx2(const uint32_t * cells, int32_t count)
+{
+   const __m256i one = _mm256_set1_epi32(1);
+   PACK_KERNEL_BODY(8, (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(AVX2_LOADU(cells + x), one))))
+}
+
+// Four rows at a time: the counts come from nibbles looked up in a 16-entry
+// table and summed per row by _mm256_sad_epu8, the hash from
+// _mm256_mul_epu32 of the two keyed halves.
+SIMD_TARGET("avx2")
+static void summarize_rows_avx2(const uint64_t * rows, const uint32_t * keys, int32_t count, row_summary_t * summary)
+{
+   const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+   const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+   const __m256i zero = _mm256_setzero_si256();
+   __m256i counts = zero, hashes = zero, columns = zero;
+   uint64_t occupied = 0;
+   auto r = 0;
+   for (; r + 4 <= count; r += 4)
+   {
+      __m256i v = AVX2_LOADU(rows + r);
+      __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(v, low_nibbles)),
+            _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles)));
+      counts = _mm256_add_epi64(counts, _mm256_sad_epu8(bytes, zero));
+      __m256i keyed = _mm256_add_epi32(v, AVX2_LOADU(keys + 2 * r));
+      hashes = _mm256_add_epi64(hashes, _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32)));
+      columns = _mm256_or_si256(columns, v);
+      uint32_t empty = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, zero)));
+      occupied |= (uint64_t)(~empty & 0xf) << r;
+   }
+   uint64_t lanes[3][4];
+   AVX2_STOREU(lanes[0], counts);
+   AVX2_STOREU(lanes[1], hashes);
+   AVX2_STOREU(lanes[2], columns);
+   summary->population = (uint32_t)(lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3]);
+   summary->hash = lanes[1][0] + lanes[1][1] + lanes[1][2] + lanes[1][3];
+   summary->columns = lanes[2][0] | lanes[2][1] | lanes[2][2] | lanes[2][3];
+   summary->occupied = occupied;
+   summarize_scalar(rows, keys, r, count, summary);
+}
+
+// GCC 12's AVX-512 headers trip -Wmaybe-uninitialized on _mm512_undefined_epi32,
+// so the warning is off for the AVX-512 kernels only
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#define AVX512_LOADU(p) _mm512_loadu_si512((const void *)(p))
+#define AVX512_STOREU(p, v) _mm512_storeu_si512((void *)(p), v)
+
+SIMD_TARGET("avx512f")
+static void update_board_avx512(const uint32_t * old_board, uint32_t * new_board, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   const __m512i three = _mm512_set1_epi32(3);
+   const __m512i one = _mm512_set1_epi32(1);
+   for (auto y = starty; y < endy; y++)
+   {
+      const uint32_t * c = old_board + y * stride;
+      uint32_t * out = new_board + y * stride;
+      auto x = startx;
+      for (; x + 16 <= endx; x += 16)
+      {
+         __m512i n = _mm512_add_epi32(
+               _mm512_add_epi32(_mm512_add_epi32(AVX512_LOADU(c + x - 1 - stride), AVX512_LOADU(c + x - stride)),
+                                _mm512_add_epi32(AVX512_LOADU(c + x + 1 - stride), AVX512_LOADU(c + x - 1))),
+               _mm512_add_epi32(_mm512_add_epi32(AVX512_LOADU(c + x + 1), AVX512_LOADU(c + x - 1 + stride)),
+                                _mm512_add_epi32(AVX512_LOADU(c + x + stride), AVX512_LOADU(c + x + 1 + stride))));
+         __mmask16 alive = _mm512_cmpeq_epi32_mask(_mm512_or_si512(n, AVX512_LOADU(c + x)), three);
+         AVX512_STOREU(out + x, _mm512_maskz_mov_epi32(alive, one));
+      }
+      update_row_scalar(c, out, stride, x, endx);
+   }
+}
+
+SIMD_TARGET("avx512f")
+static void packed_update_board_avx512(const uint64_t * old_board, uint64_t * new_board, int32_t words_per_row,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy)
+{
+   PACKED_KERNEL_BODY(8, __m512i, AVX512_LOADU, AVX512_STOREU, _mm512_slli_epi64, _mm512_srli_epi64,
+         _mm512_and_si512, _mm512_or_si512, _mm512_xor_si512, _mm512_andnot_si512)
+}
+
+SIMD_TARGET("avx512f")
+static void update_ensemble_avx512(const uint64_t * old_rows, uint64_t * new_rows, const uint64_t * reference,
+      uint64_t * differs, int32_t boards, int32_t rows)
+{
+   ENSEMBLE_KERNEL_BODY(8, __m512i, AVX512_LOADU, AVX512_STOREU, _mm512_slli_epi64, _mm512_srli_epi64,
+         _mm512_and_si512, _mm512_or_si512, _mm512_xor_si512, _mm512_andnot_si512, _mm512_setzero_si512())
+}
+
+SIMD_TARGET("avx512f")
+static void expand_packed_avx512(const uint64_t * row, uint32_t * pixels, int32_t startx, int32_t endx,
+      uint32_t dead, uint32_t alive)
+{
+   const __m512i dead_v = _mm512_set1_epi32((int)dead);
+   const __m512i alive_v = _mm512_set1_epi32((int)alive);
+   EXPAND_KERNEL_BODY(16, {
+      AVX512_STOREU(pixels + (x - startx), _mm512_mask_blend_epi32((__mmask16)bits, dead_v, alive_v));
+   })
+}
+
+SIMD_TARGET("avx512f")
+static uint64_t pack_avx512(const uint32_t * cells, int32_t count)
+{
+   const __m512i one = _mm512_set1_epi32(1);
+   PACK_KERNEL_BODY(16, _mm512_cmpeq_epi32_mask(AVX512_LOADU(cells + x), one))
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // SIMD_X86
+
+static const update_kernels_t kernels[SIMD_LEVEL_COUNT] = {
+   { SIMD_SCALAR, "scalar", update_board_scalar, packed_update_board, expand_packed_scalar, pack_scalar, summarize_rows_scalar,
+         update_ensemble_scalar },
+#if SIMD_X86
+   { SIMD_SSE2, "sse2", update_board_sse2, packed_update_board_sse2, expand_packed_sse2, pack_sse2, summarize_rows_scalar,
+         update_ensemble_sse2 },
+   { SIMD_AVX2, "avx2", update_board_avx2, packed_update_board_avx2, expand_packed_avx2, pack_avx2, summarize_rows_avx2,
+         update_ensemble_avx2 },
+   // summarizing stays on AVX2, which simd_detect requires for this level too
+   { SIMD_AVX512, "avx512", update_board_avx512, packed_update_board_avx512, expand_packed_avx512, pack_avx512, summarize_rows_avx2,
+         update_ensemble_avx512 },
+#endif
+};
+
+simd_level_t simd_detect()
+{
+#if SIMD_X86 && defined(_MSC_VER)
+   int regs[4];
+   __cpuid(regs, 0);
+   int max_leaf = regs[0];
+   __cpuid(regs, 1);
+   bool sse2 = (regs[3] >> 26) & 1;
+   bool osxsave = (regs[2] >> 27) & 1;
+   uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+   bool avx_state = (xcr0 & 0x6) == 0x6;
+   bool avx512_state = (xcr0 & 0xe6) == 0xe6;
+   bool avx2 = false, avx512 = false;
+   if (max_leaf >= 7) {
+      __cpuidex(regs, 7, 0);
+      avx2 = avx_state && ((regs[1] >> 5) & 1);
+      avx512 = avx2 && avx512_state && ((regs[1] >> 16) & 1);
+   }
+   if (avx512) return SIMD_AVX512;
+   if (avx2) return SIMD_AVX2;
+   if (sse2) return SIMD_SSE2;
+   return SIMD_SCALAR;
+#elif SIMD_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2")) return SIMD_AVX512;
+   if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+   if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+   return SIMD_SCALAR;
+#else
+   return SIMD_SCALAR;
+#endif
+}
+
+const update_kernels_t * update_kernels_get(simd_level_t level)
+{
+   simd_level_t supported = simd_detect();
+   if (level > supported) {
+      level = supported;
+   }
+   return &kernels[level];
+}
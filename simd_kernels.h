@@ -0,0 +1,66 @@
+#ifndef _SIMD_KERNELS_H
+#define _SIMD_KERNELS_H
+
+#include <cstdint>
+
+// Cells in [startx, endx) x [starty, endy) of new_board are written from the
+// neighbourhoods in old_board. `stride` is the flat board row stride in cells,
+// `words_per_row` the packed board row stride in words.
+typedef void (*update_kernel_t)(const uint32_t * old_board, uint32_t * new_board, int32_t stride,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy);
+typedef void (*packed_update_kernel_t)(const uint64_t * old_board, uint64_t * new_board, int32_t words_per_row,
+      int32_t startx, int32_t starty, int32_t endx, int32_t endy);
+
+// Pixels [0, endx - startx) get `alive` or `dead` from the bits [startx, endx)
+// of a packed row, one pixel per cell.
+typedef void (*expand_kernel_t)(const uint64_t * row, uint32_t * pixels, int32_t startx, int32_t endx,
+      uint32_t dead, uint32_t alive);
+
+// Bit i of the result is set if cells[i] is alive (exactly 1), count <= 64.
+typedef uint64_t (*pack_kernel_t)(const uint32_t * cells, int32_t count);
+
+struct row_summary_t {
+   uint32_t population;          // set bits
+   uint64_t hash;                // sum over the rows of (low half + keys[2r]) * (high half + keys[2r + 1])
+   uint64_t columns;             // OR of the rows
+   uint64_t occupied;            // bit r set if row r is not empty
+};
+
+// Summarizes rows[0, count) of up to 64 bits each, count <= 64.
+typedef void (*summarize_kernel_t)(const uint64_t * rows, const uint32_t * keys, int32_t count, row_summary_t * summary);
+
+// Many independent boards of `rows` rows by 64 columns, interleaved: row r of
+// board b is rows[r * boards + b], bit i of it the cell at x = i. Cells
+// outside the boards are dead. Also sets differs[b] to the OR over the rows
+// of board b's new state XOR `reference`, so 0 when it matches.
+typedef void (*ensemble_kernel_t)(const uint64_t * old_rows, uint64_t * new_rows, const uint64_t * reference,
+      uint64_t * differs, int32_t boards, int32_t rows);
+
+enum simd_level_t {
+   SIMD_SCALAR,
+   SIMD_SSE2,
+   SIMD_AVX2,
+   SIMD_AVX512,
+   SIMD_LEVEL_COUNT
+};
+
+struct update_kernels_t {
+   simd_level_t level;
+   const char * name;
+   update_kernel_t update;
+   packed_update_kernel_t update_packed;
+   expand_kernel_t expand_packed;
+   pack_kernel_t pack;
+   summarize_kernel_t summarize;
+   ensemble_kernel_t update_ensemble;
+};
+
+// Highest level both the CPU and the OS support.
+simd_level_t simd_detect();
+
+// Kernels for `level`, clamped to what this build and CPU can run.
+const update_kernels_t * update_kernels_get(simd_level_t level);
+
+static inline const update_kernels_t * update_kernels_select() { return update_kernels_get(simd_detect()); }
+
+#endif // _SIMD_KERNELS_H
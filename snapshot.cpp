@@ -0,0 +1,281 @@
+#include "snapshot.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char SNAPSHOT_MAGIC[8] = {'G', 'O', 'L', 'S', 'N', 'A', 'P', 0};
+const size_t RECORD_WORDS = sizeof(snapshot_record_t) / sizeof(uint64_t);
+
+snapshot_t * snapshot_create(uint32_t topology, int32_t width, int32_t height, uint64_t generation)
+{
+   snapshot_t * snapshot = (snapshot_t *)calloc(1, sizeof(snapshot_t));
+   memcpy(snapshot->header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+   snapshot->header.version = SNAPSHOT_VERSION;
+   snapshot->header.topology = topology;
+   snapshot->header.width = width;
+   snapshot->header.height = height;
+   snapshot->header.generation = generation;
+   return snapshot;
+}
+
+void snapshot_destroy(snapshot_t * snapshot)
+{
+   free(snapshot->records);
+   free(snapshot);
+}
+
+snapshot_record_t * snapshot_add_record(snapshot_t * snapshot, int64_t x, int64_t y)
+{
+   if (snapshot->record_count == snapshot->record_capacity) {
+      snapshot->record_capacity = snapshot->record_capacity ? 2 * snapshot->record_capacity : 64;
+      snapshot->records = (snapshot_record_t *)realloc(snapshot->records, snapshot->record_capacity * sizeof(snapshot_record_t));
+   }
+   snapshot_record_t * record = &snapshot->records[snapshot->record_count++];
+   record->x = x;
+   record->y = y;
+   return record;
+}
+
+static inline void hash_word(uint64_t * hash, uint64_t word)
+{
+   for (auto i = 0; i < 8; i++)
+   {
+      *hash ^= (word >> (i * 8)) & 0xff;
+      *hash *= 0x100000001b3ull;
+   }
+}
+
+static uint64_t hash_words(const uint64_t * words, size_t count)
+{
+   uint64_t hash = 0xcbf29ce484222325ull;
+   for (size_t i = 0; i < count; i++)
+   {
+      hash_word(&hash, words[i]);
+   }
+   return hash;
+}
+
+// Zero-run encoding: each token word holds (zero words << 32 | literal words)
+// and is followed by the literals. Sparse chunks are mostly empty rows, so
+// this gets most of a general-purpose compressor's gain at memcpy speed.
+static void compress_words(const uint64_t * words, size_t count, std::vector<uint64_t> * out)
+{
+   size_t i = 0;
+   while (i < count) {
+      uint64_t zeros = 0;
+      while (i < count && words[i] == 0 && zeros < UINT32_MAX) {
+         zeros++;
+         i++;
+      }
+      size_t start = i;
+      // A lone zero is cheaper as a literal than as a new token
+      while (i < count && i - start < UINT32_MAX &&
+            (words[i] != 0 || (i + 1 < count && words[i + 1] != 0))) {
+         i++;
+      }
+      out->push_back((zeros << 32) | (uint64_t)(i - start));
+      out->insert(out->end(), words + start, words + i);
+   }
+}
+
+bool snapshot_write(snapshot_t * snapshot, const char * path, const char ** error)
+{
+   const uint64_t * payload = (const uint64_t *)snapshot->records;
+   size_t payload_words = snapshot->record_count * RECORD_WORDS;
+   std::vector<uint64_t> compressed;
+   if (snapshot->header.flags & SNAPSHOT_COMPRESSED) {
+      compress_words(payload, payload_words, &compressed);
+      payload = compressed.data();
+      payload_words = compressed.size();
+   }
+   snapshot->header.record_count = snapshot->record_count;
+   snapshot->header.payload_bytes = payload_words * sizeof(uint64_t);
+   snapshot->header.payload_hash = hash_words(payload, payload_words);
+
+   std::string temp_path = std::string(path) + ".tmp";
+   FILE * file = fopen(temp_path.c_str(), "wb");
+   if (!file) {
+      *error = "cannot create the snapshot file";
+      return false;
+   }
+   bool written = fwrite(&snapshot->header, sizeof(snapshot->header), 1, file) == 1 &&
+         fwrite(payload, sizeof(uint64_t), payload_words, file) == payload_words;
+   written = (fclose(file) == 0) && written;
+#ifdef _WIN32
+   remove(path);
+#endif
+   if (!written || rename(temp_path.c_str(), path) != 0) {
+      remove(temp_path.c_str());
+      *error = "cannot write the snapshot file";
+      return false;
+   }
+   return true;
+}
+
+struct snapshot_job_t {
+   snapshot_t * snapshot;
+   std::string path;
+};
+
+static struct {
+   std::mutex lock;
+   std::condition_variable wake;
+   std::condition_variable idle;
+   std::deque<snapshot_job_t> jobs;
+   std::thread thread;
+   bool running;
+   bool busy;
+   const char * error;
+} writer;
+
+static void snapshot_writer_main()
+{
+   std::unique_lock<std::mutex> lock(writer.lock);
+   for (;;) {
+      writer.wake.wait(lock, [] { return !writer.jobs.empty() || !writer.running; });
+      if (writer.jobs.empty()) {
+         return;
+      }
+      snapshot_job_t job = writer.jobs.front();
+      writer.jobs.pop_front();
+      writer.busy = true;
+      lock.unlock();
+
+      const char * error = NULL;
+      snapshot_write(job.snapshot, job.path.c_str(), &error);
+      snapshot_destroy(job.snapshot);
+
+      lock.lock();
+      writer.busy = false;
+      if (error) {
+         writer.error = error;
+      }
+      writer.idle.notify_all();
+   }
+}
+
+void snapshot_write_async(snapshot_t * snapshot, const char * path)
+{
+   std::lock_guard<std::mutex> lock(writer.lock);
+   if (!writer.running) {
+      writer.running = true;
+      writer.thread = std::thread(snapshot_writer_main);
+   }
+   writer.jobs.push_back({snapshot, path});
+   writer.wake.notify_one();
+}
+
+bool snapshot_writer_flush(const char ** error)
+{
+   std::unique_lock<std::mutex> lock(writer.lock);
+   writer.idle.wait(lock, [] { return writer.jobs.empty() && !writer.busy; });
+   if (writer.error) {
+      *error = writer.error;
+      writer.error = NULL;
+      return false;
+   }
+   return true;
+}
+
+void snapshot_writer_shutdown()
+{
+   {
+      std::lock_guard<std::mutex> lock(writer.lock);
+      if (!writer.running) {
+         return;
+      }
+      writer.running = false;
+      writer.wake.notify_one();
+   }
+   writer.thread.join();
+}
+
+bool snapshot_open(snapshot_reader_t * reader, const char * path, const char ** error)
+{
+   if (!mapped_file_open(&reader->file, path)) {
+      *error = "cannot open the snapshot file";
+      return false;
+   }
+   const snapshot_header_t * header = (const snapshot_header_t *)reader->file.data;
+   if (reader->file.size < sizeof(snapshot_header_t) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+      *error = "not a snapshot file";
+   } else if (header->version != SNAPSHOT_VERSION) {
+      *error = "unsupported snapshot version";
+   } else if (header->payload_bytes != reader->file.size - sizeof(snapshot_header_t) || header->payload_bytes % sizeof(uint64_t) ||
+         (!(header->flags & SNAPSHOT_COMPRESSED) && header->payload_bytes != header->record_count * sizeof(snapshot_record_t))) {
+      *error = "truncated snapshot file";
+   } else if (hash_words((const uint64_t *)(header + 1), header->payload_bytes / sizeof(uint64_t)) != header->payload_hash) {
+      *error = "corrupt snapshot file";
+   } else {
+      reader->header = header;
+      reader->next = (const uint8_t *)(header + 1);
+      reader->end = reader->next + header->payload_bytes;
+      reader->records_left = header->record_count;
+      reader->zeros_left = 0;
+      reader->literals_left = 0;
+      return true;
+   }
+   mapped_file_close(&reader->file);
+   return false;
+}
+
+const snapshot_record_t * snapshot_next_record(snapshot_reader_t * reader, snapshot_record_t * scratch)
+{
+   if (reader->records_left == 0) {
+      return NULL;
+   }
+   reader->records_left--;
+   if (!(reader->header->flags & SNAPSHOT_COMPRESSED)) {
+      const snapshot_record_t * record = (const snapshot_record_t *)reader->next;
+      reader->next += sizeof(snapshot_record_t);
+      return record;
+   }
+
+   uint64_t * words = (uint64_t *)scratch;
+   const uint64_t * next = (const uint64_t *)reader->next;
+   const uint64_t * end = (const uint64_t *)reader->end;
+   for (size_t i = 0; i < RECORD_WORDS; )
+   {
+      if (reader->zeros_left) {
+         size_t count = (size_t)std::min<uint64_t>(reader->zeros_left, RECORD_WORDS - i);
+         memset(words + i, 0, count * sizeof(uint64_t));
+         reader->zeros_left -= count;
+         i += count;
+      } else if (reader->literals_left) {
+         size_t count = (size_t)std::min<uint64_t>(reader->literals_left, RECORD_WORDS - i);
+         count = (size_t)std::min<uint64_t>(count, end - next);
+         memcpy(words + i, next, count * sizeof(uint64_t));
+         next += count;
+         reader->literals_left -= count;
+         i += count;
+         if (next == end && i < RECORD_WORDS) {
+            memset(words + i, 0, (RECORD_WORDS - i) * sizeof(uint64_t));
+            break;
+         }
+      } else if (next < end) {
+         reader->zeros_left = *next >> 32;
+         reader->literals_left = *next & 0xffffffffu;
+         next++;
+      } else {
+         // Payload ran short of the record count; the hash makes this unlikely
+         memset(words + i, 0, (RECORD_WORDS - i) * sizeof(uint64_t));
+         break;
+      }
+   }
+   reader->next = (const uint8_t *)next;
+   return scratch;
+}
+
+void snapshot_close(snapshot_reader_t * reader)
+{
+   mapped_file_close(&reader->file);
+   reader->header = NULL;
+}
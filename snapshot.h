@@ -0,0 +1,94 @@
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "mapped_file.h"
+
+// Checkpoint files. A snapshot is a header followed by records of 64 x 64
+// bit-packed cells: board chunks, or tiles of the infinite plane. A full
+// snapshot holds every non-empty chunk, an incremental one the chunks that
+// changed since the snapshot at base_generation and must be applied on top of
+// it. Uncompressed records are read straight out of the mapped file.
+//
+// Files are written in native byte order.
+
+const uint32_t SNAPSHOT_VERSION = 1;
+const uint32_t SNAPSHOT_RECORD_SIZE = 64;
+
+enum snapshot_flags_t {
+   SNAPSHOT_COMPRESSED = 1,         // payload is zero-run encoded words
+   SNAPSHOT_INCREMENTAL = 2
+};
+
+struct snapshot_header_t {
+   char magic[8];                   // "GOLSNAP\0"
+   uint32_t version;
+   uint32_t flags;
+   uint32_t topology;               // topology_t
+   int32_t width;
+   int32_t height;
+   uint32_t reserved;
+   uint64_t generation;
+   uint64_t base_generation;        // SNAPSHOT_INCREMENTAL: generation it applies to
+   uint64_t record_count;
+   uint64_t payload_bytes;
+   uint64_t payload_hash;           // FNV-1a of the payload as stored
+   uint64_t reserved2;
+};
+
+struct snapshot_record_t {
+   int64_t x;                       // top left cell
+   int64_t y;
+   uint64_t rows[SNAPSHOT_RECORD_SIZE];   // bit i of rows[r] is cell (x + i, y + r)
+};
+
+// Records captured in memory, waiting to be written.
+struct snapshot_t {
+   snapshot_header_t header;
+   snapshot_record_t * records;
+   size_t record_count;
+   size_t record_capacity;
+};
+
+snapshot_t * snapshot_create(uint32_t topology, int32_t width, int32_t height, uint64_t generation);
+
+void snapshot_destroy(snapshot_t * snapshot);
+
+snapshot_record_t * snapshot_add_record(snapshot_t * snapshot, int64_t x, int64_t y);
+
+// Writes to `path` through a temporary file, so a crash never leaves a torn
+// snapshot under the final name.
+bool snapshot_write(snapshot_t * snapshot, const char * path, const char ** error);
+
+// Hands `snapshot` to the writer thread, which compresses it if asked,
+// writes it and destroys it. Returns at once.
+void snapshot_write_async(snapshot_t * snapshot, const char * path);
+
+// Waits for the queued snapshots. Returns false if any of them failed since
+// the last call.
+bool snapshot_writer_flush(const char ** error);
+
+void snapshot_writer_shutdown();
+
+struct snapshot_reader_t {
+   mapped_file_t file;
+   const snapshot_header_t * header;
+   const uint8_t * next;
+   const uint8_t * end;
+   uint64_t records_left;
+   uint64_t zeros_left;             // compressed token in progress
+   uint64_t literals_left;
+};
+
+// Maps the file and checks its header and payload hash.
+bool snapshot_open(snapshot_reader_t * reader, const char * path, const char ** error);
+
+// Returns the next record, pointing into the mapping when the file is not
+// compressed and into `scratch` when it is, or NULL after the last one.
+const snapshot_record_t * snapshot_next_record(snapshot_reader_t * reader, snapshot_record_t * scratch);
+
+void snapshot_close(snapshot_reader_t * reader);
+
+#endif // _SNAPSHOT_H
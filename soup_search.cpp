@@ -0,0 +1,731 @@
+#include "soup_search.h"
+#include "job_queue.h"
+#include "packed_board.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+const int32_t RIM_WIDTH = 8;              // gliders this close to a wall are removed
+const uint32_t RIM_SCAN_INTERVAL = 8;     // generations between looks at the rims, a glider moves 2 cells
+const uint64_t NO_SOUP = ~0ull;
+const char * const GLIDER_APGCODE = "xq4_153";
+
+// A board is settled once it repeats a reference state (Brent's cycle
+// finding): the reference is replaced after `power` generations without a
+// match, and `power` doubles up to the longest period looked for.
+struct lane_t {
+   uint64_t soup;                // NO_SOUP once the soups have run out
+   uint32_t generation;
+   uint32_t power;
+   uint32_t since_reference;
+   uint64_t rim_signature;       // of the cells near the walls at the last look
+};
+
+struct batch_t {
+   int32_t boards;
+   uint32_t current;
+   std::vector<uint64_t> rows[2];      // row r of board b at r * boards + b
+   std::vector<uint64_t> reference;
+   std::vector<uint64_t> differs;
+   std::vector<lane_t> lanes;
+   std::vector<uint64_t> phases;       // scratch for classify
+   std::vector<std::string> codes;
+   uint64_t settled;
+   uint64_t unsettled;
+   uint64_t generations;
+   uint64_t walled;
+   std::unordered_map<std::string, uint64_t> census;
+};
+
+struct batch_job_t {
+   batch_t * batch;
+};
+
+struct cell_t {
+   int32_t x;
+   int32_t y;
+};
+
+static soup_search_config_t search;
+static const update_kernels_t * kernels;
+static std::atomic<uint64_t> next_soup;
+static uint32_t period_window;
+
+// 3x3 masks, bit 3y + x, of the glider in every phase and orientation
+static bool glider_shapes[512];
+
+const uint64_t SPLITMIX_GAMMA = 0x9e3779b97f4a7c15ull;
+
+// splitmix64, the generator the game seeds its soups with
+static inline uint64_t next_random(uint64_t * state)
+{
+   uint64_t z = (*state += SPLITMIX_GAMMA);
+   z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+   z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+   return z ^ (z >> 31);
+}
+
+// Rows [from, to] of the next generation.
+static void step_rows(const uint64_t * board, uint64_t * next, int32_t from, int32_t to)
+{
+   from = std::max(from, 0);
+   to = std::min(to, SOUP_BOARD_SIZE - 1);
+   uint64_t up = (from > 0) ? board[from - 1] : 0;
+   for (auto r = from; r <= to; r++)
+   {
+      uint64_t mid = board[r];
+      uint64_t down = (r + 1 < SOUP_BOARD_SIZE) ? board[r + 1] : 0;
+      next[r] = packed_life_word(up << 1, up, up >> 1, mid << 1, mid, mid >> 1, down << 1, down, down >> 1);
+      up = mid;
+   }
+}
+
+static void step_board(const uint64_t * board, uint64_t * next)
+{
+   step_rows(board, next, 0, SOUP_BOARD_SIZE - 1);
+}
+
+static void get_board(const batch_t * batch, int32_t b, uint64_t * board)
+{
+   const uint64_t * rows = batch->rows[batch->current].data();
+   for (auto r = 0; r < SOUP_BOARD_SIZE; r++)
+   {
+      board[r] = rows[r * batch->boards + b];
+   }
+}
+
+static void put_board(batch_t * batch, int32_t b, const uint64_t * board)
+{
+   uint64_t * rows = batch->rows[batch->current].data();
+   for (auto r = 0; r < SOUP_BOARD_SIZE; r++)
+   {
+      rows[r * batch->boards + b] = board[r];
+   }
+}
+
+static void save_reference(batch_t * batch, int32_t b)
+{
+   const uint64_t * rows = batch->rows[batch->current].data();
+   for (auto r = 0; r < SOUP_BOARD_SIZE; r++)
+   {
+      batch->reference[r * batch->boards + b] = rows[r * batch->boards + b];
+   }
+}
+
+static inline uint64_t smear(uint64_t row) { return row | (row << 1) | (row >> 1); }
+
+// Cells of `cells` connected to (x, y), which must be alive, through steps
+// of up to `radius` cells in any direction, into `component`; its rows are
+// [*top, *bottom] and the other rows of `component` are left undefined.
+// Gives up once it spans more than `max_rows` rows, with part of it.
+static void flood_component(const uint64_t * cells, int32_t x, int32_t y, int32_t radius, int32_t max_rows,
+      uint64_t * component, int32_t * top, int32_t * bottom)
+{
+   component[y] = 1ull << x;
+   int32_t lo = y, hi = y;
+   uint64_t spread[SOUP_BOARD_SIZE];
+   for (bool grew = true; grew && hi - lo < max_rows; )
+   {
+      grew = false;
+      for (auto r = lo; r <= hi; r++)
+      {
+         spread[r] = component[r];
+         for (auto i = 0; i < radius; i++)
+         {
+            spread[r] = smear(spread[r]);
+         }
+      }
+      int32_t from = std::max(lo - radius, 0), to = std::min(hi + radius, SOUP_BOARD_SIZE - 1);
+      int32_t next_lo = lo, next_hi = hi;
+      for (auto r = from; r <= to; r++)
+      {
+         uint64_t reach = 0;
+         for (auto q = std::max(r - radius, lo); q <= std::min(r + radius, hi); q++)
+         {
+            reach |= spread[q];
+         }
+         uint64_t grown = reach & cells[r];
+         uint64_t before = (r >= lo && r <= hi) ? component[r] : 0;
+         component[r] = grown;
+         if (grown != before) {
+            next_lo = std::min(next_lo, r);
+            next_hi = std::max(next_hi, r);
+            grew = true;
+         }
+      }
+      lo = next_lo;
+      hi = next_hi;
+   }
+   *top = lo;
+   *bottom = hi;
+}
+
+static inline void orient(int32_t * x, int32_t * y, uint32_t orientation)
+{
+   if (orientation & 4) {
+      std::swap(*x, *y);
+   }
+   if (orientation & 1) {
+      *x = -*x;
+   }
+   if (orientation & 2) {
+      *y = -*y;
+   }
+}
+
+static void init_glider_shapes()
+{
+   uint64_t board[SOUP_BOARD_SIZE] = {}, next[SOUP_BOARD_SIZE];
+   board[30] = 2ull << 30;
+   board[31] = 4ull << 30;
+   board[32] = 7ull << 30;
+   memset(glider_shapes, 0, sizeof(glider_shapes));
+   for (auto phase = 0; phase < 4; phase++)
+   {
+      int32_t top = SOUP_BOARD_SIZE, left = SOUP_BOARD_SIZE;
+      for (auto r = 0; r < SOUP_BOARD_SIZE; r++)
+      {
+         if (board[r]) {
+            top = std::min(top, r);
+            left = std::min(left, (int32_t)packed_lowest_bit(board[r]));
+         }
+      }
+      for (uint32_t orientation = 0; orientation < 8; orientation++)
+      {
+         uint32_t mask = 0;
+         for (auto y = 0; y < 3; y++)
+         {
+            for (auto x = 0; x < 3; x++)
+            {
+               if ((board[top + y] >> (left + x)) & 1) {
+                  // Around the centre of the 3x3 box
+                  int32_t ox = x - 1, oy = y - 1;
+                  orient(&ox, &oy, orientation);
+                  mask |= 1u << (3 * (oy + 1) + ox + 1);
+               }
+            }
+         }
+         glider_shapes[mask] = true;
+      }
+      step_board(board, next);
+      memcpy(board, next, sizeof(board));
+   }
+}
+
+// Erases the isolated gliders within RIM_WIDTH of the walls. Anything else
+// near a wall is left to run into it. Debris that sits still near a wall
+// looks the same at every look and is only taken apart once.
+static void remove_gliders(batch_t * batch, int32_t b)
+{
+   const uint64_t rim_columns = ((1ull << RIM_WIDTH) - 1) | (~0ull << (64 - RIM_WIDTH));
+   uint64_t board[SOUP_BOARD_SIZE], rim[SOUP_BOARD_SIZE];
+   get_board(batch, b, board);
+   uint64_t signature = 0;
+   for (auto r = 0; r < SOUP_BOARD_SIZE; r++)
+   {
+      bool rim_row = r < RIM_WIDTH || r >= SOUP_BOARD_SIZE - RIM_WIDTH;
+      rim[r] = board[r] & (rim_row ? ~0ull : rim_columns);
+      signature = (signature + rim[r]) * SPLITMIX_GAMMA;
+   }
+   lane_t * lane = &batch->lanes[b];
+   if (signature == lane->rim_signature) {
+      return;
+   }
+   lane->rim_signature = signature;
+
+   uint32_t removed = 0;
+   uint64_t component[SOUP_BOARD_SIZE];
+   for (auto r = 0; r < SOUP_BOARD_SIZE; r++)
+   {
+      while (rim[r])
+      {
+         int32_t top, bottom;
+         flood_component(board, (int32_t)packed_lowest_bit(rim[r]), r, 1, 3, component, &top, &bottom);
+         uint64_t columns = 0;
+         uint32_t population = 0;
+         for (auto y = top; y <= bottom; y++)
+         {
+            rim[y] &= ~component[y];
+            columns |= component[y];
+            population += packed_popcount(component[y]);
+         }
+         int32_t left = (int32_t)packed_lowest_bit(columns);
+         if (population != 5 || bottom - top != 2 || packed_highest_bit(columns) - left != 2) {
+            continue;
+         }
+         uint32_t mask = 0;
+         for (auto y = 0; y < 3; y++)
+         {
+            mask |= (uint32_t)((component[top + y] >> left) & 7) << (3 * y);
+         }
+         // Nothing else within two cells, or it may still interact
+         int32_t from = std::max(left - 2, 0), to = std::min(left + 4, 63);
+         uint64_t around = ((to == 63) ? ~0ull : (2ull << to) - 1) & ~((1ull << from) - 1);
+         bool isolated = true;
+         for (auto y = std::max(top - 2, 0); y <= std::min(bottom + 2, SOUP_BOARD_SIZE - 1); y++)
+         {
+            uint64_t own = (y >= top && y <= bottom) ? component[y] : 0;
+            isolated &= ((board[y] & ~own) & around) == 0;
+         }
+         if (!glider_shapes[mask] || !isolated) {
+            continue;
+         }
+         for (auto y = top; y <= bottom; y++)
+         {
+            board[y] &= ~component[y];
+         }
+         removed++;
+      }
+   }
+   if (removed) {
+      lane->rim_signature = 0;
+      put_board(batch, b, board);
+      batch->census[GLIDER_APGCODE] += removed;
+   }
+}
+
+// Extended Wechsler format: strips of five rows separated by 'z', each
+// column of a strip one base-32 digit with the top row as bit 0, runs of
+// empty columns shortened to 'w' (two), 'x' (three) or 'y' and a count of
+// 4 to 39, and the empty columns at the end of a strip left out.
+static std::string wechsler(const std::vector<cell_t> & cells, uint32_t orientation)
+{
+   static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+   int32_t left = INT32_MAX, top = INT32_MAX, right = INT32_MIN, bottom = INT32_MIN;
+   std::vector<cell_t> oriented(cells);
+   for (auto & cell : oriented)
+   {
+      orient(&cell.x, &cell.y, orientation);
+      left = std::min(left, cell.x);
+      right = std::max(right, cell.x);
+      top = std::min(top, cell.y);
+      bottom = std::max(bottom, cell.y);
+   }
+   uint64_t rows[SOUP_BOARD_SIZE] = {};
+   for (const auto & cell : oriented)
+   {
+      rows[cell.y - top] |= 1ull << (cell.x - left);
+   }
+
+   std::string code;
+   for (auto strip = 0; strip <= bottom - top; strip += 5)
+   {
+      if (strip) {
+         code += 'z';
+      }
+      int32_t zeros = 0;
+      for (auto x = 0; x <= right - left; x++)
+      {
+         uint32_t column = 0;
+         for (auto k = 0; k < 5 && strip + k < SOUP_BOARD_SIZE; k++)
+         {
+            column |= (uint32_t)((rows[strip + k] >> x) & 1) << k;
+         }
+         if (!column) {
+            zeros++;
+            continue;
+         }
+         while (zeros > 0)
+         {
+            if (zeros >= 4) {
+               int32_t run = std::min(zeros, 39);
+               code += 'y';
+               code += digits[run - 4];
+               zeros -= run;
+            } else {
+               code += "0wx"[zeros - 1];
+               zeros = 0;
+            }
+         }
+         code += digits[column];
+      }
+   }
+   return code;
+}
+
+// apgcode of one object: xs<population>_ for a still life, xp<period>_ for an
+// oscillator, then the shortest and first in ASCII order of the Wechsler
+// codes of its phases in all eight orientations.
+static std::string apgcode(const uint64_t * phases, uint32_t period, const uint64_t * component, int32_t top, int32_t bottom)
+{
+   std::string best;
+   uint32_t population = 0;
+   std::vector<cell_t> cells;
+   for (uint32_t phase = 0; phase < period; phase++)
+   {
+      cells.clear();
+      for (auto y = top; y <= bottom; y++)
+      {
+         for (uint64_t bits = phases[phase * SOUP_BOARD_SIZE + y] & component[y]; bits; bits &= bits - 1)
+         {
+            cell_t cell = {(int32_t)packed_lowest_bit(bits), y};
+            cells.push_back(cell);
+         }
+      }
+      if (cells.empty()) {
+         continue;
+      }
+      population = (uint32_t)cells.size();
+      for (uint32_t orientation = 0; orientation < 8; orientation++)
+      {
+         std::string code = wechsler(cells, orientation);
+         if (best.empty() || code.size() < best.size() || (code.size() == best.size() && code < best)) {
+            best = code;
+         }
+      }
+   }
+   char prefix[32];
+   if (period == 1) {
+      snprintf(prefix, sizeof(prefix), "xs%u_", population);
+   } else {
+      snprintf(prefix, sizeof(prefix), "xp%u_", period);
+   }
+   return prefix + best;
+}
+
+// Shortest period, a divisor of the board's, of the cells in `component`.
+static uint32_t object_period(const uint64_t * phases, uint32_t period, const uint64_t * component, int32_t top, int32_t bottom)
+{
+   for (uint32_t p = 1; p < period; p++)
+   {
+      if (period % p) {
+         continue;
+      }
+      bool same = true;
+      for (auto y = top; y <= bottom && same; y++)
+      {
+         same = ((phases[y] ^ phases[p * SOUP_BOARD_SIZE + y]) & component[y]) == 0;
+      }
+      if (same) {
+         return p;
+      }
+   }
+   return period;
+}
+
+// Whether any cell just outside the board would have three live neighbours,
+// which the walls keep from being born.
+static bool wall_births(const uint64_t * cells)
+{
+   const uint64_t first = cells[0], last = cells[SOUP_BOARD_SIZE - 1];
+   uint64_t edges = (first & (first << 1) & (first >> 1)) | (last & (last << 1) & (last >> 1));
+   for (auto r = 1; r + 1 < SOUP_BOARD_SIZE; r++)
+   {
+      edges |= cells[r - 1] & cells[r] & cells[r + 1] & (1ull | (1ull << 63));
+   }
+   return edges != 0;
+}
+
+// Whether the object goes through the same phases on an empty plane. It may
+// only work together with its neighbours, like the quadrants of a pulsar, or
+// lean on a wall.
+static bool runs_alone(const uint64_t * phases, uint32_t period, const uint64_t * component, int32_t top, int32_t bottom)
+{
+   uint64_t cells[2][SOUP_BOARD_SIZE] = {};
+   for (auto y = top; y <= bottom; y++)
+   {
+      cells[0][y] = phases[y] & component[y];
+   }
+   for (uint32_t phase = 1; phase <= period; phase++)
+   {
+      const uint64_t * old_cells = cells[(phase - 1) & 1];
+      uint64_t * new_cells = cells[phase & 1];
+      if (wall_births(old_cells)) {
+         return false;
+      }
+      step_rows(old_cells, new_cells, top - 1, bottom + 1);
+      const uint64_t * expected = phases + (phase % period) * SOUP_BOARD_SIZE;
+      for (auto y = std::max(top - 1, 0); y <= std::min(bottom + 1, SOUP_BOARD_SIZE - 1); y++)
+      {
+         if (new_cells[y] != (expected[y] & component[y])) {
+            return false;
+         }
+      }
+   }
+   return true;
+}
+
+// Splits a board that repeats every `period` generations into objects and
+// counts them. Objects are the 8-connected groups of cells alive in any
+// phase; groups that do not run alone are joined with everything within two
+// cells of them, and if that does not run alone either it leans on a wall
+// and is left out. An object may repeat sooner than the whole board.
+static void classify(batch_t * batch, const uint64_t * board, uint32_t period)
+{
+   batch->phases.resize((size_t)period * SOUP_BOARD_SIZE);
+   uint64_t * phases = batch->phases.data();
+   memcpy(phases, board, SOUP_BOARD_SIZE * sizeof(uint64_t));
+   uint64_t any[SOUP_BOARD_SIZE];
+   memcpy(any, board, sizeof(any));
+   for (uint32_t phase = 1; phase < period; phase++)
+   {
+      step_board(phases + (phase - 1) * SOUP_BOARD_SIZE, phases + phase * SOUP_BOARD_SIZE);
+      for (auto r = 0; r < SOUP_BOARD_SIZE; r++)
+      {
+         any[r] |= phases[phase * SOUP_BOARD_SIZE + r];
+      }
+   }
+
+   uint64_t left[SOUP_BOARD_SIZE], component[SOUP_BOARD_SIZE], joined[SOUP_BOARD_SIZE] = {};
+   bool joining = false;
+   uint64_t walled = 0;
+   std::vector<std::string> & codes = batch->codes;
+   codes.clear();
+   for (auto pass = 0; pass < 2; pass++)
+   {
+      memcpy(left, any, sizeof(left));
+      for (auto r = 0; r < SOUP_BOARD_SIZE; r++)
+      {
+         while (left[r])
+         {
+            int32_t x = (int32_t)packed_lowest_bit(left[r]), top, bottom;
+            flood_component(any, x, r, 1, SOUP_BOARD_SIZE, component, &top, &bottom);
+            if (pass == 1) {
+               bool near = false;
+               for (auto y = std::max(top - 2, 0); y <= std::min(bottom + 2, SOUP_BOARD_SIZE - 1); y++)
+               {
+                  uint64_t rows = 0;
+                  for (auto q = std::max(y - 2, top); q <= std::min(y + 2, bottom); q++)
+                  {
+                     rows |= component[q];
+                  }
+                  near |= (joined[y] & smear(smear(rows))) != 0;
+               }
+               if (near) {
+                  flood_component(any, x, r, 2, SOUP_BOARD_SIZE, component, &top, &bottom);
+               }
+            }
+            for (auto y = top; y <= bottom; y++)
+            {
+               left[y] &= ~component[y];
+            }
+            uint32_t p = object_period(phases, period, component, top, bottom);
+            bool alone = (pass == 0 || joining) ? runs_alone(phases, p, component, top, bottom) : true;
+            if (pass == 0 && !alone) {
+               for (auto y = top; y <= bottom; y++)
+               {
+                  joined[y] |= component[y];
+               }
+               joining = true;
+            } else if (!alone) {
+               walled++;
+               continue;
+            }
+            codes.push_back(apgcode(phases, p, component, top, bottom));
+         }
+      }
+      if (pass == 1 || !joining) {
+         break;
+      }
+      codes.clear();
+   }
+   for (const auto & code : codes)
+   {
+      batch->census[code]++;
+   }
+   batch->walled += walled;
+}
+
+// Seeds board `b` with the next soup, or empties it when there are none left.
+static void start_soup(batch_t * batch, int32_t b)
+{
+   lane_t * lane = &batch->lanes[b];
+   uint64_t soup = next_soup.fetch_add(1, std::memory_order_relaxed);
+   lane->soup = (soup < search.soups) ? soup : NO_SOUP;
+   lane->generation = 0;
+   lane->power = 1;
+   lane->since_reference = 0;
+   lane->rim_signature = 0;
+
+   uint64_t board[SOUP_BOARD_SIZE] = {};
+   if (lane->soup != NO_SOUP) {
+      uint32_t size = search.soup_size;
+      int32_t offset = (SOUP_BOARD_SIZE - (int32_t)size) / 2;
+      uint64_t state = search.seed + soup * size * size * SPLITMIX_GAMMA;
+      for (uint32_t y = 0; y < size; y++)
+      {
+         for (uint32_t x = 0; x < size; x++)
+         {
+            if ((next_random(&state) % 100) < search.fill_percent) {
+               board[offset + y] |= 1ull << (offset + x);
+            }
+         }
+      }
+   }
+   put_board(batch, b, board);
+   save_reference(batch, b);
+}
+
+static void finish_soup(batch_t * batch, int32_t b, bool settled)
+{
+   lane_t * lane = &batch->lanes[b];
+   if (settled) {
+      uint64_t board[SOUP_BOARD_SIZE];
+      get_board(batch, b, board);
+      classify(batch, board, lane->since_reference);
+      batch->settled++;
+   } else {
+      batch->unsettled++;
+   }
+   batch->generations += lane->generation;
+   start_soup(batch, b);
+}
+
+// Advances the whole batch a generation at a time until every board has
+// run out of soups.
+static void run_batch(batch_t * batch)
+{
+   int32_t boards = batch->boards;
+   int32_t active = 0;
+   for (auto b = 0; b < boards; b++)
+   {
+      start_soup(batch, b);
+      active += batch->lanes[b].soup != NO_SOUP;
+   }
+   while (active > 0)
+   {
+      const uint64_t * old_rows = batch->rows[batch->current].data();
+      uint64_t * new_rows = batch->rows[batch->current ^ 1].data();
+      kernels->update_ensemble(old_rows, new_rows, batch->reference.data(), batch->differs.data(), boards, SOUP_BOARD_SIZE);
+      batch->current ^= 1;
+
+      for (auto b = 0; b < boards; b++)
+      {
+         lane_t * lane = &batch->lanes[b];
+         if (lane->soup == NO_SOUP) {
+            continue;
+         }
+         lane->generation++;
+         lane->since_reference++;
+         if (!batch->differs[b]) {
+            finish_soup(batch, b, true);
+         } else if (lane->generation >= search.max_generations) {
+            finish_soup(batch, b, false);
+         } else {
+            if (lane->generation % RIM_SCAN_INTERVAL == 0) {
+               remove_gliders(batch, b);
+            }
+            if (lane->since_reference == lane->power) {
+               save_reference(batch, b);
+               lane->power = std::min(lane->power * 2, period_window);
+               lane->since_reference = 0;
+            }
+            continue;
+         }
+         active -= lane->soup == NO_SOUP;
+      }
+   }
+}
+
+static void batch_handler(void * data)
+{
+   run_batch(((batch_job_t *)data)->batch);
+}
+
+soup_search_config_t soup_search_default_config()
+{
+   soup_search_config_t config;
+   config.seed = 1;
+   config.soups = 10000;
+   config.soup_size = 16;
+   config.fill_percent = 50;
+   config.batch_boards = 64;
+   config.batches = 0;
+   config.max_generations = 10000;
+   config.max_period = 64;
+   config.kernels = NULL;
+   config.multi_thread = true;
+   return config;
+}
+
+bool soup_search_run(const soup_search_config_t * config, soup_search_result_t * result, const char ** error)
+{
+   if (config->soup_size < 1 || config->soup_size > (uint32_t)SOUP_BOARD_SIZE) {
+      *error = "soups must be 1 to 64 cells wide";
+      return false;
+   }
+   if (config->fill_percent > 100 || config->batch_boards < 1 || config->batch_boards > 65536 ||
+         config->max_period < 1 || config->max_period > 65536 || config->max_generations < 1) {
+      *error = "invalid soup search settings";
+      return false;
+   }
+   search = *config;
+   kernels = config->kernels ? config->kernels : update_kernels_select();
+   next_soup.store(0, std::memory_order_relaxed);
+   for (period_window = 1; period_window < config->max_period; period_window *= 2);
+   init_glider_shapes();
+
+   result->threads = config->multi_thread ? job_queue_worker_count() + 1 : 1;
+   result->batches = config->batches ? config->batches : result->threads;
+   std::vector<batch_t> batches(result->batches);
+   for (uint32_t i = 0; i < result->batches; i++)
+   {
+      batch_t * batch = &batches[i];
+      size_t words = (size_t)config->batch_boards * SOUP_BOARD_SIZE;
+      batch->boards = (int32_t)config->batch_boards;
+      batch->current = 0;
+      batch->rows[0].assign(words, 0);
+      batch->rows[1].assign(words, 0);
+      batch->reference.assign(words, 0);
+      batch->differs.assign(config->batch_boards, 0);
+      batch->lanes.resize(config->batch_boards);
+      batch->settled = 0;
+      batch->unsettled = 0;
+      batch->generations = 0;
+      batch->walled = 0;
+   }
+
+   auto start = std::chrono::steady_clock::now();
+   job_group_t group;
+   group.pending.store(0);
+   for (uint32_t i = 0; i < result->batches; i++)
+   {
+      batch_job_t job = {&batches[i]};
+      trace_tag_t tag = {"soups", TRACE_PHASE_COUNT, (int32_t)i, 0};
+      if (config->multi_thread) {
+         job_queue_push(&group, batch_handler, &job, sizeof(job), NULL, 0, &tag);
+      } else {
+         uint64_t trace_start_ns = trace_enabled() ? trace_now_ns() : 0;
+         batch_handler(&job);
+         if (trace_start_ns) {
+            trace_job(&tag, 0, trace_start_ns, trace_now_ns());
+         }
+      }
+   }
+   if (config->multi_thread) {
+      job_group_wait(&group);
+   }
+   result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   std::unordered_map<std::string, uint64_t> census;
+   result->soups = config->soups;
+   result->settled = 0;
+   result->unsettled = 0;
+   result->generations = 0;
+   result->walled = 0;
+   for (const auto & batch : batches)
+   {
+      result->walled += batch.walled;
+      result->settled += batch.settled;
+      result->unsettled += batch.unsettled;
+      result->generations += batch.generations;
+      for (const auto & entry : batch.census)
+      {
+         census[entry.first] += entry.second;
+      }
+   }
+   result->census.clear();
+   for (const auto & entry : census)
+   {
+      soup_census_entry_t object = {entry.first, entry.second};
+      result->census.push_back(object);
+   }
+   std::sort(result->census.begin(), result->census.end(), [](const soup_census_entry_t & a, const soup_census_entry_t & b) {
+      return (a.count != b.count) ? a.count > b.count : a.apgcode < b.apgcode;
+   });
+   return true;
+}
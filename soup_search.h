@@ -0,0 +1,60 @@
+#ifndef _SOUP_SEARCH_H
+#define _SOUP_SEARCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "simd_kernels.h"
+
+// Census of random soups under B3/S23: every soup is a random square in the
+// middle of its own small bounded board, run until the board repeats, and
+// the objects left on it are counted by apgcode (xs4_33 is a block, xp2_7
+// a blinker, xq4_153 a glider). Boards are kept in batches interleaved row
+// by row, so one vector instruction advances several boards, and each batch
+// is a job that takes soups from a shared counter: a settled board is
+// classified and reseeded straight away while the rest of its batch runs on.
+//
+// Gliders heading into the walls are counted and removed before they hit
+// them; other spaceships crash and leave their debris in the census.
+// Objects that only hold together against a wall are counted apart.
+
+const int32_t SOUP_BOARD_SIZE = 64;        // boards are 64 x 64, one word per row
+
+struct soup_search_config_t {
+   uint64_t seed;                // soup s is cells [s * size^2, (s + 1) * size^2) of the generator seeded with it
+   uint64_t soups;
+   uint32_t soup_size;           // side of the random square, at most SOUP_BOARD_SIZE
+   uint32_t fill_percent;
+   uint32_t batch_boards;        // boards advanced together by a job
+   uint32_t batches;             // 0 = one per thread
+   uint32_t max_generations;     // soups still changing by then count as unsettled
+   uint32_t max_period;          // longest period recognised, rounded up to a power of two
+   const update_kernels_t * kernels;   // NULL picks the best supported
+   bool multi_thread;            // run the batches on the job queue
+};
+
+struct soup_census_entry_t {
+   std::string apgcode;
+   uint64_t count;
+};
+
+struct soup_search_result_t {
+   uint64_t soups;
+   uint64_t settled;
+   uint64_t unsettled;
+   uint64_t generations;         // summed over the soups
+   uint64_t walled;              // objects that only hold together against a wall, not in the census
+   uint32_t threads;
+   uint32_t batches;
+   double seconds;
+   std::vector<soup_census_entry_t> census;  // most common first
+};
+
+soup_search_config_t soup_search_default_config();
+
+// Runs config->soups soups. With multi_thread the job queue must be running.
+// Returns false and sets `error` for a configuration it cannot run.
+bool soup_search_run(const soup_search_config_t * config, soup_search_result_t * result, const char ** error);
+
+#endif // _SOUP_SEARCH_H
@@ -0,0 +1,349 @@
+#include "trace.h"
+#include "packed_board.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Histogram buckets: exact below 16 us, then 8 per power of two.
+const uint32_t TRACE_EXACT_BUCKETS = 16;
+const uint32_t TRACE_SUB_BUCKETS = 8;
+const uint32_t TRACE_MAX_LOG2 = 40;
+const uint32_t TRACE_BUCKETS = TRACE_EXACT_BUCKETS + (TRACE_MAX_LOG2 - 4 + 1) * TRACE_SUB_BUCKETS;
+
+const uint32_t TRACE_NO_WORKER = ~0u;
+
+struct trace_event_t {
+   const char * name;
+   uint64_t start_ns;
+   uint64_t end_ns;
+   int32_t x;
+   int32_t y;
+   uint32_t worker;              // TRACE_NO_WORKER for events that are not jobs
+   uint32_t frame;
+};
+
+// Written only by its own thread; a buffer left from an earlier trace is
+// cleared on its next event. A thread creates its buffer on its first event,
+// so threads that never record while tracing have none.
+struct trace_buffer_t {
+   uint32_t tid;
+   char name[32];
+   uint32_t session;
+   std::vector<trace_event_t> events;
+   uint64_t dropped;
+   bool exited;                  // kept only until its events are written
+};
+
+struct alignas(64) trace_histogram_t {
+   std::atomic<uint64_t> buckets[TRACE_BUCKETS];
+   std::atomic<uint64_t> max_us;
+};
+
+struct alignas(64) trace_span_t {
+   std::atomic<uint64_t> start_ns;
+   std::atomic<uint64_t> end_ns;
+};
+
+static struct {
+   std::atomic<bool> enabled;
+   std::atomic<uint32_t> session;
+   uint32_t events_per_thread;
+   uint64_t start_ns;
+   std::atomic<uint32_t> frame;
+
+   std::mutex mutex;
+   std::vector<trace_buffer_t *> buffers;
+   uint32_t next_tid;
+   uint32_t written_session;     // last session trace_write_chrome wrote
+
+   trace_span_t spans[TRACE_PHASE_COUNT];
+   trace_histogram_t histograms[TRACE_PHASE_COUNT];
+} trace;
+
+static thread_local trace_buffer_t * trace_local;
+static thread_local char trace_local_name[32];
+
+static const char * const TRACE_PHASE_NAMES[TRACE_PHASE_COUNT] = { "update", "render", "present" };
+
+static trace_buffer_t * trace_buffer()
+{
+   if (!trace_local) {
+      trace_local = new trace_buffer_t();
+      std::lock_guard<std::mutex> lock(trace.mutex);
+      trace_local->tid = ++trace.next_tid;
+      if (trace_local_name[0]) {
+         snprintf(trace_local->name, sizeof(trace_local->name), "%s", trace_local_name);
+      } else {
+         snprintf(trace_local->name, sizeof(trace_local->name), "thread %u", trace_local->tid);
+      }
+      trace_local->session = 0;
+      trace_local->dropped = 0;
+      trace_local->exited = false;
+      trace.buffers.push_back(trace_local);
+   }
+   uint32_t session = trace.session.load(std::memory_order_acquire);
+   if (trace_local->session != session) {
+      trace_local->session = session;
+      trace_local->events.clear();
+      trace_local->events.reserve(trace.events_per_thread);
+      trace_local->dropped = 0;
+   }
+   return trace_local;
+}
+
+// Frees the buffers of exited threads, except those still holding events of
+// the current trace that are not written yet when `keep_current`. Called with
+// the mutex held.
+static void release_exited(bool keep_current)
+{
+   uint32_t session = trace.session.load(std::memory_order_acquire);
+   keep_current = keep_current && trace.written_session != session;
+   size_t kept = 0;
+   for (auto buffer : trace.buffers)
+   {
+      if (buffer->exited && !(keep_current && buffer->session == session && !buffer->events.empty())) {
+         delete buffer;
+      } else {
+         trace.buffers[kept++] = buffer;
+      }
+   }
+   trace.buffers.resize(kept);
+}
+
+static void trace_record(const char * name, uint64_t start_ns, uint64_t end_ns, int32_t x, int32_t y, uint32_t worker)
+{
+   if (!trace.events_per_thread) {
+      return;
+   }
+   trace_buffer_t * buffer = trace_buffer();
+   if (buffer->events.size() >= trace.events_per_thread) {
+      buffer->dropped++;
+      return;
+   }
+   trace_event_t event = { name, start_ns, end_ns, x, y, worker, trace.frame.load(std::memory_order_relaxed) };
+   buffer->events.push_back(event);
+}
+
+static inline void atomic_min(std::atomic<uint64_t> * value, uint64_t candidate)
+{
+   uint64_t current = value->load(std::memory_order_relaxed);
+   while (candidate < current && !value->compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+   }
+}
+
+static inline void atomic_max(std::atomic<uint64_t> * value, uint64_t candidate)
+{
+   uint64_t current = value->load(std::memory_order_relaxed);
+   while (candidate > current && !value->compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+   }
+}
+
+static inline uint32_t bucket_index(uint64_t us)
+{
+   if (us < TRACE_EXACT_BUCKETS) {
+      return (uint32_t)us;
+   }
+   uint32_t log2 = packed_highest_bit(us);
+   if (log2 > TRACE_MAX_LOG2) {
+      return TRACE_BUCKETS - 1;
+   }
+   uint32_t sub = (uint32_t)(us >> (log2 - 3)) & (TRACE_SUB_BUCKETS - 1);
+   return TRACE_EXACT_BUCKETS + (log2 - 4) * TRACE_SUB_BUCKETS + sub;
+}
+
+static inline uint64_t bucket_upper(uint32_t index)
+{
+   if (index < TRACE_EXACT_BUCKETS) {
+      return index;
+   }
+   uint32_t log2 = (index - TRACE_EXACT_BUCKETS) / TRACE_SUB_BUCKETS + 4;
+   uint64_t sub = (index - TRACE_EXACT_BUCKETS) % TRACE_SUB_BUCKETS;
+   return ((TRACE_SUB_BUCKETS + sub + 1) << (log2 - 3)) - 1;
+}
+
+static void histogram_reset(trace_histogram_t * histogram)
+{
+   for (uint32_t i = 0; i < TRACE_BUCKETS; i++)
+   {
+      histogram->buckets[i].store(0, std::memory_order_relaxed);
+   }
+   histogram->max_us.store(0, std::memory_order_relaxed);
+}
+
+static void span_reset(trace_span_t * span)
+{
+   span->start_ns.store(UINT64_MAX, std::memory_order_relaxed);
+   span->end_ns.store(0, std::memory_order_relaxed);
+}
+
+void trace_start(uint32_t events_per_thread)
+{
+   {
+      std::lock_guard<std::mutex> lock(trace.mutex);
+      release_exited(false);
+   }
+   trace.events_per_thread = events_per_thread;
+   trace.start_ns = trace_now_ns();
+   trace.frame.store(0);
+   for (uint32_t i = 0; i < TRACE_PHASE_COUNT; i++)
+   {
+      span_reset(&trace.spans[i]);
+      histogram_reset(&trace.histograms[i]);
+   }
+   trace.session.fetch_add(1, std::memory_order_release);
+   trace.enabled.store(true, std::memory_order_release);
+}
+
+void trace_stop()
+{
+   trace.enabled.store(false, std::memory_order_release);
+}
+
+bool trace_enabled()
+{
+   return trace.enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t trace_now_ns()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void trace_thread_name(const char * name)
+{
+   snprintf(trace_local_name, sizeof(trace_local_name), "%s", name);
+   if (trace_local) {
+      std::lock_guard<std::mutex> lock(trace.mutex);
+      snprintf(trace_local->name, sizeof(trace_local->name), "%s", name);
+   }
+}
+
+void trace_thread_exit()
+{
+   if (!trace_local) {
+      return;
+   }
+   std::lock_guard<std::mutex> lock(trace.mutex);
+   trace_local->exited = true;
+   trace_local = NULL;
+   release_exited(true);
+}
+
+void trace_job(const trace_tag_t * tag, uint32_t worker, uint64_t start_ns, uint64_t end_ns)
+{
+   if (tag->phase < TRACE_PHASE_COUNT) {
+      trace_span_t * span = &trace.spans[tag->phase];
+      atomic_min(&span->start_ns, start_ns);
+      atomic_max(&span->end_ns, end_ns);
+   }
+   trace_record(tag->name, start_ns, end_ns, tag->x, tag->y, worker);
+}
+
+void trace_event(const char * name, uint64_t start_ns, uint64_t end_ns)
+{
+   trace_record(name, start_ns, end_ns, 0, 0, TRACE_NO_WORKER);
+}
+
+void trace_frame_end()
+{
+   for (uint32_t i = 0; i < TRACE_PHASE_COUNT; i++)
+   {
+      trace_span_t * span = &trace.spans[i];
+      uint64_t start = span->start_ns.load(std::memory_order_relaxed);
+      uint64_t end = span->end_ns.load(std::memory_order_relaxed);
+      if (end >= start) {
+         trace_phase_add((trace_phase_t)i, (end - start) / 1000);
+         span_reset(span);
+      }
+   }
+   trace.frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void trace_phase_add(trace_phase_t phase, uint64_t us)
+{
+   trace_histogram_t * histogram = &trace.histograms[phase];
+   histogram->buckets[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+   atomic_max(&histogram->max_us, us);
+}
+
+void trace_get_percentiles(trace_phase_t phase, trace_percentiles_t * percentiles, bool reset)
+{
+   trace_histogram_t * histogram = &trace.histograms[phase];
+   uint64_t counts[TRACE_BUCKETS];
+   uint64_t count = 0;
+   for (uint32_t i = 0; i < TRACE_BUCKETS; i++)
+   {
+      counts[i] = reset ? histogram->buckets[i].exchange(0, std::memory_order_relaxed) :
+         histogram->buckets[i].load(std::memory_order_relaxed);
+      count += counts[i];
+   }
+   percentiles->count = count;
+   percentiles->max_us = reset ? histogram->max_us.exchange(0, std::memory_order_relaxed) :
+      histogram->max_us.load(std::memory_order_relaxed);
+
+   // The rank of p is ceil(p * count); its bucket bound never exceeds the max
+   percentiles->p50_us = 0;
+   percentiles->p99_us = 0;
+   uint64_t rank50 = (count * 50 + 99) / 100, rank99 = (count * 99 + 99) / 100;
+   uint64_t seen = 0;
+   for (uint32_t i = 0; i < TRACE_BUCKETS && count; i++)
+   {
+      uint64_t before = seen;
+      seen += counts[i];
+      uint64_t bound = bucket_upper(i) < percentiles->max_us ? bucket_upper(i) : percentiles->max_us;
+      if (before < rank50 && seen >= rank50) {
+         percentiles->p50_us = bound;
+      }
+      if (before < rank99 && seen >= rank99) {
+         percentiles->p99_us = bound;
+      }
+   }
+}
+
+const char * trace_phase_name(trace_phase_t phase)
+{
+   return TRACE_PHASE_NAMES[phase];
+}
+
+bool trace_write_chrome(const char * path, uint64_t * dropped)
+{
+   FILE * file = fopen(path, "w");
+   if (!file) {
+      return false;
+   }
+   *dropped = 0;
+   uint32_t session = trace.session.load(std::memory_order_acquire);
+   std::lock_guard<std::mutex> lock(trace.mutex);
+
+   fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+   bool first = true;
+   for (auto buffer : trace.buffers)
+   {
+      fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+            first ? "" : ",\n", buffer->tid, buffer->name);
+      first = false;
+      if (buffer->session != session) {
+         continue;
+      }
+      *dropped += buffer->dropped;
+      for (auto & event : buffer->events)
+      {
+         // Complete events, in microseconds since trace_start
+         fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"frame\": %u",
+               event.name, buffer->tid, (event.start_ns - trace.start_ns) / 1000.0, (event.end_ns - event.start_ns) / 1000.0, event.frame);
+         if (event.worker != TRACE_NO_WORKER) {
+            fprintf(file, ", \"x\": %d, \"y\": %d, \"worker\": %u", event.x, event.y, event.worker);
+         }
+         fprintf(file, "}}");
+      }
+   }
+   fprintf(file, "\n]}\n");
+   trace.written_session = session;
+   release_exited(false);
+   return fclose(file) == 0;
+}
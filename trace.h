@@ -0,0 +1,75 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <cstdint>
+
+// Low-overhead tracing. Every thread appends complete events to a buffer of
+// its own, so recording takes no lock; the buffers are read only by
+// trace_write_chrome, once the threads are idle. Independently of the
+// events, the time every frame spends in each phase goes into a log-linear
+// histogram for percentiles.
+
+enum trace_phase_t {
+   TRACE_PHASE_UPDATE,           // first update job start to last update job end
+   TRACE_PHASE_RENDER,           // the same for the render jobs
+   TRACE_PHASE_PRESENT,          // handing the pixels to the screen
+   TRACE_PHASE_COUNT
+};
+
+// What a job is for its trace event: a static name and the chunk or tile it
+// works on.
+struct trace_tag_t {
+   const char * name;
+   trace_phase_t phase;          // TRACE_PHASE_COUNT for jobs outside the phases
+   int32_t x;
+   int32_t y;
+};
+
+struct trace_percentiles_t {
+   uint64_t count;
+   uint64_t p50_us;              // bucket bounds, within 1/8 of the value
+   uint64_t p99_us;
+   uint64_t max_us;              // exact
+};
+
+const uint32_t TRACE_DEFAULT_EVENTS = 1 << 20;
+
+// Turns the phase histograms on and, with `events_per_thread` > 0, event
+// recording too; events past that many per thread are dropped. Clears
+// whatever an earlier trace recorded.
+void trace_start(uint32_t events_per_thread);
+
+void trace_stop();
+
+bool trace_enabled();
+
+uint64_t trace_now_ns();
+
+// Names the calling thread in the exported trace.
+void trace_thread_name(const char * name);
+
+// Called by a thread before it exits: its buffer is freed, or once written
+// if it holds events of the current trace that are not written yet.
+void trace_thread_exit();
+
+// A job run by job queue thread `worker` (0 = the thread that waits).
+void trace_job(const trace_tag_t * tag, uint32_t worker, uint64_t start_ns, uint64_t end_ns);
+
+// Any other span on the calling thread; `name` must be static.
+void trace_event(const char * name, uint64_t start_ns, uint64_t end_ns);
+
+// Closes the update and render phases of the frame whose jobs just finished.
+void trace_frame_end();
+
+void trace_phase_add(trace_phase_t phase, uint64_t us);
+
+void trace_get_percentiles(trace_phase_t phase, trace_percentiles_t * percentiles, bool reset);
+
+const char * trace_phase_name(trace_phase_t phase);
+
+// Chrome trace event JSON, for chrome://tracing or Perfetto. Returns false
+// if the file cannot be written; `dropped` gets the events that did not fit.
+// The events of threads that have exited are written only once.
+bool trace_write_chrome(const char * path, uint64_t * dropped);
+
+#endif // _TRACE_H
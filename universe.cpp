@@ -0,0 +1,407 @@
+#include "universe.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "packed_board.h"
+
+const size_t UNIVERSE_BLOCK_TILES = 256;
+const size_t UNIVERSE_INITIAL_BUCKETS = 1 << 10;
+
+// Empty tiles are kept around for a few generations so oscillators on a
+// tile border do not allocate and free the same tile every generation.
+const uint32_t TILE_IDLE_GENERATIONS = 16;
+
+struct universe_block_t {
+   universe_block_t * next;
+   tile_t tiles[UNIVERSE_BLOCK_TILES];
+};
+
+struct universe_t {
+   tile_t ** buckets;
+   size_t bucket_count;
+   universe_block_t * blocks;
+   size_t block_used;
+   tile_t * free_list;
+
+   tile_t ** tiles;                    // every allocated tile
+   uint32_t tile_count;
+   uint32_t tile_capacity;
+   tile_t ** active;                   // tiles updated this generation
+   uint32_t active_count;
+   bool neighbours_dirty;
+   uint32_t parity;
+};
+
+static const uint64_t empty_rows[TILE_SIZE] = {};
+
+static inline size_t universe_hash(int64_t tx, int64_t ty)
+{
+   uint64_t h = (uint64_t)tx * 0x9e3779b97f4a7c15ull + (uint64_t)ty;
+   h *= 0xbf58476d1ce4e5b9ull;
+   return (size_t)(h ^ (h >> 31));
+}
+
+static void universe_rehash(universe_t * universe, size_t bucket_count)
+{
+   tile_t ** buckets = (tile_t **)calloc(bucket_count, sizeof(tile_t *));
+   for (size_t i = 0; i < universe->bucket_count; i++)
+   {
+      tile_t * tile = universe->buckets[i];
+      while (tile) {
+         tile_t * next = tile->next;
+         size_t b = universe_hash(tile->tx, tile->ty) & (bucket_count - 1);
+         tile->next = buckets[b];
+         buckets[b] = tile;
+         tile = next;
+      }
+   }
+   free(universe->buckets);
+   universe->buckets = buckets;
+   universe->bucket_count = bucket_count;
+}
+
+static tile_t * universe_find(const universe_t * universe, int64_t tx, int64_t ty)
+{
+   size_t b = universe_hash(tx, ty) & (universe->bucket_count - 1);
+   for (tile_t * tile = universe->buckets[b]; tile; tile = tile->next)
+   {
+      if (tile->tx == tx && tile->ty == ty) {
+         return tile;
+      }
+   }
+   return NULL;
+}
+
+static tile_t * universe_alloc(universe_t * universe)
+{
+   if (universe->free_list) {
+      tile_t * tile = universe->free_list;
+      universe->free_list = tile->next;
+      return tile;
+   }
+   if (!universe->blocks || universe->block_used == UNIVERSE_BLOCK_TILES) {
+      universe_block_t * block = (universe_block_t *)malloc(sizeof(universe_block_t));
+      block->next = universe->blocks;
+      universe->blocks = block;
+      universe->block_used = 0;
+   }
+   return &universe->blocks->tiles[universe->block_used++];
+}
+
+static tile_t * universe_get(universe_t * universe, int64_t tx, int64_t ty)
+{
+   tile_t * tile = universe_find(universe, tx, ty);
+   if (tile) {
+      return tile;
+   }
+
+   tile = universe_alloc(universe);
+   memset(tile, 0, sizeof(*tile));
+   tile->tx = tx;
+   tile->ty = ty;
+
+   size_t b = universe_hash(tx, ty) & (universe->bucket_count - 1);
+   tile->next = universe->buckets[b];
+   universe->buckets[b] = tile;
+
+   if (universe->tile_count == universe->tile_capacity) {
+      universe->tile_capacity = universe->tile_capacity ? universe->tile_capacity * 2 : 64;
+      universe->tiles = (tile_t **)realloc(universe->tiles, universe->tile_capacity * sizeof(tile_t *));
+      universe->active = (tile_t **)realloc(universe->active, universe->tile_capacity * sizeof(tile_t *));
+   }
+   tile->index = universe->tile_count;
+   universe->tiles[universe->tile_count++] = tile;
+   universe->neighbours_dirty = true;
+
+   if (universe->tile_count > universe->bucket_count) {
+      universe_rehash(universe, universe->bucket_count * 2);
+   }
+   return tile;
+}
+
+static void universe_release(universe_t * universe, tile_t * tile)
+{
+   size_t b = universe_hash(tile->tx, tile->ty) & (universe->bucket_count - 1);
+   tile_t ** link = &universe->buckets[b];
+   while (*link != tile) {
+      link = &(*link)->next;
+   }
+   *link = tile->next;
+
+   tile_t * last = universe->tiles[--universe->tile_count];
+   last->index = tile->index;
+   universe->tiles[tile->index] = last;
+
+   tile->next = universe->free_list;
+   universe->free_list = tile;
+   universe->neighbours_dirty = true;
+}
+
+universe_t * universe_create()
+{
+   universe_t * universe = (universe_t *)calloc(1, sizeof(universe_t));
+   universe->bucket_count = UNIVERSE_INITIAL_BUCKETS;
+   universe->buckets = (tile_t **)calloc(universe->bucket_count, sizeof(tile_t *));
+   return universe;
+}
+
+void universe_destroy(universe_t * universe)
+{
+   universe_block_t * block = universe->blocks;
+   while (block) {
+      universe_block_t * next = block->next;
+      free(block);
+      block = next;
+   }
+   free(universe->buckets);
+   free(universe->tiles);
+   free(universe->active);
+   free(universe);
+}
+
+void universe_clear(universe_t * universe)
+{
+   while (universe->tile_count) {
+      universe_release(universe, universe->tiles[universe->tile_count - 1]);
+   }
+   universe->active_count = 0;
+   universe->parity = 0;
+}
+
+// New cells go into both generations so the tile stays consistent whether or
+// not it is updated next; it is flagged as changed so it will be.
+static inline void universe_or_word(universe_t * universe, int64_t tx, int64_t ty, int32_t row, uint64_t bits)
+{
+   tile_t * tile = universe_get(universe, tx, ty);
+   tile->population += packed_popcount(bits & ~tile->rows[universe->parity][row]);
+   tile->rows[0][row] |= bits;
+   tile->rows[1][row] |= bits;
+   tile->changed = true;
+   tile->idle_generations = 0;
+}
+
+void universe_set_cell(universe_t * universe, int64_t x, int64_t y)
+{
+   tile_t * tile = universe_get(universe, x >> 6, y >> 6);
+   uint64_t bit = 1ull << (x & 63);
+   if (!(tile->rows[universe->parity][y & 63] & bit)) {
+      tile->population++;
+   }
+   tile->rows[0][y & 63] |= bit;
+   tile->rows[1][y & 63] |= bit;
+   tile->changed = true;
+   tile->idle_generations = 0;
+}
+
+void universe_set_run(universe_t * universe, int64_t x, int64_t y, int64_t length)
+{
+   while (length > 0) {
+      int32_t bit = (int32_t)(x & 63);
+      int64_t count = (64 - bit < length) ? 64 - bit : length;
+      uint64_t bits = (count == 64) ? ~0ull : (((1ull << count) - 1) << bit);
+      universe_or_word(universe, x >> 6, y >> 6, (int32_t)(y & 63), bits);
+      x += count;
+      length -= count;
+   }
+}
+
+void universe_set_tile(universe_t * universe, int64_t tx, int64_t ty, const uint64_t * rows)
+{
+   for (auto y = 0; y < TILE_SIZE; y++)
+   {
+      if (rows[y]) {
+         universe_or_word(universe, tx, ty, y, rows[y]);
+      }
+   }
+}
+
+void universe_load(universe_t * universe, const board_t * board)
+{
+   for (auto y = 1; y <= board->height; y++)
+   {
+      const uint32_t * row = board_row(board, y);
+      for (auto start = 0; start <= board->width; start += 64)
+      {
+         uint64_t word = 0;
+         for (auto i = 0; i < 64 && start + i <= board->width; i++)
+         {
+            word |= (uint64_t)(row[start + i] & 1) << i;
+         }
+         if (word) {
+            universe_or_word(universe, start >> 6, y >> 6, y & 63, word);
+         }
+      }
+   }
+}
+
+static void universe_link_neighbours(universe_t * universe)
+{
+   for (uint32_t i = 0; i < universe->tile_count; i++)
+   {
+      tile_t * tile = universe->tiles[i];
+      for (auto dy = -1; dy <= 1; dy++)
+      {
+         for (auto dx = -1; dx <= 1; dx++)
+         {
+            tile->neighbours[(dy + 1) * 3 + dx + 1] = (dx || dy) ?
+               universe_find(universe, tile->tx + dx, tile->ty + dy) : tile;
+         }
+      }
+   }
+   universe->neighbours_dirty = false;
+}
+
+// Keeps the tile alive as long as a neighbour has live cells against it.
+static inline void universe_touch(universe_t * universe, int64_t tx, int64_t ty)
+{
+   universe_get(universe, tx, ty)->idle_generations = 0;
+}
+
+// Cells on the border of a live tile can give birth in the tiles next to it,
+// so those have to exist before the generation is computed.
+static void universe_grow(universe_t * universe)
+{
+   uint32_t count = universe->tile_count;
+   for (uint32_t i = 0; i < count; i++)
+   {
+      tile_t * tile = universe->tiles[i];
+      if (!tile->population) {
+         continue;
+      }
+      const uint64_t * rows = tile->rows[universe->parity];
+      uint64_t columns = 0;
+      for (auto y = 0; y < TILE_SIZE; y++)
+      {
+         columns |= rows[y];
+      }
+      bool north = rows[0] != 0;
+      bool south = rows[TILE_SIZE - 1] != 0;
+      bool west = columns & 1;
+      bool east = columns >> 63;
+      int64_t tx = tile->tx, ty = tile->ty;
+
+      if (north) universe_touch(universe, tx, ty - 1);
+      if (south) universe_touch(universe, tx, ty + 1);
+      if (west) universe_touch(universe, tx - 1, ty);
+      if (east) universe_touch(universe, tx + 1, ty);
+      if (rows[0] & 1) universe_touch(universe, tx - 1, ty - 1);
+      if (rows[0] >> 63) universe_touch(universe, tx + 1, ty - 1);
+      if (rows[TILE_SIZE - 1] & 1) universe_touch(universe, tx - 1, ty + 1);
+      if (rows[TILE_SIZE - 1] >> 63) universe_touch(universe, tx + 1, ty + 1);
+   }
+}
+
+uint32_t universe_prepare(universe_t * universe)
+{
+   universe_grow(universe);
+   if (universe->neighbours_dirty) {
+      universe_link_neighbours(universe);
+   }
+
+   // A tile is updated when anything in its 3x3 neighbourhood changed; the
+   // others keep identical rows in both generations.
+   universe->active_count = 0;
+   for (uint32_t i = 0; i < universe->tile_count; i++)
+   {
+      tile_t * tile = universe->tiles[i];
+      bool active = false;
+      for (auto n = 0; n < 9 && !active; n++)
+      {
+         active = tile->neighbours[n] && tile->neighbours[n]->changed;
+      }
+      if (active) {
+         universe->active[universe->active_count++] = tile;
+      }
+   }
+   for (uint32_t i = 0; i < universe->tile_count; i++)
+   {
+      universe->tiles[i]->changed = false;
+   }
+   return universe->active_count;
+}
+
+tile_t * universe_active_tile(const universe_t * universe, uint32_t i)
+{
+   return universe->active[i];
+}
+
+void universe_update_tile(const universe_t * universe, tile_t * tile)
+{
+   uint32_t current = universe->parity;
+   const uint64_t * rows[9];
+   for (auto n = 0; n < 9; n++)
+   {
+      rows[n] = tile->neighbours[n] ? tile->neighbours[n]->rows[current] : empty_rows;
+   }
+   const uint64_t * mid = rows[4];
+   uint64_t * out = tile->rows[current ^ 1];
+   uint32_t population = 0;
+   bool changed = false;
+
+   for (auto y = 0; y < TILE_SIZE; y++)
+   {
+      // West, center and east words of the rows above, at and below y
+      uint64_t uw, uc, ue, dw, dc, de;
+      if (y == 0) {
+         uw = rows[0][TILE_SIZE - 1]; uc = rows[1][TILE_SIZE - 1]; ue = rows[2][TILE_SIZE - 1];
+      } else {
+         uw = rows[3][y - 1]; uc = mid[y - 1]; ue = rows[5][y - 1];
+      }
+      if (y == TILE_SIZE - 1) {
+         dw = rows[6][0]; dc = rows[7][0]; de = rows[8][0];
+      } else {
+         dw = rows[3][y + 1]; dc = mid[y + 1]; de = rows[5][y + 1];
+      }
+      uint64_t mw = rows[3][y], mc = mid[y], me = rows[5][y];
+
+      uint64_t next = packed_life_word(
+            packed_west(uw, uc), uc, packed_east(uc, ue),
+            packed_west(mw, mc), mc, packed_east(mc, me),
+            packed_west(dw, dc), dc, packed_east(dc, de));
+      changed |= next != mc;
+      population += packed_popcount(next);
+      out[y] = next;
+   }
+
+   tile->population = population;
+   tile->changed = changed;
+}
+
+void universe_finish(universe_t * universe)
+{
+   universe->parity ^= 1;
+
+   for (uint32_t i = 0; i < universe->tile_count; )
+   {
+      tile_t * tile = universe->tiles[i];
+      if (tile->population) {
+         tile->idle_generations = 0;
+      } else if (++tile->idle_generations >= TILE_IDLE_GENERATIONS && !tile->changed) {
+         universe_release(universe, tile);
+         continue;
+      }
+      i++;
+   }
+}
+
+tile_t * const * universe_tiles(const universe_t * universe, size_t * count)
+{
+   *count = universe->tile_count;
+   return universe->tiles;
+}
+
+uint64_t universe_population(const universe_t * universe)
+{
+   uint64_t population = 0;
+   for (uint32_t i = 0; i < universe->tile_count; i++)
+   {
+      population += universe->tiles[i]->population;
+   }
+   return population;
+}
+
+uint32_t universe_parity(const universe_t * universe)
+{
+   return universe->parity;
+}
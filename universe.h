@@ -0,0 +1,73 @@
+#ifndef _UNIVERSE_H
+#define _UNIVERSE_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "board.h"
+
+// Unbounded plane kept as a hash map of TILE_SIZE x TILE_SIZE bit-packed
+// tiles. A tile is allocated when live cells reach its border and goes back
+// to the pool after staying empty for a while, so memory and work follow the
+// live area rather than its bounding box.
+//
+// A generation is universe_prepare (grows the map and picks the tiles to
+// update), universe_update_tile for every active tile, which may run
+// concurrently, and universe_finish.
+
+const int32_t TILE_SIZE = 64;
+
+struct tile_t {
+   int64_t tx;                         // cell (x, y) lives in tile (x >> 6, y >> 6)
+   int64_t ty;
+   uint64_t rows[2][TILE_SIZE];        // bit i of a row is cell tx * 64 + i
+   tile_t * neighbours[9];             // 3x3 around and including this tile, NULL if absent
+   tile_t * next;                      // hash chain / free list
+   uint32_t index;                     // position in the tile list
+   uint32_t population;
+   uint32_t idle_generations;
+   bool changed;                       // differs from the previous generation
+};
+
+struct universe_t;
+
+universe_t * universe_create();
+
+void universe_destroy(universe_t * universe);
+
+void universe_clear(universe_t * universe);
+
+// Adds the live cells of `board` at their board coordinates.
+void universe_load(universe_t * universe, const board_t * board);
+
+void universe_set_cell(universe_t * universe, int64_t x, int64_t y);
+
+// Sets the cells [x, x + length) of row y.
+void universe_set_run(universe_t * universe, int64_t x, int64_t y, int64_t length);
+
+// Adds the live cells of a whole tile, bit i of rows[r] being cell
+// (tx * 64 + i, ty * 64 + r).
+void universe_set_tile(universe_t * universe, int64_t tx, int64_t ty, const uint64_t * rows);
+
+// Returns the number of tiles to update this generation.
+uint32_t universe_prepare(universe_t * universe);
+
+tile_t * universe_active_tile(const universe_t * universe, uint32_t i);
+
+void universe_update_tile(const universe_t * universe, tile_t * tile);
+
+void universe_finish(universe_t * universe);
+
+tile_t * const * universe_tiles(const universe_t * universe, size_t * count);
+
+uint64_t universe_population(const universe_t * universe);
+
+uint32_t universe_parity(const universe_t * universe);
+
+// Rows of the current generation.
+static inline const uint64_t * universe_tile_rows(const universe_t * universe, const tile_t * tile)
+{
+   return tile->rows[universe_parity(universe)];
+}
+
+#endif // _UNIVERSE_H